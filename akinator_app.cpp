@@ -1,60 +1,376 @@
 #include <stdio.h>
+#include <string.h>
 #include <stdlib.h>
+#include <assert.h>
+
+#include <chrono>
+#include <thread>
 
 #include "tree.h"
 #include "speech.h"
 #include "graphics.h"
 #include "tree_tests.h"
 #include "akinator_app.h"
+#include "phrase_filter.h"
+#include "tree_compact.h"
+#include "tree_dump.h"
+#include "tree_merge.h"
+#include "tree_diff.h"
+#include "tree_induction.h"
+#include "tree_export.h"
+#include "tree_registry.h"
+#include "tree_history.h"
+#include "tree_snapshot.h"
+#include "metrics.h"
+#include "trace.h"
+#include "startup_profiler.h"
 #include "tree_error_type.h"
 
 
 static const char* DEFAULT_DATABASE = "akinator_database.txt";
+static const char* DEFAULT_DATABASE_NAME = "default";
 static const char* EXPORT_FILENAME = "akinator_tree.txt";
+static const char* FORBIDDEN_PHRASES_FILE = "forbidden_phrases.txt";
 
 
-bool initialize_akinator_app()
+bool parse_akinator_options(int argc, char* argv[], akinator_options_t* options)
 {
-    initialization_graphics();
-    printf("Graphics initialized successfully\n\n");
+    assert(argv    != NULL);
+    assert(options != NULL);
 
-    test_akinator();
-    printf("Database created successfully\n\n");
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--self-test") == 0)
+        {
+            options -> run_self_test = true;
+        }
+        else if (strcmp(argv[i], "--low-memory") == 0)
+        {
+            options -> low_memory_frames = true;
+        }
+        else if (strcmp(argv[i], "--merge") == 0 && i + 3 < argc)
+        {
+            options -> merge_first  = argv[++i];
+            options -> merge_second = argv[++i];
+            options -> merge_output = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--diff") == 0 || strcmp(argv[i], "--diff-json") == 0) && i + 2 < argc)
+        {
+            options -> diff_json = strcmp(argv[i], "--diff-json") == 0;
+            options -> diff_old  = argv[++i];
+            options -> diff_new  = argv[++i];
+        }
+        else if (strcmp(argv[i], "--import") == 0 && i + 2 < argc)
+        {
+            options -> import_table  = argv[++i];
+            options -> import_output = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--export-ndjson") == 0 || strcmp(argv[i], "--export-ndjson-paths") == 0) && i + 2 < argc)
+        {
+            options -> export_paths    = strcmp(argv[i], "--export-ndjson-paths") == 0;
+            options -> export_database = argv[++i];
+            options -> export_output   = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+        {
+            options -> metrics_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics-period") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            options -> metrics_period_ms = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            options -> trace_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--database") == 0 && i + 1 < argc && strchr(argv[i + 1], '=') != NULL &&
+                 options -> number_of_databases < MAX_NUMBER_OF_TREES)
+        {
+            options -> databases[options -> number_of_databases++] = argv[++i];
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[i]);
+            printf("Usage: %s [--self-test] [--low-memory] [--database name=file]... [--merge first second output] [--diff|--diff-json old new] [--import table.csv output] [--export-ndjson|--export-ndjson-paths database output] [--metrics file.prom [--metrics-period ms]] [--trace trace.json]\n", argv[0]);
+            return false;
+        }
+    }
 
     return true;
 }
 
 
-bool load_or_create_database(tree_t* tree)
+bool run_merge_tool(const akinator_options_t* options)
 {
-    tree_error_type result = tree_constructor(tree);
+    assert(options                != NULL);
+    assert(options -> merge_first != NULL);
+
+    merge_report_t report = {};
+
+    tree_error_type result = merge_databases(options -> merge_first, options -> merge_second,
+                                             options -> merge_output, stdout, &report);
     if (result != TREE_NO_ERROR)
     {
-        printf("Error initializing tree: %s\n", tree_error_translator(result));
+        printf("Merge failed: %s\n", tree_error_translator(result));
         return false;
     }
 
-    tree_error_type load_result = load_tree_from_file(tree, DEFAULT_DATABASE);
+    merge_report_print(&report, stdout);
+    printf("Merged database saved to %s\n", options -> merge_output);
 
-    if (load_result != TREE_NO_ERROR)
+    return true;
+}
+
+
+bool run_diff_tool(const akinator_options_t* options)
+{
+    assert(options             != NULL);
+    assert(options -> diff_old != NULL);
+
+    tree_t old_tree = {};
+    tree_t new_tree = {};
+    tree_diff_t diff = {};
+
+    tree_error_type result = load_tree_from_file(&old_tree, options -> diff_old);
+    if (result == TREE_NO_ERROR)
+        result = load_tree_from_file(&new_tree, options -> diff_new);
+    if (result == TREE_NO_ERROR)
+        result = tree_diff(&old_tree, &new_tree, &diff);
+
+    if (result == TREE_NO_ERROR)
+    {
+        if (options -> diff_json)
+            tree_diff_write_json(&diff, stdout);
+        else
+            tree_diff_print(&diff, stdout);
+    }
+    else
     {
-        animate_question("Database isn't found. Creating new database...");
-        printf("Database isn't found. Creating new database...");
+        printf("Diff failed: %s\n", tree_error_translator(result));
+    }
 
-        result = save_tree_to_file(tree, DEFAULT_DATABASE);
-        if (result != TREE_NO_ERROR)
+    tree_diff_destroy(&diff);
+    tree_destructor(&old_tree);
+    tree_destructor(&new_tree);
+
+    return result == TREE_NO_ERROR;
+}
+
+
+bool run_import_tool(const akinator_options_t* options)
+{
+    assert(options                 != NULL);
+    assert(options -> import_table != NULL);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    induction_table_t table = {};
+    induction_report_t report = {};
+    tree_t tree = {};
+
+    tree_error_type result = induction_table_load_csv(options -> import_table, &table);
+    if (result == TREE_NO_ERROR)
+    {
+        printf("Read %zu objects with %zu features\n", table.number_of_objects, table.number_of_features);
+        result = induce_tree(&table, 0, &tree, &report);
+    }
+    if (result == TREE_NO_ERROR)
+        result = save_tree_to_file(&tree, options -> import_output);
+
+    if (result == TREE_NO_ERROR)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        induction_report_print(&report, stdout);
+        printf("Induced database saved to %s in %.2f s\n", options -> import_output, elapsed.count());
+    }
+    else
+    {
+        printf("Import failed: %s\n", tree_error_translator(result));
+    }
+
+    induction_table_destroy(&table);
+    tree_destructor(&tree);
+
+    return result == TREE_NO_ERROR;
+}
+
+
+bool run_export_tool(const akinator_options_t* options)
+{
+    assert(options                    != NULL);
+    assert(options -> export_database != NULL);
+
+    bool to_stdout = strcmp(options -> export_output, "-") == 0;
+
+    tree_t tree = {};
+    tree_export_report_t report = {};
+
+    tree_error_type result = load_tree_from_file(&tree, options -> export_database);
+    if (result == TREE_NO_ERROR)
+    {
+        FILE* output = to_stdout ? stdout : fopen(options -> export_output, "wb");
+        if (output == NULL)
         {
-            printf("Error creating database: %s\n", tree_error_translator(result));
-            return false;
+            result = TREE_ERROR_OPENING_FILE;
+        }
+        else
+        {
+            result = tree_export_ndjson(&tree, output, options -> export_paths, &report);
+            if (!to_stdout && fclose(output) != 0 && result == TREE_NO_ERROR)
+                result = TREE_ERROR_OPENING_FILE;
         }
-        printf("New database created successfully!\n");
     }
+
+    // в stdout идут сами записи, поэтому сообщения - в stderr
+    FILE* messages = to_stdout ? stderr : stdout;
+    if (result == TREE_NO_ERROR)
+        fprintf(messages, "Exported %zu nodes and %zu paths (%zu bytes) to %s\n", report.number_of_nodes,
+                report.number_of_paths, report.bytes_written, options -> export_output);
     else
+        fprintf(messages, "Export failed: %s\n", tree_error_translator(result));
+
+    tree_destructor(&tree);
+
+    return result == TREE_NO_ERROR;
+}
+
+
+// Без --database играем с одной базой по умолчанию, как раньше
+bool register_databases(tree_registry_t* registry, const akinator_options_t* options)
+{
+    assert(registry != NULL);
+    assert(options  != NULL);
+
+    if (options -> number_of_databases == 0)
+        return tree_registry_add(registry, DEFAULT_DATABASE_NAME, DEFAULT_DATABASE) == TREE_NO_ERROR;
+
+    for (size_t i = 0; i < options -> number_of_databases; i++)
+    {
+        const char* specification = options -> databases[i];
+        const char* separator = strchr(specification, '=');
+
+        char name[MAX_LENGTH_OF_TREE_NAME] = {};
+        size_t name_length = (size_t)(separator - specification);
+
+        if (name_length == 0 || name_length >= sizeof(name))
+        {
+            printf("Bad database name in %s\n", specification);
+            return false;
+        }
+        memcpy(name, specification, name_length);
+
+        if (tree_registry_add(registry, name, separator + 1) != TREE_NO_ERROR)
+        {
+            printf("Cannot register database %s\n", specification);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool initialize_akinator_app(tree_registry_t* registry, const akinator_options_t* options)
+{
+    assert(registry != NULL);
+    assert(options  != NULL);
+
+    startup_profiler_t profiler;
+    startup_profiler_start(&profiler);
+
+    if (options -> trace_file != NULL && !trace_start(options -> trace_file))
+        printf("Cannot write trace to %s\n", options -> trace_file);
+    TRACE_THREAD_NAME("game");
+
+    if (options -> metrics_file != NULL && !metrics_exporter_start(options -> metrics_file, options -> metrics_period_ms))
+        printf("Cannot write metrics to %s\n", options -> metrics_file);
+
+    if (tree_registry_init(registry) != TREE_NO_ERROR || !register_databases(registry, options))
+        return false;
+
+    // база грузится параллельно с созданием окна: друг от друга они не зависят.
+    // Остальные базы грузятся, когда их выберут в меню
+    bool database_ready = false;
+    bool database_created = false;
+    std::thread database_loader([&]
+    {
+        TRACE_THREAD_NAME("database loader");
+        size_t phase = startup_phase_begin(&profiler, "database load");
+        database_ready = load_or_create_database(registry, &registry -> entries[0], &database_created);
+        startup_phase_end(&profiler, phase);
+    });
+
+    size_t phase = startup_phase_begin(&profiler, "graphics init");
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
+    if (options -> low_memory_frames)
+        set_frame_cache_mode(FRAME_CACHE_CURRENT_STATE);
+#endif
+    initialization_graphics();
+    startup_phase_end(&profiler, phase);
+    printf("Graphics initialized successfully\n\n");
+
+    phase = startup_phase_begin(&profiler, "phrase filter");
+    tree_error_type filter_result = initialize_negative_phrase_filter(FORBIDDEN_PHRASES_FILE);
+    startup_phase_end(&profiler, phase);
+
+    if (options -> run_self_test)
+    {
+        phase = startup_phase_begin(&profiler, "self-test");
+        size_t failures = test_akinator();
+        startup_phase_end(&profiler, phase);
+
+        if (failures != 0)
+        {
+            database_loader.join();
+            return false;
+        }
+    }
+
+    database_loader.join();
+
+    if (filter_result != TREE_NO_ERROR)
     {
-        animate_question("Database loaded successfully!");
-        printf("Database loaded successfully! (%zu nodes)\n", tree -> size);
+        printf("Error: cannot build forbidden phrases filter\n");
+        return false;
     }
 
+    if (!database_ready)
+        return false;
+
+    animate_question(database_created ? "Database isn't found. Using the built-in database"
+                                      : "Database loaded successfully!");
+
+    startup_profiler_report(&profiler, stdout);
+
+    return true;
+}
+
+
+// После разбора дерево уплотняется (узлы разбросаны по куче вперемешку с буферами),
+// а его фразы уходят в общий пул всех баз
+bool load_or_create_database(tree_registry_t* registry, tree_registry_entry_t* entry, bool* created)
+{
+    assert(registry != NULL);
+    assert(entry    != NULL);
+    assert(created  != NULL);
+
+    tree_error_type result = tree_registry_load(registry, entry, created);
+    if (result != TREE_NO_ERROR)
+    {
+        printf("Error loading database %s: %s\n", entry -> name, tree_error_translator(result));
+        return false;
+    }
+
+    // выученное за игры можно отменить, не перечитывая базу
+    if (tree_history_create(&entry -> tree) != TREE_NO_ERROR)
+        printf("Undo is unavailable for %s\n", entry -> name);
+
+    if (*created)
+        printf("Database %s isn't found. Starting from the built-in database (%zu nodes)\n", entry -> filename, entry -> tree.size);
+    else
+        printf("Database %s loaded successfully! (%zu nodes)\n", entry -> name, entry -> tree.size);
+
     return true;
 }
 
@@ -76,15 +392,31 @@ void handle_play_game(tree_t* tree)
 }
 
 
-void handle_save_database(tree_t* tree)
+// База по умолчанию выгружается, как раньше, в EXPORT_FILENAME, базы из --database - каждая в свой файл
+static void make_export_filename(const tree_registry_entry_t* entry, char* filename, size_t filename_size)
+{
+    if (strcmp(entry -> name, DEFAULT_DATABASE_NAME) == 0)
+        snprintf(filename, filename_size, "%s", EXPORT_FILENAME);
+    else
+        snprintf(filename, filename_size, "akinator_tree_%s.txt", entry -> name);
+}
+
+
+void handle_save_database(tree_registry_entry_t* entry)
 {
+    assert(entry != NULL);
+
     set_game_state_background(STATE_SAVING);
     animate_question("Saving database...");
 
-    tree_error_type result = save_tree_to_file(tree, EXPORT_FILENAME);
+    char filename[MAX_LENGTH_OF_FILENAME] = {};
+    make_export_filename(entry, filename, sizeof(filename));
+
+    // пишет рабочий поток, об окончании сообщит report_finished_saves в меню
+    tree_error_type result = tree_snapshot_save(&entry -> tree, filename);
     if (result == TREE_NO_ERROR)
     {
-        speak_print_with_variable_number_of_parameters("Tree successfully saved to %s\n", EXPORT_FILENAME);
+        speak_print_with_variable_number_of_parameters("Saving tree to %s in background\n", filename);
     }
     else
     {
@@ -122,6 +454,66 @@ void handle_exit_program(tree_t* tree)
 }
 
 
+// Базу выбирают перед игрой: она грузится при первом выборе, уже загруженные остаются в памяти
+void handle_choose_database(tree_registry_t* registry, tree_registry_entry_t** current)
+{
+    assert(registry != NULL);
+    assert(current  != NULL);
+
+    printf("\nDatabases:\n");
+    tree_registry_print(registry, stdout);
+
+    char name[MAX_LENGTH_OF_TREE_NAME] = {};
+    get_input_without_negatives("Enter database name: ", name, sizeof(name));
+
+    tree_registry_entry_t* entry = tree_registry_find(registry, name);
+    if (entry == NULL)
+    {
+        speak_print_with_variable_number_of_parameters("Unknown database: %s\n", name);
+        return;
+    }
+
+    bool created = false;
+    if (!entry -> is_loaded && !load_or_create_database(registry, entry, &created))
+        return;
+
+    *current = entry;
+    speak_print_with_variable_number_of_parameters("Now playing with %s\n", entry -> name);
+}
+
+
+void handle_undo_learning(tree_t* tree)
+{
+    const tree_split_record_t* record = NULL;
+
+    if (tree_undo_split(tree, &record) != TREE_NO_ERROR)
+    {
+        speak_print_with_variable_number_of_parameters("Nothing to undo\n");
+        return;
+    }
+
+    speak_print_with_variable_number_of_parameters("Forgot %s: no more \"%s\" before %s (%zu more to undo)\n",
+                                                   record -> yes -> question, record -> other_question,
+                                                   record -> node -> question, tree_history_undo_count(tree));
+}
+
+
+void handle_redo_learning(tree_t* tree)
+{
+    const tree_split_record_t* record = NULL;
+
+    if (tree_redo_split(tree, &record) != TREE_NO_ERROR)
+    {
+        speak_print_with_variable_number_of_parameters("Nothing to redo\n");
+        return;
+    }
+
+    speak_print_with_variable_number_of_parameters("Remembered %s again: \"%s\" before %s (%zu more to redo)\n",
+                                                   record -> node -> yes -> question, record -> node -> question,
+                                                   record -> node -> no -> question, tree_history_redo_count(tree));
+}
+
+
 void handle_invalid_choice()
 {
     animate_question("Invalid option. Please try again.");
@@ -129,16 +521,20 @@ void handle_invalid_choice()
 }
 
 
-void handle_menu_choice(tree_t* tree, int choice)
+void handle_menu_choice(tree_registry_entry_t* entry, int choice)
 {
+    tree_t* tree = &entry -> tree;
+
     switch (choice)
     {
         case 1: handle_play_game(tree);         break;
-        case 2: handle_save_database(tree);     break;
+        case 2: handle_save_database(entry);    break;
         case 3: handle_show_tree(tree);         break;
         case 4: handle_object_definition(tree); break;
         case 5: handle_object_comparison(tree); break;
         case 6: handle_exit_program(tree);      break;
+        case 8: handle_undo_learning(tree);     break;
+        case 9: handle_redo_learning(tree);     break;
         default: handle_invalid_choice();       break;
     }
 }
@@ -162,37 +558,84 @@ int get_user_choice()
 }
 
 
-void run_akinator_loop(tree_t* tree)
+void report_finished_saves(tree_registry_t* registry)
 {
+    assert(registry != NULL);
+
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+    {
+        tree_snapshot_report_t report = {};
+        if (tree_snapshot_poll(&registry -> entries[i].tree, &report))
+            tree_snapshot_report_print(&report, stdout);
+    }
+}
+
+
+void run_akinator_loop(tree_registry_t* registry)
+{
+    assert(registry != NULL);
+
+    tree_registry_entry_t* current = &registry -> entries[0];
     int choice = 0;
 
     do
     {
         set_game_state_background(STATE_MAIN_MENU);
 
+        // в меню никто не держит указателей на узлы, можно переложить выученное за игру
+        tree_compact_if_needed(&current -> tree);
+
+        report_finished_saves(registry);
+
         choice = get_user_choice();
         if (choice == 0)
             continue;
 
-        handle_menu_choice(tree, choice);
+        if (choice == 7)
+            handle_choose_database(registry, &current);
+        else
+            handle_menu_choice(current, choice);
 
     } while (choice != 6);
 }
 
 
-void save_before_exit(tree_t* tree)
+void save_before_exit(tree_registry_t* registry)
 {
     animate_question("Saving database before exit...");
     speak_print_with_variable_number_of_parameters("Saving database before exit...\n");
-    save_tree_to_file(tree, DEFAULT_DATABASE);
+
+    // все базы пишутся одновременно, каждая своим потоком
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+    {
+        tree_registry_entry_t* entry = &registry -> entries[i];
+        if (!entry -> is_loaded)
+            continue;
+
+        tree_error_type result = tree_snapshot_save(&entry -> tree, entry -> filename);
+        if (result != TREE_NO_ERROR)
+            printf("Error saving %s: %s\n", entry -> filename, tree_error_translator(result));
+    }
+
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+    {
+        tree_snapshot_report_t report = {};
+        if (tree_snapshot_wait(&registry -> entries[i].tree, &report))
+            tree_snapshot_report_print(&report, stdout);
+    }
 }
 
 
-void cleanup_akinator_app(tree_t* tree)
+void cleanup_akinator_app(tree_registry_t* registry)
 {
-    save_before_exit(tree);
-    tree_destructor(tree);
+    save_before_exit(registry);
+    metrics_exporter_stop(); // после сохранения, чтобы оно попало в последний файл
+    tree_registry_destroy(registry);
+    destroy_negative_phrase_filter();
     close_graphics();
 
+    dump_worker_flush();
+    trace_stop(); // когда потоки отрисовки и дампов уже всё записали
+
     printf("Graphics closed successfully\n");
 }
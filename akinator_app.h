@@ -2,22 +2,61 @@
 #define AKINATOR_APP_H_
 
 #include "tree.h"
+#include "tree_registry.h"
 #include "tree_error_type.h"
 
+struct akinator_options_t
+{
+    bool run_self_test;     // прогнать test_akinator перед игрой (раньше - при каждом запуске)
+    bool low_memory_frames; // держать в памяти только кадр текущего состояния
 
-bool initialize_akinator_app(void);
-bool load_or_create_database(tree_t* tree);
+    const char* databases[MAX_NUMBER_OF_TREES]; // --database name=file, первая грузится при запуске
+    size_t number_of_databases;
+
+    const char* merge_first;  // --merge: слить две базы в третью и выйти, без окна и игры
+    const char* merge_second;
+    const char* merge_output;
+
+    const char* diff_old;  // --diff: что изменилось между двумя снимками базы, и выйти
+    const char* diff_new;
+    bool diff_json;        // --diff-json: то же, но по записи JSON на строку
+
+    const char* import_table;  // --import: построить базу по CSV-таблице признаков, и выйти
+    const char* import_output;
+
+    const char* export_database; // --export-ndjson: база в NDJSON для аналитики, "-" - в stdout
+    const char* export_output;
+    bool export_paths;           // --export-ndjson-paths: ещё и путь к каждому листу
+
+    const char* metrics_file;    // --metrics: периодически писать метрики в формате Prometheus
+    unsigned metrics_period_ms;  // --metrics-period, 0 - METRICS_DEFAULT_PERIOD_MS
+
+    const char* trace_file;      // --trace: спаны горячих мест в Chrome Trace JSON, пишется при выходе
+};
+
+bool parse_akinator_options(int argc, char* argv[], akinator_options_t* options);
+bool run_merge_tool(const akinator_options_t* options);
+bool run_diff_tool(const akinator_options_t* options);
+bool run_import_tool(const akinator_options_t* options);
+bool run_export_tool(const akinator_options_t* options);
+bool initialize_akinator_app(tree_registry_t* registry, const akinator_options_t* options);
+bool register_databases(tree_registry_t* registry, const akinator_options_t* options);
+bool load_or_create_database(tree_registry_t* registry, tree_registry_entry_t* entry, bool* created);
 void handle_play_game(tree_t* tree);
-void handle_save_database(tree_t* tree);
+void handle_save_database(tree_registry_entry_t* entry);
 void handle_show_tree(tree_t* tree);
 void handle_object_definition(tree_t* tree);
 void handle_object_comparison(tree_t* tree);
 void handle_exit_program(tree_t* tree);
+void handle_undo_learning(tree_t* tree);
+void handle_redo_learning(tree_t* tree);
+void handle_choose_database(tree_registry_t* registry, tree_registry_entry_t** current);
 void handle_invalid_choice();
-void handle_menu_choice(tree_t* tree, int choice);
+void handle_menu_choice(tree_registry_entry_t* entry, int choice);
 int get_user_choice();
-void run_akinator_loop(tree_t* tree);
-void save_before_exit(tree_t* tree);
-void cleanup_akinator_app(tree_t* tree);
+void report_finished_saves(tree_registry_t* registry);
+void run_akinator_loop(tree_registry_t* registry);
+void save_before_exit(tree_registry_t* registry);
+void cleanup_akinator_app(tree_registry_t* registry);
 
 #endif // AKINATOR_APP_H_
@@ -1,4 +1,12 @@
-files="main.cpp tree.cpp tree_tests.cpp"
+# ./compile.sh [headless|console] - сборка под Linux, TXLib не нужен
+backend="PRESENTATION_NONE"
+output="akinator_headless"
+if [ "$1" = "console" ]; then
+    backend="PRESENTATION_CONSOLE"
+    output="akinator_console"
+fi
+
+files="main.cpp tree.cpp tree_tests.cpp speech.cpp graphics.cpp akinator_app.cpp phrase_filter.cpp presentation_queue.cpp startup_profiler.cpp tree_dump.cpp tree_verifier.cpp tree_compact.cpp packed_tree.cpp tree_merge.cpp tree_diff.cpp string_pool.cpp tree_registry.cpp tree_history.cpp tree_induction.cpp tree_export.cpp tree_snapshot.cpp metrics.cpp trace.cpp tree_memory.cpp tree_parser.cpp tree_scan.cpp tree_embedded.cpp"
 
 flags="-D _DEBUG -ggdb3 -std=c++17 -O0 -Wall -Wextra -Weffc++ -Waggressive-loop-optimizations \
     -Wc++14-compat -Wmissing-declarations -Wcast-align -Wcast-qual -Wchar-subscripts \
@@ -14,4 +22,10 @@ flags="-D _DEBUG -ggdb3 -std=c++17 -O0 -Wall -Wextra -Weffc++ -Waggressive-loop-
     -fstack-protector -fstrict-overflow -flto-odr-type-merging -fno-omit-frame-pointer \
     -Wlarger-than=8192 -Wstack-usage=8192 -pie -fPIE -Werror=vla \
     -fsanitize=address,alignment,bool,bounds,enum,float-cast-overflow,float-divide-by-zero,integer-divide-by-zero,leak,nonnull-attribute,null,object-size,return,returns-nonnull-attribute,shift,signed-integer-overflow,undefined,unreachable,vla-bound,vptr"
-g++ $files -o akinator $flags
+# встроенная база собирается из akinator_seed.txt, как в make: заголовок не должен от неё отставать
+seed="akinator_seed.txt"
+if [ "$seed" -nt tree_embedded_data.h ]; then
+    g++ -std=c++11 -O2 tree_embed.cpp tree_parser.cpp tree_scan.cpp -o tree_embed && ./tree_embed $seed tree_embedded_data.h || exit 1
+fi
+
+g++ $files -o $output $flags -pthread -D PRESENTATION_BACKEND=$backend
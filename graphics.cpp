@@ -1,63 +1,75 @@
-#include <TXLib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <assert.h>
 
 #include "graphics.h"
+#include "presentation_queue.h"
+
+
+const char* get_game_state_caption(int state)
+{
+    switch(state)
+    {
+        case STATE_MAIN_MENU:  return "Main Menu - Choose an option";
+        case STATE_PLAYING:    return "Game in progress - Think of something!";
+        case STATE_SHOW_TREE:  return "Showing tree structure";
+        case STATE_DEFINITION: return "Finding object definition";
+        case STATE_COMPARISON: return "Comparing two objects";
+        case STATE_SAVING:     return "Saving database...";
+        default:               return "Akinator Game";
+    }
+}
+
+
+int get_game_state_frame(int state)
+{
+    switch(state)
+    {
+        case STATE_PLAYING:    return 1;
+        case STATE_SHOW_TREE:  return 2;
+        case STATE_DEFINITION: return 3;
+        case STATE_COMPARISON: return 4;
+        default:               return 0;
+    }
+}
+
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
 
 bool graphics_initialized = false;
-HDC background_frames[NUMBER_OF_FRAMES] = {NULL, NULL, NULL, NULL, NULL};
+frame_asset_t background_frames[NUMBER_OF_FRAMES] = {{"frame1.bmp"}, {"frame2.bmp"}, {"frame3.bmp"},
+                                                     {"frame4.bmp"}, {"frame5.bmp"}};
+frame_cache_mode background_cache_mode = DEFAULT_FRAME_CACHE_MODE;
+
+compositor_t compositor = {NO_FRAME};
+
+static int current_state_frame = 0;
 
 
 void set_game_state_background(int state)
 {
     if (!graphics_initialized) return;
 
-    switch(state)
-    {
-        case STATE_MAIN_MENU:
-            show_background(0);
-            show_text("Main Menu - Choose an option");
-            break;
-
-        case STATE_PLAYING:
-            show_background(1);
-            show_text("Game in progress - Think of something!");
-            break;
-
-        case STATE_SHOW_TREE:
-            show_background(2);
-            show_text("Showing tree structure");
-            break;
-
-        case STATE_DEFINITION:
-            show_background(3);
-            show_text("Finding object definition");
-            break;
-
-        case STATE_COMPARISON:
-            show_background(4);
-            show_text("Comparing two objects");
-            break;
-
-        case STATE_SAVING:
-            show_background(0);
-            show_text("Saving database...");
-            break;
-
-        default:
-            show_background(0);
-            show_text("Akinator Game");
-            break;
-    }
+    if (presentation_queue_is_running())
+        presentation_post_background(state);
+    else
+        draw_game_state_background(state);
+}
+
+
+void draw_game_state_background(int state)
+{
+    if (!graphics_initialized) return;
+
+    current_state_frame = get_game_state_frame(state);
+    show_scene(current_state_frame, get_game_state_caption(state));
 }
 
 
 bool create_main_window(int width, int height)
 {
     printf("Creating main window...\n");
-    txCreateWindow(width, height);
-    txSleep(FRAME_DELAY);
+    txCreateWindow(width, height); // окно готово к возврату, лишние полсекунды сна не нужны
 
     if (txGetExtentX() == 0 || txGetExtentY() == 0)
     {
@@ -71,26 +83,97 @@ bool create_main_window(int width, int height)
 }
 
 
-bool load_background_frames()
+static bool map_frame_asset(frame_asset_t* frame)
 {
-    background_frames[0] = txLoadImage("frame1.bmp");
-    background_frames[1] = txLoadImage("frame2.bmp");
-    background_frames[2] = txLoadImage("frame3.bmp");
-    background_frames[3] = txLoadImage("frame4.bmp");
-    background_frames[4] = txLoadImage("frame5.bmp");
+    assert(frame != NULL);
 
-    bool all_loaded = true;
-    for (int i = 0; i < NUMBER_OF_FRAMES; i++)
+    // отображение только для чтения: страницы файла делят между собой все запущенные копии игры
+    frame -> file = CreateFileA(frame -> filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (frame -> file == INVALID_HANDLE_VALUE)
+    {
+        frame -> file = NULL;
+        return false;
+    }
+
+    LARGE_INTEGER file_size = {};
+    if (!GetFileSizeEx(frame -> file, &file_size) ||
+        (size_t)file_size.QuadPart < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER))
+        return false;
+
+    frame -> mapping = CreateFileMappingA(frame -> file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (frame -> mapping == NULL)
+        return false;
+
+    frame -> view = (const unsigned char*)MapViewOfFile(frame -> mapping, FILE_MAP_READ, 0, 0, 0);
+    if (frame -> view == NULL)
+        return false;
+
+    const BITMAPFILEHEADER* file_header = (const BITMAPFILEHEADER*)frame -> view;
+    if (file_header -> bfType != 0x4D42 || file_header -> bfOffBits >= (DWORD)file_size.QuadPart) // "BM"
+        return false;
+
+    // BMP уже лежит в формате DIB, так что "декодирование" - это просто указатели внутрь отображения
+    frame -> info   = (const BITMAPINFO*)(frame -> view + sizeof(BITMAPFILEHEADER));
+    frame -> pixels = frame -> view + file_header -> bfOffBits;
+
+    return true;
+}
+
+
+void release_background_frame(int frame_index)
+{
+    if (frame_index < 0 || frame_index >= NUMBER_OF_FRAMES)
+        return;
+
+    frame_asset_t* frame = &background_frames[frame_index];
+
+    if (frame -> view    != NULL) UnmapViewOfFile(frame -> view);
+    if (frame -> mapping != NULL) CloseHandle(frame -> mapping);
+    if (frame -> file    != NULL) CloseHandle(frame -> file);
+
+    frame -> file    = NULL;
+    frame -> mapping = NULL;
+    frame -> view    = NULL;
+    frame -> info    = NULL;
+    frame -> pixels  = NULL;
+}
+
+
+const frame_asset_t* acquire_background_frame(int frame_index)
+{
+    if (frame_index < 0 || frame_index >= NUMBER_OF_FRAMES)
+        return NULL;
+
+    frame_asset_t* frame = &background_frames[frame_index];
+
+    if (frame -> pixels == NULL && !frame -> failed)
     {
-        if (background_frames[i] == NULL)
+        if (!map_frame_asset(frame))
         {
-            printf("ERROR: Failed to load frame%d.bmp\n", i + 1);
-            all_loaded = false;
+            printf("ERROR: Failed to load %s\n", frame -> filename);
+            release_background_frame(frame_index);
+            frame -> failed = true; // не пытаемся открывать битый файл на каждом кадре
         }
     }
-    set_game_state_background(STATE_MAIN_MENU);
 
-    return all_loaded;
+    return (frame -> pixels != NULL) ? frame : NULL;
+}
+
+
+void set_frame_cache_mode(frame_cache_mode mode)
+{
+    background_cache_mode = mode;
+}
+
+
+bool load_background_frames()
+{
+    // кадры больше не грузятся заранее: файл отображается в память при первом показе
+    for (int i = 0; i < NUMBER_OF_FRAMES; i++)
+        background_frames[i].failed = false;
+
+    return true;
 }
 
 
@@ -98,13 +181,15 @@ bool initialization_graphics()
 {
     if (graphics_initialized) return true;
 
-    if (!create_main_window(800, 600)) return false;
+    if (!create_main_window(MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT)) return false;
 
     if(!load_background_frames())
         printf("Some background frames failed to load\n");
 
     graphics_initialized = true;
 
+    presentation_queue_start();
+
     printf("Graphics system initialized successfully\n");
     return true;
 }
@@ -112,49 +197,192 @@ bool initialization_graphics()
 
 void close_graphics()
 {
+    presentation_queue_stop(); // поток отрисовки не должен пережить кадры
+
+    for (int i = 0; i < NUMBER_OF_FRAMES; i++)
+        release_background_frame(i);
+
+    compositor = {NO_FRAME};
+
+    graphics_initialized = false;
+    printf("Graphics system closed\n");
+}
+
+
+static void release_unused_frames(int frame_index)
+{
+    // в экономном режиме держим отображённым только кадр текущего состояния игры
+    if (background_cache_mode != FRAME_CACHE_CURRENT_STATE)
+        return;
+
     for (int i = 0; i < NUMBER_OF_FRAMES; i++)
     {
-        if (background_frames[i] != NULL)
+        if (i != frame_index && i != current_state_frame)
+            release_background_frame(i);
+    }
+}
+
+
+static bool rects_intersect(const compositor_rect_t* first, const compositor_rect_t* second)
+{
+    return first -> left < second -> right  && second -> left < first -> right &&
+           first -> top  < second -> bottom && second -> top  < first -> bottom;
+}
+
+
+void compositor_mark_dirty(compositor_rect_t rect)
+{
+    for (size_t i = 0; i < compositor.dirty_count; i++)
+    {
+        compositor_rect_t* dirty = &compositor.dirty[i];
+        if (dirty -> left <= rect.left && dirty -> top <= rect.top &&
+            dirty -> right >= rect.right && dirty -> bottom >= rect.bottom)
+            return; // уже покрыто
+    }
+
+    if (compositor.dirty_count == MAX_NUMBER_OF_DIRTY_RECTS)
+    {
+        // прямоугольников слишком много - сливаем всё в один охватывающий
+        compositor_rect_t* bounds = &compositor.dirty[0];
+        for (size_t i = 1; i < compositor.dirty_count; i++)
         {
-            txDeleteDC(background_frames[i]);
-            background_frames[i] = NULL;
+            if (compositor.dirty[i].left   < bounds -> left)   bounds -> left   = compositor.dirty[i].left;
+            if (compositor.dirty[i].top    < bounds -> top)    bounds -> top    = compositor.dirty[i].top;
+            if (compositor.dirty[i].right  > bounds -> right)  bounds -> right  = compositor.dirty[i].right;
+            if (compositor.dirty[i].bottom > bounds -> bottom) bounds -> bottom = compositor.dirty[i].bottom;
         }
+        compositor.dirty_count = 1;
     }
 
-    graphics_initialized = false;
-    printf("Graphics system closed\n");
+    compositor.dirty[compositor.dirty_count++] = rect;
 }
 
 
-void show_background(int frame_index)
+void compositor_set_background(int frame_index)
 {
-    if (!graphics_initialized) return;
+    if (frame_index == compositor.shown_frame)
+        return; // тот же кадр уже на экране, перекладывать 800x600 незачем
+
+    compositor.shown_frame = frame_index;
+
+    compositor_rect_t whole_window = {0, 0, MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT};
+    compositor_mark_dirty(whole_window);
+}
+
+
+void compositor_set_caption(const char* text)
+{
+    assert(text != NULL);
+
+    if (compositor.has_caption && strcmp(compositor.caption, text) == 0)
+        return;
+
+    snprintf(compositor.caption, sizeof(compositor.caption), "%s", text);
+    compositor.has_caption = true;
+
+    compositor_rect_t text_panel = {0, TEXT_PANEL_TOP, MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT};
+    compositor_mark_dirty(text_panel);
+}
 
-    if (frame_index >= 0 && frame_index < NUMBER_OF_FRAMES && background_frames[frame_index] != NULL)
+
+static void blit_background_rect(const compositor_rect_t* rect)
+{
+    assert(rect != NULL);
+
+    const frame_asset_t* frame = acquire_background_frame(compositor.shown_frame);
+    if (frame == NULL)
     {
-        txSetFillColor(RGB(0, 0, 0));
-        txClear();
-        txBitBlt(0, 0, background_frames[frame_index]);
-        txRedrawWindow(); // гарантируем смену фона
+        txSetFillColor(TX_BLACK);
+        txSetColor(TX_BLACK);
+        txRectangle(rect -> left, rect -> top, rect -> right, rect -> bottom);
+        return;
     }
+
+    const BITMAPINFOHEADER* header = &frame -> info -> bmiHeader;
+    int height = (header -> biHeight < 0) ? -header -> biHeight : header -> biHeight;
+
+    // у BMP, записанного снизу вверх, строки источника отсчитываются от нижнего края
+    int source_y = (header -> biHeight < 0) ? rect -> top : height - rect -> bottom;
+
+    txLock();
+    SetDIBitsToDevice(txDC(), rect -> left, rect -> top,
+                      (DWORD)(rect -> right - rect -> left), (DWORD)(rect -> bottom - rect -> top),
+                      rect -> left, source_y, 0, (UINT)height,
+                      frame -> pixels, frame -> info, DIB_RGB_COLORS);
+    txUnlock();
 }
 
 
-void show_text(const char* text)
+static void draw_caption_panel()
 {
-    if (!graphics_initialized) return;
-
     // панель для текста
+    txSetColor(TX_BLACK);
     txSetFillColor(TX_BLACK);
-    txRectangle(0, 520, 800, 600);
+    txRectangle(0, TEXT_PANEL_TOP, MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT);
 
     // Выводим текст
     txSetColor(TX_WHITE);
     txSelectFont("Arial", 20, 10, FW_BOLD);
     txSetTextAlign(TA_CENTER);
-    txTextOut(400, 540, text);
+    txTextOut(MAIN_WINDOW_WIDTH / 2, TEXT_PANEL_TOP + 20, compositor.caption);
+}
+
+
+void compositor_present()
+{
+    if (compositor.dirty_count == 0)
+        return;
+
+    compositor_rect_t text_panel = {0, TEXT_PANEL_TOP, MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT};
+    bool caption_dirty = false;
 
-    txRedrawWindow();
+    txBegin(); // пока собираем кадр, окно не перерисовывается - без мерцания
+
+    for (size_t i = 0; i < compositor.dirty_count; i++)
+    {
+        blit_background_rect(&compositor.dirty[i]);
+
+        if (rects_intersect(&compositor.dirty[i], &text_panel))
+            caption_dirty = true;
+    }
+
+    if (caption_dirty && compositor.has_caption)
+        draw_caption_panel();
+
+    compositor.dirty_count = 0;
+
+    txEnd();
+    txRedrawWindow(); // одна перерисовка на всё логическое обновление
+
+    release_unused_frames(compositor.shown_frame);
+}
+
+
+void show_scene(int frame_index, const char* text)
+{
+    if (!graphics_initialized) return;
+
+    compositor_set_background(frame_index);
+    compositor_set_caption(text);
+    compositor_present();
+}
+
+
+void show_background(int frame_index)
+{
+    if (!graphics_initialized) return;
+
+    compositor_set_background(frame_index);
+    compositor_present();
+}
+
+
+void show_text(const char* text)
+{
+    if (!graphics_initialized) return;
+
+    compositor_set_caption(text);
+    compositor_present();
 }
 
 
@@ -169,18 +397,80 @@ void animate_question(const char* question_text)
         }
     }
 
-    for (int cycle = 0; cycle < ANIMATION_CYCLES; cycle++)
-    {
-        for (int i = 0; i < NUMBER_OF_FRAMES; i++)
-        {
-            show_background(i);
+    // кадры крутит поток отрисовки, а мы сразу возвращаемся к игре
+    presentation_post_animation(question_text);
+}
 
-            show_text(question_text);
+#elif PRESENTATION_BACKEND == PRESENTATION_CONSOLE
 
-            txSleep(FRAME_DELAY);
-        }
-    }
+// Консольный бэкенд: вместо кадров печатаем подписи сцен в stderr, чтобы не мешать диалогу в stdout
+bool graphics_initialized = false;
+
+
+void set_game_state_background(int state)
+{
+    draw_game_state_background(state);
+}
+
+
+void draw_game_state_background(int state)
+{
+    if (!graphics_initialized) return;
+
+    show_text(get_game_state_caption(state));
+}
+
+
+bool create_main_window(int width, int height)
+{
+    return true;
+}
+
+
+bool load_background_frames()
+{
+    return true;
+}
+
+
+bool initialization_graphics()
+{
+    graphics_initialized = true;
+    return true;
+}
+
+
+void close_graphics()
+{
+    graphics_initialized = false;
+}
+
+
+void show_background(int frame_index)
+{
+}
+
+
+void show_scene(int frame_index, const char* text)
+{
+    show_text(text);
+}
+
+
+void show_text(const char* text)
+{
+    if (!graphics_initialized) return;
+
+    fprintf(stderr, "[ %s ]\n", text);
+}
+
+
+void animate_question(const char* question_text)
+{
+    if (!graphics_initialized)
+        initialization_graphics();
 
-    set_game_state_background(STATE_MAIN_MENU);
+    show_text(question_text);
 }
 
+#endif // PRESENTATION_BACKEND
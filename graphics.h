@@ -1,13 +1,23 @@
 #ifndef GRAPHICS_H_
 #define GRAPHICS_H_
 
+#include "presentation.h"
+
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
 #include <TXLib.h>
+#endif
 
 #define ANIMATION_CYCLES 1
 #define NUMBER_OF_FRAMES 5
 #define FRAME_DELAY 500
 #define MAX_LENGTH_OF_TEXT 1024
 
+#define MAIN_WINDOW_WIDTH  800
+#define MAIN_WINDOW_HEIGHT 600
+#define TEXT_PANEL_TOP     520
+#define NO_FRAME -1
+#define MAX_NUMBER_OF_DIRTY_RECTS 8
+
 enum game_state
 {
     STATE_MAIN_MENU  = 0,
@@ -18,11 +28,86 @@ enum game_state
     STATE_SAVING     = 5
 };
 
+const char* get_game_state_caption(int state);
+int get_game_state_frame(int state);
+
+#if PRESENTATION_BACKEND == PRESENTATION_NONE
+
+inline void set_game_state_background(int) {}
+inline void draw_game_state_background(int) {}
+inline bool create_main_window(int, int) { return true; }
+inline bool load_background_frames() { return true; }
+inline bool initialization_graphics() { return true; }
+inline void close_graphics() {}
+inline void animate_question(const char*) {}
+inline void show_background(int) {}
+inline void show_text(const char*) {}
+inline void show_scene(int, const char*) {}
+
+#else
 
 extern bool graphics_initialized;
-extern HDC background_frames[NUMBER_OF_FRAMES];
+
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
+
+enum frame_cache_mode
+{
+    FRAME_CACHE_ALL           = 0, // отображённый кадр остаётся в памяти до close_graphics
+    FRAME_CACHE_CURRENT_STATE = 1, // держим только кадр текущего game_state
+};
+
+#define DEFAULT_FRAME_CACHE_MODE FRAME_CACHE_ALL
+
+// Кадр фона, отображённый в память прямо из BMP-файла
+struct frame_asset_t
+{
+    const char* filename;
+    bool failed;
+
+    HANDLE file;
+    HANDLE mapping;
+    const unsigned char* view;
+
+    const BITMAPINFO* info;
+    const void* pixels;
+};
+
+struct compositor_rect_t
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+// Помнит, что уже нарисовано в окне, и перерисовывает только изменившиеся области
+struct compositor_t
+{
+    int shown_frame;
+    bool has_caption;
+    char caption[MAX_LENGTH_OF_TEXT];
+
+    compositor_rect_t dirty[MAX_NUMBER_OF_DIRTY_RECTS];
+    size_t dirty_count;
+};
+
+extern frame_asset_t background_frames[NUMBER_OF_FRAMES];
+extern compositor_t compositor;
+extern frame_cache_mode background_cache_mode;
+
+const frame_asset_t* acquire_background_frame(int frame_index);
+void release_background_frame(int frame_index);
+void set_frame_cache_mode(frame_cache_mode mode);
+
+void compositor_mark_dirty(compositor_rect_t rect);
+void compositor_set_background(int frame_index);
+void compositor_set_caption(const char* text);
+void compositor_present();
+
+#endif
 
 void set_game_state_background(int state);
+void draw_game_state_background(int state);
 bool create_main_window(int width, int height);
 bool load_background_frames();
 bool initialization_graphics();
@@ -30,5 +115,8 @@ void close_graphics();
 void animate_question(const char* question_text);
 void show_background(int frame_index);
 void show_text(const char* text);
+void show_scene(int frame_index, const char* text);
+
+#endif // PRESENTATION_BACKEND == PRESENTATION_NONE
 
 #endif // GRAPHICS_H_
@@ -6,23 +6,38 @@
 #include "graphics.h"
 #include "tree_tests.h"
 #include "akinator_app.h"
+#include "tree_registry.h"
 #include "tree_error_type.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-    if (!initialize_akinator_app())
-        return OPERATION_FAILED;
+    akinator_options_t options = {};
+    // OPERATION_FAILED равен нулю, а провал запуска и самотеста должен быть виден по коду выхода
+    if (!parse_akinator_options(argc, argv, &options))
+        return EXIT_FAILURE;
 
-    tree_t tree = {};
-    if (!load_or_create_database(&tree))
+    if (options.merge_first != NULL)
+        return run_merge_tool(&options) ? 0 : EXIT_FAILURE;
+
+    if (options.diff_old != NULL)
+        return run_diff_tool(&options) ? 0 : EXIT_FAILURE;
+
+    if (options.import_table != NULL)
+        return run_import_tool(&options) ? 0 : EXIT_FAILURE;
+
+    if (options.export_database != NULL)
+        return run_export_tool(&options) ? 0 : EXIT_FAILURE;
+
+    static tree_registry_t registry; // пул и шестнадцать записей - не для стека
+    if (!initialize_akinator_app(&registry, &options))
     {
         close_graphics();
-        return OPERATION_FAILED;
+        return EXIT_FAILURE;
     }
 
-    run_akinator_loop(&tree);
+    run_akinator_loop(&registry);
 
-    cleanup_akinator_app(&tree);
+    cleanup_akinator_app(&registry);
 
     return 0;
 }
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "tree.h"
+#include "metrics.h"
+
+enum metric_type
+{
+    METRIC_TYPE_COUNTER   = 0,
+    METRIC_TYPE_GAUGE     = 1,
+    METRIC_TYPE_HISTOGRAM = 2,
+};
+
+struct metric_descriptor_t
+{
+    const char* name;
+    const char* help;
+    metric_type type;
+    double scale; // во сколько раз умножить значение при выводе: наносекунды -> секунды
+};
+
+struct metric_histogram_t
+{
+    std::atomic<uint64_t> buckets[METRICS_NUMBER_OF_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+// Порядок совпадает с metric_id
+static const metric_descriptor_t METRIC_DESCRIPTORS[NUMBER_OF_METRICS] =
+{
+    {"akinator_games_played_total",     "Games started",                                  METRIC_TYPE_COUNTER,   1},
+    {"akinator_games_won_total",        "Games where the first guess was right",          METRIC_TYPE_COUNTER,   1},
+    {"akinator_objects_learned_total",  "Objects learned after a wrong guess",            METRIC_TYPE_COUNTER,   1},
+    {"akinator_questions_asked_total",  "Questions answered by players",                  METRIC_TYPE_COUNTER,   1},
+    {"akinator_tree_load_errors_total", "Failed database loads",                          METRIC_TYPE_COUNTER,   1},
+    {"akinator_tree_save_errors_total", "Failed database saves",                          METRIC_TYPE_COUNTER,   1},
+    {"akinator_tree_nodes",             "Nodes in the last loaded or changed tree",       METRIC_TYPE_GAUGE,     1},
+    {"akinator_tree_load_seconds",      "Time to load a database",                        METRIC_TYPE_HISTOGRAM, 1e-9},
+    {"akinator_tree_save_seconds",      "Time to save a database",                        METRIC_TYPE_HISTOGRAM, 1e-9},
+    {"akinator_dump_seconds",           "Time the game thread spends on a tree dump",     METRIC_TYPE_HISTOGRAM, 1e-9},
+    {"akinator_question_seconds",       "Time from asking a question to a valid answer",  METRIC_TYPE_HISTOGRAM, 1e-9},
+    {"akinator_questions_per_game",     "Questions asked before the guess",               METRIC_TYPE_HISTOGRAM, 1},
+};
+
+static const double EXPORTED_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+static std::atomic<uint64_t> metric_values[NUMBER_OF_METRICS];
+static metric_histogram_t metric_histograms[NUMBER_OF_METRICS]; // заняты только у гистограмм
+
+struct metrics_exporter_t
+{
+    std::mutex mutex = {};
+    std::condition_variable stop_requested = {};
+    std::thread worker = {};
+    bool running = false;
+
+    char filename[MAX_LENGTH_OF_FILENAME] = {};
+    unsigned period_ms = 0;
+};
+
+static metrics_exporter_t metrics_exporter;
+
+// ============================UPDATE===========================================
+
+uint64_t metrics_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void metrics_counter_add(metric_id metric, uint64_t value)
+{
+    assert(METRIC_DESCRIPTORS[metric].type == METRIC_TYPE_COUNTER);
+
+    metric_values[metric].fetch_add(value, std::memory_order_relaxed);
+}
+
+
+void metrics_gauge_set(metric_id metric, uint64_t value)
+{
+    assert(METRIC_DESCRIPTORS[metric].type == METRIC_TYPE_GAUGE);
+
+    metric_values[metric].store(value, std::memory_order_relaxed);
+}
+
+
+size_t metrics_bucket_index(uint64_t value)
+{
+    if (value < METRICS_SUB_BUCKETS)
+        return value;
+
+    size_t exponent = 63 - (size_t)__builtin_clzll(value); // не меньше METRICS_SUB_BUCKET_BITS
+    size_t shift = exponent - METRICS_SUB_BUCKET_BITS;
+    size_t sub_bucket = (value >> shift) - METRICS_SUB_BUCKETS;
+
+    return (shift + 1) * METRICS_SUB_BUCKETS + sub_bucket;
+}
+
+
+// Наибольшее значение, которое попадает в корзину
+uint64_t metrics_bucket_upper_bound(size_t index)
+{
+    size_t group = index / METRICS_SUB_BUCKETS;
+    uint64_t sub_bucket = index % METRICS_SUB_BUCKETS;
+
+    if (group == 0)
+        return sub_bucket;
+
+    uint64_t lower = (METRICS_SUB_BUCKETS + sub_bucket) << (group - 1);
+    return lower + ((uint64_t)1 << (group - 1)) - 1;
+}
+
+
+void metrics_observe(metric_id metric, uint64_t value)
+{
+    assert(METRIC_DESCRIPTORS[metric].type == METRIC_TYPE_HISTOGRAM);
+
+    metric_histogram_t* histogram = &metric_histograms[metric];
+
+    histogram -> buckets[metrics_bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    histogram -> count.fetch_add(1, std::memory_order_relaxed);
+    histogram -> sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = histogram -> max.load(std::memory_order_relaxed);
+    while (value > max && !histogram -> max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+// ============================READ=============================================
+
+uint64_t metrics_value(metric_id metric)
+{
+    return metric_values[metric].load(std::memory_order_relaxed);
+}
+
+
+uint64_t metrics_histogram_count(metric_id metric)
+{
+    return metric_histograms[metric].count.load(std::memory_order_relaxed);
+}
+
+
+// Верхняя граница корзины, в которую попадает значение с этим рангом, но не больше максимума
+uint64_t metrics_histogram_quantile(metric_id metric, double quantile)
+{
+    const metric_histogram_t* histogram = &metric_histograms[metric];
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < METRICS_NUMBER_OF_BUCKETS; i++)
+        total += histogram -> buckets[i].load(std::memory_order_relaxed);
+
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(quantile * (double)total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t max = histogram -> max.load(std::memory_order_relaxed);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < METRICS_NUMBER_OF_BUCKETS; i++)
+    {
+        seen += histogram -> buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            uint64_t upper = metrics_bucket_upper_bound(i);
+            return (upper < max) ? upper : max;
+        }
+    }
+
+    return max;
+}
+
+
+void metrics_reset()
+{
+    for (size_t i = 0; i < NUMBER_OF_METRICS; i++)
+    {
+        metric_values[i].store(0, std::memory_order_relaxed);
+
+        metric_histogram_t* histogram = &metric_histograms[i];
+        for (size_t j = 0; j < METRICS_NUMBER_OF_BUCKETS; j++)
+            histogram -> buckets[j].store(0, std::memory_order_relaxed);
+
+        histogram -> count.store(0, std::memory_order_relaxed);
+        histogram -> sum.store(0, std::memory_order_relaxed);
+        histogram -> max.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+// Текстовый формат Prometheus 0.0.4. Гистограммы выводятся как summary:
+// квантили из корзин, сумма и количество
+void metrics_write_prometheus(FILE* stream)
+{
+    assert(stream != NULL);
+
+    for (size_t i = 0; i < NUMBER_OF_METRICS; i++)
+    {
+        const metric_descriptor_t* descriptor = &METRIC_DESCRIPTORS[i];
+        metric_id metric = (metric_id)i;
+
+        fprintf(stream, "# HELP %s %s\n", descriptor -> name, descriptor -> help);
+
+        if (descriptor -> type != METRIC_TYPE_HISTOGRAM)
+        {
+            fprintf(stream, "# TYPE %s %s\n", descriptor -> name,
+                    (descriptor -> type == METRIC_TYPE_COUNTER) ? "counter" : "gauge");
+            fprintf(stream, "%s %llu\n", descriptor -> name, (unsigned long long)metrics_value(metric));
+            continue;
+        }
+
+        fprintf(stream, "# TYPE %s summary\n", descriptor -> name);
+
+        for (size_t q = 0; q < sizeof(EXPORTED_QUANTILES) / sizeof(EXPORTED_QUANTILES[0]); q++)
+            fprintf(stream, "%s{quantile=\"%g\"} %.9g\n", descriptor -> name, EXPORTED_QUANTILES[q],
+                    (double)metrics_histogram_quantile(metric, EXPORTED_QUANTILES[q]) * descriptor -> scale);
+
+        fprintf(stream, "%s_sum %.9g\n", descriptor -> name,
+                (double)metric_histograms[i].sum.load(std::memory_order_relaxed) * descriptor -> scale);
+        fprintf(stream, "%s_count %llu\n", descriptor -> name, (unsigned long long)metrics_histogram_count(metric));
+    }
+}
+
+// ============================EXPORTER=========================================
+
+static void write_metrics_file(const char* filename)
+{
+    char temporary_name[MAX_LENGTH_OF_FILENAME + sizeof(METRICS_TEMPORARY_SUFFIX)] = {};
+    snprintf(temporary_name, sizeof(temporary_name), "%s%s", filename, METRICS_TEMPORARY_SUFFIX);
+
+    FILE* file = fopen(temporary_name, "w");
+    if (file == NULL)
+        return;
+
+    metrics_write_prometheus(file);
+
+    if (fclose(file) != 0)
+    {
+        remove(temporary_name);
+        return;
+    }
+
+    // сборщик не должен увидеть файл наполовину, а rename в Windows не заменяет существующий
+    if (rename(temporary_name, filename) != 0)
+    {
+        remove(filename);
+        rename(temporary_name, filename);
+    }
+}
+
+
+static void metrics_exporter_loop()
+{
+    std::unique_lock<std::mutex> lock(metrics_exporter.mutex);
+
+    while (metrics_exporter.running)
+    {
+        write_metrics_file(metrics_exporter.filename);
+
+        metrics_exporter.stop_requested.wait_for(lock, std::chrono::milliseconds(metrics_exporter.period_ms), []
+        {
+            return !metrics_exporter.running;
+        });
+    }
+
+    write_metrics_file(metrics_exporter.filename); // последние значения перед выходом
+}
+
+
+bool metrics_exporter_start(const char* filename, unsigned period_ms)
+{
+    assert(filename != NULL);
+
+    if (strlen(filename) >= MAX_LENGTH_OF_FILENAME)
+        return false;
+
+    std::lock_guard<std::mutex> guard(metrics_exporter.mutex);
+
+    if (metrics_exporter.running)
+        return true;
+
+    strcpy(metrics_exporter.filename, filename);
+    metrics_exporter.period_ms = (period_ms == 0) ? METRICS_DEFAULT_PERIOD_MS : period_ms;
+    metrics_exporter.running   = true;
+
+    metrics_exporter.worker = std::thread(metrics_exporter_loop);
+
+    return true;
+}
+
+
+void metrics_exporter_stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(metrics_exporter.mutex);
+        if (!metrics_exporter.running)
+            return;
+
+        metrics_exporter.running = false;
+    }
+
+    metrics_exporter.stop_requested.notify_all();
+    metrics_exporter.worker.join();
+}
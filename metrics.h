@@ -0,0 +1,62 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_SUB_BUCKET_BITS 5 // 32 корзины на каждую степень двойки, погрешность до 3%
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_NUMBER_OF_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+#define METRICS_DEFAULT_PERIOD_MS 1000
+#define METRICS_TEMPORARY_SUFFIX ".tmp"
+
+enum metric_id
+{
+    // счётчики
+    METRIC_GAMES_PLAYED       = 0,
+    METRIC_GAMES_WON          = 1,
+    METRIC_OBJECTS_LEARNED    = 2,
+    METRIC_QUESTIONS_ASKED    = 3,
+    METRIC_TREE_LOAD_ERRORS   = 4,
+    METRIC_TREE_SAVE_ERRORS   = 5,
+
+    // текущие значения
+    METRIC_TREE_NODES         = 6,
+
+    // гистограммы
+    METRIC_TREE_LOAD_SECONDS  = 7,
+    METRIC_TREE_SAVE_SECONDS  = 8,
+    METRIC_DUMP_SECONDS       = 9,
+    METRIC_QUESTION_SECONDS   = 10, // от вопроса до принятого ответа
+    METRIC_QUESTIONS_PER_GAME = 11,
+
+    NUMBER_OF_METRICS         = 12,
+};
+
+// Счётчики и гистограммы обновляются из любого потока без блокировок.
+// Гистограмма логарифмически-линейная, как HDR: значения до 32 - точно,
+// дальше по 32 корзины на степень двойки
+void metrics_counter_add(metric_id metric, uint64_t value);
+void metrics_gauge_set(metric_id metric, uint64_t value);
+void metrics_observe(metric_id metric, uint64_t value);
+uint64_t metrics_now_ns();
+
+uint64_t metrics_value(metric_id metric);
+uint64_t metrics_histogram_count(metric_id metric);
+uint64_t metrics_histogram_quantile(metric_id metric, double quantile);
+
+// Корзина значения и наибольшее значение в ней
+size_t metrics_bucket_index(uint64_t value);
+uint64_t metrics_bucket_upper_bound(size_t index);
+
+// Обнуляет все метрики, для самопроверки
+void metrics_reset();
+
+void metrics_write_prometheus(FILE* stream);
+
+// Периодическая запись в файл для локального сборщика, файл подменяется целиком
+bool metrics_exporter_start(const char* filename, unsigned period_ms);
+void metrics_exporter_stop();
+
+#endif // METRICS_H_
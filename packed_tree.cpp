@@ -0,0 +1,465 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "packed_tree.h"
+#include "tree_parser.h"
+#include "tree_compact.h"
+#include "tree_error_type.h"
+
+struct packed_build_entry
+{
+    const node_t* node;
+    uint32_t parent;
+    bool is_yes;
+};
+
+
+const char* packed_node_question(const packed_tree_t* packed, uint32_t node)
+{
+    assert(packed != NULL);
+    assert(node < packed -> count);
+
+    const packed_node_t* packed_node = &packed -> nodes[node];
+
+    if (packed_node -> phrase_length != PACKED_PHRASE_IN_POOL)
+        return packed_node -> phrase;
+
+    uint64_t offset = 0;
+    memcpy(&offset, packed_node -> phrase, sizeof(offset));
+
+    return packed -> pool + offset;
+}
+
+
+uint32_t packed_node_yes(const packed_tree_t* packed, uint32_t node)
+{
+    assert(packed != NULL);
+    assert(node < packed -> count);
+
+    return packed -> nodes[node].yes;
+}
+
+
+uint32_t packed_node_no(const packed_tree_t* packed, uint32_t node)
+{
+    assert(packed != NULL);
+    assert(node < packed -> count);
+
+    return packed -> nodes[node].no;
+}
+
+
+uint32_t packed_node_parent(const packed_tree_t* packed, uint32_t node)
+{
+    assert(packed != NULL);
+    assert(node < packed -> count);
+
+    return packed -> nodes[node].parent;
+}
+
+
+bool packed_node_is_leaf(const packed_tree_t* packed, uint32_t node)
+{
+    return node != PACKED_NIL && packed_node_yes(packed, node) == PACKED_NIL && packed_node_no(packed, node) == PACKED_NIL;
+}
+
+
+static tree_error_type set_packed_phrase(packed_tree_t* packed, uint32_t node, const char* phrase)
+{
+    size_t length = strlen(phrase);
+    packed_node_t* packed_node = &packed -> nodes[node];
+
+    if (length < PACKED_INLINE_PHRASE_SIZE)
+    {
+        memcpy(packed_node -> phrase, phrase, length + 1);
+        packed_node -> phrase_length = (uint8_t)length;
+        return TREE_NO_ERROR;
+    }
+
+    if (packed -> pool_size + length + 1 > packed -> pool_capacity)
+    {
+        size_t new_capacity = packed -> pool_capacity * 2;
+        if (new_capacity < packed -> pool_size + length + 1)
+            new_capacity = packed -> pool_size + length + 1;
+
+        char* new_pool = (char*)realloc(packed -> pool, new_capacity);
+        if (new_pool == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        packed -> pool = new_pool;
+        packed -> pool_capacity = new_capacity;
+    }
+
+    uint64_t offset = packed -> pool_size;
+    memcpy(packed -> pool + offset, phrase, length + 1);
+    packed -> pool_size += length + 1;
+
+    memcpy(packed_node -> phrase, &offset, sizeof(offset));
+    packed_node -> phrase_length = PACKED_PHRASE_IN_POOL;
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type reserve_packed_nodes(packed_tree_t* packed, size_t count)
+{
+    if (count <= packed -> capacity)
+        return TREE_NO_ERROR;
+
+    if (count >= PACKED_NIL)
+        return TREE_ERROR_SIZE_MISMATCH; // индексы 32-битные
+
+    size_t new_capacity = (size_t)packed -> capacity * 2;
+    if (new_capacity < count)
+        new_capacity = count;
+    if (new_capacity >= PACKED_NIL)
+        new_capacity = PACKED_NIL - 1;
+
+    packed_node_t* new_nodes = (packed_node_t*)realloc(packed -> nodes, new_capacity * sizeof(packed_node_t));
+    if (new_nodes == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    packed -> nodes = new_nodes;
+    packed -> capacity = (uint32_t)new_capacity;
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type add_packed_node(packed_tree_t* packed, const char* phrase, uint32_t parent, uint32_t* node)
+{
+    tree_error_type result = reserve_packed_nodes(packed, (size_t)packed -> count + 1);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    *node = packed -> count;
+
+    packed_node_t* packed_node = &packed -> nodes[*node];
+    packed_node -> yes    = PACKED_NIL;
+    packed_node -> no     = PACKED_NIL;
+    packed_node -> parent = parent;
+
+    result = set_packed_phrase(packed, *node, phrase);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    packed -> count++;
+    return TREE_NO_ERROR;
+}
+
+
+// Узлы раскладываются в прямом порядке обхода, как в tree_compact
+tree_error_type packed_tree_build(const tree_t* tree, packed_tree_t* packed)
+{
+    assert(tree   != NULL);
+    assert(packed != NULL);
+
+    *packed = {};
+    packed -> root = PACKED_NIL;
+
+    if (tree -> root == NULL)
+        return TREE_NO_ERROR;
+
+    tree_error_type result = reserve_packed_nodes(packed, tree -> size);
+
+    packed_build_entry* stack = (packed_build_entry*)calloc(tree -> size + 1, sizeof(packed_build_entry));
+    size_t stack_size = 0;
+
+    if (result != TREE_NO_ERROR || stack == NULL)
+    {
+        free(stack);
+        packed_tree_destroy(packed);
+        return (result != TREE_NO_ERROR) ? result : TREE_ERROR_ALLOCATION;
+    }
+
+    stack[stack_size++] = {tree -> root, PACKED_NIL, true};
+
+    while (stack_size > 0 && result == TREE_NO_ERROR)
+    {
+        packed_build_entry entry = stack[--stack_size];
+
+        if (packed -> count == tree -> size)
+        {
+            result = TREE_ERROR_SIZE_MISMATCH; // узлов больше, чем size
+            break;
+        }
+
+        uint32_t node = PACKED_NIL;
+        result = add_packed_node(packed, entry.node -> question, entry.parent, &node);
+        if (result != TREE_NO_ERROR)
+            break;
+
+        if (entry.parent == PACKED_NIL)
+            packed -> root = node;
+        else if (entry.is_yes)
+            packed -> nodes[entry.parent].yes = node;
+        else
+            packed -> nodes[entry.parent].no = node;
+
+        // в стеке не больше узлов, чем осталось добавить, так что size + 1 хватает
+        if (entry.node -> no  != NULL) stack[stack_size++] = {entry.node -> no,  node, false};
+        if (entry.node -> yes != NULL) stack[stack_size++] = {entry.node -> yes, node, true};
+    }
+
+    free(stack);
+
+    if (result == TREE_NO_ERROR && packed -> count != tree -> size)
+        result = TREE_ERROR_SIZE_MISMATCH;
+
+    // после удвоений в пуле может остаться до половины пустого места
+    if (result == TREE_NO_ERROR && packed -> pool_size < packed -> pool_capacity)
+    {
+        char* fitted_pool = (char*)realloc(packed -> pool, packed -> pool_size);
+        if (fitted_pool != NULL)
+        {
+            packed -> pool = fitted_pool;
+            packed -> pool_capacity = packed -> pool_size;
+        }
+    }
+
+    if (result != TREE_NO_ERROR)
+        packed_tree_destroy(packed);
+
+    return result;
+}
+
+
+tree_error_type packed_tree_unpack(const packed_tree_t* packed, tree_t* tree)
+{
+    assert(packed != NULL);
+    assert(tree   != NULL);
+
+    node_t** nodes = (node_t**)calloc((size_t)packed -> count + 1, sizeof(node_t*));
+    if (nodes == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    for (uint32_t i = 0; i < packed -> count; i++)
+    {
+        tree_error_type result = tree_create_node(&nodes[i], packed_node_question(packed, i));
+        if (result != TREE_NO_ERROR)
+        {
+            for (uint32_t j = 0; j < i; j++)
+            {
+                free(nodes[j] -> question);
+                free(nodes[j]);
+            }
+            free(nodes);
+            return result;
+        }
+    }
+
+    for (uint32_t i = 0; i < packed -> count; i++)
+    {
+        const packed_node_t* packed_node = &packed -> nodes[i];
+
+        nodes[i] -> yes    = (packed_node -> yes    == PACKED_NIL) ? NULL : nodes[packed_node -> yes];
+        nodes[i] -> no     = (packed_node -> no     == PACKED_NIL) ? NULL : nodes[packed_node -> no];
+        nodes[i] -> parent = (packed_node -> parent == PACKED_NIL) ? NULL : nodes[packed_node -> parent];
+    }
+
+    tree_destructor(tree);
+    tree -> root = (packed -> root == PACKED_NIL) ? NULL : nodes[packed -> root];
+    tree -> size = packed -> count;
+
+    free(nodes);
+    return TREE_NO_ERROR;
+}
+
+
+void packed_tree_destroy(packed_tree_t* packed)
+{
+    if (packed == NULL)
+        return;
+
+    free(packed -> nodes);
+    free(packed -> pool);
+
+    *packed = {};
+    packed -> root = PACKED_NIL;
+}
+
+
+tree_error_type packed_tree_split_node(packed_tree_t* packed, uint32_t old_node, const char* feature, const char* new_object)
+{
+    assert(packed     != NULL);
+    assert(feature    != NULL);
+    assert(new_object != NULL);
+    assert(old_node < packed -> count);
+
+    tree_error_type result = reserve_packed_nodes(packed, (size_t)packed -> count + 2);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    // старый объект переезжает в no как есть: и короткая фраза, и смещение в пуле копируются байтами
+    packed_node_t old_object = packed -> nodes[old_node];
+
+    result = set_packed_phrase(packed, old_node, feature);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    uint32_t yes_node = PACKED_NIL;
+    result = add_packed_node(packed, new_object, old_node, &yes_node);
+    if (result != TREE_NO_ERROR)
+    {
+        packed -> nodes[old_node] = old_object;
+        return result;
+    }
+
+    uint32_t no_node = packed -> count++;
+    packed -> nodes[no_node] = old_object;
+    packed -> nodes[no_node].parent = old_node;
+
+    packed -> nodes[old_node].yes = yes_node;
+    packed -> nodes[old_node].no  = no_node;
+
+    return TREE_NO_ERROR;
+}
+
+
+static bool equal_ignoring_case(const char* first, const char* second)
+{
+    for (; *first != '\0' && *second != '\0'; first++, second++)
+    {
+        if (tolower((unsigned char)*first) != tolower((unsigned char)*second))
+            return false;
+    }
+
+    return *first == *second;
+}
+
+
+// Как find_leaf_by_phrase: первый подходящий лист в прямом порядке, регистр не важен
+uint32_t packed_tree_find_leaf_by_phrase(const packed_tree_t* packed, const char* phrase)
+{
+    assert(packed != NULL);
+    assert(phrase != NULL);
+
+    if (packed -> root == PACKED_NIL)
+        return PACKED_NIL;
+
+    uint32_t* stack = (uint32_t*)calloc((size_t)packed -> count + 1, sizeof(uint32_t));
+    if (stack == NULL)
+        return PACKED_NIL;
+
+    size_t stack_size = 0;
+    uint32_t found = PACKED_NIL;
+
+    stack[stack_size++] = packed -> root;
+
+    while (stack_size > 0)
+    {
+        uint32_t node = stack[--stack_size];
+
+        if (packed_node_is_leaf(packed, node))
+        {
+            if (equal_ignoring_case(packed_node_question(packed, node), phrase))
+            {
+                found = node;
+                break;
+            }
+            continue;
+        }
+
+        if (packed_node_no(packed, node)  != PACKED_NIL) stack[stack_size++] = packed_node_no(packed, node);
+        if (packed_node_yes(packed, node) != PACKED_NIL) stack[stack_size++] = packed_node_yes(packed, node);
+    }
+
+    free(stack);
+    return found;
+}
+
+
+static void save_packed_node_recursive(const packed_tree_t* packed, uint32_t node, FILE* file)
+{
+    if (node == PACKED_NIL)
+    {
+        fprintf(file, "nil");
+        return;
+    }
+
+    fputs("(\"", file);
+    tree_write_phrase(file, packed_node_question(packed, node));
+    fputs("\" ", file);
+    save_packed_node_recursive(packed, packed_node_yes(packed, node), file);
+    fprintf(file, " ");
+    save_packed_node_recursive(packed, packed_node_no(packed, node), file);
+    fprintf(file, ")");
+}
+
+
+tree_error_type packed_tree_save_to_file(const packed_tree_t* packed, const char* filename)
+{
+    assert(packed   != NULL);
+    assert(filename != NULL);
+
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    save_packed_node_recursive(packed, packed -> root, file);
+
+    fclose(file);
+
+    return TREE_NO_ERROR;
+}
+
+
+size_t packed_tree_memory_usage(const packed_tree_t* packed)
+{
+    assert(packed != NULL);
+
+    return (size_t)packed -> capacity * sizeof(packed_node_t) + packed -> pool_capacity;
+}
+
+
+// Сколько на самом деле займёт блок malloc такого размера
+size_t heap_chunk_size(size_t requested)
+{
+    size_t size = (requested + HEAP_CHUNK_OVERHEAD + HEAP_CHUNK_ALIGNMENT - 1) / HEAP_CHUNK_ALIGNMENT * HEAP_CHUNK_ALIGNMENT;
+
+    return (size < HEAP_MIN_CHUNK_SIZE) ? HEAP_MIN_CHUNK_SIZE : size;
+}
+
+
+// Узлы из арены tree_compact лежат без заголовков malloc, остальные - каждый в своём блоке
+size_t tree_heap_memory_estimate(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    size_t total = 0;
+
+    if (tree -> arena != NULL)
+        total += tree -> arena -> number_of_nodes * sizeof(node_t) + tree -> arena -> phrases_size;
+
+    if (tree -> root == NULL)
+        return total;
+
+    const node_t** stack = (const node_t**)calloc(tree -> size + 1, sizeof(const node_t*));
+    if (stack == NULL)
+        return total;
+
+    size_t stack_size = 0;
+    size_t visited = 0;
+    stack[stack_size++] = tree -> root;
+
+    while (stack_size > 0 && visited++ < tree -> size)
+    {
+        const node_t* node = stack[--stack_size];
+
+        if (!is_node_in_arena(tree -> arena, node))
+            total += heap_chunk_size(sizeof(node_t));
+
+        if (!is_phrase_in_arena(tree -> arena, node -> question))
+            total += heap_chunk_size(strlen(node -> question) + 1);
+
+        if (node -> no  != NULL && stack_size <= tree -> size) stack[stack_size++] = node -> no;
+        if (node -> yes != NULL && stack_size <= tree -> size) stack[stack_size++] = node -> yes;
+    }
+
+    free(stack);
+    return total;
+}
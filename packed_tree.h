@@ -0,0 +1,63 @@
+#ifndef PACKED_TREE_H_
+#define PACKED_TREE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define PACKED_NIL UINT32_MAX
+#define PACKED_INLINE_PHRASE_SIZE 11 // до 10 символов и '\0' лежат прямо в узле
+#define PACKED_PHRASE_IN_POOL 0xFF   // в phrase_length: в phrase лежит смещение в пуле
+
+// Для оценки памяти обычного дерева: заголовок и выравнивание блока malloc
+#define HEAP_CHUNK_OVERHEAD  8
+#define HEAP_CHUNK_ALIGNMENT 16
+#define HEAP_MIN_CHUNK_SIZE  32
+
+// 24 байта вместо node_t (32 байта + заголовок malloc) и отдельной строки в куче.
+// Ссылки - 32-битные индексы в массиве узлов, поэтому массив можно переносить целиком
+struct packed_node_t
+{
+    uint32_t yes;
+    uint32_t no;
+    uint32_t parent;
+    uint8_t phrase_length;
+    char phrase[PACKED_INLINE_PHRASE_SIZE];
+};
+
+struct packed_tree_t
+{
+    packed_node_t* nodes;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t root;
+
+    char* pool; // длинные фразы подряд через '\0'
+    size_t pool_size;
+    size_t pool_capacity;
+};
+
+tree_error_type packed_tree_build(const tree_t* tree, packed_tree_t* packed);
+tree_error_type packed_tree_unpack(const packed_tree_t* packed, tree_t* tree);
+void packed_tree_destroy(packed_tree_t* packed);
+
+// Доступ к узлам. Строка из пула действительна до следующего изменения дерева
+const char* packed_node_question(const packed_tree_t* packed, uint32_t node);
+uint32_t packed_node_yes(const packed_tree_t* packed, uint32_t node);
+uint32_t packed_node_no(const packed_tree_t* packed, uint32_t node);
+uint32_t packed_node_parent(const packed_tree_t* packed, uint32_t node);
+bool packed_node_is_leaf(const packed_tree_t* packed, uint32_t node);
+
+// Те же операции, что и у tree_t
+tree_error_type packed_tree_split_node(packed_tree_t* packed, uint32_t old_node, const char* feature, const char* new_object);
+uint32_t packed_tree_find_leaf_by_phrase(const packed_tree_t* packed, const char* phrase);
+tree_error_type packed_tree_save_to_file(const packed_tree_t* packed, const char* filename);
+
+size_t packed_tree_memory_usage(const packed_tree_t* packed);
+size_t tree_heap_memory_estimate(const tree_t* tree);
+size_t heap_chunk_size(size_t requested);
+
+#endif // PACKED_TREE_H_
@@ -0,0 +1,272 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "phrase_filter.h"
+#include "tree_error_type.h"
+
+phrase_filter_t negative_phrase_filter = {};
+
+static const char* DEFAULT_FORBIDDEN_PHRASES[] = {"do not", "is not", "does not", "did not",
+                                                  "don't", "isn't", "doesn't", "didn't"};
+
+
+static void build_symbol_classes(phrase_filter_t* filter, const char* const* phrases, size_t number_of_phrases)
+{
+    assert(filter  != NULL);
+    assert(phrases != NULL);
+
+    unsigned char lower_class[PHRASE_FILTER_ALPHABET_SIZE] = {};
+    filter -> number_of_classes = 1; // класс 0 - все остальные байты
+
+    for (size_t i = 0; i < number_of_phrases; i++)
+    {
+        for (const char* letter = phrases[i]; *letter; letter++)
+        {
+            unsigned char lower = (unsigned char)tolower((unsigned char)*letter);
+            if (lower_class[lower] == 0)
+                lower_class[lower] = (unsigned char)(filter -> number_of_classes++);
+        }
+    }
+
+    // регистр сворачиваем прямо в таблице, чтобы при поиске не вызывать tolower
+    for (int symbol = 0; symbol < PHRASE_FILTER_ALPHABET_SIZE; symbol++)
+        filter -> symbol_class[symbol] = lower_class[(unsigned char)tolower(symbol)];
+}
+
+
+static size_t add_phrase_to_trie(phrase_filter_t* filter, const char* phrase)
+{
+    assert(filter != NULL);
+    assert(phrase != NULL);
+
+    uint32_t state = PHRASE_FILTER_ROOT_STATE;
+
+    for (const char* letter = phrase; *letter; letter++)
+    {
+        uint32_t* next = &filter -> transitions[state * filter -> number_of_classes +
+                                                filter -> symbol_class[(unsigned char)*letter]];
+        if (*next == PHRASE_FILTER_NO_STATE)
+            *next = (uint32_t)(filter -> number_of_states++);
+
+        state = *next;
+    }
+
+    filter -> is_terminal[state] = 1;
+
+    return filter -> number_of_states;
+}
+
+
+static tree_error_type complete_transitions(phrase_filter_t* filter)
+{
+    assert(filter != NULL);
+
+    size_t classes = filter -> number_of_classes;
+
+    uint32_t* fail  = (uint32_t*)calloc(filter -> number_of_states, sizeof(uint32_t));
+    uint32_t* queue = (uint32_t*)calloc(filter -> number_of_states, sizeof(uint32_t));
+    if (fail == NULL || queue == NULL)
+    {
+        free(fail);
+        free(queue);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    size_t head = 0, tail = 0;
+
+    for (size_t symbol = 0; symbol < classes; symbol++)
+    {
+        uint32_t* next = &filter -> transitions[symbol];
+        if (*next == PHRASE_FILTER_NO_STATE)
+        {
+            *next = PHRASE_FILTER_ROOT_STATE;
+        }
+        else
+        {
+            fail[*next] = PHRASE_FILTER_ROOT_STATE;
+            queue[tail++] = *next;
+        }
+    }
+
+    // обход в ширину: к моменту обработки состояния его суффиксная ссылка уже достроена
+    while (head < tail)
+    {
+        uint32_t state = queue[head++];
+
+        for (size_t symbol = 0; symbol < classes; symbol++)
+        {
+            uint32_t* next = &filter -> transitions[state * classes + symbol];
+            uint32_t fallback = filter -> transitions[fail[state] * classes + symbol];
+
+            if (*next == PHRASE_FILTER_NO_STATE)
+            {
+                *next = fallback;
+            }
+            else
+            {
+                fail[*next] = fallback;
+                filter -> is_terminal[*next] |= filter -> is_terminal[fallback];
+                queue[tail++] = *next;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type phrase_filter_build(phrase_filter_t* filter, const char* const* phrases, size_t number_of_phrases)
+{
+    if (filter == NULL || phrases == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    phrase_filter_t new_filter = {};
+
+    size_t max_states = 1;
+    for (size_t i = 0; i < number_of_phrases; i++)
+        max_states += strlen(phrases[i]);
+
+    build_symbol_classes(&new_filter, phrases, number_of_phrases);
+
+    new_filter.transitions = (uint32_t*)malloc(max_states * new_filter.number_of_classes * sizeof(uint32_t));
+    new_filter.is_terminal = (unsigned char*)calloc(max_states, sizeof(unsigned char));
+    if (new_filter.transitions == NULL || new_filter.is_terminal == NULL)
+    {
+        phrase_filter_destroy(&new_filter);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    memset(new_filter.transitions, 0xFF, max_states * new_filter.number_of_classes * sizeof(uint32_t));
+    new_filter.number_of_states = 1; // корень
+
+    for (size_t i = 0; i < number_of_phrases; i++)
+    {
+        if (phrases[i][0] == '\0')
+            continue;
+
+        add_phrase_to_trie(&new_filter, phrases[i]);
+        new_filter.number_of_phrases++;
+    }
+
+    tree_error_type result = complete_transitions(&new_filter);
+    if (result != TREE_NO_ERROR)
+    {
+        phrase_filter_destroy(&new_filter);
+        return result;
+    }
+
+    phrase_filter_destroy(filter);
+    *filter = new_filter;
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type phrase_filter_load_from_file(phrase_filter_t* filter, const char* filename)
+{
+    assert(filter   != NULL);
+    assert(filename != NULL);
+
+    char* buffer = NULL;
+    tree_error_type result = read_file_to_buffer(filename, &buffer, NULL);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    size_t number_of_lines = 1;
+    for (const char* symbol = buffer; *symbol; symbol++)
+    {
+        if (*symbol == '\n')
+            number_of_lines++;
+    }
+
+    const char** phrases = (const char**)calloc(number_of_lines, sizeof(const char*));
+    if (phrases == NULL)
+    {
+        free(buffer);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    // одна фраза на строку, пустые строки и строки с '#' пропускаем
+    size_t number_of_phrases = 0;
+    for (char* line = buffer; line != NULL; )
+    {
+        char* line_end = strchr(line, '\n');
+        if (line_end != NULL)
+            *line_end = '\0';
+
+        line[strcspn(line, "\r")] = '\0';
+
+        if (line[0] != '\0' && line[0] != '#')
+            phrases[number_of_phrases++] = line;
+
+        line = (line_end != NULL) ? line_end + 1 : NULL;
+    }
+
+    result = phrase_filter_build(filter, phrases, number_of_phrases);
+
+    free(phrases);
+    free(buffer);
+
+    return result;
+}
+
+
+void phrase_filter_destroy(phrase_filter_t* filter)
+{
+    if (filter == NULL)
+        return;
+
+    free(filter -> transitions);
+    free(filter -> is_terminal);
+
+    *filter = {};
+}
+
+
+bool phrase_filter_matches(const phrase_filter_t* filter, const char* text)
+{
+    assert(filter != NULL);
+    assert(text   != NULL);
+
+    if (filter -> number_of_phrases == 0)
+        return false;
+
+    size_t classes = filter -> number_of_classes;
+    uint32_t state = PHRASE_FILTER_ROOT_STATE;
+
+    for (const unsigned char* symbol = (const unsigned char*)text; *symbol; symbol++)
+    {
+        state = filter -> transitions[state * classes + filter -> symbol_class[*symbol]];
+        if (filter -> is_terminal[state])
+            return true;
+    }
+
+    return false;
+}
+
+
+tree_error_type initialize_negative_phrase_filter(const char* filename)
+{
+    if (filename != NULL && phrase_filter_load_from_file(&negative_phrase_filter, filename) == TREE_NO_ERROR)
+    {
+        printf("Loaded %zu forbidden phrases from %s\n", negative_phrase_filter.number_of_phrases, filename);
+        return TREE_NO_ERROR;
+    }
+
+    size_t number_of_phrases = sizeof(DEFAULT_FORBIDDEN_PHRASES) / sizeof(DEFAULT_FORBIDDEN_PHRASES[0]);
+
+    return phrase_filter_build(&negative_phrase_filter, DEFAULT_FORBIDDEN_PHRASES, number_of_phrases);
+}
+
+
+void destroy_negative_phrase_filter()
+{
+    phrase_filter_destroy(&negative_phrase_filter);
+}
@@ -0,0 +1,36 @@
+#ifndef PHRASE_FILTER_H_
+#define PHRASE_FILTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tree_error_type.h"
+
+#define PHRASE_FILTER_ALPHABET_SIZE 256
+#define PHRASE_FILTER_ROOT_STATE 0
+#define PHRASE_FILTER_NO_STATE UINT32_MAX
+
+// Детерминированный автомат Ахо-Корасик: все запрещённые фразы ищутся
+// за один проход по строке без выделения памяти, регистр не учитывается
+struct phrase_filter_t
+{
+    unsigned char symbol_class[PHRASE_FILTER_ALPHABET_SIZE]; // байт -> класс (0 - байта нет ни в одной фразе)
+    size_t number_of_classes;
+
+    uint32_t* transitions; // number_of_states * number_of_classes
+    unsigned char* is_terminal;
+    size_t number_of_states;
+
+    size_t number_of_phrases;
+};
+
+extern phrase_filter_t negative_phrase_filter;
+
+tree_error_type phrase_filter_build(phrase_filter_t* filter, const char* const* phrases, size_t number_of_phrases);
+tree_error_type phrase_filter_load_from_file(phrase_filter_t* filter, const char* filename);
+void phrase_filter_destroy(phrase_filter_t* filter);
+bool phrase_filter_matches(const phrase_filter_t* filter, const char* text);
+
+tree_error_type initialize_negative_phrase_filter(const char* filename);
+void destroy_negative_phrase_filter();
+
+#endif // PHRASE_FILTER_H_
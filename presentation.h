@@ -0,0 +1,13 @@
+#ifndef PRESENTATION_H_
+#define PRESENTATION_H_
+
+// Бэкенд графики и озвучки выбирается при сборке: -D PRESENTATION_BACKEND=PRESENTATION_NONE
+#define PRESENTATION_TXLIB   1 // окно TXLib, анимация и txSpeak (только Windows)
+#define PRESENTATION_CONSOLE 2 // подписи сцен пишутся в stderr, без окна и звука
+#define PRESENTATION_NONE    3 // headless: вызовы графики и озвучки исчезают при компиляции
+
+#ifndef PRESENTATION_BACKEND
+#define PRESENTATION_BACKEND PRESENTATION_TXLIB
+#endif
+
+#endif // PRESENTATION_H_
@@ -0,0 +1,228 @@
+#include "presentation.h"
+
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
+
+#include <TXLib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "graphics.h"
+#include "presentation_queue.h"
+#include "trace.h"
+
+struct presentation_visual_job
+{
+    presentation_job_type type;
+    int state;
+    char text[MAX_LENGTH_OF_PRESENTATION_TEXT];
+};
+
+struct presentation_queue_t
+{
+    std::mutex mutex;
+    std::condition_variable has_work;
+    std::thread worker;
+    bool running;
+
+    presentation_visual_job visual; // единственный слот: более новое задание затирает старое
+    unsigned long long visual_generation;
+
+    char speech[MAX_NUMBER_OF_SPEECH_JOBS][MAX_LENGTH_OF_PRESENTATION_TEXT];
+    size_t speech_head;
+    size_t speech_count;
+};
+
+static presentation_queue_t presentation_queue;
+
+
+// Ждём между кадрами, но просыпаемся сразу, как только пришло новое задание отрисовки
+static bool wait_frame_delay(std::unique_lock<std::mutex>& lock, unsigned long long generation)
+{
+    TRACE_SPAN("frame delay"); // бывший txSleep между кадрами
+
+    presentation_queue.has_work.wait_for(lock, std::chrono::milliseconds(FRAME_DELAY), [generation]
+    {
+        return !presentation_queue.running || presentation_queue.visual_generation != generation;
+    });
+
+    return presentation_queue.running && presentation_queue.visual_generation == generation;
+}
+
+
+static void run_animation_job(std::unique_lock<std::mutex>& lock, const presentation_visual_job* job,
+                              unsigned long long generation)
+{
+    assert(job != NULL);
+
+    for (int cycle = 0; cycle < ANIMATION_CYCLES; cycle++)
+    {
+        for (int i = 0; i < NUMBER_OF_FRAMES; i++)
+        {
+            lock.unlock();
+            {
+                TRACE_SPAN("show scene");
+                show_scene(i, job -> text); // один present на кадр
+            }
+            lock.lock();
+
+            if (!wait_frame_delay(lock, generation))
+                return; // кадры устарели, их место займёт новый вопрос
+        }
+    }
+
+    lock.unlock();
+    draw_game_state_background(STATE_MAIN_MENU);
+    lock.lock();
+}
+
+
+static void presentation_worker()
+{
+    TRACE_THREAD_NAME("presentation");
+
+    std::unique_lock<std::mutex> lock(presentation_queue.mutex);
+
+    while (presentation_queue.running)
+    {
+        presentation_queue.has_work.wait(lock, []
+        {
+            return !presentation_queue.running ||
+                   presentation_queue.visual.type != PRESENTATION_JOB_NONE ||
+                   presentation_queue.speech_count > 0;
+        });
+
+        if (presentation_queue.visual.type != PRESENTATION_JOB_NONE)
+        {
+            presentation_visual_job job = presentation_queue.visual;
+            unsigned long long generation = presentation_queue.visual_generation;
+            presentation_queue.visual.type = PRESENTATION_JOB_NONE;
+
+            if (job.type == PRESENTATION_JOB_ANIMATION)
+            {
+                run_animation_job(lock, &job, generation);
+            }
+            else
+            {
+                lock.unlock();
+                draw_game_state_background(job.state);
+                lock.lock();
+            }
+        }
+        else if (presentation_queue.speech_count > 0)
+        {
+            char text[MAX_LENGTH_OF_PRESENTATION_TEXT] = {};
+            strcpy(text, presentation_queue.speech[presentation_queue.speech_head]);
+
+            presentation_queue.speech_head = (presentation_queue.speech_head + 1) % MAX_NUMBER_OF_SPEECH_JOBS;
+            presentation_queue.speech_count--;
+
+            lock.unlock();
+            {
+                TRACE_SPAN("txSpeak");
+                txSpeak(text);
+            }
+            lock.lock();
+        }
+    }
+}
+
+
+bool presentation_queue_start()
+{
+    std::lock_guard<std::mutex> guard(presentation_queue.mutex);
+
+    if (presentation_queue.running)
+        return true;
+
+    presentation_queue.running = true;
+    presentation_queue.visual.type = PRESENTATION_JOB_NONE;
+    presentation_queue.speech_head = 0;
+    presentation_queue.speech_count = 0;
+
+    presentation_queue.worker = std::thread(presentation_worker);
+
+    return true;
+}
+
+
+void presentation_queue_stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(presentation_queue.mutex);
+        if (!presentation_queue.running)
+            return;
+
+        presentation_queue.running = false;
+    }
+
+    presentation_queue.has_work.notify_all();
+    presentation_queue.worker.join();
+}
+
+
+bool presentation_queue_is_running()
+{
+    std::lock_guard<std::mutex> guard(presentation_queue.mutex);
+    return presentation_queue.running;
+}
+
+
+static void post_visual_job(presentation_job_type type, int state, const char* text)
+{
+    {
+        std::lock_guard<std::mutex> guard(presentation_queue.mutex);
+
+        presentation_queue.visual.type  = type;
+        presentation_queue.visual.state = state;
+        snprintf(presentation_queue.visual.text, sizeof(presentation_queue.visual.text), "%s", text);
+
+        presentation_queue.visual_generation++;
+    }
+
+    presentation_queue.has_work.notify_one();
+}
+
+
+void presentation_post_background(int state)
+{
+    post_visual_job(PRESENTATION_JOB_BACKGROUND, state, "");
+}
+
+
+void presentation_post_animation(const char* text)
+{
+    assert(text != NULL);
+
+    post_visual_job(PRESENTATION_JOB_ANIMATION, STATE_MAIN_MENU, text);
+}
+
+
+void presentation_post_speech(const char* text)
+{
+    assert(text != NULL);
+
+    {
+        std::lock_guard<std::mutex> guard(presentation_queue.mutex);
+
+        if (presentation_queue.speech_count == MAX_NUMBER_OF_SPEECH_JOBS)
+        {
+            // очередь забита - самая старая реплика уже неактуальна
+            presentation_queue.speech_head = (presentation_queue.speech_head + 1) % MAX_NUMBER_OF_SPEECH_JOBS;
+            presentation_queue.speech_count--;
+        }
+
+        size_t tail = (presentation_queue.speech_head + presentation_queue.speech_count) % MAX_NUMBER_OF_SPEECH_JOBS;
+        snprintf(presentation_queue.speech[tail], sizeof(presentation_queue.speech[tail]), "%s", text);
+        presentation_queue.speech_count++;
+    }
+
+    presentation_queue.has_work.notify_one();
+}
+
+#endif // PRESENTATION_BACKEND == PRESENTATION_TXLIB
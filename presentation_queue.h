@@ -0,0 +1,25 @@
+#ifndef PRESENTATION_QUEUE_H_
+#define PRESENTATION_QUEUE_H_
+
+#define MAX_NUMBER_OF_SPEECH_JOBS 32
+#define MAX_LENGTH_OF_PRESENTATION_TEXT 1024
+
+enum presentation_job_type
+{
+    PRESENTATION_JOB_NONE       = 0,
+    PRESENTATION_JOB_BACKGROUND = 1,
+    PRESENTATION_JOB_ANIMATION  = 2,
+};
+
+// Отрисовка и озвучка выполняются отдельным потоком, игровая логика только ставит задания.
+// Кадр на экране всегда один, поэтому новое задание отрисовки вытесняет старое (даже недоигранное),
+// а реплики копятся в кольцевой очереди, при переполнении старые выбрасываются
+bool presentation_queue_start();
+void presentation_queue_stop();
+bool presentation_queue_is_running();
+
+void presentation_post_background(int state);
+void presentation_post_animation(const char* text);
+void presentation_post_speech(const char* text);
+
+#endif // PRESENTATION_QUEUE_H_
@@ -1,10 +1,15 @@
-#include <TXLib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
 
 #include "speech.h"
+#include "presentation_queue.h"
+#include "trace.h"
+
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
+
+#include <TXLib.h>
 
 #define MAX_LENGTH_OF_ANSWER 256
 
@@ -25,8 +30,18 @@ void speak_print_with_variable_number_of_parameters(const char* format, ...)
     if (length <= 0 || buffer[0] == '\0')
         return;
 
-    char final_buffer[MAX_LENGTH_OF_ANSWER];
-    snprintf(final_buffer, sizeof(final_buffer), "\v%s", buffer);
+    // текст выводим сразу, чтобы не задерживать ввод, а озвучку отдаём потоку отрисовки
+    fputs(buffer, stdout);
+    fflush(stdout);
 
-    txSpeak(final_buffer);
+    if (presentation_queue_is_running())
+    {
+        presentation_post_speech(buffer);
+        return;
+    }
+
+    TRACE_SPAN("txSpeak");
+    txSpeak(buffer);
 }
+
+#endif // PRESENTATION_BACKEND == PRESENTATION_TXLIB
@@ -1,8 +1,15 @@
 #ifndef SPEECH_H_
 #define SPEECH_H_
 
+#include <stdio.h>
 #include <stdarg.h>
+#include "presentation.h"
 
+#if PRESENTATION_BACKEND == PRESENTATION_TXLIB
 void speak_print_with_variable_number_of_parameters(const char* format, ...);
+#else
+// без синтезатора речи остаётся только вывод в консоль
+#define speak_print_with_variable_number_of_parameters printf
+#endif
 
 #endif // SPEECH_H_
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "startup_profiler.h"
+
+
+void startup_profiler_start(startup_profiler_t* profiler)
+{
+    assert(profiler != NULL);
+
+    profiler -> start = std::chrono::steady_clock::now();
+    profiler -> number_of_phases = 0;
+}
+
+
+double startup_profiler_elapsed_ms(const startup_profiler_t* profiler)
+{
+    assert(profiler != NULL);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - profiler -> start;
+
+    return elapsed.count();
+}
+
+
+size_t startup_phase_begin(startup_profiler_t* profiler, const char* name)
+{
+    assert(profiler != NULL);
+    assert(name     != NULL);
+
+    size_t phase = profiler -> number_of_phases++;
+    if (phase >= MAX_NUMBER_OF_STARTUP_PHASES)
+        return MAX_NUMBER_OF_STARTUP_PHASES; // лишние фазы просто не учитываем
+
+    profiler -> phases[phase].name        = name;
+    profiler -> phases[phase].start_ms    = startup_profiler_elapsed_ms(profiler);
+    profiler -> phases[phase].duration_ms = 0;
+    profiler -> phases[phase].finished    = false;
+
+    return phase;
+}
+
+
+void startup_phase_end(startup_profiler_t* profiler, size_t phase)
+{
+    assert(profiler != NULL);
+
+    if (phase >= MAX_NUMBER_OF_STARTUP_PHASES)
+        return;
+
+    profiler -> phases[phase].duration_ms = startup_profiler_elapsed_ms(profiler) - profiler -> phases[phase].start_ms;
+    profiler -> phases[phase].finished    = true;
+}
+
+
+void startup_profiler_report(const startup_profiler_t* profiler, FILE* stream)
+{
+    assert(profiler != NULL);
+    assert(stream   != NULL);
+
+    size_t number_of_phases = profiler -> number_of_phases;
+    if (number_of_phases > MAX_NUMBER_OF_STARTUP_PHASES)
+        number_of_phases = MAX_NUMBER_OF_STARTUP_PHASES;
+
+    fprintf(stream, "Startup profile:\n");
+    for (size_t i = 0; i < number_of_phases; i++)
+    {
+        const startup_phase_t* phase = &profiler -> phases[i];
+
+        if (phase -> finished)
+            fprintf(stream, "  %-24s %9.3f ms  (from +%.3f ms)\n", phase -> name, phase -> duration_ms, phase -> start_ms);
+        else
+            fprintf(stream, "  %-24s  unfinished (from +%.3f ms)\n", phase -> name, phase -> start_ms);
+    }
+    fprintf(stream, "  %-24s %9.3f ms\n\n", "total to first menu", startup_profiler_elapsed_ms(profiler));
+}
@@ -0,0 +1,34 @@
+#ifndef STARTUP_PROFILER_H_
+#define STARTUP_PROFILER_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <chrono>
+
+#define MAX_NUMBER_OF_STARTUP_PHASES 16
+
+struct startup_phase_t
+{
+    const char* name;
+    double start_ms;    // от начала запуска
+    double duration_ms;
+    bool finished;
+};
+
+// Фазы могут идти в разных потоках: каждая пишет только в свой слот
+struct startup_profiler_t
+{
+    std::chrono::steady_clock::time_point start = {};
+    startup_phase_t phases[MAX_NUMBER_OF_STARTUP_PHASES] = {};
+    std::atomic<size_t> number_of_phases = {0};
+};
+
+void startup_profiler_start(startup_profiler_t* profiler);
+size_t startup_phase_begin(startup_profiler_t* profiler, const char* name);
+void startup_phase_end(startup_profiler_t* profiler, size_t phase);
+double startup_profiler_elapsed_ms(const startup_profiler_t* profiler);
+void startup_profiler_report(const startup_profiler_t* profiler, FILE* stream);
+
+#endif // STARTUP_PROFILER_H_
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "string_pool.h"
+#include "tree_error_type.h"
+
+#define STRING_POOL_HASH_OFFSET 14695981039346656037ULL
+#define STRING_POOL_HASH_PRIME  1099511628211ULL
+
+
+static uint64_t hash_pool_string(const char* text)
+{
+    uint64_t hash = STRING_POOL_HASH_OFFSET;
+
+    for (const char* symbol = text; *symbol != '\0'; symbol++)
+    {
+        hash ^= (unsigned char)*symbol;
+        hash *= STRING_POOL_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+
+tree_error_type string_pool_init(string_pool_t* pool)
+{
+    assert(pool != NULL);
+
+    pool -> number_of_chunks = 0;
+    pool -> number_of_strings = 0;
+    pool -> interned_bytes = 0;
+    pool -> stored_bytes = 0;
+
+    pool -> buckets = (char**)calloc(STRING_POOL_INITIAL_BUCKETS, sizeof(char*));
+    if (pool -> buckets == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    pool -> number_of_buckets = STRING_POOL_INITIAL_BUCKETS;
+
+    return TREE_NO_ERROR;
+}
+
+
+void string_pool_destroy(string_pool_t* pool)
+{
+    if (pool == NULL)
+        return;
+
+    for (size_t i = 0; i < pool -> number_of_chunks; i++)
+        free(pool -> chunks[i].data);
+
+    free(pool -> buckets);
+
+    pool -> buckets = NULL;
+    pool -> number_of_buckets = 0;
+    pool -> number_of_strings = 0;
+    pool -> number_of_chunks = 0;
+}
+
+
+static char** find_pool_bucket(char** buckets, size_t number_of_buckets, const char* text, uint64_t hash)
+{
+    size_t mask = number_of_buckets - 1;
+
+    for (size_t index = hash & mask; ; index = (index + 1) & mask)
+    {
+        if (buckets[index] == NULL || strcmp(buckets[index], text) == 0)
+            return &buckets[index];
+    }
+}
+
+
+// Заполненность держим не выше половины, чтобы цепочки проб оставались короткими
+static tree_error_type grow_pool_buckets(string_pool_t* pool)
+{
+    size_t new_number_of_buckets = pool -> number_of_buckets * 2;
+
+    char** new_buckets = (char**)calloc(new_number_of_buckets, sizeof(char*));
+    if (new_buckets == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    for (size_t i = 0; i < pool -> number_of_buckets; i++)
+    {
+        char* text = pool -> buckets[i];
+        if (text != NULL)
+            *find_pool_bucket(new_buckets, new_number_of_buckets, text, hash_pool_string(text)) = text;
+    }
+
+    free(pool -> buckets);
+    pool -> buckets = new_buckets;
+    pool -> number_of_buckets = new_number_of_buckets;
+
+    return TREE_NO_ERROR;
+}
+
+
+static char* allocate_in_pool(string_pool_t* pool, size_t size)
+{
+    size_t number_of_chunks = pool -> number_of_chunks;
+
+    if (number_of_chunks > 0)
+    {
+        string_pool_chunk_t* last = &pool -> chunks[number_of_chunks - 1];
+        if (last -> size - last -> used >= size)
+        {
+            char* place = last -> data + last -> used;
+            last -> used += size;
+            return place;
+        }
+    }
+
+    if (number_of_chunks == MAX_NUMBER_OF_STRING_POOL_CHUNKS)
+        return NULL;
+
+    size_t chunk_size = (size_t)STRING_POOL_FIRST_CHUNK_SIZE << number_of_chunks;
+    if (chunk_size < size)
+        chunk_size = size;
+
+    string_pool_chunk_t* chunk = &pool -> chunks[number_of_chunks];
+
+    chunk -> data = (char*)calloc(chunk_size, sizeof(char));
+    if (chunk -> data == NULL)
+        return NULL;
+
+    chunk -> size = chunk_size;
+    chunk -> used = size;
+
+    // блок виден читателям только после того, как он полностью заполнен
+    pool -> number_of_chunks.store(number_of_chunks + 1, std::memory_order_release);
+
+    return chunk -> data;
+}
+
+
+tree_error_type string_pool_intern(string_pool_t* pool, const char* text, char** interned)
+{
+    assert(pool     != NULL);
+    assert(text     != NULL);
+    assert(interned != NULL);
+
+    std::lock_guard<std::mutex> lock(pool -> mutex);
+
+    size_t size = strlen(text) + 1;
+    pool -> interned_bytes += size;
+
+    uint64_t hash = hash_pool_string(text);
+
+    char** bucket = find_pool_bucket(pool -> buckets, pool -> number_of_buckets, text, hash);
+    if (*bucket != NULL)
+    {
+        *interned = *bucket;
+        return TREE_NO_ERROR;
+    }
+
+    if ((pool -> number_of_strings + 1) * 2 > pool -> number_of_buckets)
+    {
+        tree_error_type result = grow_pool_buckets(pool);
+        if (result != TREE_NO_ERROR)
+            return result;
+
+        bucket = find_pool_bucket(pool -> buckets, pool -> number_of_buckets, text, hash);
+    }
+
+    char* copy = allocate_in_pool(pool, size);
+    if (copy == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    memcpy(copy, text, size);
+    *bucket = copy;
+
+    pool -> number_of_strings++;
+    pool -> stored_bytes += size;
+
+    *interned = copy;
+    return TREE_NO_ERROR;
+}
+
+
+bool string_pool_contains(const string_pool_t* pool, const char* text)
+{
+    if (pool == NULL || text == NULL)
+        return false;
+
+    size_t number_of_chunks = pool -> number_of_chunks.load(std::memory_order_acquire);
+    uintptr_t address = (uintptr_t)text;
+
+    for (size_t i = 0; i < number_of_chunks; i++)
+    {
+        uintptr_t begin = (uintptr_t)pool -> chunks[i].data;
+
+        if (address >= begin && address < begin + pool -> chunks[i].size)
+            return true;
+    }
+
+    return false;
+}
+
+
+size_t string_pool_memory_usage(const string_pool_t* pool)
+{
+    assert(pool != NULL);
+
+    size_t total = pool -> number_of_buckets * sizeof(char*);
+
+    size_t number_of_chunks = pool -> number_of_chunks;
+    for (size_t i = 0; i < number_of_chunks; i++)
+        total += pool -> chunks[i].size;
+
+    return total;
+}
@@ -0,0 +1,46 @@
+#ifndef STRING_POOL_H_
+#define STRING_POOL_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "tree_error_type.h"
+
+#define STRING_POOL_FIRST_CHUNK_SIZE (64 * 1024) // каждый следующий блок вдвое больше
+#define MAX_NUMBER_OF_STRING_POOL_CHUNKS 40
+#define STRING_POOL_INITIAL_BUCKETS 1024
+
+struct string_pool_chunk_t
+{
+    char* data;
+    size_t size;
+    size_t used;
+};
+
+// Общее хранилище фраз для всех деревьев процесса: одинаковая фраза лежит один раз.
+// Строки из пула неизменяемы и не освобождаются по одной, пул живёт дольше любого дерева.
+// Блоки только добавляются, поэтому проверка принадлежности идёт без блокировки
+struct string_pool_t
+{
+    string_pool_chunk_t chunks[MAX_NUMBER_OF_STRING_POOL_CHUNKS] = {};
+    std::atomic<size_t> number_of_chunks = {0};
+
+    char** buckets = NULL; // открытая адресация, NULL - пусто
+    size_t number_of_buckets = 0;
+    size_t number_of_strings = 0;
+
+    size_t interned_bytes = 0;   // сколько байт фраз попросили положить
+    size_t stored_bytes = 0;     // сколько из них действительно лежит в пуле
+
+    std::mutex mutex = {};
+};
+
+tree_error_type string_pool_init(string_pool_t* pool);
+void string_pool_destroy(string_pool_t* pool);
+tree_error_type string_pool_intern(string_pool_t* pool, const char* text, char** interned);
+bool string_pool_contains(const string_pool_t* pool, const char* text);
+size_t string_pool_memory_usage(const string_pool_t* pool);
+
+#endif // STRING_POOL_H_
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "tree.h"
+#include "trace.h"
+
+// Время хранится в тиках счётчика процессора: он вдвое дешевле steady_clock,
+// а в наносекунды тики переводятся один раз, при записи трассы
+struct trace_event_t
+{
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+    std::atomic<unsigned> thread_id; // кольцо переходит от потока к потоку, поэтому у каждого события
+    std::atomic<uint64_t> sequence;  // номер события + 1, пока владелец его пишет - 0
+};
+
+struct trace_buffer_t
+{
+    trace_event_t events[TRACE_RING_SIZE];
+    std::atomic<uint64_t> head; // сколько событий записано за всё время, меняет только владелец
+
+    std::atomic<bool> in_use;
+    trace_buffer_t* next; // после вставки в список не меняется
+};
+
+// Отдаёт кольцо следующему потоку, когда его владелец завершается
+struct trace_thread_t
+{
+    trace_buffer_t* buffer;
+    unsigned thread_id;
+
+    ~trace_thread_t()
+    {
+        if (buffer != NULL)
+            buffer -> in_use.store(false, std::memory_order_release);
+    }
+};
+
+struct trace_state_t
+{
+    std::atomic<bool> enabled = {false};
+    std::atomic<trace_buffer_t*> buffers = {NULL}; // все когда-либо созданные кольца, только добавляются
+    std::atomic<unsigned> next_thread_id = {0};
+    std::atomic<const char*> thread_names[TRACE_MAX_NAMED_THREADS] = {}; // по номеру потока
+
+    std::mutex mutex = {}; // старт и остановка
+    char filename[MAX_LENGTH_OF_FILENAME] = {};
+    uint64_t start_ticks = 0;
+    std::chrono::steady_clock::time_point start_time = {};
+};
+
+static trace_state_t trace_state;
+static thread_local trace_thread_t trace_thread;
+
+// ============================RECORDING========================================
+
+static inline uint64_t trace_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+// Медленный путь, один раз на поток: свободное кольцо завершившегося потока или новое
+static trace_buffer_t* acquire_trace_buffer()
+{
+    trace_thread.thread_id = trace_state.next_thread_id.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    for (trace_buffer_t* buffer = trace_state.buffers.load(std::memory_order_acquire); buffer != NULL; buffer = buffer -> next)
+    {
+        bool expected = false;
+        if (buffer -> in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return buffer;
+    }
+
+    trace_buffer_t* buffer = new (std::nothrow) trace_buffer_t();
+    if (buffer == NULL)
+        return NULL;
+
+    buffer -> in_use.store(true, std::memory_order_relaxed);
+    buffer -> next = trace_state.buffers.load(std::memory_order_relaxed);
+
+    while (!trace_state.buffers.compare_exchange_weak(buffer -> next, buffer, std::memory_order_release,
+                                                                               std::memory_order_relaxed));
+
+    return buffer;
+}
+
+
+#if TRACE_ENABLED
+uint64_t trace_span_begin()
+{
+    if (!trace_state.enabled.load(std::memory_order_relaxed))
+        return 0;
+
+    return trace_ticks();
+}
+
+
+void trace_span_end(const char* name, uint64_t begin)
+{
+    uint64_t end = trace_ticks();
+
+    trace_buffer_t* buffer = trace_thread.buffer;
+    if (buffer == NULL)
+    {
+        buffer = trace_thread.buffer = acquire_trace_buffer();
+        if (buffer == NULL)
+            return;
+    }
+
+    uint64_t head = buffer -> head.load(std::memory_order_relaxed);
+    trace_event_t* event = &buffer -> events[head & (TRACE_RING_SIZE - 1)];
+
+    event -> sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event -> name.store(name, std::memory_order_relaxed);
+    event -> begin.store(begin, std::memory_order_relaxed);
+    event -> end.store(end, std::memory_order_relaxed);
+    event -> thread_id.store(trace_thread.thread_id, std::memory_order_relaxed);
+
+    event -> sequence.store(head + 1, std::memory_order_release);
+    buffer -> head.store(head + 1, std::memory_order_release);
+}
+#endif
+
+
+void trace_set_thread_name(const char* name)
+{
+    assert(name != NULL);
+
+    if (trace_thread.buffer == NULL)
+    {
+        trace_thread.buffer = acquire_trace_buffer();
+        if (trace_thread.buffer == NULL)
+            return;
+    }
+
+    if (trace_thread.thread_id < TRACE_MAX_NAMED_THREADS)
+        trace_state.thread_names[trace_thread.thread_id].store(name, std::memory_order_relaxed);
+}
+
+// ============================OUTPUT===========================================
+
+// Кольца читаются, пока потоки, возможно, ещё пишут. Владелец мог как раз затирать
+// прочитанное событие: тогда его номер до и после чтения не совпадёт с ожидаемым
+static void write_thread_events(FILE* stream, trace_buffer_t* buffer, double ns_per_tick, bool* first)
+{
+    uint64_t head = buffer -> head.load(std::memory_order_acquire);
+    uint64_t first_index = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+
+    for (uint64_t index = first_index; index < head; index++)
+    {
+        const trace_event_t* event = &buffer -> events[index & (TRACE_RING_SIZE - 1)];
+
+        if (event -> sequence.load(std::memory_order_acquire) != index + 1)
+            continue; // уже затирается
+
+        const char* name = event -> name.load(std::memory_order_relaxed);
+        uint64_t begin   = event -> begin.load(std::memory_order_relaxed);
+        uint64_t end     = event -> end.load(std::memory_order_relaxed);
+        unsigned thread_id = event -> thread_id.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event -> sequence.load(std::memory_order_relaxed) != index + 1)
+            continue; // затёрто, пока читали
+
+        // события до trace_start, если трассу включали повторно
+        if (begin < trace_state.start_ticks || end < begin)
+            continue;
+
+        fprintf(stream, "%s\n{\"name\":\"%s\",\"cat\":\"akinator\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                *first ? "" : ",", name, thread_id,
+                (double)(begin - trace_state.start_ticks) * ns_per_tick / 1000,
+                (double)(end - begin) * ns_per_tick / 1000);
+        *first = false;
+    }
+}
+
+
+void trace_write_chrome_json(FILE* stream)
+{
+    assert(stream != NULL);
+
+    // цена тика по двум замерам: при старте трассы и сейчас
+    uint64_t ticks = trace_ticks() - trace_state.start_ticks;
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - trace_state.start_time;
+    double ns_per_tick = (ticks != 0) ? elapsed.count() / (double)ticks : 1;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", stream);
+
+    bool first = true;
+    unsigned number_of_threads = trace_state.next_thread_id.load(std::memory_order_relaxed);
+
+    for (unsigned thread_id = 1; thread_id <= number_of_threads && thread_id < TRACE_MAX_NAMED_THREADS; thread_id++)
+    {
+        const char* thread_name = trace_state.thread_names[thread_id].load(std::memory_order_relaxed);
+        if (thread_name == NULL)
+            continue;
+
+        fprintf(stream, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", thread_id, thread_name);
+        first = false;
+    }
+
+    for (trace_buffer_t* buffer = trace_state.buffers.load(std::memory_order_acquire); buffer != NULL; buffer = buffer -> next)
+        write_thread_events(stream, buffer, ns_per_tick, &first);
+
+    fputs("\n]}\n", stream);
+}
+
+// ============================CONTROL==========================================
+
+bool trace_start(const char* filename)
+{
+    assert(filename != NULL);
+
+    if (strlen(filename) >= MAX_LENGTH_OF_FILENAME)
+        return false;
+
+    std::lock_guard<std::mutex> guard(trace_state.mutex);
+
+    if (trace_state.enabled.load(std::memory_order_relaxed))
+        return true;
+
+    strcpy(trace_state.filename, filename);
+    trace_state.start_time  = std::chrono::steady_clock::now();
+    trace_state.start_ticks = trace_ticks();
+
+    trace_state.enabled.store(true, std::memory_order_relaxed);
+
+    return true;
+}
+
+
+static void write_trace_file(const char* filename)
+{
+    char temporary_name[MAX_LENGTH_OF_FILENAME + sizeof(TRACE_TEMPORARY_SUFFIX)] = {};
+    snprintf(temporary_name, sizeof(temporary_name), "%s%s", filename, TRACE_TEMPORARY_SUFFIX);
+
+    FILE* file = fopen(temporary_name, "w");
+    if (file == NULL)
+        return;
+
+    trace_write_chrome_json(file);
+
+    if (fclose(file) != 0)
+    {
+        remove(temporary_name);
+        return;
+    }
+
+    // rename в Windows не заменяет существующий файл
+    if (rename(temporary_name, filename) != 0)
+    {
+        remove(filename);
+        rename(temporary_name, filename);
+    }
+}
+
+
+void trace_stop()
+{
+    std::lock_guard<std::mutex> guard(trace_state.mutex);
+
+    if (!trace_state.enabled.load(std::memory_order_relaxed))
+        return;
+
+    trace_state.enabled.store(false, std::memory_order_relaxed);
+
+    write_trace_file(trace_state.filename);
+}
+
+
+bool trace_is_enabled()
+{
+    return trace_state.enabled.load(std::memory_order_relaxed);
+}
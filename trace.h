@@ -0,0 +1,58 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Спаны вырезаются при компиляции: -D TRACE_ENABLED=0
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_RING_SIZE 16384 // событий на поток, степень двойки: старые затираются новыми
+#define TRACE_MAX_NAMED_THREADS 256
+#define TRACE_TEMPORARY_SUFFIX ".tmp"
+
+// Каждый поток пишет в своё кольцо без блокировок и атомарных read-modify-write.
+// Кольцо завершившегося потока достаётся следующему новому потоку.
+// Имена спанов и потоков должны жить до записи трассы: обычно это строковые литералы
+void trace_set_thread_name(const char* name);
+
+// Формат Chrome Trace Event: открывается в Perfetto и chrome://tracing
+void trace_write_chrome_json(FILE* stream);
+
+// Запись включается при старте, при остановке трасса пишется в файл
+bool trace_start(const char* filename);
+void trace_stop();
+bool trace_is_enabled();
+
+#if TRACE_ENABLED
+uint64_t trace_span_begin();
+void trace_span_end(const char* name, uint64_t begin);
+
+struct trace_span_t
+{
+    const char* name;
+    uint64_t begin; // 0 - трассировка была выключена
+
+    explicit trace_span_t(const char* span_name) : name(span_name), begin(trace_span_begin()) {}
+    ~trace_span_t() { if (begin != 0) trace_span_end(name, begin); }
+
+    trace_span_t(const trace_span_t&) = delete;
+    trace_span_t& operator=(const trace_span_t&) = delete;
+};
+#endif
+
+#define TRACE_CONCATENATE_(first, second) first##second
+#define TRACE_CONCATENATE(first, second) TRACE_CONCATENATE_(first, second)
+
+#if TRACE_ENABLED
+#define TRACE_SPAN(name) trace_span_t TRACE_CONCATENATE(trace_span_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+#else
+#define TRACE_SPAN(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_H_
@@ -1,4 +1,3 @@
-#include <TXLib.h>
 #include <time.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -12,6 +11,16 @@
 #include "tree.h"
 #include "speech.h"
 #include "graphics.h"
+#include "phrase_filter.h"
+#include "tree_verifier.h"
+#include "tree_memory.h"
+#include "tree_parser.h"
+#include "tree_compact.h"
+#include "tree_embedded.h"
+#include "tree_history.h"
+#include "tree_snapshot.h"
+#include "metrics.h"
+#include "trace.h"
 #include "tree_error_type.h"
 
 const char* tree_error_translator(tree_error_type error)
@@ -51,30 +60,39 @@ tree_error_type tree_verify(tree_t* tree)
     if (tree == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    size_t actual_size = count_nodes_recursive(tree -> root);
+    tree_verify_report_t report = {};
+    tree_error_type result = tree_verify_deep(tree, 0, &report);
+    tree_verify_report_destroy(&report);
 
-    if (actual_size != tree -> size)
-        return TREE_ERROR_SIZE_MISMATCH;
-
-    return TREE_NO_ERROR;
+    return result;
 }
 
 
-tree_error_type tree_destroy_recursive(node_t* node)
+// Узлы и фразы из арены освобождаются вместе с ней, а не по одному
+static tree_error_type destroy_subtree(const tree_arena_t* arena, node_t* node)
 {
     if (node == NULL)
         return TREE_NO_ERROR; // для рекурсии это норм
 
-    tree_destroy_recursive(node -> yes);
-    tree_destroy_recursive(node -> no);
+    destroy_subtree(arena, node -> yes);
+    destroy_subtree(arena, node -> no);
+
+    if (!is_phrase_in_arena(arena, node -> question))
+        free(node -> question);
 
-    free(node -> question);
-    free(node);
+    if (!is_node_in_arena(arena, node))
+        free(node);
 
     return TREE_NO_ERROR;
 }
 
 
+tree_error_type tree_destroy_recursive(node_t* node)
+{
+    return destroy_subtree(NULL, node);
+}
+
+
 tree_error_type print_tree_node(const node_t* node)
 {
     if (node == NULL)
@@ -83,7 +101,9 @@ tree_error_type print_tree_node(const node_t* node)
         return TREE_NO_ERROR;
     }
 
-    printf("(\"%s\" ", node -> question);
+    fputs("(\"", stdout);
+    tree_write_phrase(stdout, node -> question);
+    fputs("\" ", stdout);
 
     print_tree_node(node -> yes);
     printf(" ");
@@ -139,41 +159,52 @@ tree_error_type tree_split_node(tree_t* tree, node_t* old_node, const char* feat
     assert(old_node   != NULL);
     assert(new_object != NULL);
 
-    char* old_object = strdup(old_node -> question);
-    if (old_object == NULL)
-        return TREE_ERROR_ALLOCATION;
-
-    free(old_node -> question);
-    old_node -> question = strdup(feature);
+    // встроенная база только для чтения: сначала её копия, и дальше меняем копию листа
+    tree_error_type result = tree_embedded_unshare(tree, &old_node);
+    if (result != TREE_NO_ERROR)
+        return result;
 
-    if (old_node -> question == NULL)
-    {
-        free(old_object);
+    // лист меняем, только когда всё выделилось: при ошибке дерево остаётся прежним
+    char* old_object = old_node -> question;
+    char* new_question = strdup(feature);
+    if (new_question == NULL)
         return TREE_ERROR_ALLOCATION;
-    }
 
-    tree_error_type result_yes = tree_create_node(&(old_node -> yes), new_object);
+    node_t* yes = NULL;
+    node_t* no  = NULL;
+
+    tree_error_type result_yes = tree_create_node(&yes, new_object);
     if (result_yes != TREE_NO_ERROR)
     {
-        free(old_object);
+        free(new_question);
         return result_yes;
     }
 
-    tree_error_type result_no = tree_create_node(&(old_node -> no), old_object);
-    free(old_object);
-
+    tree_error_type result_no = tree_create_node(&no, old_object);
     if (result_no != TREE_NO_ERROR)
     {
-        tree_destroy_recursive(old_node -> yes);
-        old_node -> yes = NULL;
+        tree_destroy_recursive(yes);
+        free(new_question);
         return result_no;
     }
 
+    tree_snapshot_preserve(tree, old_node);
+
+    old_node -> question = new_question;
+    old_node -> yes = yes;
+    old_node -> no  = no;
+
     tree_set_parent(old_node -> yes, old_node);
     tree_set_parent(old_node -> no,  old_node);
 
     tree -> size += 2;
 
+    // с журналом старая фраза остаётся в нём до отмены или вытеснения
+    if (tree -> history != NULL)
+        tree_history_record_split(tree, old_node, old_object);
+    else if (!is_phrase_in_arena(tree -> arena, old_object) && !tree_snapshot_retire_phrase(tree, old_object))
+        free(old_object);
+
     return TREE_NO_ERROR;
 }
 
@@ -183,8 +214,12 @@ tree_error_type tree_constructor(tree_t* tree)
     if (tree == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    tree -> root = NULL;
-    tree -> size = 0;
+    tree -> root  = NULL;
+    tree -> size  = 0;
+    tree -> arena = NULL;
+    tree -> pool  = NULL;
+    tree -> history = NULL;
+    tree -> snapshot = NULL;
 
     tree_error_type result = tree_create_node(&(tree -> root), "nothing");
     if (result == TREE_NO_ERROR)
@@ -201,10 +236,14 @@ tree_error_type tree_destructor(tree_t* tree)
     if (tree == NULL)
         return TREE_ERROR_NULL_PTR;
 
-    tree_destroy_recursive(tree -> root);
+    tree_snapshot_wait(tree, NULL); // фоновое сохранение ещё читает узлы
+    tree_history_destroy(tree); // фразы журнала могут лежать в арене
+    destroy_subtree(tree -> arena, tree -> root);
+    tree_arena_destroy(tree -> arena);
 
-    tree -> root = NULL;
-    tree -> size = 0;
+    tree -> root  = NULL;
+    tree -> size  = 0;
+    tree -> arena = NULL;
 
     return TREE_NO_ERROR;
 }
@@ -221,8 +260,17 @@ tree_error_type tree_common_dump(tree_t* tree)
     speak_print_with_variable_number_of_parameters("TREE DUMP");
     speak_print_with_variable_number_of_parameters("Tree size = %zu", tree -> size);
 
-    tree_error_type verify_result = tree_verify(tree);
+    tree_verify_report_t report = {};
+    tree_error_type verify_result = tree_verify_deep(tree, 0, &report);
     speak_print_with_variable_number_of_parameters("Tree verification: %s", tree_error_translator(verify_result));
+    if (verify_result != TREE_NO_ERROR)
+        tree_verify_report_print(&report, stdout);
+    tree_verify_report_destroy(&report);
+
+    tree_memory_report_t memory = {};
+    if (tree_memory_report_build(tree, &memory) == TREE_NO_ERROR)
+        tree_memory_report_print(&memory, stdout);
+    tree_memory_report_destroy(&memory);
 
     speak_print_with_variable_number_of_parameters("Tree structure:");
     if (tree -> root == NULL)
@@ -259,29 +307,12 @@ int contains_negative_words(const char* str)
     if (str == NULL)
         return OPERATION_FAILED;
 
-    const char* forbidden_phrases[] = {"do not", "is not", "does not", "did not",
-        "don't", "isn't", "doesn't", "didn't"};
-
-    size_t number_of_phrases = sizeof(forbidden_phrases) / sizeof(forbidden_phrases[0]);
-
-    char* lower_input = string_to_lower_copy(str);
-
-    if (lower_input == NULL)
+    // автомат строится один раз, дальше каждая строка проверяется за один проход
+    if (negative_phrase_filter.transitions == NULL &&
+        initialize_negative_phrase_filter(NULL) != TREE_NO_ERROR)
         return OPERATION_FAILED;
 
-    int found_phrases = 0;
-
-    for (size_t i = 0; i < number_of_phrases; i++)
-    {
-        if (strstr(lower_input, forbidden_phrases[i]) != NULL)
-        {
-            found_phrases = 1;
-            break;
-        }
-    }
-
-    free(lower_input);
-    return found_phrases;
+    return phrase_filter_matches(&negative_phrase_filter, str) ? 1 : 0;
 }
 
 
@@ -325,6 +356,8 @@ node_t* ask_questions_until_leaf(node_t* current, char* answer, size_t answer_si
 
     while (current -> yes != NULL && current -> no != NULL)
     {
+        uint64_t asked = metrics_now_ns();
+
         animate_question(current -> question);
 
         speak_print_with_variable_number_of_parameters("%s? (yes/no): ", current -> question);
@@ -332,6 +365,9 @@ node_t* ask_questions_until_leaf(node_t* current, char* answer, size_t answer_si
 
         validate_yes_no_input(answer, answer_size);
 
+        metrics_observe(METRIC_QUESTION_SECONDS, metrics_now_ns() - asked);
+        metrics_counter_add(METRIC_QUESTIONS_ASKED, 1);
+
         if (strcmp(answer, "yes") == 0)
             current = current -> yes;
         else
@@ -357,7 +393,11 @@ tree_error_type learn_new_object(tree_t* tree, node_t* current_node)
     speak_print_with_variable_number_of_parameters("How is %s different? It...", new_object);
 
     get_input_without_negatives("Enter the distinguishing feature: ", feature, sizeof(feature));
-    tree_split_node(tree, current_node, feature, new_object);
+    if (tree_split_node(tree, current_node, feature, new_object) == TREE_NO_ERROR)
+    {
+        metrics_counter_add(METRIC_OBJECTS_LEARNED, 1);
+        metrics_gauge_set(METRIC_TREE_NODES, tree -> size);
+    }
 
     speak_print_with_variable_number_of_parameters("Great! I'll remember that for next time!");
 
@@ -373,7 +413,9 @@ tree_error_type save_tree_to_file_recursive(const node_t* node, FILE* file)
         return TREE_NO_ERROR;
     }
 
-    fprintf(file, "(\"%s\" ", node -> question);
+    fputs("(\"", file);
+    tree_write_phrase(file, node -> question);
+    fputs("\" ", file);
     save_tree_to_file_recursive(node -> yes, file);
     fprintf(file, " ");
     save_tree_to_file_recursive(node -> no, file);
@@ -388,14 +430,21 @@ tree_error_type save_tree_to_file(const tree_t* tree, const char* filename)
     assert(tree     != NULL);
     assert(filename != NULL);
 
+    uint64_t start = metrics_now_ns();
+
     FILE* file = fopen(filename, "w");
     if (file == NULL)
+    {
+        metrics_counter_add(METRIC_TREE_SAVE_ERRORS, 1);
         return TREE_ERROR_OPENING_FILE;
+    }
 
     save_tree_to_file_recursive(tree -> root, file);
 
     fclose(file);
 
+    metrics_observe(METRIC_TREE_SAVE_SECONDS, metrics_now_ns() - start);
+
     return TREE_NO_ERROR;
 }
 
@@ -411,6 +460,9 @@ void print_menu()
     speak_print_with_variable_number_of_parameters("4. Give definition\n");
     speak_print_with_variable_number_of_parameters("5. Compare two objects\n");
     speak_print_with_variable_number_of_parameters("6. Exit\n");
+    speak_print_with_variable_number_of_parameters("7. Choose database\n");
+    speak_print_with_variable_number_of_parameters("8. Undo last learned object\n");
+    speak_print_with_variable_number_of_parameters("9. Redo\n");
     speak_print_with_variable_number_of_parameters("Choose option: ");
 }
 
@@ -422,7 +474,7 @@ void clear_input_buffer()
 }
 
 
-node_t* find_leaf_by_phrase(node_t* node, const char* phrase)
+static node_t* find_leaf_in_subtree(node_t* node, const char* phrase)
 {
     if (node == NULL)
         return NULL;
@@ -448,15 +500,24 @@ node_t* find_leaf_by_phrase(node_t* node, const char* phrase)
             return node;
     }
 
-    node_t* yes_result = find_leaf_by_phrase(node -> yes, phrase);
+    node_t* yes_result = find_leaf_in_subtree(node -> yes, phrase);
     if (yes_result != NULL)
         return yes_result;
 
-    node_t* no_result = find_leaf_by_phrase(node -> no, phrase);
+    node_t* no_result = find_leaf_in_subtree(node -> no, phrase);
     return no_result;
 }
 
 
+// Один спан на весь поиск, а не на каждый рекурсивный вызов
+node_t* find_leaf_by_phrase(node_t* node, const char* phrase)
+{
+    TRACE_SPAN("find_leaf_by_phrase");
+
+    return find_leaf_in_subtree(node, phrase);
+}
+
+
 tree_error_type find_and_validate_object(tree_t* tree, const char* object, node_t** found_node)
 {
     if (tree == NULL || object == NULL)
@@ -587,140 +648,6 @@ void give_object_definition(tree_t* tree)
 }
 
 
-void move_position_until_get_not_space(const char** position)
-{
-    assert(position  != NULL);
-    assert(*position != NULL);
-
-    while (isspace((unsigned char)**position))
-        (*position)++;
-}
-
-
-tree_error_type check_symbol(const char** position, char expected_symbol)
-{
-    assert(position  != NULL);
-    assert(*position != NULL);
-
-    if (**position != expected_symbol)
-        return TREE_ERROR_SYNTAX;
-
-    (*position)++;
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type read_child_node(const char** position, node_t** parent, node_t** child)
-{
-    assert(parent    != NULL);
-    assert(*parent   != NULL);
-    assert(position  != NULL);
-    assert(*position != NULL);
-
-    tree_error_type result = read_node(position, child);
-    if (result != TREE_NO_ERROR)
-    {
-        tree_destroy_recursive(*parent);
-        *parent = NULL;
-        return result;
-    }
-
-    if (*child != NULL)
-        (*child) -> parent = *parent;
-
-    move_position_until_get_not_space(position);
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type read_nil_node(const char** position, node_t** node)
-{
-    move_position_until_get_not_space(position);
-
-    if (strncmp(*position, "nil", 3) == 0)
-    {
-        *position += 3;
-        *node = NULL;
-        return TREE_NO_ERROR;
-    }
-
-    return TREE_ERROR_SYNTAX;
-}
-
-
-tree_error_type create_node_and_read_children(const char** position, node_t** node, const char* phrase)
-{
-    tree_error_type result = tree_create_node(node, phrase);
-    if (result != TREE_NO_ERROR)
-        return result;
-
-    result = read_child_node(position, node, &((*node) -> yes));
-    if (result != TREE_NO_ERROR)
-        return result;
-
-    result = read_child_node(position, node, &((*node) -> no));
-    if (result != TREE_NO_ERROR)
-        return result;
-
-    return check_symbol(position, ')');
-}
-
-
-tree_error_type read_phrase_in_quote(const char** position, char* phrase_buffer)
-{
-    assert(position      != NULL);
-    assert(*position     != NULL);
-    assert(phrase_buffer != NULL);
-
-    tree_error_type result = check_symbol(position, '"');
-    if (result != TREE_NO_ERROR)
-        return result;
-
-    int chars_read = 0;
-
-    if (sscanf(*position, "%[^\"]%n", phrase_buffer, &chars_read) != 1)
-        return TREE_ERROR_SYNTAX;
-
-    (*position) += chars_read;
-
-    check_symbol(position, '"');
-
-    move_position_until_get_not_space(position);
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type read_node(const char** position, node_t** node)
-{
-    assert(position  != NULL);
-    assert(*position != NULL);
-
-    if (node == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    move_position_until_get_not_space(position);
-
-    if (**position == '(')
-    {
-        (*position)++;
-
-        move_position_until_get_not_space(position);
-
-        char phrase[MAX_LENGTH_OF_ANSWER] = {};
-
-        tree_error_type result = read_phrase_in_quote(position, phrase);
-        if (result != TREE_NO_ERROR)
-            return result;
-
-        return create_node_and_read_children(position, node, phrase);
-    }
-
-    return read_nil_node(position, node);
-}
-
-
 size_t get_file_size(FILE *file)
 {
     assert(file != NULL);
@@ -744,11 +671,14 @@ size_t get_file_size(FILE *file)
 }
 
 
-tree_error_type read_file_to_buffer(const char* filename, char** buffer)
+// size можно не передавать: буфер всё равно заканчивается нулём
+tree_error_type read_file_to_buffer(const char* filename, char** buffer, size_t* size)
 {
     assert(buffer    != NULL);
     assert(filename  != NULL);
 
+    TRACE_SPAN("read database file");
+
     FILE* file = fopen(filename, "r");
     if (file == NULL)
         return TREE_ERROR_OPENING_FILE;
@@ -776,23 +706,8 @@ tree_error_type read_file_to_buffer(const char* filename, char** buffer)
     fclose(file);
 
     *buffer = local_buffer;
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type validate_no_extra_chars(const char* position, node_t* tree_root)
-{
-    assert(position  != NULL);
-    assert(tree_root != NULL);
-
-    move_position_until_get_not_space(&position);
-    if (*position != '\0')
-    {
-        tree_destroy_recursive(tree_root);
-        speak_print_with_variable_number_of_parameters("Syntax error: extra characters after tree: '%s'\n", position);
-        return TREE_ERROR_SYNTAX;
-    }
+    if (size != NULL)
+        *size = bytes_read;
 
     return TREE_NO_ERROR;
 }
@@ -814,29 +729,41 @@ tree_error_type load_tree_from_file(tree_t* tree, const char* filename)
     assert(tree     != NULL);
     assert(filename != NULL);
 
+    uint64_t start = metrics_now_ns();
     char* buffer = NULL;
+    size_t size = 0;
 
-    tree_error_type result = read_file_to_buffer(filename, &buffer);
+    tree_error_type result = read_file_to_buffer(filename, &buffer, &size);
     if (result != TREE_NO_ERROR)
+    {
+        metrics_counter_add(METRIC_TREE_LOAD_ERRORS, 1);
         return result;
+    }
 
-    const char* position = buffer;
     node_t* new_root = NULL;
+    tree_parse_error_t error = {};
 
-    result = read_node(&position, &new_root);
-
-    if (result == TREE_NO_ERROR)
-        result = validate_no_extra_chars(position, new_root);
+    {
+        TRACE_SPAN("parse tree");
+        result = tree_parse(buffer, size, &new_root, NULL, &error);
+    }
 
     free(buffer);
 
     if (result != TREE_NO_ERROR)
     {
+        metrics_counter_add(METRIC_TREE_LOAD_ERRORS, 1);
+        if (result == TREE_ERROR_SYNTAX)
+            tree_parse_error_print(&error, filename, stdout);
         speak_print_with_variable_number_of_parameters("Error loading tree from file: %s\n", tree_error_translator(result));
         return result;
     }
 
     replace_tree(tree, new_root);
+
+    metrics_observe(METRIC_TREE_LOAD_SECONDS, metrics_now_ns() - start);
+    metrics_gauge_set(METRIC_TREE_NODES, tree -> size);
+
     return TREE_NO_ERROR;
 }
 
@@ -957,9 +884,16 @@ tree_error_type akinator_play(tree_t* tree)
 
     speak_print_with_variable_number_of_parameters("Let's play! I'll try to guess your object.");
     printf("\n");
+    metrics_counter_add(METRIC_GAMES_PLAYED, 1);
+
     // проходим по дереву вопросов
     current = ask_questions_until_leaf(current, answer, sizeof(answer));
 
+    uint64_t number_of_questions = 0;
+    for (const node_t* node = current; node -> parent != NULL; node = node -> parent)
+        number_of_questions++;
+    metrics_observe(METRIC_QUESTIONS_PER_GAME, number_of_questions);
+
     speak_print_with_variable_number_of_parameters("Is it %s?\n", current -> question);
 
     get_input_without_negatives("", answer, sizeof(answer));
@@ -968,6 +902,7 @@ tree_error_type akinator_play(tree_t* tree)
 
     if (strcmp(answer, "yes") == 0)
     {
+        metrics_counter_add(METRIC_GAMES_WON, 1);
         speak_print_with_variable_number_of_parameters("AI wins!");
         speak_print_with_variable_number_of_parameters("Hooray! I won!");
         return TREE_NO_ERROR;
@@ -980,343 +915,3 @@ tree_error_type akinator_play(tree_t* tree)
 
     return TREE_NO_ERROR;
 }
-
-// ============================GRAPHIC_DUMP===========================================
-
-void write_dump_header(FILE* htm_file, time_t now)
-{
-    assert(htm_file != NULL);
-
-    fprintf(htm_file, "<div style='border:2px solid #ccc; margin:10px; padding:15px; background:#f9f9f9;'>\n");
-    fprintf(htm_file, "<h2 style='color:#333;'>Tree Dump at %s</h2>\n", ctime(&now));
-}
-
-
-void write_information_about_tree(FILE* htm_file, tree_t* tree)
-{
-    assert(tree     != NULL);
-    assert(htm_file != NULL);
-
-    fprintf(htm_file, "<div style='margin-bottom:15px;'>\n");
-    fprintf(htm_file, "<p><b>Tree size:</b> %zu</p>\n", tree -> size);
-    fprintf(htm_file, "<p><b>Root address:</b> %p</p>\n", (void*)tree -> root);
-    fprintf(htm_file, "</div>\n");
-}
-
-
-tree_error_type write_tree_nodes_table_recursive(node_t* node, FILE* htm_file)
-{
-    assert(htm_file != NULL);
-    if (node == NULL)
-        return TREE_NO_ERROR;
-
-    fprintf(htm_file, "<tr><td>%p</td><td>%s</td><td>%p</td><td>%p</td><td>%p</td></tr>\n",
-                      (void*)node, node -> question, (void*)node -> yes, (void*)node -> no, (void*)node -> parent);
-
-    tree_error_type result = TREE_NO_ERROR;
-
-    result = write_tree_nodes_table_recursive(node -> yes,  htm_file);
-    if (result != TREE_NO_ERROR) return result;
-
-    result = write_tree_nodes_table_recursive(node -> no,  htm_file);
-    if (result != TREE_NO_ERROR) return result;
-
-    return TREE_NO_ERROR;
-}
-
-
-void write_tree_nodes_table(FILE* htm_file, tree_t* tree)
-{
-    assert(tree     != NULL);
-    assert(htm_file != NULL);
-
-    fprintf(htm_file, "<table border='1' style='border-collapse:collapse; width:100%%; margin-top:15px;'>\n");
-    fprintf(htm_file, "<tr><th>Address</th><th>Question</th><th>Yes</th><th>No</th><th>Parent</th></tr>\n");
-
-    if (tree -> root != NULL)
-        write_tree_nodes_table_recursive(tree -> root, htm_file);
-
-    fprintf(htm_file, "</table>\n");
-}
-
-
-int is_root_node(tree_t* tree, node_t* node)
-{
-    return (tree -> root == node) ? 1 : 0;
-}
-
-
-void format_node_part(char* part_buffer, size_t buffer_size, const char* label, node_t* child_node)
-{
-    assert(label       != NULL);
-    assert(part_buffer != NULL);
-
-    if (child_node == NULL)
-        snprintf(part_buffer, buffer_size, "O");
-    else
-        snprintf(part_buffer, buffer_size, "%s: %p", label, (void*)child_node);
-}
-
-
-// tree_error_type create_dot_edge(FILE* dot_file, node_t* parent_node, node_t* child_node,
-//                                const char* port, const char* colour, const char* label,
-//                                double distance, tree_t* tree, int level)
-// {
-//     if (child_node == NULL)
-//         return TREE_NO_ERROR;
-//
-//     fprintf(dot_file, "    node_%p:%s -> node_%p [color=%s, minlen=%.1f, label=\"%s\"];\n",
-//                       (void*)parent_node, port, (void*)child_node, colour, distance, label);
-//
-//     return TREE_NO_ERROR;
-// }
-
-
-tree_error_type create_dot_tree_recursive(tree_t* tree, node_t* node, FILE* dot_file, int level)
-{
-    if (node == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    const char* fill_color = is_root_node(tree, node) ? "lightblue" : "white";
-    const char* shape = "Mrecord";
-
-    char yes_part[MAX_LENGTH_OF_ADDRESS] = {};
-    char no_part[MAX_LENGTH_OF_ADDRESS]  = {};
-
-    format_node_part(yes_part, sizeof(yes_part), "YES", node -> yes);
-    format_node_part(no_part, sizeof(no_part), "NO", node -> no);
-
-    fprintf(dot_file, "    node_%p [label=\"{%s | {<f0> %s | <f1> %s}}\", shape=%s, style=filled, fillcolor=%s, color=black];\n",
-                      (void*)node, node -> question, yes_part, no_part, shape, fill_color);
-
-    double distance = BASE_EDGE_LENGTH + (level * DEPTH_SPREAD_FACTOR); // distance - min расстояние между узлом и листом
-
-    if (node -> yes != NULL)
-    {
-        fprintf(dot_file, "    node_%p:<f0> -> node_%p [colour=green, minlen=%.1f, label=\"YES\"];\n",
-                          (void*)node, (void*)node -> yes, distance);
-        create_dot_tree_recursive(tree, node -> yes, dot_file, level + 1);
-    }
-
-    if (node -> no != NULL)
-    {
-        fprintf(dot_file, "    node_%p:<f1> -> node_%p [color=red, minlen=%.1f, label=\"NO\"];\n",
-                          (void*)node, (void*)node -> no, distance);
-        create_dot_tree_recursive(tree, node -> no, dot_file, level + 1);
-    }
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type create_tree_dot_header(FILE* dot_file)
-{
-    if (dot_file == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    fprintf(dot_file, "digraph AkinatorTree {\n");
-    fprintf(dot_file, "    rankdir=TB;\n");
-    fprintf(dot_file, "    node [shape=Mrecord, color=black];\n\n");
-    fprintf(dot_file, "    graph [nodesep=0.5, ranksep=1.0];\n");
-    fprintf(dot_file, "    edge [arrowsize=0.8];\n\n");
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type create_dot_file_tree(tree_t* tree, const char* filename)
-{
-    assert(filename != NULL);
-    if (tree == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    FILE* dot_file = fopen(filename, "w");
-    if (dot_file == NULL)
-        return TREE_ERROR_OPENING_FILE;
-
-    tree_error_type header_result = create_tree_dot_header(dot_file);
-    if (header_result != TREE_NO_ERROR)
-    {
-        fclose(dot_file);
-        return header_result;
-    }
-
-    if (tree -> root == NULL)
-        fprintf(dot_file, "    empty [label=\"Empty tree\"];\n");
-    else
-        create_dot_tree_recursive(tree, tree->root, dot_file, ZERO_RANK);
-
-    fprintf(dot_file, "}\n");
-    fclose(dot_file);
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type execute_graphviz_command(const char* input_file, const char* output_file)
-{
-    assert(input_file  != NULL);
-    assert(output_file != NULL);
-
-    char command[MAX_LENGTH_OF_SYSTEM_COMMAND] = {};
-    snprintf(command, sizeof(command), "dot -Tsvg \"%s\" -o \"%s\"", input_file, output_file);
-
-    int result = system(command);
-    if (result != 0)
-        return TREE_ERROR_OPENING_FILE;
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type create_graph_visualization_tree(tree_t* tree, FILE* htm_file, const char* folder_name, time_t now)
-{
-    assert(tree        != NULL);
-    assert(htm_file    != NULL);
-    assert(folder_name != NULL);
-
-    static int number_of_pictures = 0;
-
-    char temp_dot[MAX_LENGTH_OF_FILENAME] = {};
-    char temp_svg[MAX_LENGTH_OF_FILENAME] = {};
-
-    snprintf(temp_dot, sizeof(temp_dot), "%s/tree_temp_%d%lld.dot", folder_name, number_of_pictures, (long long)now);
-    snprintf(temp_svg, sizeof(temp_svg), "%s/tree_temp_%d%lld.svg", folder_name, number_of_pictures, (long long)now);
-    number_of_pictures++;
-
-    tree_error_type dot_result = create_dot_file_tree(tree, temp_dot);
-    if (dot_result != TREE_NO_ERROR)
-        return dot_result;
-
-    execute_graphviz_command(temp_dot, temp_svg);
-
-    fprintf(htm_file, "<div style='text-align:center;'>\n");
-    fprintf(htm_file, "<img src='%s' style='max-width:100%%; border:1px solid #ddd;'>\n", temp_svg);
-    fprintf(htm_file, "</div>\n");
-
-    remove(temp_dot);
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type tree_dump_to_htm(tree_t* tree, FILE* htm_file, const char* folder_name)
-{
-    assert(tree != NULL);
-    assert(htm_file != NULL);
-
-    time_t now = time(NULL); // получаем текущее время
-
-    write_dump_header(htm_file, now);
-    write_information_about_tree(htm_file, tree);
-    create_graph_visualization_tree(tree, htm_file, folder_name, now);
-    write_tree_nodes_table(htm_file, tree);
-
-    fprintf(htm_file, "</div>\n\n");
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type make_folder_name(const char* base_name, char* folder_name, size_t folder_name_size)
-{
-    assert(base_name   != NULL);
-    assert(folder_name != NULL);
-
-    ssize_t written = snprintf(folder_name, folder_name_size, "%s_dump", base_name);
-    if (written < 0 || (size_t)written >= folder_name_size)
-        return TREE_ERROR_SIZE_MISMATCH;
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type make_directory(const char* folder_name)
-{
-    if (folder_name == NULL)
-        return TREE_ERROR_NULL_PTR;
-
-    char command[MAX_LENGTH_OF_SYSTEM_COMMAND] = {};
-    snprintf(command, sizeof(command), "mkdir \"%s\" 2>nul", folder_name); // для винды
-    // snprintf(command, sizeof(command), "mkdir -p \"%s\"", folder_name); // для wsl
-
-    int result = system(command);
-    if (result != 0)
-        return TREE_ERROR_OPENING_FILE;
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type tree_dump(tree_t* tree, const char* filename)
-{
-    assert(tree     != NULL);
-    assert(filename != NULL);
-
-    char folder_name[MAX_LENGTH_OF_FILENAME] = {};
-
-    make_folder_name(filename, folder_name, sizeof(folder_name));
-    make_directory(folder_name);
-
-    char htm_filename[MAX_LENGTH_OF_FILENAME] = {};
-    snprintf(htm_filename, sizeof(htm_filename), "%s.htm", filename);
-
-    FILE* htm_file = fopen(htm_filename, "a");
-    if (htm_file == NULL)
-        return TREE_ERROR_OPENING_FILE;
-
-    tree_error_type result = tree_dump_to_htm(tree, htm_file, folder_name);
-
-    fclose(htm_file);
-
-    return result;
-}
-
-
-tree_error_type initialization_of_tree_log(const char* filename)
-{
-    assert(filename != NULL);
-
-    char htm_filename[MAX_LENGTH_OF_FILENAME] = {};
-    snprintf(htm_filename, sizeof(htm_filename), "%s.htm", filename);
-
-    FILE* htm_file = fopen(htm_filename, "w");
-    if (htm_file == NULL)
-        return TREE_ERROR_OPENING_FILE;
-
-    fprintf(htm_file, "<!DOCTYPE html>\n"
-                      "<html>\n"
-                      "<head>\n"
-                      "<title>Tree Dump Log</title>\n"
-                      "<style>\n"
-                      "body { font-family: Arial, sans-serif; margin: 20px; }\n"
-                      "table { border-collapse: collapse; width: 100%%; }\n"
-                      "th, td { border: 1px solid #ddd; padding: 8px; text-align: left; }\n"
-                      "th { background-color: #f2f2f2; }\n"
-                      "</style>\n"
-                      "</head>\n"
-                      "<body>\n"
-                      "<h1>Tree Dump Log</h1>\n");
-    fclose(htm_file);
-
-    return TREE_NO_ERROR;
-}
-
-
-tree_error_type close_tree_log(const char* filename)
-{
-    assert(filename != NULL);
-
-    char htm_filename[MAX_LENGTH_OF_FILENAME] = {};
-    snprintf(htm_filename, sizeof(htm_filename), "%s.htm", filename);
-
-    FILE* htm_file = fopen(htm_filename, "a");
-    if (htm_file == NULL)
-        return TREE_ERROR_OPENING_FILE;
-
-    fprintf(htm_file, "</body>\n");
-    fprintf(htm_file, "</html>\n");
-    fclose(htm_file);
-
-    return TREE_NO_ERROR;
-}
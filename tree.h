@@ -27,10 +27,19 @@ struct node_t
     node_t* parent;
 };
 
+struct tree_arena_t;
+struct string_pool_t;
+struct tree_history_t;
+struct tree_snapshot_t;
+
 struct tree_t
 {
     node_t* root;
     size_t size;
+    tree_arena_t* arena; // сплошное хранилище после tree_compact, NULL - все узлы в куче
+    string_pool_t* pool; // общий пул фраз нескольких деревьев, NULL - фразы арены свои
+    tree_history_t* history; // журнал разделений для отмены, NULL - не ведётся
+    tree_snapshot_t* snapshot; // снимок, который сохраняется в фоне, NULL - сохранения нет
 };
 
 struct path_step
@@ -63,21 +72,12 @@ void print_comparison_results(const char* object1, const char* object2,
                               int common_steps);
 int find_common_steps(path_step* path1, int steps1, path_step* path2, int steps2);
 void compare_two_objects(tree_t* tree);
-void format_node_part(char* part_buffer, size_t buffer_size, const char* label, node_t* child_node);
 
 // Функции сохранения и вывода
 tree_error_type save_tree_to_file_recursive(const node_t* node, FILE* file);
 tree_error_type save_tree_to_file(const tree_t* tree, const char* filename);
 tree_error_type print_tree_node(const node_t* node);
-void move_position_until_get_not_space(const char** position);
-tree_error_type check_symbol(const char** position, char expected_symbol);
-tree_error_type read_child_node(const char** position, node_t** parent, node_t** child);
-tree_error_type read_nil_node(const char** position, node_t** node);
-tree_error_type create_node_and_read_children(const char** position, node_t** node, const char* phrase);
-tree_error_type read_phrase_in_quote(const char** position, char* phrase_buffer);
-tree_error_type read_node(const char** position, node_t** node);
-tree_error_type read_file_to_buffer(const char* filename, char** buffer);
-tree_error_type validate_no_extra_chars(const char* position, node_t* tree_root);
+tree_error_type read_file_to_buffer(const char* filename, char** buffer, size_t* size);
 void replace_tree(tree_t* tree, node_t* new_root);
 tree_error_type load_tree_from_file(tree_t* tree, const char* filename);
 
@@ -105,19 +105,4 @@ tree_error_type tree_destroy_recursive(node_t* node);
 size_t count_nodes_recursive(node_t* node);
 size_t get_file_size(FILE *file);
 
-// Функции для дампа
-void write_dump_header(FILE* htm_file, time_t now);
-void write_information_about_tree(FILE* htm_file, tree_t* tree);
-tree_error_type execute_graphviz_command(const char* input_file, const char* output_file);
-tree_error_type make_folder_name(const char* base_name, char* folder_name, size_t folder_name_size);
-tree_error_type make_directory(const char* folder_name);
-tree_error_type write_tree_nodes_table_recursive(node_t* node, FILE* htm_file);
-void write_tree_nodes_table(FILE* htm_file, tree_t* tree);
-int is_root_node(tree_t* tree, node_t* node);
-tree_error_type create_dot_tree_recursive(tree_t* tree, node_t* node, FILE* dot_file, int level);
-tree_error_type create_tree_dot_header(FILE* dot_file);
-tree_error_type create_dot_file_tree(tree_t* tree, const char* filename);
-tree_error_type create_graph_visualization_tree(tree_t* tree, FILE* htm_file, const char* folder_name, time_t now);
-tree_error_type tree_dump_to_htm(tree_t* tree, FILE* htm_file, const char* folder_name);
-
 #endif // TREE_H_
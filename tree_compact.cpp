@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_compact.h"
+#include "string_pool.h"
+#include "tree_history.h"
+#include "tree_snapshot.h"
+#include "tree_error_type.h"
+
+// Временная раскладка: узлы в прямом порядке обхода и связи между ними по индексам
+struct compact_layout_t
+{
+    node_t** order;
+    size_t* yes;
+    size_t* no;
+    size_t* parent;
+    size_t* subtree_size;
+    size_t* new_index;
+    size_t* phrase_length;
+    size_t count;
+    size_t phrases_size;
+};
+
+#define COMPACT_NO_NODE ((size_t)-1)
+
+
+bool is_node_in_arena(const tree_arena_t* arena, const node_t* node)
+{
+    if (arena == NULL || node == NULL)
+        return false;
+
+    uintptr_t address = (uintptr_t)node;
+    uintptr_t begin   = (uintptr_t)arena -> nodes;
+
+    return address >= begin && address < begin + arena -> number_of_nodes * sizeof(node_t);
+}
+
+
+bool is_phrase_in_arena(const tree_arena_t* arena, const char* phrase)
+{
+    if (arena == NULL || phrase == NULL)
+        return false;
+
+    if (arena -> pool != NULL)
+        return string_pool_contains(arena -> pool, phrase);
+
+    uintptr_t address = (uintptr_t)phrase;
+    uintptr_t begin   = (uintptr_t)arena -> phrases;
+
+    return address >= begin && address < begin + arena -> phrases_size;
+}
+
+
+void tree_arena_destroy(tree_arena_t* arena)
+{
+    if (arena == NULL || arena -> is_embedded)
+        return;
+
+    free(arena -> nodes);
+    free(arena -> phrases);
+    free(arena);
+}
+
+
+size_t tree_count_scattered_nodes(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    size_t in_arena = (tree -> arena != NULL) ? tree -> arena -> number_of_nodes - tree -> arena -> number_of_detached : 0;
+
+    return (tree -> size > in_arena) ? tree -> size - in_arena : 0;
+}
+
+
+static void destroy_compact_layout(compact_layout_t* layout)
+{
+    free(layout -> order);
+    free(layout -> yes);
+    free(layout -> no);
+    free(layout -> parent);
+    free(layout -> subtree_size);
+    free(layout -> new_index);
+    free(layout -> phrase_length);
+}
+
+
+// Прямой обход без рекурсии: вершины стека - индексы ещё не разложенных детей.
+// Каждый старый узел и его фразу читаем здесь один раз, дальше работаем только с массивами
+static tree_error_type collect_nodes_in_preorder(const tree_t* tree, compact_layout_t* layout)
+{
+    size_t capacity = tree -> size;
+    if (capacity == 0)
+        return TREE_ERROR_SIZE_MISMATCH;
+
+    layout -> order        = (node_t**)calloc(capacity, sizeof(node_t*));
+    layout -> yes          = (size_t*)calloc(capacity, sizeof(size_t));
+    layout -> no           = (size_t*)calloc(capacity, sizeof(size_t));
+    layout -> parent       = (size_t*)calloc(capacity, sizeof(size_t));
+    layout -> subtree_size = (size_t*)calloc(capacity, sizeof(size_t));
+    layout -> new_index    = (size_t*)calloc(capacity, sizeof(size_t));
+    layout -> phrase_length = (size_t*)calloc(capacity, sizeof(size_t));
+
+    if (layout -> order == NULL || layout -> yes == NULL || layout -> no == NULL || layout -> parent == NULL ||
+        layout -> subtree_size == NULL || layout -> new_index == NULL || layout -> phrase_length == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    // стек храним в new_index: он понадобится только после обхода
+    size_t* stack = layout -> new_index;
+    size_t stack_size = 0;
+
+    layout -> order[0]  = tree -> root;
+    layout -> parent[0] = COMPACT_NO_NODE;
+    layout -> count     = 1;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        size_t index = stack[--stack_size];
+        node_t* node = layout -> order[index];
+
+        layout -> phrase_length[index] = strlen(node -> question) + 1;
+        layout -> phrases_size += layout -> phrase_length[index];
+
+        // no кладём первым, чтобы yes-ветка шла раньше
+        size_t* child_index[2] = {&layout -> no[index], &layout -> yes[index]};
+        node_t* children[2]    = {node -> no, node -> yes};
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            *child_index[i] = COMPACT_NO_NODE;
+            if (children[i] == NULL)
+                continue;
+
+            if (layout -> count == capacity)
+                return TREE_ERROR_SIZE_MISMATCH; // узлов больше, чем size: дерево испорчено
+
+            size_t child = layout -> count++;
+            layout -> order[child]  = children[i];
+            layout -> parent[child] = index;
+            *child_index[i] = child;
+            stack[stack_size++] = child;
+        }
+    }
+
+    return (layout -> count == tree -> size) ? TREE_NO_ERROR : TREE_ERROR_SIZE_MISMATCH;
+}
+
+
+// Родитель всегда раньше детей, поэтому размеры поддеревьев копятся одним проходом с конца
+static void count_subtree_sizes(compact_layout_t* layout)
+{
+    for (size_t i = layout -> count; i > 0; i--)
+    {
+        size_t index = i - 1;
+        layout -> subtree_size[index] += 1;
+
+        if (layout -> parent[index] != COMPACT_NO_NODE)
+            layout -> subtree_size[layout -> parent[index]] += layout -> subtree_size[index];
+    }
+}
+
+
+// Обход в глубину, где больший ребёнок идёт сразу за родителем: при равномерных запросах
+// по нему проходит больше игр, а весь путь к листу чаще оказывается в соседних кэш-линиях
+static tree_error_type place_heavy_child_first(compact_layout_t* layout)
+{
+    size_t* stack = (size_t*)calloc(layout -> count, sizeof(size_t));
+    if (stack == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    size_t stack_size = 0;
+    size_t next_position = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        size_t index = stack[--stack_size];
+        layout -> new_index[index] = next_position++;
+
+        size_t yes = layout -> yes[index];
+        size_t no  = layout -> no[index];
+
+        if (yes == COMPACT_NO_NODE || no == COMPACT_NO_NODE)
+        {
+            if (yes != COMPACT_NO_NODE) stack[stack_size++] = yes;
+            if (no  != COMPACT_NO_NODE) stack[stack_size++] = no;
+            continue;
+        }
+
+        bool yes_is_heavier = layout -> subtree_size[yes] >= layout -> subtree_size[no];
+        stack[stack_size++] = yes_is_heavier ? no  : yes;
+        stack[stack_size++] = yes_is_heavier ? yes : no;
+    }
+
+    free(stack);
+    return TREE_NO_ERROR;
+}
+
+
+// Фразы кладём в том же порядке, что и узлы: смещения - префиксные суммы длин в новом порядке.
+// Размеры поддеревьев после раскладки не нужны, их массив идёт под смещения
+static void copy_arena_phrases(compact_layout_t* layout, tree_arena_t* arena)
+{
+    size_t* phrase_offset = layout -> subtree_size;
+    for (size_t i = 0; i < layout -> count; i++)
+        phrase_offset[layout -> new_index[i]] = layout -> phrase_length[i];
+
+    size_t offset = 0;
+    for (size_t position = 0; position < layout -> count; position++)
+    {
+        size_t length = phrase_offset[position];
+        phrase_offset[position] = offset;
+        offset += length;
+    }
+
+    for (size_t i = 0; i < layout -> count; i++)
+    {
+        node_t* copy = &arena -> nodes[layout -> new_index[i]];
+
+        copy -> question = arena -> phrases + phrase_offset[layout -> new_index[i]];
+        memcpy(copy -> question, layout -> order[i] -> question, layout -> phrase_length[i]);
+    }
+}
+
+
+// Фразы дерева с общим пулом не копируются в арену, а берутся из пула: одинаковые фразы
+// разных деревьев (и одного дерева) после этого лежат в памяти один раз
+static tree_error_type intern_arena_phrases(compact_layout_t* layout, string_pool_t* pool, tree_arena_t* arena)
+{
+    for (size_t i = 0; i < layout -> count; i++)
+    {
+        node_t* copy = &arena -> nodes[layout -> new_index[i]];
+
+        tree_error_type result = string_pool_intern(pool, layout -> order[i] -> question, &copy -> question);
+        if (result != TREE_NO_ERROR)
+            return result;
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type build_arena(compact_layout_t* layout, string_pool_t* pool, tree_arena_t** arena)
+{
+    tree_arena_t* new_arena = (tree_arena_t*)calloc(1, sizeof(tree_arena_t));
+    if (new_arena == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    new_arena -> pool = pool;
+    new_arena -> phrases_size = (pool != NULL) ? 0 : layout -> phrases_size;
+
+    new_arena -> nodes   = (node_t*)calloc(layout -> count, sizeof(node_t));
+    new_arena -> phrases = (pool != NULL) ? NULL : (char*)calloc(new_arena -> phrases_size, sizeof(char));
+    if (new_arena -> nodes == NULL || (pool == NULL && new_arena -> phrases == NULL))
+    {
+        tree_arena_destroy(new_arena);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    new_arena -> number_of_nodes = layout -> count;
+
+    if (pool != NULL)
+    {
+        tree_error_type result = intern_arena_phrases(layout, pool, new_arena);
+        if (result != TREE_NO_ERROR)
+        {
+            tree_arena_destroy(new_arena);
+            return result;
+        }
+    }
+    else
+    {
+        copy_arena_phrases(layout, new_arena);
+    }
+
+    for (size_t i = 0; i < layout -> count; i++)
+    {
+        node_t* copy = &new_arena -> nodes[layout -> new_index[i]];
+
+        copy -> yes    = (layout -> yes[i]    == COMPACT_NO_NODE) ? NULL : &new_arena -> nodes[layout -> new_index[layout -> yes[i]]];
+        copy -> no     = (layout -> no[i]     == COMPACT_NO_NODE) ? NULL : &new_arena -> nodes[layout -> new_index[layout -> no[i]]];
+        copy -> parent = (layout -> parent[i] == COMPACT_NO_NODE) ? NULL : &new_arena -> nodes[layout -> new_index[layout -> parent[i]]];
+    }
+
+    *arena = new_arena;
+    return TREE_NO_ERROR;
+}
+
+
+static void move_history_node(tree_history_t* history, const node_t* old_node, node_t* new_node)
+{
+    for (size_t i = 0; i < TREE_HISTORY_CAPACITY; i++)
+    {
+        if (history -> records[i].node == old_node)
+            history -> records[i].node = new_node;
+    }
+}
+
+
+// Фраза пропадёт вместе со старой ареной. Пул у обеих арен общий, его фразы остаются
+static tree_error_type copy_phrase_out_of_arena(const tree_arena_t* old_arena, const tree_arena_t* new_arena, char** phrase)
+{
+    if (!is_phrase_in_arena(old_arena, *phrase) || is_phrase_in_arena(new_arena, *phrase))
+        return TREE_NO_ERROR;
+
+    char* copy = strdup(*phrase);
+    if (copy == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    *phrase = copy;
+    return TREE_NO_ERROR;
+}
+
+
+// Лист, отцепленный отменой после прошлого уплотнения, лежит в старой арене: переносим в кучу.
+// У узла в куче и фраза всегда своя, иначе её не освободить вместе с узлом
+static tree_error_type copy_leaf_out_of_arena(tree_history_t* history, const tree_arena_t* old_arena, node_t** leaf)
+{
+    if (!is_node_in_arena(old_arena, *leaf))
+        return TREE_NO_ERROR;
+
+    node_t* copy = (node_t*)calloc(1, sizeof(node_t));
+    if (copy == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    copy -> question = strdup((*leaf) -> question);
+    if (copy -> question == NULL)
+    {
+        free(copy);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    copy -> parent = (*leaf) -> parent;
+
+    move_history_node(history, *leaf, copy); // на отцепленном листе могло быть и более позднее разделение
+    *leaf = copy;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Всё, что журнал держит вне дерева, переживает старую арену. При ошибке журнал остаётся
+// рабочим: копии заменяют то, что ещё лежит в живой старой арене
+static tree_error_type move_history_out_of_arena(tree_history_t* history, const tree_arena_t* old_arena,
+                                                 const tree_arena_t* new_arena)
+{
+    tree_error_type result = TREE_NO_ERROR;
+
+    for (size_t i = 0; i < TREE_HISTORY_CAPACITY && result == TREE_NO_ERROR; i++)
+    {
+        tree_split_record_t* record = &history -> records[i];
+        if (record -> node == NULL)
+            continue;
+
+        result = copy_phrase_out_of_arena(old_arena, new_arena, &record -> other_question);
+
+        if (result == TREE_NO_ERROR && record -> yes != NULL)
+            result = copy_leaf_out_of_arena(history, old_arena, &record -> yes);
+        if (result == TREE_NO_ERROR && record -> no != NULL)
+            result = copy_leaf_out_of_arena(history, old_arena, &record -> no);
+    }
+
+    return result;
+}
+
+
+static int compare_node_addresses(const void* first, const void* second)
+{
+    uintptr_t first_address  = (uintptr_t)*(node_t* const*)first;
+    uintptr_t second_address = (uintptr_t)*(node_t* const*)second;
+
+    if (first_address != second_address)
+        return (first_address < second_address) ? -1 : 1;
+
+    return 0;
+}
+
+
+// Узлы записей, которые остались в дереве, находим в раскладке: записей не больше
+// TREE_HISTORY_CAPACITY, поэтому на узел дерева - двоичный поиск по их отсортированным адресам
+static void move_history_into_arena(tree_history_t* history, const compact_layout_t* layout, tree_arena_t* new_arena)
+{
+    node_t* old_nodes[TREE_HISTORY_CAPACITY] = {};
+    size_t number_of_old_nodes = 0;
+
+    for (size_t i = 0; i < TREE_HISTORY_CAPACITY; i++)
+    {
+        if (history -> records[i].node != NULL)
+            old_nodes[number_of_old_nodes++] = history -> records[i].node;
+    }
+
+    qsort(old_nodes, number_of_old_nodes, sizeof(node_t*), compare_node_addresses);
+
+    for (size_t i = 0; i < layout -> count && number_of_old_nodes > 0; i++)
+    {
+        if (bsearch(&layout -> order[i], old_nodes, number_of_old_nodes, sizeof(node_t*), compare_node_addresses) != NULL)
+            move_history_node(history, layout -> order[i], &new_arena -> nodes[layout -> new_index[i]]);
+    }
+
+    // отцепленные отменой листья при возврате снова повиснут на узле своей записи
+    for (size_t i = 0; i < TREE_HISTORY_CAPACITY; i++)
+    {
+        tree_split_record_t* record = &history -> records[i];
+
+        if (record -> yes != NULL)
+            record -> yes -> parent = record -> node;
+        if (record -> no != NULL)
+            record -> no -> parent = record -> node;
+    }
+}
+
+// Все указатели на старые узлы после этого недействительны, поэтому вызывать только
+// там, где никто не держит node_t* между вызовами: после загрузки и в главном меню
+tree_error_type tree_compact(tree_t* tree)
+{
+    if (tree == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (tree -> root == NULL)
+        return TREE_NO_ERROR;
+
+    tree_snapshot_wait(tree, NULL); // узлы переедут, а сохранение их ещё читает
+
+    compact_layout_t layout = {};
+
+    tree_error_type result = collect_nodes_in_preorder(tree, &layout);
+    if (result == TREE_NO_ERROR)
+    {
+        count_subtree_sizes(&layout);
+        result = place_heavy_child_first(&layout);
+    }
+
+    tree_arena_t* new_arena = NULL;
+    if (result == TREE_NO_ERROR)
+        result = build_arena(&layout, tree -> pool, &new_arena);
+
+    if (result == TREE_NO_ERROR && tree -> history != NULL)
+        result = move_history_out_of_arena(tree -> history, tree -> arena, new_arena);
+
+    if (result != TREE_NO_ERROR)
+    {
+        tree_arena_destroy(new_arena);
+        destroy_compact_layout(&layout);
+        return result;
+    }
+
+    // узлы переезжают, журнал переходит на новые адреса и отмена после уплотнения работает
+    if (tree -> history != NULL)
+        move_history_into_arena(tree -> history, &layout, new_arena);
+
+    tree_arena_t* old_arena = tree -> arena;
+    for (size_t i = 0; i < layout.count; i++)
+    {
+        node_t* node = layout.order[i];
+
+        if (!is_phrase_in_arena(old_arena, node -> question))
+            free(node -> question);
+
+        if (!is_node_in_arena(old_arena, node))
+            free(node);
+    }
+
+    tree_arena_destroy(old_arena);
+
+    tree -> arena = new_arena;
+    tree -> root  = &new_arena -> nodes[0];
+
+    destroy_compact_layout(&layout);
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type tree_compact_if_needed(tree_t* tree)
+{
+    if (tree == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    if (tree_snapshot_is_running(tree))
+        return TREE_NO_ERROR; // не ждём сохранения, уплотним в следующий раз
+
+    size_t scattered = tree_count_scattered_nodes(tree);
+
+    if (scattered < COMPACT_MIN_SCATTERED_NODES || scattered * COMPACT_SCATTERED_FRACTION < tree -> size)
+        return TREE_NO_ERROR;
+
+    return tree_compact(tree);
+}
@@ -0,0 +1,38 @@
+#ifndef TREE_COMPACT_H_
+#define TREE_COMPACT_H_
+
+#include <stddef.h>
+
+#include "tree.h"
+#include "string_pool.h"
+#include "tree_error_type.h"
+
+// Пороги по make compact-bench (1M узлов, уплотнение ~300 нс на узел). Уплотнённое дерево
+// проходится на четверть быстрее, а обходится целиком (поиск, проверка) в 3-3.5 раза быстрее.
+// Доученная после уплотнения 1/16 узлов замедляет полный обход на 10-20%, 1/8 - уже в 1.5 раза,
+// 1/4 - в 2-2.5 раза. До ~4K узлов дерево лежит в кэше и уплотнение ничего не даёт
+#define COMPACT_MIN_SCATTERED_NODES 4096
+#define COMPACT_SCATTERED_FRACTION  8 // уплотняем, когда вне арены лежит хотя бы 1/8 узлов
+
+// Узлы и фразы уплотнённого дерева лежат в двух сплошных блоках. Узлы, добавленные
+// после уплотнения, живут в куче как обычно, до следующего уплотнения.
+// У дерева с общим пулом своего блока фраз нет: фразы кладутся в пул
+struct tree_arena_t
+{
+    node_t* nodes;
+    size_t number_of_nodes;
+    char* phrases;
+    size_t phrases_size;
+    const string_pool_t* pool;
+    bool is_embedded; // встроенная база (tree_embedded.h): узлы и фразы в памяти программы, не освобождаются и не меняются
+    size_t number_of_detached; // листья отменённых разделений: лежат в арене, но не в дереве
+};
+
+tree_error_type tree_compact(tree_t* tree);
+tree_error_type tree_compact_if_needed(tree_t* tree);
+size_t tree_count_scattered_nodes(const tree_t* tree);
+bool is_node_in_arena(const tree_arena_t* arena, const node_t* node);
+bool is_phrase_in_arena(const tree_arena_t* arena, const char* phrase);
+void tree_arena_destroy(tree_arena_t* arena);
+
+#endif // TREE_COMPACT_H_
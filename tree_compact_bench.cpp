@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "tree.h"
+#include "tree_compact.h"
+#include "tree_error_type.h"
+
+// Что даёт tree_compact и когда его запускать:
+//     ./tree_compact_bench [--nodes N] [--walks N] [--repeat N]
+// Дерево растёт так же, как в игре, - разделением случайных листов, поэтому узлы одного пути
+// лежат в куче вперемешку с фразами и друг с другом. Меряются проход от корня до листа
+// (одна партия), поиск объекта по фразе и tree_verify до и после уплотнения, потом
+// сколько теряет проход, когда после уплотнения доучена ещё доля узлов, и сколько
+// стоит само уплотнение. По этим цифрам выбраны COMPACT_MIN_SCATTERED_NODES и
+// COMPACT_SCATTERED_FRACTION
+
+#define BENCH_DEFAULT_NODES 1000000
+#define BENCH_DEFAULT_WALKS 2000000
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_FIND_QUERIES 20
+
+struct bench_times_t
+{
+    double walk_ns;   // на один проход от корня до листа
+    double find_ms;   // на один поиск объекта
+    double verify_ms;
+};
+
+// ============================TREE=============================================
+
+static size_t next_random(size_t* state)
+{
+    *state = *state * 6364136223846793005u + 1442695040888963407u;
+    return *state >> 33;
+}
+
+
+static node_t* random_leaf(const tree_t* tree, size_t* state)
+{
+    node_t* node = tree -> root;
+
+    while (node -> yes != NULL)
+        node = (next_random(state) & 1) ? node -> yes : node -> no;
+
+    return node;
+}
+
+
+// Каждое разделение добавляет два узла, новые фразы различны, чтобы поиск шёл по всему дереву
+static bool grow_tree(tree_t* tree, size_t number_of_nodes, size_t* state)
+{
+    char feature[MAX_LENGTH_OF_ADDRESS] = {};
+    char object[MAX_LENGTH_OF_ADDRESS]  = {};
+
+    while (tree -> size + 2 <= number_of_nodes)
+    {
+        snprintf(feature, sizeof(feature), "feature %zu", tree -> size);
+        snprintf(object,  sizeof(object),  "object %zu",  tree -> size);
+
+        if (tree_split_node(tree, random_leaf(tree, state), feature, object) != TREE_NO_ERROR)
+            return false;
+    }
+
+    return true;
+}
+
+// ============================MEASURE==========================================
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Проход как в партии: читаем вопрос и идём по случайному ответу
+static double measure_walks(const tree_t* tree, size_t walks)
+{
+    size_t state = 42;
+    size_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < walks; i++)
+    {
+        const node_t* node = tree -> root;
+        while (node -> yes != NULL)
+        {
+            checksum += (unsigned char)node -> question[0];
+            node = (next_random(&state) & 1) ? node -> yes : node -> no;
+        }
+        checksum += (unsigned char)node -> question[0];
+    }
+
+    double seconds = seconds_since(start);
+
+    if (checksum == 0)
+        printf("checksum %zu\n", checksum); // чтобы проход не выбросил оптимизатор
+
+    return seconds * 1e9 / (double)walks;
+}
+
+
+static double measure_find(tree_t* tree)
+{
+    char phrase[MAX_LENGTH_OF_ADDRESS] = {};
+    size_t found = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < BENCH_FIND_QUERIES; i++)
+    {
+        // объекты с номерами вразброс по всему дереву, последний не найдётся - полный обход
+        size_t number = (i + 1 < BENCH_FIND_QUERIES) ? tree -> size * i / BENCH_FIND_QUERIES + 1 : tree -> size + 1;
+        snprintf(phrase, sizeof(phrase), "object %zu", number | 1);
+
+        found += (find_leaf_by_phrase(tree -> root, phrase) != NULL);
+    }
+
+    double seconds = seconds_since(start);
+
+    if (found == BENCH_FIND_QUERIES)
+        printf("unexpected: every object found\n");
+
+    return seconds * 1000 / BENCH_FIND_QUERIES;
+}
+
+
+static bool measure(tree_t* tree, size_t walks, size_t repeat, bench_times_t* best)
+{
+    for (size_t i = 0; i < repeat; i++)
+    {
+        bench_times_t times = {};
+        times.walk_ns = measure_walks(tree, walks);
+        times.find_ms = measure_find(tree);
+
+        auto start = std::chrono::steady_clock::now();
+        if (tree_verify(tree) != TREE_NO_ERROR)
+            return false;
+        times.verify_ms = seconds_since(start) * 1000;
+
+        if (i == 0 || times.walk_ns   < best -> walk_ns)   best -> walk_ns   = times.walk_ns;
+        if (i == 0 || times.find_ms   < best -> find_ms)   best -> find_ms   = times.find_ms;
+        if (i == 0 || times.verify_ms < best -> verify_ms) best -> verify_ms = times.verify_ms;
+    }
+
+    return true;
+}
+
+
+static void print_times(const char* name, const tree_t* tree, const bench_times_t* times, const bench_times_t* baseline)
+{
+    printf("%-26s %9zu nodes %6zu scattered | walk %7.1f ns (%5.2fx) | find %8.3f ms (%5.2fx) | verify %8.3f ms (%5.2fx)\n",
+           name, tree -> size, tree_count_scattered_nodes(tree),
+           times -> walk_ns,   times -> walk_ns   / baseline -> walk_ns,
+           times -> find_ms,   times -> find_ms   / baseline -> find_ms,
+           times -> verify_ms, times -> verify_ms / baseline -> verify_ms);
+}
+
+
+static bool measure_compaction(tree_t* tree, double* milliseconds)
+{
+    auto start = std::chrono::steady_clock::now();
+    bool ok = (tree_compact(tree) == TREE_NO_ERROR);
+    *milliseconds = seconds_since(start) * 1000;
+
+    return ok;
+}
+
+// ============================RUN==============================================
+
+int main(int argc, char* argv[])
+{
+    size_t number_of_nodes = BENCH_DEFAULT_NODES;
+    size_t walks  = BENCH_DEFAULT_WALKS;
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--nodes") == 0)
+            number_of_nodes = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--walks") == 0)
+            walks = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = strtoul(argv[i + 1], NULL, 10);
+        else
+        {
+            fprintf(stderr, "Usage: %s [--nodes N] [--walks N] [--repeat N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (repeat == 0)
+        repeat = 1;
+
+    // узлы доучиваются долями базы после уплотнения: 1/64 ... 1/2
+    const size_t fractions[] = {64, 16, 8, 4, 2};
+    const size_t number_of_fractions = sizeof(fractions) / sizeof(fractions[0]);
+
+    size_t state = 1;
+    tree_t tree = {};
+    bool ok = (tree_constructor(&tree) == TREE_NO_ERROR) && grow_tree(&tree, number_of_nodes, &state);
+
+    bench_times_t scattered = {};
+    bench_times_t compacted = {};
+    double compact_ms = 0;
+
+    ok = ok && measure(&tree, walks, repeat, &scattered);
+    if (ok)
+        print_times("learned in a game", &tree, &scattered, &scattered);
+
+    ok = ok && measure_compaction(&tree, &compact_ms);
+    ok = ok && measure(&tree, walks, repeat, &compacted);
+
+    if (ok)
+    {
+        print_times("compacted", &tree, &compacted, &scattered);
+        printf("tree_compact: %.1f ms, %.1f ns per node\n", compact_ms, compact_ms * 1e6 / (double)tree.size);
+    }
+
+    // после уплотнения база доучивается: каждый раз от одного и того же уплотнённого дерева
+    for (size_t i = 0; i < number_of_fractions && ok; i++)
+    {
+        tree_t grown = {};
+        size_t grow_state = 7;
+
+        ok = (tree_constructor(&grown) == TREE_NO_ERROR);
+        state = 1;
+        ok = ok && grow_tree(&grown, number_of_nodes, &state) && tree_compact(&grown) == TREE_NO_ERROR;
+        ok = ok && grow_tree(&grown, number_of_nodes + number_of_nodes / fractions[i], &grow_state);
+
+        bench_times_t times = {};
+        ok = ok && measure(&grown, walks, repeat, &times);
+
+        char name[MAX_LENGTH_OF_ADDRESS] = {};
+        snprintf(name, sizeof(name), "compacted + 1/%zu learned", fractions[i]);
+        if (ok)
+            print_times(name, &grown, &times, &compacted);
+
+        tree_destructor(&grown);
+    }
+
+    // маленькие деревья: с какого размера уплотнение вообще заметно и сколько стоит лишний запуск из меню
+    for (size_t small_size = 65; small_size <= 65537 && ok; small_size = small_size * 4 - 3)
+    {
+        tree_t small = {};
+        state = 3;
+        ok = (tree_constructor(&small) == TREE_NO_ERROR) && grow_tree(&small, small_size, &state);
+
+        bench_times_t small_scattered = {};
+        bench_times_t small_compacted = {};
+        double small_ms = 0;
+
+        ok = ok && measure(&small, walks, repeat, &small_scattered);
+        ok = ok && measure_compaction(&small, &small_ms);
+        ok = ok && measure(&small, walks, repeat, &small_compacted);
+
+        char name[MAX_LENGTH_OF_ADDRESS] = {};
+        snprintf(name, sizeof(name), "small, compact %.3f ms", small_ms);
+        if (ok)
+            print_times(name, &small, &small_compacted, &small_scattered);
+
+        tree_destructor(&small);
+    }
+
+    tree_destructor(&tree);
+
+    if (!ok)
+        fprintf(stderr, "Benchmark failed\n");
+
+    return ok ? 0 : 1;
+}
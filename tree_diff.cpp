@@ -0,0 +1,668 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_diff.h"
+#include "tree_error_type.h"
+
+#define DIFF_HASH_OFFSET     14695981039346656037ULL
+#define DIFF_HASH_PRIME      1099511628211ULL
+#define DIFF_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+#define DIFF_NIL_HASH        0x2545F4914F6CDD1DULL
+#define DIFF_INITIAL_CAPACITY 64
+
+struct diff_leaf_t
+{
+    const char* name;
+    size_t index;
+};
+
+struct diff_index_list_t
+{
+    size_t* indices;
+    size_t count;
+    size_t capacity;
+};
+
+struct diff_context_t
+{
+    tree_diff_side_t old_side;
+    tree_diff_side_t new_side;
+    tree_diff_t* diff;
+
+    diff_index_list_t removed;     // листья старого снимка из изменённых мест
+    diff_index_list_t added;       // листья нового снимка из изменённых мест
+    diff_index_list_t renamed_old; // лист на месте листа: пары кандидатов в переименование
+    diff_index_list_t renamed_new;
+
+    unsigned char* old_matched; // лист уже попал в MOVE или RENAME
+    unsigned char* new_matched;
+};
+
+// ============================SNAPSHOT===========================================
+
+static uint64_t hash_diff_phrase(const char* phrase)
+{
+    uint64_t hash = DIFF_HASH_OFFSET;
+
+    for (const char* symbol = phrase; *symbol != '\0'; symbol++)
+    {
+        hash ^= (unsigned char)*symbol;
+        hash *= DIFF_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+
+static uint64_t mix_diff_hash(uint64_t hash, uint64_t child_hash)
+{
+    hash = ((hash << 5) | (hash >> 59)) ^ child_hash;
+    return hash * DIFF_HASH_MULTIPLIER;
+}
+
+
+// Хэш поддерева считается после детей, поэтому он зависит от всего содержимого, но не от положения
+static size_t fill_diff_side(tree_diff_side_t* side, const node_t* node, size_t index)
+{
+    side -> nodes[index] = node;
+
+    uint64_t hash = hash_diff_phrase(node -> question);
+    size_t next = index + 1;
+
+    const node_t* children[] = {node -> yes, node -> no};
+
+    for (int i = 0; i < 2; i++)
+    {
+        const node_t* child = children[i];
+
+        if (child == NULL)
+        {
+            hash = mix_diff_hash(hash, DIFF_NIL_HASH);
+            continue;
+        }
+
+        size_t child_index = next;
+        next = fill_diff_side(side, child, next);
+        hash = mix_diff_hash(hash, side -> hashes[child_index]);
+    }
+
+    side -> hashes[index] = hash;
+    side -> sizes[index]  = next - index;
+
+    return next;
+}
+
+
+static tree_error_type build_diff_side(const tree_t* tree, tree_diff_side_t* side)
+{
+    *side = {};
+
+    if (tree -> root == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    size_t count = count_nodes_recursive(tree -> root);
+
+    side -> nodes  = (const node_t**)calloc(count, sizeof(const node_t*));
+    side -> hashes = (uint64_t*)calloc(count, sizeof(uint64_t));
+    side -> sizes  = (size_t*)calloc(count, sizeof(size_t));
+
+    if (side -> nodes == NULL || side -> hashes == NULL || side -> sizes == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    side -> count = fill_diff_side(side, tree -> root, 0);
+
+    return TREE_NO_ERROR;
+}
+
+
+static void destroy_diff_side(tree_diff_side_t* side)
+{
+    free(side -> nodes);
+    free(side -> hashes);
+    free(side -> sizes);
+
+    *side = {};
+}
+
+
+static bool is_diff_leaf(const tree_diff_side_t* side, size_t index)
+{
+    return side -> sizes[index] == 1;
+}
+
+
+// Ответ "да" в прямом порядке идёт сразу за вопросом, размеры для этого не нужны
+static size_t diff_yes_child(size_t index)
+{
+    return index + 1;
+}
+
+
+static size_t diff_no_child(const tree_diff_side_t* side, size_t index)
+{
+    return index + 1 + side -> sizes[index + 1];
+}
+
+
+static bool same_subtree(const tree_diff_side_t* first, size_t first_index,
+                         const tree_diff_side_t* second, size_t second_index)
+{
+    return first  -> hashes[first_index] == second -> hashes[second_index] &&
+           first  -> sizes[first_index]  == second -> sizes[second_index];
+}
+
+// ============================CHANGES===========================================
+
+static tree_error_type push_diff_index(diff_index_list_t* list, size_t index)
+{
+    if (list -> count == list -> capacity)
+    {
+        size_t new_capacity = (list -> capacity == 0) ? DIFF_INITIAL_CAPACITY : list -> capacity * 2;
+        size_t* new_indices = (size_t*)realloc(list -> indices, new_capacity * sizeof(size_t));
+        if (new_indices == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        list -> indices  = new_indices;
+        list -> capacity = new_capacity;
+    }
+
+    list -> indices[list -> count++] = index;
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type add_diff_change(tree_diff_t* diff, tree_diff_change_type type,
+                                       const node_t* old_node, const node_t* new_node)
+{
+    if (diff -> number_of_changes == diff -> changes_capacity)
+    {
+        size_t new_capacity = (diff -> changes_capacity == 0) ? DIFF_INITIAL_CAPACITY : diff -> changes_capacity * 2;
+        tree_diff_change_t* new_changes = (tree_diff_change_t*)realloc(diff -> changes,
+                                                                       new_capacity * sizeof(tree_diff_change_t));
+        if (new_changes == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        diff -> changes = new_changes;
+        diff -> changes_capacity = new_capacity;
+    }
+
+    diff -> changes[diff -> number_of_changes++] = {type, old_node, new_node};
+    return TREE_NO_ERROR;
+}
+
+
+// Листья поддерева идут в прямом порядке подряд, рекурсия не нужна
+static tree_error_type collect_diff_leaves(const tree_diff_side_t* side, size_t index, diff_index_list_t* list)
+{
+    tree_error_type result = TREE_NO_ERROR;
+
+    for (size_t i = index; i < index + side -> sizes[index] && result == TREE_NO_ERROR; i++)
+    {
+        if (is_diff_leaf(side, i))
+            result = push_diff_index(list, i);
+    }
+
+    return result;
+}
+
+// ============================WALK===========================================
+
+// Новый вопрос над старым поддеревом: вторая его ветка - новые объекты
+static tree_error_type try_diff_split(diff_context_t* context, size_t old_index, size_t new_index, bool* found)
+{
+    const tree_diff_side_t* old_side = &context -> old_side;
+    const tree_diff_side_t* new_side = &context -> new_side;
+
+    *found = false;
+    if (is_diff_leaf(new_side, new_index))
+        return TREE_NO_ERROR;
+
+    size_t yes = diff_yes_child(new_index);
+    size_t no  = diff_no_child(new_side, new_index);
+
+    size_t other = 0;
+    if (same_subtree(old_side, old_index, new_side, no))
+        other = yes;
+    else if (same_subtree(old_side, old_index, new_side, yes))
+        other = no;
+    else
+        return TREE_NO_ERROR;
+
+    *found = true;
+    context -> diff -> number_of_skipped_nodes += old_side -> sizes[old_index];
+
+    tree_error_type result = add_diff_change(context -> diff, TREE_DIFF_SPLIT, old_side -> nodes[old_index],
+                                             new_side -> nodes[new_index]);
+    if (result == TREE_NO_ERROR)
+        result = collect_diff_leaves(new_side, other, &context -> added);
+
+    return result;
+}
+
+
+// Вопрос убрали: осталась одна ветка, объекты второй пропали или переехали
+static tree_error_type try_diff_unsplit(diff_context_t* context, size_t old_index, size_t new_index, bool* found)
+{
+    const tree_diff_side_t* old_side = &context -> old_side;
+    const tree_diff_side_t* new_side = &context -> new_side;
+
+    *found = false;
+    if (is_diff_leaf(old_side, old_index))
+        return TREE_NO_ERROR;
+
+    size_t yes = diff_yes_child(old_index);
+    size_t no  = diff_no_child(old_side, old_index);
+
+    size_t other = 0;
+    if (same_subtree(old_side, no, new_side, new_index))
+        other = yes;
+    else if (same_subtree(old_side, yes, new_side, new_index))
+        other = no;
+    else
+        return TREE_NO_ERROR;
+
+    *found = true;
+    context -> diff -> number_of_skipped_nodes += new_side -> sizes[new_index];
+
+    tree_error_type result = add_diff_change(context -> diff, TREE_DIFF_UNSPLIT, old_side -> nodes[old_index],
+                                             new_side -> nodes[new_index]);
+    if (result == TREE_NO_ERROR)
+        result = collect_diff_leaves(old_side, other, &context -> removed);
+
+    return result;
+}
+
+
+static tree_error_type diff_subtrees(diff_context_t* context, size_t old_index, size_t new_index)
+{
+    const tree_diff_side_t* old_side = &context -> old_side;
+    const tree_diff_side_t* new_side = &context -> new_side;
+
+    context -> diff -> number_of_compared_nodes++;
+
+    if (same_subtree(old_side, old_index, new_side, new_index))
+    {
+        context -> diff -> number_of_skipped_nodes += old_side -> sizes[old_index];
+        return TREE_NO_ERROR;
+    }
+
+    bool found = false;
+
+    tree_error_type result = try_diff_split(context, old_index, new_index, &found);
+    if (result != TREE_NO_ERROR || found)
+        return result;
+
+    result = try_diff_unsplit(context, old_index, new_index, &found);
+    if (result != TREE_NO_ERROR || found)
+        return result;
+
+    bool old_is_leaf = is_diff_leaf(old_side, old_index);
+    bool new_is_leaf = is_diff_leaf(new_side, new_index);
+
+    // два разных листа на одном месте: переименование, если ни один из них не нашёлся в другом месте
+    if (old_is_leaf && new_is_leaf)
+    {
+        result = push_diff_index(&context -> removed, old_index);
+        if (result == TREE_NO_ERROR)
+            result = push_diff_index(&context -> added, new_index);
+        if (result == TREE_NO_ERROR)
+            result = push_diff_index(&context -> renamed_old, old_index);
+        if (result == TREE_NO_ERROR)
+            result = push_diff_index(&context -> renamed_new, new_index);
+
+        return result;
+    }
+
+    // лист против вопроса без общего поддерева - сравнивать нечего, объекты сопоставятся по именам
+    if (old_is_leaf || new_is_leaf)
+    {
+        result = collect_diff_leaves(old_side, old_index, &context -> removed);
+        if (result == TREE_NO_ERROR)
+            result = collect_diff_leaves(new_side, new_index, &context -> added);
+
+        return result;
+    }
+
+    if (strcmp(old_side -> nodes[old_index] -> question, new_side -> nodes[new_index] -> question) != 0)
+    {
+        result = add_diff_change(context -> diff, TREE_DIFF_RENAME_QUESTION, old_side -> nodes[old_index],
+                                 new_side -> nodes[new_index]);
+        if (result != TREE_NO_ERROR)
+            return result;
+    }
+
+    result = diff_subtrees(context, diff_yes_child(old_index), diff_yes_child(new_index));
+    if (result == TREE_NO_ERROR)
+        result = diff_subtrees(context, diff_no_child(old_side, old_index), diff_no_child(new_side, new_index));
+
+    return result;
+}
+
+// ============================OBJECTS===========================================
+
+static int compare_diff_leaves(const void* first, const void* second)
+{
+    const diff_leaf_t* first_leaf  = (const diff_leaf_t*)first;
+    const diff_leaf_t* second_leaf = (const diff_leaf_t*)second;
+
+    int order = strcmp(first_leaf -> name, second_leaf -> name);
+    if (order != 0)
+        return order;
+
+    return (first_leaf -> index < second_leaf -> index) ? -1 : (first_leaf -> index > second_leaf -> index);
+}
+
+
+static diff_leaf_t* make_sorted_diff_leaves(const tree_diff_side_t* side, const diff_index_list_t* list)
+{
+    diff_leaf_t* leaves = (diff_leaf_t*)calloc(list -> count + 1, sizeof(diff_leaf_t));
+    if (leaves == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < list -> count; i++)
+        leaves[i] = {side -> nodes[list -> indices[i]] -> question, list -> indices[i]};
+
+    qsort(leaves, list -> count, sizeof(diff_leaf_t), compare_diff_leaves);
+
+    return leaves;
+}
+
+
+// Объект пропал в одном месте и появился в другом - это перенос, а не удаление и добавление
+static tree_error_type match_moved_objects(diff_context_t* context)
+{
+    diff_leaf_t* removed = make_sorted_diff_leaves(&context -> old_side, &context -> removed);
+    diff_leaf_t* added   = make_sorted_diff_leaves(&context -> new_side, &context -> added);
+
+    tree_error_type result = (removed != NULL && added != NULL) ? TREE_NO_ERROR : TREE_ERROR_ALLOCATION;
+
+    size_t i = 0, j = 0;
+    while (result == TREE_NO_ERROR && i < context -> removed.count && j < context -> added.count)
+    {
+        int order = strcmp(removed[i].name, added[j].name);
+
+        if (order < 0)
+        {
+            i++;
+        }
+        else if (order > 0)
+        {
+            j++;
+        }
+        else
+        {
+            context -> old_matched[removed[i].index] = 1;
+            context -> new_matched[added[j].index]   = 1;
+
+            result = add_diff_change(context -> diff, TREE_DIFF_MOVE, context -> old_side.nodes[removed[i].index],
+                                     context -> new_side.nodes[added[j].index]);
+            i++;
+            j++;
+        }
+    }
+
+    free(removed);
+    free(added);
+
+    return result;
+}
+
+
+static tree_error_type classify_changed_objects(diff_context_t* context)
+{
+    tree_error_type result = match_moved_objects(context);
+
+    for (size_t i = 0; i < context -> renamed_old.count && result == TREE_NO_ERROR; i++)
+    {
+        size_t old_index = context -> renamed_old.indices[i];
+        size_t new_index = context -> renamed_new.indices[i];
+
+        if (context -> old_matched[old_index] || context -> new_matched[new_index])
+            continue;
+
+        context -> old_matched[old_index] = 1;
+        context -> new_matched[new_index] = 1;
+
+        result = add_diff_change(context -> diff, TREE_DIFF_RENAME_OBJECT, context -> old_side.nodes[old_index],
+                                 context -> new_side.nodes[new_index]);
+    }
+
+    for (size_t i = 0; i < context -> removed.count && result == TREE_NO_ERROR; i++)
+    {
+        size_t old_index = context -> removed.indices[i];
+        if (!context -> old_matched[old_index])
+            result = add_diff_change(context -> diff, TREE_DIFF_REMOVE, context -> old_side.nodes[old_index], NULL);
+    }
+
+    for (size_t i = 0; i < context -> added.count && result == TREE_NO_ERROR; i++)
+    {
+        size_t new_index = context -> added.indices[i];
+        if (!context -> new_matched[new_index])
+            result = add_diff_change(context -> diff, TREE_DIFF_ADD, NULL, context -> new_side.nodes[new_index]);
+    }
+
+    return result;
+}
+
+// ============================API===========================================
+
+tree_error_type tree_diff(const tree_t* old_tree, const tree_t* new_tree, tree_diff_t* diff)
+{
+    assert(old_tree != NULL);
+    assert(new_tree != NULL);
+    assert(diff     != NULL);
+
+    *diff = {};
+
+    diff_context_t context = {};
+    context.diff = diff;
+
+    tree_error_type result = build_diff_side(old_tree, &context.old_side);
+    if (result == TREE_NO_ERROR)
+        result = build_diff_side(new_tree, &context.new_side);
+
+    if (result == TREE_NO_ERROR)
+    {
+        context.old_matched = (unsigned char*)calloc(context.old_side.count, sizeof(unsigned char));
+        context.new_matched = (unsigned char*)calloc(context.new_side.count, sizeof(unsigned char));
+
+        if (context.old_matched == NULL || context.new_matched == NULL)
+            result = TREE_ERROR_ALLOCATION;
+    }
+
+    if (result == TREE_NO_ERROR)
+        result = diff_subtrees(&context, 0, 0);
+
+    if (result == TREE_NO_ERROR)
+        result = classify_changed_objects(&context);
+
+    free(context.old_matched);
+    free(context.new_matched);
+    free(context.removed.indices);
+    free(context.added.indices);
+    free(context.renamed_old.indices);
+    free(context.renamed_new.indices);
+    destroy_diff_side(&context.old_side);
+    destroy_diff_side(&context.new_side);
+
+    if (result != TREE_NO_ERROR)
+        tree_diff_destroy(diff);
+
+    return result;
+}
+
+
+void tree_diff_destroy(tree_diff_t* diff)
+{
+    if (diff == NULL)
+        return;
+
+    free(diff -> changes);
+    *diff = {};
+}
+
+
+const char* tree_diff_change_translator(tree_diff_change_type type)
+{
+    switch (type)
+    {
+        case TREE_DIFF_SPLIT:           return "split";
+        case TREE_DIFF_UNSPLIT:         return "unsplit";
+        case TREE_DIFF_RENAME_QUESTION: return "rename_question";
+        case TREE_DIFF_RENAME_OBJECT:   return "rename_object";
+        case TREE_DIFF_MOVE:            return "move";
+        case TREE_DIFF_ADD:             return "add";
+        case TREE_DIFF_REMOVE:          return "remove";
+        default:                        return "unknown";
+    }
+}
+
+// ============================OUTPUT===========================================
+
+// Путь от корня до узла: вопросы и ответы, по которым в него приходят
+static void print_diff_path(FILE* stream, const node_t* node)
+{
+    if (node -> parent != NULL)
+    {
+        print_diff_path(stream, node -> parent);
+        fprintf(stream, " -%s-> ", (node -> parent -> yes == node) ? "yes" : "no");
+    }
+
+    fprintf(stream, "\"%s\"", node -> question);
+}
+
+
+void tree_diff_print(const tree_diff_t* diff, FILE* stream)
+{
+    assert(diff   != NULL);
+    assert(stream != NULL);
+
+    for (size_t i = 0; i < diff -> number_of_changes; i++)
+    {
+        const tree_diff_change_t* change = &diff -> changes[i];
+
+        fprintf(stream, "%-16s ", tree_diff_change_translator(change -> type));
+
+        switch (change -> type)
+        {
+            case TREE_DIFF_SPLIT:
+                fprintf(stream, "\"%s\" asked before \"%s\": ", change -> new_node -> question, change -> old_node -> question);
+                print_diff_path(stream, change -> new_node);
+                break;
+
+            case TREE_DIFF_UNSPLIT:
+                fprintf(stream, "\"%s\" no longer asked before \"%s\": ", change -> old_node -> question, change -> new_node -> question);
+                print_diff_path(stream, change -> old_node);
+                break;
+
+            case TREE_DIFF_RENAME_QUESTION:
+            case TREE_DIFF_RENAME_OBJECT:
+                fprintf(stream, "\"%s\" -> \"%s\": ", change -> old_node -> question, change -> new_node -> question);
+                print_diff_path(stream, change -> new_node);
+                break;
+
+            case TREE_DIFF_MOVE:
+                print_diff_path(stream, change -> old_node);
+                fprintf(stream, "  =>  ");
+                print_diff_path(stream, change -> new_node);
+                break;
+
+            case TREE_DIFF_ADD:
+                print_diff_path(stream, change -> new_node);
+                break;
+
+            case TREE_DIFF_REMOVE:
+                print_diff_path(stream, change -> old_node);
+                break;
+
+            default:
+                break;
+        }
+
+        fprintf(stream, "\n");
+    }
+
+    fprintf(stream, "Tree diff: %zu changes, %zu node pairs compared, %zu nodes skipped in identical subtrees\n",
+                    diff -> number_of_changes, diff -> number_of_compared_nodes, diff -> number_of_skipped_nodes);
+}
+
+
+static void write_json_string(FILE* stream, const char* text)
+{
+    fputc('"', stream);
+
+    for (const unsigned char* symbol = (const unsigned char*)text; *symbol != '\0'; symbol++)
+    {
+        if (*symbol == '"' || *symbol == '\\')
+        {
+            fputc('\\', stream);
+            fputc(*symbol, stream);
+        }
+        else if (*symbol < 0x20)
+        {
+            fprintf(stream, "\\u%04x", *symbol);
+        }
+        else
+        {
+            fputc(*symbol, stream);
+        }
+    }
+
+    fputc('"', stream);
+}
+
+
+static void write_json_path_steps(FILE* stream, const node_t* node)
+{
+    const node_t* parent = node -> parent;
+    if (parent == NULL)
+        return;
+
+    write_json_path_steps(stream, parent);
+
+    if (parent -> parent != NULL)
+        fputc(',', stream);
+
+    fputc('[', stream);
+    write_json_string(stream, parent -> question);
+    fprintf(stream, ",\"%s\"]", (parent -> yes == node) ? "yes" : "no");
+}
+
+
+static void write_json_node(FILE* stream, const char* key, const node_t* node)
+{
+    fprintf(stream, ",\"%s\":", key);
+
+    if (node == NULL)
+    {
+        fprintf(stream, "null,\"%s_path\":null", key);
+        return;
+    }
+
+    write_json_string(stream, node -> question);
+
+    fprintf(stream, ",\"%s_path\":[", key);
+    write_json_path_steps(stream, node);
+    fputc(']', stream);
+}
+
+
+// Одна запись JSON на строку: {"change":..,"old":..,"old_path":[[вопрос,ответ],..],"new":..,"new_path":..}
+void tree_diff_write_json(const tree_diff_t* diff, FILE* stream)
+{
+    assert(diff   != NULL);
+    assert(stream != NULL);
+
+    for (size_t i = 0; i < diff -> number_of_changes; i++)
+    {
+        const tree_diff_change_t* change = &diff -> changes[i];
+
+        fprintf(stream, "{\"change\":\"%s\"", tree_diff_change_translator(change -> type));
+        write_json_node(stream, "old", change -> old_node);
+        write_json_node(stream, "new", change -> new_node);
+        fprintf(stream, "}\n");
+    }
+}
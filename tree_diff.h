@@ -0,0 +1,57 @@
+#ifndef TREE_DIFF_H_
+#define TREE_DIFF_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+enum tree_diff_change_type
+{
+    TREE_DIFF_SPLIT           = 1, // над старым поддеревом появился вопрос (обычное обучение)
+    TREE_DIFF_UNSPLIT         = 2, // вопрос убрали, осталась одна из его веток
+    TREE_DIFF_RENAME_QUESTION = 3,
+    TREE_DIFF_RENAME_OBJECT   = 4,
+    TREE_DIFF_MOVE            = 5, // объект есть в обоих снимках, но путь к нему другой
+    TREE_DIFF_ADD             = 6,
+    TREE_DIFF_REMOVE          = 7,
+};
+
+// old_node - узел старого снимка, new_node - нового, у ADD и REMOVE один из них NULL.
+// У SPLIT old_node - поддерево, над которым появился вопрос new_node, у UNSPLIT - наоборот
+struct tree_diff_change_t
+{
+    tree_diff_change_type type;
+    const node_t* old_node;
+    const node_t* new_node;
+};
+
+// Узлы снимка в прямом порядке обхода с хэшами поддеревьев: одинаковые поддеревья
+// сравниваются за O(1) и пропускаются целиком, обход идёт только по изменённой части
+struct tree_diff_side_t
+{
+    const node_t** nodes;
+    uint64_t* hashes;
+    size_t* sizes; // узлов в поддереве, yes-ребёнок - следующий узел, no - через sizes[yes]
+    size_t count;
+};
+
+struct tree_diff_t
+{
+    tree_diff_change_t* changes;
+    size_t number_of_changes;
+    size_t changes_capacity;
+
+    size_t number_of_compared_nodes;
+    size_t number_of_skipped_nodes; // в совпавших поддеревьях, внутрь которых не заходили
+};
+
+tree_error_type tree_diff(const tree_t* old_tree, const tree_t* new_tree, tree_diff_t* diff);
+void tree_diff_print(const tree_diff_t* diff, FILE* stream);
+void tree_diff_write_json(const tree_diff_t* diff, FILE* stream);
+void tree_diff_destroy(tree_diff_t* diff);
+const char* tree_diff_change_translator(tree_diff_change_type type);
+
+#endif // TREE_DIFF_H_
@@ -0,0 +1,1314 @@
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "tree.h"
+#include "tree_dump.h"
+#include "metrics.h"
+#include "trace.h"
+#include "tree_error_type.h"
+
+// Последний записанный снимок каждого лога - база для следующего инкрементального дампа
+struct dump_log_state_t
+{
+    char htm_filename[MAX_LENGTH_OF_FILENAME];
+    dump_snapshot_t* previous;
+    int dumps_since_full;
+};
+
+struct dump_worker_t
+{
+    std::mutex mutex = {};
+    std::condition_variable has_work = {};
+    std::condition_variable is_idle = {};
+    std::thread worker = {};
+    bool running = false;
+    bool busy = false;
+
+    dump_snapshot_t* head = NULL; // очередь снимков в порядке вызовов tree_dump
+    dump_snapshot_t* tail = NULL;
+
+    int number_of_pictures = 0;
+    char last_folder[MAX_LENGTH_OF_FILENAME] = {}; // mkdir делаем один раз на папку
+
+    dump_log_state_t logs[MAX_NUMBER_OF_DUMP_LOGS] = {};
+    size_t next_log_slot = 0;
+};
+
+static dump_worker_t dump_worker;
+
+struct snapshot_stack_entry
+{
+    const node_t* node;
+    size_t parent;
+    bool is_yes;
+    int level;
+    int budget;           // сколько ещё шагов осталось до границы окрестности
+    size_t path_distance; // для предков фокуса - расстояние до него, иначе DUMP_NO_NODE
+    bool collapsed;       // вместо поддерева рисуем один сводный узел
+};
+
+// Какую часть дерева снимаем: окрестность фокуса и/или дерево до заданной глубины
+struct snapshot_scope_t
+{
+    const node_t** path; // path[j] - предок фокуса на расстоянии j, path[0] - сам фокус
+    size_t path_length;
+    int radius;
+    int max_depth;
+};
+
+
+static bool push_snapshot_entry(snapshot_stack_entry** stack, size_t* size, size_t* capacity,
+                                snapshot_stack_entry entry)
+{
+    if (*size == *capacity)
+    {
+        size_t new_capacity = (*capacity == 0) ? 64 : *capacity * 2;
+        snapshot_stack_entry* new_stack = (snapshot_stack_entry*)realloc(*stack, new_capacity * sizeof(snapshot_stack_entry));
+        if (new_stack == NULL)
+            return false;
+
+        *stack = new_stack;
+        *capacity = new_capacity;
+    }
+
+    (*stack)[(*size)++] = entry;
+    return true;
+}
+
+
+static bool push_counted_node(const node_t*** stack, size_t* size, size_t* capacity, const node_t* node)
+{
+    if (*size == *capacity)
+    {
+        size_t new_capacity = (*capacity == 0) ? 64 : *capacity * 2;
+
+        const node_t** new_stack = (const node_t**)realloc(*stack, new_capacity * sizeof(const node_t*));
+        if (new_stack == NULL)
+            return false;
+
+        *stack = new_stack;
+        *capacity = new_capacity;
+    }
+
+    (*stack)[(*size)++] = node;
+    return true;
+}
+
+
+// Размер скрытого поддерева считаем не дальше limit, чтобы сводные узлы не стоили как полный обход.
+// is_exact - false, если обход остановился раньше: на limit или без памяти под стек
+static size_t count_nodes_bounded(const node_t* node, size_t limit, bool* is_exact)
+{
+    const node_t** stack = NULL;
+    size_t stack_size = 0, stack_capacity = 0;
+    size_t count = 0;
+
+    *is_exact = push_counted_node(&stack, &stack_size, &stack_capacity, node);
+
+    while (*is_exact && stack_size > 0 && count < limit)
+    {
+        const node_t* current = stack[--stack_size];
+        count++;
+
+        if (current -> no  != NULL) *is_exact = push_counted_node(&stack, &stack_size, &stack_capacity, current -> no);
+        if (current -> yes != NULL && *is_exact) *is_exact = push_counted_node(&stack, &stack_size, &stack_capacity, current -> yes);
+    }
+
+    if (stack_size > 0)
+        *is_exact = false;
+
+    free(stack);
+    return count;
+}
+
+
+static void format_collapsed_label(char* buffer, size_t buffer_size, size_t hidden, bool is_exact)
+{
+    snprintf(buffer, buffer_size, "... %zu%s nodes", hidden, is_exact ? "" : "+");
+}
+
+
+static snapshot_stack_entry make_child_entry(const snapshot_scope_t* scope, const snapshot_stack_entry* parent_entry,
+                                             const node_t* child, size_t parent_index, bool is_yes)
+{
+    snapshot_stack_entry child_entry = {child, parent_index, is_yes, parent_entry -> level + 1,
+                                        parent_entry -> budget - 1, DUMP_NO_NODE, false};
+
+    // ребёнок предка, лежащий на пути к фокусу, ближе к фокусу, а не дальше
+    size_t distance = parent_entry -> path_distance;
+    if (distance != DUMP_NO_NODE && distance > 0 && scope -> path[distance - 1] == child)
+    {
+        child_entry.path_distance = distance - 1;
+        child_entry.budget = scope -> radius - (int)(distance - 1);
+    }
+
+    child_entry.collapsed = child_entry.budget < 0 || child_entry.level > scope -> max_depth;
+
+    return child_entry;
+}
+
+
+// Обходим дерево дважды без рекурсии: сначала считаем узлы и длину фраз, потом копируем
+static tree_error_type walk_tree_for_snapshot(const snapshot_scope_t* scope, size_t limit, dump_snapshot_t* snapshot,
+                                              size_t* count, size_t* text_size)
+{
+    snapshot_stack_entry* stack = NULL;
+    size_t stack_size = 0, stack_capacity = 0;
+    char* text_position = (snapshot != NULL) ? snapshot -> phrases : NULL;
+
+    *count = 0;
+    *text_size = 0;
+
+    if (scope -> path_length > 0)
+    {
+        size_t top = scope -> path_length - 1;
+        snapshot_stack_entry start = {scope -> path[top], DUMP_NO_NODE, true, ZERO_RANK, scope -> radius - (int)top, top, false};
+
+        if (!push_snapshot_entry(&stack, &stack_size, &stack_capacity, start))
+            return TREE_ERROR_ALLOCATION;
+    }
+
+    while (stack_size > 0)
+    {
+        snapshot_stack_entry entry = stack[--stack_size];
+
+        if (*count == limit)
+        {
+            if (snapshot != NULL)
+                snapshot -> truncated = true; // дерево больше, чем обещает size, - скорее всего цикл
+            break;
+        }
+
+        size_t index = (*count)++;
+        size_t hidden = 0;
+        char collapsed_label[MAX_LENGTH_OF_ADDRESS] = {};
+        const char* text = entry.node -> question;
+
+        if (entry.collapsed)
+        {
+            bool is_exact = true;
+            hidden = count_nodes_bounded(entry.node, DUMP_COLLAPSED_COUNT_LIMIT, &is_exact);
+            format_collapsed_label(collapsed_label, sizeof(collapsed_label), hidden, is_exact);
+            text = collapsed_label;
+        }
+
+        size_t length = strlen(text) + 1;
+        *text_size += length;
+
+        if (snapshot != NULL)
+        {
+            dump_node_t* copy = &snapshot -> nodes[index];
+
+            copy -> address   = entry.node;
+            copy -> question  = text_position;
+            copy -> yes       = DUMP_NO_NODE;
+            copy -> no        = DUMP_NO_NODE;
+            copy -> parent    = entry.parent;
+            copy -> level     = entry.level;
+            copy -> collapsed = hidden;
+
+            memcpy(text_position, text, length);
+            text_position += length;
+
+            if (entry.parent != DUMP_NO_NODE)
+            {
+                if (entry.is_yes)
+                    snapshot -> nodes[entry.parent].yes = index;
+                else
+                    snapshot -> nodes[entry.parent].no  = index;
+            }
+
+            if (entry.collapsed)
+                snapshot -> number_of_collapsed++;
+        }
+
+        if (entry.collapsed)
+            continue;
+
+        // no кладём первым, чтобы yes-ветка шла раньше, как в рекурсивном обходе
+        if ((entry.node -> no != NULL &&
+             !push_snapshot_entry(&stack, &stack_size, &stack_capacity,
+                                  make_child_entry(scope, &entry, entry.node -> no,  index, false))) ||
+            (entry.node -> yes != NULL &&
+             !push_snapshot_entry(&stack, &stack_size, &stack_capacity,
+                                  make_child_entry(scope, &entry, entry.node -> yes, index, true))))
+        {
+            free(stack);
+            return TREE_ERROR_ALLOCATION;
+        }
+    }
+
+    free(stack);
+    return TREE_NO_ERROR;
+}
+
+
+void dump_options_init(dump_options_t* options)
+{
+    assert(options != NULL);
+
+    options -> mode            = DUMP_MODE_INCREMENTAL;
+    options -> focus_node      = NULL;
+    options -> focus_object    = NULL;
+    options -> radius          = DUMP_UNLIMITED;
+    options -> max_depth       = DUMP_UNLIMITED;
+    options -> table_page_size = DUMP_DEFAULT_TABLE_PAGE_SIZE;
+}
+
+
+static tree_error_type find_dump_focus(const tree_t* tree, const dump_options_t* options, const node_t** focus)
+{
+    *focus = tree -> root;
+
+    if (options -> focus_node != NULL)
+        *focus = options -> focus_node;
+
+    else if (options -> focus_object != NULL)
+    {
+        *focus = find_leaf_by_phrase(tree -> root, options -> focus_object);
+        if (*focus == NULL)
+            return TREE_ERROR_NULL_PTR; // такого объекта в дереве нет
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+// Подымаемся от фокуса не выше radius шагов: выше лежат узлы вне окрестности
+static tree_error_type build_snapshot_scope(const tree_t* tree, const dump_options_t* options, snapshot_scope_t* scope)
+{
+    const node_t* focus = NULL;
+    tree_error_type result = find_dump_focus(tree, options, &focus);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    scope -> radius    = (options -> radius    < 0) ? INT_MAX : options -> radius;
+    scope -> max_depth = (options -> max_depth < 0) ? INT_MAX : options -> max_depth;
+
+    if (focus == NULL)
+        return TREE_NO_ERROR;
+
+    size_t path_length = 1;
+    for (const node_t* node = focus -> parent; node != NULL && path_length <= (size_t)scope -> radius &&
+                                               path_length <= tree -> size; node = node -> parent)
+        path_length++;
+
+    scope -> path = (const node_t**)calloc(path_length, sizeof(const node_t*));
+    if (scope -> path == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    const node_t* node = focus;
+    for (size_t i = 0; i < path_length; i++, node = node -> parent)
+        scope -> path[i] = node;
+
+    scope -> path_length = path_length;
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type dump_snapshot_create(const tree_t* tree, const dump_options_t* options, dump_snapshot_t** snapshot)
+{
+    assert(tree     != NULL);
+    assert(options  != NULL);
+    assert(snapshot != NULL);
+
+    snapshot_scope_t scope = {};
+    tree_error_type result = build_snapshot_scope(tree, options, &scope);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    size_t limit = 2 * tree -> size + 1;
+    size_t count = 0, text_size = 0;
+
+    result = walk_tree_for_snapshot(&scope, limit, NULL, &count, &text_size);
+    if (result != TREE_NO_ERROR)
+    {
+        free(scope.path);
+        return result;
+    }
+
+    dump_snapshot_t* new_snapshot = (dump_snapshot_t*)calloc(1, sizeof(dump_snapshot_t));
+    if (new_snapshot == NULL)
+    {
+        free(scope.path);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    new_snapshot -> nodes   = (dump_node_t*)calloc(count + 1, sizeof(dump_node_t));
+    new_snapshot -> phrases = (char*)calloc(text_size + 1, sizeof(char));
+    if (new_snapshot -> nodes == NULL || new_snapshot -> phrases == NULL)
+    {
+        free(scope.path);
+        dump_snapshot_destroy(new_snapshot);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    result = walk_tree_for_snapshot(&scope, count, new_snapshot, &new_snapshot -> count, &text_size);
+    if (result != TREE_NO_ERROR)
+    {
+        free(scope.path);
+        dump_snapshot_destroy(new_snapshot);
+        return result;
+    }
+
+    new_snapshot -> truncated      |= (count == limit);
+    new_snapshot -> tree_size       = tree -> size;
+    new_snapshot -> root_address    = tree -> root;
+    new_snapshot -> focus_address   = (scope.path_length > 0) ? scope.path[0] : NULL;
+    new_snapshot -> is_partial      = options -> radius >= 0 || options -> max_depth >= 0;
+    new_snapshot -> radius          = options -> radius;
+    new_snapshot -> max_depth       = options -> max_depth;
+    new_snapshot -> table_page_size = options -> table_page_size;
+    new_snapshot -> time            = time(NULL);
+
+    if (!new_snapshot -> is_partial)
+        new_snapshot -> has_memory_report = tree_memory_report_build(tree, &new_snapshot -> memory) == TREE_NO_ERROR;
+
+    free(scope.path);
+
+    *snapshot = new_snapshot;
+    return TREE_NO_ERROR;
+}
+
+
+void dump_snapshot_destroy(dump_snapshot_t* snapshot)
+{
+    if (snapshot == NULL)
+        return;
+
+    free(snapshot -> nodes);
+    free(snapshot -> phrases);
+    free(snapshot -> previous_index);
+    free(snapshot -> previous_seen);
+    free(snapshot -> marks);
+    tree_memory_report_destroy(&snapshot -> memory);
+    free(snapshot);
+}
+
+// ============================WRITERS===========================================
+
+void write_dump_header(FILE* htm_file, time_t now)
+{
+    assert(htm_file != NULL);
+
+    fprintf(htm_file, "<div style='border:2px solid #ccc; margin:10px; padding:15px; background:#f9f9f9;'>\n");
+    fprintf(htm_file, "<h2 style='color:#333;'>Tree Dump at %s</h2>\n", ctime(&now));
+}
+
+
+void write_information_about_tree(FILE* htm_file, const dump_snapshot_t* snapshot)
+{
+    assert(snapshot != NULL);
+    assert(htm_file != NULL);
+
+    fprintf(htm_file, "<div style='margin-bottom:15px;'>\n");
+    fprintf(htm_file, "<p><b>Tree size:</b> %zu</p>\n", snapshot -> tree_size);
+    fprintf(htm_file, "<p><b>Root address:</b> %p</p>\n", (const void*)snapshot -> root_address);
+    if (snapshot -> truncated)
+        fprintf(htm_file, "<p><b>Warning:</b> more nodes than tree size, dump truncated at %zu</p>\n", snapshot -> count);
+    if (snapshot -> is_partial)
+    {
+        fprintf(htm_file, "<p><b>Partial dump:</b> %zu nodes shown, %zu subtrees collapsed, focus %p",
+                          snapshot -> count - snapshot -> number_of_collapsed, snapshot -> number_of_collapsed,
+                          (const void*)snapshot -> focus_address);
+        if (snapshot -> radius >= 0)
+            fprintf(htm_file, ", radius %d", snapshot -> radius);
+        if (snapshot -> max_depth >= 0)
+            fprintf(htm_file, ", max depth %d", snapshot -> max_depth);
+        fprintf(htm_file, "</p>\n");
+    }
+    fprintf(htm_file, "</div>\n");
+
+    if (snapshot -> has_memory_report)
+        tree_memory_report_write_html(&snapshot -> memory, htm_file);
+}
+
+
+static const node_t* snapshot_address(const dump_snapshot_t* snapshot, size_t index)
+{
+    return (index == DUMP_NO_NODE) ? NULL : snapshot -> nodes[index].address;
+}
+
+
+// Фразы пишутся в лог как текст: &<>" в них - служебные символы HTML
+static void write_html_text(FILE* htm_file, const char* text)
+{
+    for (const char* symbol = text; *symbol != '\0'; symbol++)
+    {
+        switch (*symbol)
+        {
+            case '&': fputs("&amp;",  htm_file); break;
+            case '<': fputs("&lt;",   htm_file); break;
+            case '>': fputs("&gt;",   htm_file); break;
+            case '"': fputs("&quot;", htm_file); break;
+            default:  fputc(*symbol,  htm_file); break;
+        }
+    }
+}
+
+
+static void write_tree_nodes_rows(FILE* htm_file, const dump_snapshot_t* snapshot, size_t first, size_t last)
+{
+    fprintf(htm_file, "<table border='1' style='border-collapse:collapse; width:100%%; margin-top:15px;'>\n");
+    fprintf(htm_file, "<tr><th>Address</th><th>Question</th><th>Yes</th><th>No</th><th>Parent</th></tr>\n");
+
+    for (size_t i = first; i < last; i++)
+    {
+        const dump_node_t* node = &snapshot -> nodes[i];
+
+        if (node -> collapsed != 0)
+        {
+            fprintf(htm_file, "<tr><td>%p</td><td><i>", (const void*)node -> address);
+            write_html_text(htm_file, node -> question);
+            fprintf(htm_file, "</i></td><td></td><td></td><td>%p</td></tr>\n",
+                              (const void*)snapshot_address(snapshot, node -> parent));
+            continue;
+        }
+
+        fprintf(htm_file, "<tr><td>%p</td><td>", (const void*)node -> address);
+        write_html_text(htm_file, node -> question);
+        fprintf(htm_file, "</td><td>%p</td><td>%p</td><td>%p</td></tr>\n",
+                          (const void*)snapshot_address(snapshot, node -> yes),
+                          (const void*)snapshot_address(snapshot, node -> no),
+                          (const void*)snapshot_address(snapshot, node -> parent));
+    }
+
+    fprintf(htm_file, "</table>\n");
+}
+
+
+static void make_table_page_filename(char* filename, size_t filename_size, const dump_snapshot_t* snapshot,
+                                     size_t page, bool inside_folder)
+{
+    if (inside_folder)
+        snprintf(filename, filename_size, "tree_table_%d_%zu.htm", snapshot -> picture_number, page);
+    else
+        snprintf(filename, filename_size, "%s/tree_table_%d_%zu.htm", snapshot -> folder_name, snapshot -> picture_number, page);
+}
+
+
+// Первая страница лежит в самом логе, остальные - отдельными файлами в папке дампа
+static void write_table_pages_navigation(FILE* htm_file, const dump_snapshot_t* snapshot,
+                                         size_t number_of_pages, size_t current_page, bool inside_folder)
+{
+    char filename[MAX_LENGTH_OF_FILENAME + MAX_LENGTH_OF_ADDRESS] = {};
+
+    fprintf(htm_file, "<p><b>Pages:</b>");
+    for (size_t page = 0; page < number_of_pages; page++)
+    {
+        if (page == current_page)
+        {
+            fprintf(htm_file, " <b>%zu</b>", page + 1);
+            continue;
+        }
+
+        if (page == 0)
+        {
+            const char* log_name = strrchr(snapshot -> htm_filename, '/');
+            log_name = (log_name == NULL) ? snapshot -> htm_filename : log_name + 1;
+            snprintf(filename, sizeof(filename), "../%s", log_name);
+        }
+        else
+            make_table_page_filename(filename, sizeof(filename), snapshot, page, inside_folder);
+
+        fprintf(htm_file, " <a href='%s'>%zu</a>", filename, page + 1);
+    }
+    fprintf(htm_file, "</p>\n");
+}
+
+
+static void write_tree_nodes_page_file(const dump_snapshot_t* snapshot, size_t page, size_t number_of_pages)
+{
+    char filename[MAX_LENGTH_OF_FILENAME + MAX_LENGTH_OF_ADDRESS] = {};
+    make_table_page_filename(filename, sizeof(filename), snapshot, page, false);
+
+    FILE* page_file = fopen(filename, "w");
+    if (page_file == NULL)
+        return;
+
+    setvbuf(page_file, NULL, _IOFBF, DUMP_FILE_BUFFER_SIZE);
+
+    size_t first = page * snapshot -> table_page_size;
+    size_t last  = first + snapshot -> table_page_size;
+    if (last > snapshot -> count)
+        last = snapshot -> count;
+
+    fprintf(page_file, "<!DOCTYPE html>\n<html>\n<head>\n<title>Tree Dump Nodes</title>\n</head>\n<body>\n");
+    fprintf(page_file, "<h2>Nodes %zu-%zu of %zu</h2>\n", first + 1, last, snapshot -> count);
+    write_table_pages_navigation(page_file, snapshot, number_of_pages, page, true);
+    write_tree_nodes_rows(page_file, snapshot, first, last);
+    fprintf(page_file, "</body>\n</html>\n");
+
+    fclose(page_file);
+}
+
+
+void write_tree_nodes_table(FILE* htm_file, const dump_snapshot_t* snapshot)
+{
+    assert(snapshot != NULL);
+    assert(htm_file != NULL);
+
+    size_t page_size = snapshot -> table_page_size;
+    if (page_size == 0 || snapshot -> count <= page_size)
+    {
+        write_tree_nodes_rows(htm_file, snapshot, 0, snapshot -> count);
+        return;
+    }
+
+    size_t number_of_pages = (snapshot -> count + page_size - 1) / page_size;
+
+    write_table_pages_navigation(htm_file, snapshot, number_of_pages, 0, false);
+    write_tree_nodes_rows(htm_file, snapshot, 0, page_size);
+
+    for (size_t page = 1; page < number_of_pages; page++)
+        write_tree_nodes_page_file(snapshot, page, number_of_pages);
+}
+
+
+void format_node_part(char* part_buffer, size_t buffer_size, const char* label, const node_t* child_node)
+{
+    assert(label       != NULL);
+    assert(part_buffer != NULL);
+
+    if (child_node == NULL)
+        snprintf(part_buffer, buffer_size, "O");
+    else
+        snprintf(part_buffer, buffer_size, "%s: %p", label, (const void*)child_node);
+}
+
+
+tree_error_type create_tree_dot_header(FILE* dot_file)
+{
+    if (dot_file == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    fprintf(dot_file, "digraph AkinatorTree {\n");
+    fprintf(dot_file, "    rankdir=TB;\n");
+    fprintf(dot_file, "    node [shape=Mrecord, color=black];\n\n");
+    fprintf(dot_file, "    graph [nodesep=0.5, ranksep=1.0];\n");
+    fprintf(dot_file, "    edge [arrowsize=0.8];\n\n");
+
+    return TREE_NO_ERROR;
+}
+
+
+static bool is_node_visible(const dump_snapshot_t* snapshot, size_t index)
+{
+    return snapshot -> marks == NULL || snapshot -> marks[index] != DUMP_MARK_HIDDEN;
+}
+
+
+// Фразы могут содержать кавычки, а в подписи Mrecord ещё и {}|<> - служебные
+static void write_dot_label_text(FILE* dot_file, const char* text)
+{
+    for (const char* symbol = text; *symbol != '\0'; symbol++)
+    {
+        if (strchr("\"\\{}|<>", *symbol) != NULL)
+            fputc('\\', dot_file);
+        fputc(*symbol, dot_file);
+    }
+}
+
+
+static void write_dot_node(FILE* dot_file, const dump_snapshot_t* snapshot, size_t index)
+{
+    const dump_node_t* node = &snapshot -> nodes[index];
+
+    if (node -> collapsed != 0)
+    {
+        fprintf(dot_file, "    node_%p [label=\"", (const void*)node -> address);
+        write_dot_label_text(dot_file, node -> question);
+        fprintf(dot_file, "\", shape=box, style=\"dashed,filled\", fillcolor=whitesmoke];\n");
+        return;
+    }
+
+    const char* fill_color = (index == 0) ? "lightblue" : "white";
+    const char* shape = "Mrecord";
+
+    if (snapshot -> marks != NULL && snapshot -> marks[index] == DUMP_MARK_ADDED)
+        fill_color = "palegreen";
+    else if (snapshot -> marks != NULL && snapshot -> marks[index] == DUMP_MARK_CHANGED)
+        fill_color = "gold";
+    else if (snapshot -> is_partial && node -> address == snapshot -> focus_address)
+        fill_color = "orange";
+
+    char yes_part[MAX_LENGTH_OF_ADDRESS] = {};
+    char no_part[MAX_LENGTH_OF_ADDRESS]  = {};
+
+    format_node_part(yes_part, sizeof(yes_part), "YES", snapshot_address(snapshot, node -> yes));
+    format_node_part(no_part,  sizeof(no_part),  "NO",  snapshot_address(snapshot, node -> no));
+
+    fprintf(dot_file, "    node_%p [label=\"{", (const void*)node -> address);
+    write_dot_label_text(dot_file, node -> question);
+    fprintf(dot_file, " | {<f0> %s | <f1> %s}}\", shape=%s, style=filled, fillcolor=%s, color=black];\n",
+                      yes_part, no_part, shape, fill_color);
+
+    double distance = BASE_EDGE_LENGTH + (node -> level * DEPTH_SPREAD_FACTOR); // distance - min расстояние между узлом и листом
+
+    if (node -> yes != DUMP_NO_NODE && is_node_visible(snapshot, node -> yes))
+        fprintf(dot_file, "    node_%p:<f0> -> node_%p [colour=green, minlen=%.1f, label=\"YES\"];\n",
+                          (const void*)node -> address, (const void*)snapshot_address(snapshot, node -> yes), distance);
+
+    if (node -> no != DUMP_NO_NODE && is_node_visible(snapshot, node -> no))
+        fprintf(dot_file, "    node_%p:<f1> -> node_%p [color=red, minlen=%.1f, label=\"NO\"];\n",
+                          (const void*)node -> address, (const void*)snapshot_address(snapshot, node -> no), distance);
+}
+
+
+tree_error_type create_dot_file_tree(const dump_snapshot_t* snapshot)
+{
+    assert(snapshot != NULL);
+
+    FILE* dot_file = fopen(snapshot -> dot_filename, "w");
+    if (dot_file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    setvbuf(dot_file, NULL, _IOFBF, DUMP_FILE_BUFFER_SIZE);
+
+    create_tree_dot_header(dot_file);
+
+    if (snapshot -> count == 0)
+        fprintf(dot_file, "    empty [label=\"Empty tree\"];\n");
+
+    for (size_t i = 0; i < snapshot -> count; i++)
+    {
+        if (is_node_visible(snapshot, i))
+            write_dot_node(dot_file, snapshot, i);
+    }
+
+    fprintf(dot_file, "}\n");
+    fclose(dot_file);
+
+    return TREE_NO_ERROR;
+}
+
+
+static int run_program(char* const* arguments)
+{
+#ifdef _WIN32
+    return (int)_spawnvp(_P_WAIT, arguments[0], arguments);
+#else
+    pid_t pid = 0;
+    if (posix_spawnp(&pid, arguments[0], NULL, NULL, arguments, environ) != 0)
+        return -1;
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status))
+        return -1;
+
+    return WEXITSTATUS(status);
+#endif
+}
+
+
+// spawn принимает неконстантные строки, поэтому аргументы dot - свои массивы, а не литералы
+static char graphviz_program[]       = "dot";
+static char graphviz_svg_format[]    = "-Tsvg";
+static char graphviz_next_to_input[] = "-O";
+
+// Один запуск dot на пачку файлов: -O кладёт результат рядом, в <имя>.dot.svg
+tree_error_type execute_graphviz_batch(dump_snapshot_t* const* snapshots, size_t count)
+{
+    assert(snapshots != NULL);
+
+    if (count == 0)
+        return TREE_NO_ERROR;
+
+    char* arguments[MAX_GRAPHVIZ_BATCH + 4] = {};
+    size_t number_of_arguments = 0;
+
+    arguments[number_of_arguments++] = graphviz_program;
+    arguments[number_of_arguments++] = graphviz_svg_format;
+    arguments[number_of_arguments++] = graphviz_next_to_input;
+
+    for (size_t i = 0; i < count && i < MAX_GRAPHVIZ_BATCH; i++)
+        arguments[number_of_arguments++] = snapshots[i] -> dot_filename;
+
+    arguments[number_of_arguments] = NULL;
+
+    TRACE_SPAN("dot");
+
+    if (run_program(arguments) != 0)
+        return TREE_ERROR_OPENING_FILE;
+
+    return TREE_NO_ERROR;
+}
+
+
+void write_graph_visualization_tree(FILE* htm_file, const dump_snapshot_t* snapshot)
+{
+    assert(htm_file != NULL);
+    assert(snapshot != NULL);
+
+    fprintf(htm_file, "<div style='text-align:center;'>\n");
+    fprintf(htm_file, "<img src='%s' style='max-width:100%%; border:1px solid #ddd;'>\n", snapshot -> svg_filename);
+    fprintf(htm_file, "</div>\n");
+}
+
+
+tree_error_type tree_dump_to_htm(const dump_snapshot_t* snapshot, FILE* htm_file)
+{
+    assert(snapshot != NULL);
+    assert(htm_file != NULL);
+
+    write_dump_header(htm_file, snapshot -> time);
+    write_information_about_tree(htm_file, snapshot);
+    write_graph_visualization_tree(htm_file, snapshot);
+    write_tree_nodes_table(htm_file, snapshot);
+
+    fprintf(htm_file, "</div>\n\n");
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type make_folder_name(const char* base_name, char* folder_name, size_t folder_name_size)
+{
+    assert(base_name   != NULL);
+    assert(folder_name != NULL);
+
+    int written = snprintf(folder_name, folder_name_size, "%s_dump", base_name);
+    if (written < 0 || (size_t)written >= folder_name_size)
+        return TREE_ERROR_SIZE_MISMATCH;
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type make_directory(const char* folder_name)
+{
+    if (folder_name == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+#ifdef _WIN32
+    int result = _mkdir(folder_name);
+#else
+    int result = mkdir(folder_name, 0755);
+#endif
+
+    if (result != 0 && errno != EEXIST)
+        return TREE_ERROR_OPENING_FILE;
+
+    return TREE_NO_ERROR;
+}
+
+// ============================DIFF===========================================
+
+struct diff_pair_t
+{
+    size_t current;
+    size_t previous; // DUMP_NO_NODE - в прошлом снимке по этому пути узла не было
+};
+
+
+static size_t snapshot_child(const dump_snapshot_t* snapshot, size_t index, bool is_yes)
+{
+    if (index == DUMP_NO_NODE)
+        return DUMP_NO_NODE;
+
+    return is_yes ? snapshot -> nodes[index].yes : snapshot -> nodes[index].no;
+}
+
+
+static bool has_same_children(const dump_node_t* node, const dump_node_t* old_node)
+{
+    return (node -> yes == DUMP_NO_NODE) == (old_node -> yes == DUMP_NO_NODE) &&
+           (node -> no  == DUMP_NO_NODE) == (old_node -> no  == DUMP_NO_NODE);
+}
+
+
+static void mark_context(dump_snapshot_t* snapshot, size_t index)
+{
+    if (index != DUMP_NO_NODE && snapshot -> marks[index] == DUMP_MARK_HIDDEN)
+        snapshot -> marks[index] = DUMP_MARK_CONTEXT;
+}
+
+
+// Узлы сопоставляются по пути от корня, а не по адресу: tree_compact переносит все узлы,
+// а память узлов, освобождённых после отмены, malloc отдаёт новым. После tree_split_node
+// узел на том же пути меняет вопрос, а по путям его детей появляются два новых узла.
+// Оба снимка обходятся один раз вместе, без сортировки и поиска
+tree_error_type compute_dump_diff(dump_snapshot_t* current, const dump_snapshot_t* previous)
+{
+    assert(current  != NULL);
+    assert(previous != NULL);
+
+    diff_pair_t* stack = (diff_pair_t*)calloc(current -> count + 1, sizeof(diff_pair_t));
+    current -> previous_index = (size_t*)calloc(current -> count + 1, sizeof(size_t));
+    current -> previous_seen  = (unsigned char*)calloc(previous -> count + 1, sizeof(unsigned char));
+    current -> marks          = (unsigned char*)calloc(current -> count + 1, sizeof(unsigned char));
+
+    if (stack == NULL || current -> previous_index == NULL || current -> previous_seen == NULL || current -> marks == NULL)
+    {
+        free(stack);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    current -> previous = previous;
+
+    // каждый узел текущего снимка кладётся в стек один раз
+    size_t stack_size = 0;
+    size_t number_of_matched = 0;
+    if (current -> count > 0)
+        stack[stack_size++] = {0, (previous -> count > 0) ? 0 : DUMP_NO_NODE};
+
+    while (stack_size > 0)
+    {
+        diff_pair_t pair = stack[--stack_size];
+        const dump_node_t* node = &current -> nodes[pair.current];
+
+        current -> previous_index[pair.current] = pair.previous;
+
+        if (pair.previous == DUMP_NO_NODE)
+        {
+            current -> marks[pair.current] = DUMP_MARK_ADDED;
+            current -> number_of_added++;
+        }
+        else
+        {
+            const dump_node_t* old_node = &previous -> nodes[pair.previous];
+            current -> previous_seen[pair.previous] = 1;
+            number_of_matched++;
+
+            if (strcmp(node -> question, old_node -> question) != 0 || !has_same_children(node, old_node))
+            {
+                current -> marks[pair.current] = DUMP_MARK_CHANGED;
+                current -> number_of_changed++;
+            }
+        }
+
+        if (node -> no  != DUMP_NO_NODE) stack[stack_size++] = {node -> no,  snapshot_child(previous, pair.previous, false)};
+        if (node -> yes != DUMP_NO_NODE) stack[stack_size++] = {node -> yes, snapshot_child(previous, pair.previous, true)};
+    }
+
+    current -> number_of_removed = previous -> count - number_of_matched;
+
+    // вокруг каждого изменения показываем родителя и детей
+    for (size_t i = 0; i < current -> count; i++)
+    {
+        if (current -> marks[i] == DUMP_MARK_ADDED || current -> marks[i] == DUMP_MARK_CHANGED)
+        {
+            mark_context(current, current -> nodes[i].parent);
+            mark_context(current, current -> nodes[i].yes);
+            mark_context(current, current -> nodes[i].no);
+        }
+    }
+
+    free(stack);
+    return TREE_NO_ERROR;
+}
+
+
+void write_dump_changes_table(FILE* htm_file, const dump_snapshot_t* snapshot)
+{
+    assert(htm_file != NULL);
+    assert(snapshot != NULL);
+    assert(snapshot -> previous != NULL);
+
+    fprintf(htm_file, "<table border='1' style='border-collapse:collapse; width:100%%; margin-top:15px;'>\n");
+    fprintf(htm_file, "<tr><th>Change</th><th>Address</th><th>Question</th><th>Previous question</th><th>Parent</th></tr>\n");
+
+    for (size_t i = 0; i < snapshot -> count; i++)
+    {
+        const dump_node_t* node = &snapshot -> nodes[i];
+
+        if (snapshot -> marks[i] == DUMP_MARK_ADDED)
+        {
+            fprintf(htm_file, "<tr><td>added</td><td>%p</td><td>", (const void*)node -> address);
+            write_html_text(htm_file, node -> question);
+            fprintf(htm_file, "</td><td></td><td>%p</td></tr>\n", (const void*)snapshot_address(snapshot, node -> parent));
+        }
+        else if (snapshot -> marks[i] == DUMP_MARK_CHANGED)
+        {
+            fprintf(htm_file, "<tr><td>changed</td><td>%p</td><td>", (const void*)node -> address);
+            write_html_text(htm_file, node -> question);
+            fprintf(htm_file, "</td><td>");
+            write_html_text(htm_file, snapshot -> previous -> nodes[snapshot -> previous_index[i]].question);
+            fprintf(htm_file, "</td><td>%p</td></tr>\n", (const void*)snapshot_address(snapshot, node -> parent));
+        }
+    }
+
+    for (size_t i = 0; i < snapshot -> previous -> count; i++)
+    {
+        if (!snapshot -> previous_seen[i])
+        {
+            fprintf(htm_file, "<tr><td>removed</td><td>%p</td><td></td><td>", (const void*)snapshot -> previous -> nodes[i].address);
+            write_html_text(htm_file, snapshot -> previous -> nodes[i].question);
+            fprintf(htm_file, "</td><td></td></tr>\n");
+        }
+    }
+
+    fprintf(htm_file, "</table>\n");
+}
+
+
+static bool has_dump_changes(const dump_snapshot_t* snapshot)
+{
+    return snapshot -> number_of_added + snapshot -> number_of_changed + snapshot -> number_of_removed > 0;
+}
+
+
+tree_error_type tree_diff_dump_to_htm(const dump_snapshot_t* snapshot, FILE* htm_file)
+{
+    assert(snapshot != NULL);
+    assert(htm_file != NULL);
+
+    write_dump_header(htm_file, snapshot -> time);
+    write_information_about_tree(htm_file, snapshot);
+
+    fprintf(htm_file, "<p><b>Changes since previous dump:</b> %zu added, %zu changed, %zu removed</p>\n",
+                      snapshot -> number_of_added, snapshot -> number_of_changed, snapshot -> number_of_removed);
+
+    if (has_dump_changes(snapshot))
+    {
+        write_graph_visualization_tree(htm_file, snapshot);
+        write_dump_changes_table(htm_file, snapshot);
+    }
+
+    fprintf(htm_file, "</div>\n\n");
+
+    return TREE_NO_ERROR;
+}
+
+// ============================LOG===========================================
+
+tree_error_type tree_dump(tree_t* tree, const char* filename)
+{
+    dump_options_t options = {};
+    dump_options_init(&options);
+
+    return tree_dump_with_options(tree, filename, &options);
+}
+
+
+tree_error_type tree_dump_with_options(tree_t* tree, const char* filename, const dump_options_t* options)
+{
+    assert(tree     != NULL);
+    assert(options  != NULL);
+    assert(filename != NULL);
+
+    TRACE_SPAN("dump snapshot");
+
+    uint64_t start = metrics_now_ns();
+
+    // здесь только снимаем копию дерева, файлы и graphviz - забота рабочего потока
+    dump_snapshot_t* snapshot = NULL;
+    tree_error_type result = dump_snapshot_create(tree, options, &snapshot);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    result = make_folder_name(filename, snapshot -> folder_name, sizeof(snapshot -> folder_name));
+    if (result != TREE_NO_ERROR)
+    {
+        dump_snapshot_destroy(snapshot);
+        return result;
+    }
+
+    snprintf(snapshot -> htm_filename, sizeof(snapshot -> htm_filename), "%s.htm", filename);
+    snapshot -> mode = options -> mode;
+
+    dump_worker_submit(snapshot);
+
+    metrics_observe(METRIC_DUMP_SECONDS, metrics_now_ns() - start);
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type initialization_of_tree_log(const char* filename)
+{
+    assert(filename != NULL);
+
+    char htm_filename[MAX_LENGTH_OF_FILENAME] = {};
+    snprintf(htm_filename, sizeof(htm_filename), "%s.htm", filename);
+
+    FILE* htm_file = fopen(htm_filename, "w");
+    if (htm_file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    fprintf(htm_file, "<!DOCTYPE html>\n"
+                      "<html>\n"
+                      "<head>\n"
+                      "<title>Tree Dump Log</title>\n"
+                      "<style>\n"
+                      "body { font-family: Arial, sans-serif; margin: 20px; }\n"
+                      "table { border-collapse: collapse; width: 100%%; }\n"
+                      "th, td { border: 1px solid #ddd; padding: 8px; text-align: left; }\n"
+                      "th { background-color: #f2f2f2; }\n"
+                      "</style>\n"
+                      "</head>\n"
+                      "<body>\n"
+                      "<h1>Tree Dump Log</h1>\n");
+    fclose(htm_file);
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type close_tree_log(const char* filename)
+{
+    assert(filename != NULL);
+
+    dump_worker_flush(); // закрывающие теги должны оказаться после всех дампов
+
+    char htm_filename[MAX_LENGTH_OF_FILENAME] = {};
+    snprintf(htm_filename, sizeof(htm_filename), "%s.htm", filename);
+
+    FILE* htm_file = fopen(htm_filename, "a");
+    if (htm_file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    fprintf(htm_file, "</body>\n");
+    fprintf(htm_file, "</html>\n");
+    fclose(htm_file);
+
+    return TREE_NO_ERROR;
+}
+
+// ============================WORKER===========================================
+
+static dump_log_state_t* find_dump_log_state(const char* htm_filename, dump_snapshot_t** evicted)
+{
+    for (size_t i = 0; i < MAX_NUMBER_OF_DUMP_LOGS; i++)
+    {
+        if (strcmp(dump_worker.logs[i].htm_filename, htm_filename) == 0)
+            return &dump_worker.logs[i];
+    }
+
+    // логов больше, чем слотов, - вытесняем по кругу, этот лог начнётся с полного дампа
+    dump_log_state_t* log_state = &dump_worker.logs[dump_worker.next_log_slot];
+    dump_worker.next_log_slot = (dump_worker.next_log_slot + 1) % MAX_NUMBER_OF_DUMP_LOGS;
+
+    *evicted = log_state -> previous;
+    log_state -> previous = NULL;
+    log_state -> dumps_since_full = 0;
+    snprintf(log_state -> htm_filename, sizeof(log_state -> htm_filename), "%s", htm_filename);
+
+    return log_state;
+}
+
+
+// Сравнивает снимок с предыдущим снимком того же лога и делает его новой базой.
+// Вытесненные снимки ещё нужны при записи HTML, освобождаются они в конце пачки
+static void prepare_dump(dump_snapshot_t* snapshot, dump_snapshot_t** superseded, size_t* number_of_superseded)
+{
+    dump_snapshot_t* evicted = NULL;
+    dump_log_state_t* log_state = find_dump_log_state(snapshot -> htm_filename, &evicted);
+
+    if (evicted != NULL)
+        superseded[(*number_of_superseded)++] = evicted;
+
+    snapshot -> is_incremental = snapshot -> mode == DUMP_MODE_INCREMENTAL && !snapshot -> is_partial &&
+                                 log_state -> previous != NULL && !log_state -> previous -> is_partial &&
+                                 log_state -> dumps_since_full + 1 < DUMP_FULL_PERIOD;
+
+    if (snapshot -> is_incremental && compute_dump_diff(snapshot, log_state -> previous) != TREE_NO_ERROR)
+    {
+        snapshot -> is_incremental = false; // не хватило памяти на сравнение - пишем полный дамп
+        free(snapshot -> marks);
+        snapshot -> marks = NULL;
+    }
+
+    log_state -> dumps_since_full = snapshot -> is_incremental ? log_state -> dumps_since_full + 1 : 0;
+
+    if (log_state -> previous != NULL)
+        superseded[(*number_of_superseded)++] = log_state -> previous;
+    log_state -> previous = snapshot;
+}
+
+
+static bool needs_picture(const dump_snapshot_t* snapshot)
+{
+    return !snapshot -> is_incremental || has_dump_changes(snapshot);
+}
+
+
+static void write_dump_batch(dump_snapshot_t** batch, size_t count)
+{
+    dump_snapshot_t* pictures[MAX_GRAPHVIZ_BATCH] = {};
+    size_t number_of_pictures = 0;
+
+    dump_snapshot_t* superseded[2 * MAX_GRAPHVIZ_BATCH] = {};
+    size_t number_of_superseded = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        prepare_dump(batch[i], superseded, &number_of_superseded);
+
+        // папка нужна и картинкам, и страницам таблицы
+        if (strcmp(dump_worker.last_folder, batch[i] -> folder_name) != 0)
+        {
+            make_directory(batch[i] -> folder_name);
+            snprintf(dump_worker.last_folder, sizeof(dump_worker.last_folder), "%s", batch[i] -> folder_name);
+        }
+
+        if (!needs_picture(batch[i]))
+            continue;
+
+        create_dot_file_tree(batch[i]);
+        pictures[number_of_pictures++] = batch[i];
+    }
+
+    if (execute_graphviz_batch(pictures, number_of_pictures) != TREE_NO_ERROR)
+        fprintf(stderr, "Warning: graphviz failed, tree pictures are missing\n");
+
+    FILE* htm_file = NULL;
+    const char* open_htm = NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (needs_picture(batch[i]))
+            remove(batch[i] -> dot_filename);
+
+        // лог открываем один раз на подряд идущие дампы одного файла
+        if (open_htm == NULL || strcmp(open_htm, batch[i] -> htm_filename) != 0)
+        {
+            if (htm_file != NULL)
+                fclose(htm_file);
+
+            htm_file = fopen(batch[i] -> htm_filename, "a");
+            open_htm = batch[i] -> htm_filename;
+            if (htm_file != NULL)
+                setvbuf(htm_file, NULL, _IOFBF, DUMP_FILE_BUFFER_SIZE);
+        }
+
+        if (htm_file != NULL)
+        {
+            if (batch[i] -> is_incremental)
+                tree_diff_dump_to_htm(batch[i], htm_file);
+            else
+                tree_dump_to_htm(batch[i], htm_file);
+        }
+    }
+
+    if (htm_file != NULL)
+        fclose(htm_file);
+
+    // последние снимки остаются базой, ссылки на вытесненные им больше не нужны
+    for (size_t i = 0; i < count; i++)
+        batch[i] -> previous = NULL;
+
+    for (size_t i = 0; i < number_of_superseded; i++)
+        dump_snapshot_destroy(superseded[i]);
+}
+
+
+static void dump_worker_loop()
+{
+    TRACE_THREAD_NAME("dump worker");
+
+    std::unique_lock<std::mutex> lock(dump_worker.mutex);
+
+    while (true)
+    {
+        dump_worker.has_work.wait(lock, [] { return !dump_worker.running || dump_worker.head != NULL; });
+
+        if (dump_worker.head == NULL)
+            break; // остановка, очередь пуста
+
+        // забираем всё, что накопилось, и отдаём graphviz одной пачкой
+        dump_snapshot_t* batch[MAX_GRAPHVIZ_BATCH] = {};
+        size_t count = 0;
+
+        while (dump_worker.head != NULL && count < MAX_GRAPHVIZ_BATCH)
+        {
+            batch[count++] = dump_worker.head;
+            dump_worker.head = dump_worker.head -> next;
+        }
+        if (dump_worker.head == NULL)
+            dump_worker.tail = NULL;
+
+        dump_worker.busy = true;
+        lock.unlock();
+
+        write_dump_batch(batch, count); // снимки забирает состояние логов
+
+        lock.lock();
+        dump_worker.busy = false;
+
+        if (dump_worker.head == NULL)
+            dump_worker.is_idle.notify_all();
+    }
+
+    dump_worker.is_idle.notify_all();
+}
+
+
+void dump_worker_submit(dump_snapshot_t* snapshot)
+{
+    assert(snapshot != NULL);
+
+    {
+        std::lock_guard<std::mutex> guard(dump_worker.mutex);
+
+        if (!dump_worker.running)
+        {
+            dump_worker.running = true;
+            dump_worker.worker  = std::thread(dump_worker_loop);
+            atexit(dump_worker_stop); // поток нужно дождаться до разрушения статических объектов
+        }
+
+        snapshot -> picture_number = dump_worker.number_of_pictures++;
+        snprintf(snapshot -> dot_filename, sizeof(snapshot -> dot_filename), "%s/tree_temp_%d%lld.dot",
+                 snapshot -> folder_name, snapshot -> picture_number, (long long)snapshot -> time);
+        snprintf(snapshot -> svg_filename, sizeof(snapshot -> svg_filename), "%s.svg", snapshot -> dot_filename);
+
+        snapshot -> next = NULL;
+        if (dump_worker.tail != NULL)
+            dump_worker.tail -> next = snapshot;
+        else
+            dump_worker.head = snapshot;
+        dump_worker.tail = snapshot;
+    }
+
+    dump_worker.has_work.notify_one();
+}
+
+
+void dump_worker_flush()
+{
+    std::unique_lock<std::mutex> lock(dump_worker.mutex);
+
+    dump_worker.is_idle.wait(lock, [] { return !dump_worker.running || (dump_worker.head == NULL && !dump_worker.busy); });
+}
+
+
+void dump_worker_stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(dump_worker.mutex);
+        if (!dump_worker.running)
+            return;
+
+        dump_worker.running = false; // недописанные дампы рабочий поток ещё успеет сохранить
+    }
+
+    dump_worker.has_work.notify_all();
+    dump_worker.worker.join();
+
+    for (size_t i = 0; i < MAX_NUMBER_OF_DUMP_LOGS; i++)
+    {
+        dump_snapshot_destroy(dump_worker.logs[i].previous);
+        dump_worker.logs[i] = {};
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef TREE_DUMP_H_
+#define TREE_DUMP_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "tree.h"
+#include "tree_memory.h"
+#include "tree_error_type.h"
+
+#define DUMP_NO_NODE ((size_t)-1)
+#define DUMP_FILE_BUFFER_SIZE (64 * 1024)
+#define MAX_GRAPHVIZ_BATCH 32
+#define DUMP_FULL_PERIOD 8 // в инкрементальном режиме каждый N-й дамп всё равно полный
+#define MAX_NUMBER_OF_DUMP_LOGS 16
+#define DUMP_UNLIMITED -1
+#define DUMP_DEFAULT_TABLE_PAGE_SIZE 500
+#define DUMP_COLLAPSED_COUNT_LIMIT 10000 // дальше в сводном узле пишем "N+"
+
+enum dump_mode
+{
+    DUMP_MODE_FULL        = 0, // всё дерево: таблица и картинка целиком
+    DUMP_MODE_INCREMENTAL = 1, // только изменения с прошлого дампа этого же лога
+};
+
+enum dump_node_mark
+{
+    DUMP_MARK_HIDDEN  = 0,
+    DUMP_MARK_CONTEXT = 1, // соседи изменённых узлов, рисуются для ориентира
+    DUMP_MARK_CHANGED = 2,
+    DUMP_MARK_ADDED   = 3,
+};
+
+// Для больших деревьев: рисуем только окрестность фокуса и/или верх дерева до max_depth,
+// отрезанные поддеревья заменяются сводными узлами. Частичные дампы всегда полные, не разностные
+struct dump_options_t
+{
+    dump_mode mode;
+    const node_t* focus_node; // центр окрестности
+    const char* focus_object; // или объект, лист ищется по фразе; без фокуса - корень
+    int radius;               // в рёбрах от фокуса, DUMP_UNLIMITED - без ограничения
+    int max_depth;            // от верхнего показанного узла, DUMP_UNLIMITED - без ограничения
+    size_t table_page_size;   // строк таблицы на страницу, 0 - одна страница
+};
+
+// Копия одного узла в момент дампа: живое дерево после этого можно менять
+struct dump_node_t
+{
+    const node_t* address; // адрес в живом дереве, нужен только для подписей
+    const char* question;  // указывает в phrases снимка
+    size_t yes;
+    size_t no;
+    size_t parent;
+    int level;
+    size_t collapsed; // для сводного узла - сколько узлов он скрывает, иначе 0
+};
+
+// Снимок дерева, который рабочий поток превращает в DOT, SVG и раздел HTML-лога
+struct dump_snapshot_t
+{
+    dump_node_t* nodes; // в прямом порядке обхода, nodes[0] - корень
+    size_t count;
+    char* phrases;
+
+    size_t tree_size;
+    const node_t* root_address;
+    bool truncated;
+    tree_memory_report_t memory; // только у полных дампов: частичные делают для больших деревьев
+    bool has_memory_report;
+
+    bool is_partial;
+    const node_t* focus_address;
+    int radius;
+    int max_depth;
+    size_t number_of_collapsed;
+    size_t table_page_size;
+
+    dump_mode mode;
+    bool is_incremental; // решает рабочий поток: первый и каждый DUMP_FULL_PERIOD-й дамп полные
+
+    // заполняется при сравнении с предыдущим снимком того же лога
+    const dump_snapshot_t* previous;
+    size_t* previous_index;        // для каждого узла - индекс в previous или DUMP_NO_NODE
+    unsigned char* previous_seen;  // узлы previous, которые остались в дереве
+    unsigned char* marks;          // dump_node_mark, NULL - рисуем всё
+    size_t number_of_added;
+    size_t number_of_changed;
+    size_t number_of_removed;
+
+    time_t time;
+    int picture_number;
+    char htm_filename[MAX_LENGTH_OF_FILENAME];
+    char folder_name[MAX_LENGTH_OF_FILENAME];
+    char dot_filename[MAX_LENGTH_OF_FILENAME + MAX_LENGTH_OF_ADDRESS];
+    char svg_filename[MAX_LENGTH_OF_FILENAME + 2 * MAX_LENGTH_OF_ADDRESS];
+
+    dump_snapshot_t* next;
+};
+
+// Снимок и очередь
+tree_error_type tree_dump_with_options(tree_t* tree, const char* filename, const dump_options_t* options);
+void dump_options_init(dump_options_t* options);
+tree_error_type dump_snapshot_create(const tree_t* tree, const dump_options_t* options, dump_snapshot_t** snapshot);
+void dump_snapshot_destroy(dump_snapshot_t* snapshot);
+void dump_worker_submit(dump_snapshot_t* snapshot);
+void dump_worker_flush();
+void dump_worker_stop();
+
+// Запись результатов (выполняется в рабочем потоке)
+void write_dump_header(FILE* htm_file, time_t now);
+void write_information_about_tree(FILE* htm_file, const dump_snapshot_t* snapshot);
+tree_error_type execute_graphviz_batch(dump_snapshot_t* const* snapshots, size_t count);
+tree_error_type make_folder_name(const char* base_name, char* folder_name, size_t folder_name_size);
+tree_error_type make_directory(const char* folder_name);
+void format_node_part(char* part_buffer, size_t buffer_size, const char* label, const node_t* child_node);
+void write_tree_nodes_table(FILE* htm_file, const dump_snapshot_t* snapshot);
+tree_error_type create_tree_dot_header(FILE* dot_file);
+tree_error_type create_dot_file_tree(const dump_snapshot_t* snapshot);
+void write_graph_visualization_tree(FILE* htm_file, const dump_snapshot_t* snapshot);
+tree_error_type tree_dump_to_htm(const dump_snapshot_t* snapshot, FILE* htm_file);
+
+// Инкрементальный дамп
+tree_error_type compute_dump_diff(dump_snapshot_t* current, const dump_snapshot_t* previous);
+void write_dump_changes_table(FILE* htm_file, const dump_snapshot_t* snapshot);
+tree_error_type tree_diff_dump_to_htm(const dump_snapshot_t* snapshot, FILE* htm_file);
+
+#endif // TREE_DUMP_H_
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tree.h"
+#include "tree_parser.h"
+#include "tree_error_type.h"
+
+// Сборка встроенной базы по умолчанию:
+//     ./tree_embed akinator_seed.txt tree_embedded_data.h
+// База разбирается и записывается constexpr-таблицей узлов в прямом порядке обхода,
+// фразы - одним массивом через '\0'. Таблицу подключает tree_embedded.cpp
+
+#define EMBED_NO_NODE ((size_t)-1)
+
+struct embed_step_t
+{
+    const node_t* node;
+    size_t parent;
+    bool is_yes;
+};
+
+struct embed_table_t
+{
+    const node_t** order;
+    size_t* yes;
+    size_t* no;
+    size_t* parent;
+    size_t count;
+};
+
+
+static char* read_seed(const char* filename, size_t* size)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+
+    size_t capacity = BUFSIZ;
+    char* text = (char*)malloc(capacity);
+    *size = 0;
+
+    size_t bytes_read = 0;
+    while (text != NULL && (bytes_read = fread(text + *size, 1, capacity - *size, file)) > 0)
+    {
+        *size += bytes_read;
+        if (*size == capacity)
+        {
+            char* new_text = (char*)realloc(text, 2 * capacity);
+            if (new_text == NULL)
+                free(text);
+
+            text = new_text;
+            capacity *= 2;
+        }
+    }
+
+    fclose(file);
+    return text;
+}
+
+
+// Номера узлов - в прямом порядке обхода, ответы и родитель - по номерам
+static bool build_table(const node_t* root, size_t number_of_nodes, embed_table_t* table)
+{
+    table -> order  = (const node_t**)calloc(number_of_nodes, sizeof(const node_t*));
+    table -> yes    = (size_t*)calloc(number_of_nodes, sizeof(size_t));
+    table -> no     = (size_t*)calloc(number_of_nodes, sizeof(size_t));
+    table -> parent = (size_t*)calloc(number_of_nodes, sizeof(size_t));
+    embed_step_t* stack = (embed_step_t*)calloc(number_of_nodes + 1, sizeof(embed_step_t));
+
+    if (table -> order == NULL || table -> yes == NULL || table -> no == NULL || table -> parent == NULL || stack == NULL)
+    {
+        free(stack);
+        return false;
+    }
+
+    size_t stack_size = 0;
+    stack[stack_size++] = {root, EMBED_NO_NODE, false};
+
+    while (stack_size > 0)
+    {
+        embed_step_t step = stack[--stack_size];
+        size_t index = table -> count++;
+
+        table -> order[index]  = step.node;
+        table -> parent[index] = step.parent;
+        table -> yes[index]    = EMBED_NO_NODE;
+        table -> no[index]     = EMBED_NO_NODE;
+
+        if (step.parent != EMBED_NO_NODE)
+        {
+            if (step.is_yes)
+                table -> yes[step.parent] = index;
+            else
+                table -> no[step.parent] = index;
+        }
+
+        if (step.node -> no  != NULL) stack[stack_size++] = {step.node -> no,  index, false};
+        if (step.node -> yes != NULL) stack[stack_size++] = {step.node -> yes, index, true};
+    }
+
+    free(stack);
+    return true;
+}
+
+
+static void destroy_table(embed_table_t* table)
+{
+    free(table -> order);
+    free(table -> yes);
+    free(table -> no);
+    free(table -> parent);
+}
+
+
+// Печатное ASCII как есть, остальное восьмеричными escape из трёх цифр:
+// они не продолжаются следующей цифрой, в отличие от \x. '?' экранируется из-за триграфов
+static void write_phrase_literal(FILE* file, const char* phrase)
+{
+    fputs("    \"", file);
+
+    for (const unsigned char* symbol = (const unsigned char*)phrase; *symbol != '\0'; symbol++)
+    {
+        if (*symbol == '"' || *symbol == '\\' || *symbol == '?')
+            fprintf(file, "\\%c", *symbol);
+        else if (*symbol >= ' ' && *symbol < 0x7F)
+            fputc(*symbol, file);
+        else
+            fprintf(file, "\\%03o", *symbol);
+    }
+
+    fputs("\\0\"\n", file);
+}
+
+
+static void write_node_reference(FILE* file, size_t index)
+{
+    if (index == EMBED_NO_NODE)
+        fputs("NULL", file);
+    else
+        fprintf(file, "EMBEDDED_NODE(%zu)", index);
+}
+
+
+static void write_table(FILE* file, const char* seed_name, const embed_table_t* table)
+{
+    fprintf(file, "// Встроенная база по умолчанию из %s. Сгенерировано tree_embed (make embedded-tree), руками не править\n", seed_name);
+    fputs("#ifndef TREE_EMBEDDED_DATA_H_\n"
+          "#define TREE_EMBEDDED_DATA_H_\n"
+          "\n"
+          "#include \"tree.h\"\n"
+          "\n", file);
+    fprintf(file, "#define EMBEDDED_TREE_NUMBER_OF_NODES %zu\n\n", table -> count);
+    fputs("#define EMBEDDED_PHRASE(offset) const_cast<char*>(embedded_tree_phrases + (offset))\n"
+          "#define EMBEDDED_NODE(index)    const_cast<node_t*>(&embedded_tree_nodes[index])\n"
+          "\n"
+          "static constexpr char embedded_tree_phrases[] =\n", file);
+
+    for (size_t i = 0; i < table -> count; i++)
+        write_phrase_literal(file, table -> order[i] -> question);
+
+    fputs(";\n\nstatic constexpr node_t embedded_tree_nodes[EMBEDDED_TREE_NUMBER_OF_NODES] =\n{\n", file);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < table -> count; i++)
+    {
+        fprintf(file, "    {EMBEDDED_PHRASE(%zu), ", offset);
+        write_node_reference(file, table -> yes[i]);
+        fputs(", ", file);
+        write_node_reference(file, table -> no[i]);
+        fputs(", ", file);
+        write_node_reference(file, table -> parent[i]);
+        fputs("},\n", file);
+
+        offset += strlen(table -> order[i] -> question) + 1;
+    }
+
+    fputs("};\n"
+          "\n"
+          "#undef EMBEDDED_PHRASE\n"
+          "#undef EMBEDDED_NODE\n"
+          "\n"
+          "#endif // TREE_EMBEDDED_DATA_H_\n", file);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s seed_database.txt tree_embedded_data.h\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = 0;
+    char* text = read_seed(argv[1], &size);
+    if (text == NULL)
+    {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    node_t* root = NULL;
+    size_t number_of_nodes = 0;
+    tree_parse_error_t error = {};
+
+    tree_error_type result = tree_parse(text, size, &root, &number_of_nodes, &error);
+    free(text);
+
+    if (result != TREE_NO_ERROR)
+    {
+        tree_parse_error_print(&error, argv[1], stderr);
+        return 1;
+    }
+
+    embed_table_t table = {};
+    bool ok = build_table(root, number_of_nodes, &table);
+
+    FILE* file = ok ? fopen(argv[2], "w") : NULL;
+    if (file != NULL)
+    {
+        write_table(file, argv[1], &table);
+        ok = (fclose(file) == 0);
+    }
+    else
+        ok = false;
+
+    if (ok)
+        printf("%s: %zu nodes embedded into %s\n", argv[1], table.count, argv[2]);
+    else
+        fprintf(stderr, "Cannot write %s\n", argv[2]);
+
+    destroy_table(&table);
+    tree_parse_destroy(root);
+
+    return ok ? 0 : 1;
+}
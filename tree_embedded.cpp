@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_compact.h"
+#include "tree_embedded.h"
+#include "tree_embedded_data.h"
+#include "tree_error_type.h"
+
+// Арена без владельца: tree_arena_destroy её не трогает, а is_node_in_arena и
+// is_phrase_in_arena узнают встроенные узлы и фразы, так что их никто не освободит
+static const tree_arena_t EMBEDDED_ARENA =
+{
+    const_cast<node_t*>(embedded_tree_nodes), EMBEDDED_TREE_NUMBER_OF_NODES,
+    const_cast<char*>(embedded_tree_phrases), sizeof(embedded_tree_phrases),
+    NULL, true
+};
+
+
+tree_error_type tree_embedded_attach(tree_t* tree)
+{
+    if (tree == NULL)
+        return TREE_ERROR_NULL_PTR;
+
+    tree_destructor(tree);
+
+    tree -> arena = const_cast<tree_arena_t*>(&EMBEDDED_ARENA);
+    tree -> root  = const_cast<node_t*>(&embedded_tree_nodes[0]);
+    tree -> size  = EMBEDDED_TREE_NUMBER_OF_NODES;
+
+    return TREE_NO_ERROR;
+}
+
+
+bool tree_is_embedded(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    return tree -> arena != NULL && tree -> arena -> is_embedded;
+}
+
+
+size_t tree_embedded_size()
+{
+    return EMBEDDED_TREE_NUMBER_OF_NODES;
+}
+
+
+static node_t* relocate_node(const tree_arena_t* arena, node_t* node)
+{
+    if (node == NULL)
+        return NULL;
+
+    return arena -> nodes + (node - embedded_tree_nodes);
+}
+
+
+// Таблица копируется как есть, связи переводятся по индексам. Фоновое сохранение ждать
+// не нужно: оно дочитывает неизменную таблицу, а меняться будет уже копия.
+// node - узел, который вызывающий собирается менять, после копии указывает на его двойника
+tree_error_type tree_embedded_unshare(tree_t* tree, node_t** node)
+{
+    assert(tree != NULL);
+
+    if (!tree_is_embedded(tree))
+        return TREE_NO_ERROR;
+
+    assert(tree -> size == EMBEDDED_TREE_NUMBER_OF_NODES);
+
+    tree_arena_t* arena = (tree_arena_t*)calloc(1, sizeof(tree_arena_t));
+    if (arena == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    arena -> nodes   = (node_t*)calloc(EMBEDDED_TREE_NUMBER_OF_NODES, sizeof(node_t));
+    arena -> phrases = (char*)malloc(sizeof(embedded_tree_phrases));
+    if (arena -> nodes == NULL || arena -> phrases == NULL)
+    {
+        tree_arena_destroy(arena);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    arena -> number_of_nodes = EMBEDDED_TREE_NUMBER_OF_NODES;
+    arena -> phrases_size    = sizeof(embedded_tree_phrases);
+    memcpy(arena -> phrases, embedded_tree_phrases, sizeof(embedded_tree_phrases));
+
+    for (size_t i = 0; i < EMBEDDED_TREE_NUMBER_OF_NODES; i++)
+    {
+        const node_t* original = &embedded_tree_nodes[i];
+        node_t* copy = &arena -> nodes[i];
+
+        copy -> question = arena -> phrases + (original -> question - embedded_tree_phrases);
+        copy -> yes      = relocate_node(arena, original -> yes);
+        copy -> no       = relocate_node(arena, original -> no);
+        copy -> parent   = relocate_node(arena, original -> parent);
+    }
+
+    tree -> root  = relocate_node(arena, tree -> root);
+    tree -> arena = arena;
+
+    if (node != NULL)
+        *node = relocate_node(arena, *node);
+
+    return TREE_NO_ERROR;
+}
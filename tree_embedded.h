@@ -0,0 +1,20 @@
+#ifndef TREE_EMBEDDED_H_
+#define TREE_EMBEDDED_H_
+
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+// База по умолчанию, собранная в программу (tree_embedded_data.h из akinator_seed.txt,
+// пересобирается make embedded-tree). Без файла базы дерево просто указывает на эту
+// таблицу: ни разбора, ни выделения памяти, ни записи на диск при первом запуске.
+// Таблица только для чтения, поэтому перед первым изменением дерево целиком копируется
+// в обычную арену в куче (tree_embedded_unshare): узлы связаны ссылками на родителя,
+// и копия одного узла всё равно потянула бы за собой весь путь до корня
+tree_error_type tree_embedded_attach(tree_t* tree);
+tree_error_type tree_embedded_unshare(tree_t* tree, node_t** node);
+bool tree_is_embedded(const tree_t* tree);
+size_t tree_embedded_size();
+
+#endif // TREE_EMBEDDED_H_
@@ -0,0 +1,44 @@
+// Встроенная база по умолчанию из akinator_seed.txt. Сгенерировано tree_embed (make embedded-tree), руками не править
+#ifndef TREE_EMBEDDED_DATA_H_
+#define TREE_EMBEDDED_DATA_H_
+
+#include "tree.h"
+
+#define EMBEDDED_TREE_NUMBER_OF_NODES 11
+
+#define EMBEDDED_PHRASE(offset) const_cast<char*>(embedded_tree_phrases + (offset))
+#define EMBEDDED_NODE(index)    const_cast<node_t*>(&embedded_tree_nodes[index])
+
+static constexpr char embedded_tree_phrases[] =
+    "has tail\0"
+    "barks\0"
+    "dog\0"
+    "live in Thailand\0"
+    "snake\0"
+    "cat\0"
+    "can fly\0"
+    "bird\0"
+    "can swim\0"
+    "fish\0"
+    "nothing\0"
+;
+
+static constexpr node_t embedded_tree_nodes[EMBEDDED_TREE_NUMBER_OF_NODES] =
+{
+    {EMBEDDED_PHRASE(0), EMBEDDED_NODE(1), EMBEDDED_NODE(6), NULL},
+    {EMBEDDED_PHRASE(9), EMBEDDED_NODE(2), EMBEDDED_NODE(3), EMBEDDED_NODE(0)},
+    {EMBEDDED_PHRASE(15), NULL, NULL, EMBEDDED_NODE(1)},
+    {EMBEDDED_PHRASE(19), EMBEDDED_NODE(4), EMBEDDED_NODE(5), EMBEDDED_NODE(1)},
+    {EMBEDDED_PHRASE(36), NULL, NULL, EMBEDDED_NODE(3)},
+    {EMBEDDED_PHRASE(42), NULL, NULL, EMBEDDED_NODE(3)},
+    {EMBEDDED_PHRASE(46), EMBEDDED_NODE(7), EMBEDDED_NODE(8), EMBEDDED_NODE(0)},
+    {EMBEDDED_PHRASE(54), NULL, NULL, EMBEDDED_NODE(6)},
+    {EMBEDDED_PHRASE(59), EMBEDDED_NODE(9), EMBEDDED_NODE(10), EMBEDDED_NODE(6)},
+    {EMBEDDED_PHRASE(68), NULL, NULL, EMBEDDED_NODE(8)},
+    {EMBEDDED_PHRASE(73), NULL, NULL, EMBEDDED_NODE(8)},
+};
+
+#undef EMBEDDED_PHRASE
+#undef EMBEDDED_NODE
+
+#endif // TREE_EMBEDDED_DATA_H_
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_export.h"
+#include "tree_error_type.h"
+
+#define MAX_LENGTH_OF_NUMBER 24
+
+struct export_writer_t
+{
+    FILE* stream;
+    char* buffer;
+    size_t size;
+    size_t bytes_written;
+    bool failed;
+};
+
+// Узел на пути от корня к текущему и ветка, по которой из него спустились
+struct export_step_t
+{
+    const node_t* node;
+    size_t id;
+    bool answer;
+};
+
+struct export_path_t
+{
+    export_step_t* steps;
+    size_t count;
+    size_t capacity;
+};
+
+// ============================WRITER===========================================
+
+static void writer_flush(export_writer_t* writer)
+{
+    if (writer -> size != 0 && fwrite(writer -> buffer, sizeof(char), writer -> size, writer -> stream) != writer -> size)
+        writer -> failed = true;
+
+    writer -> bytes_written += writer -> size;
+    writer -> size = 0;
+}
+
+
+static void writer_put(export_writer_t* writer, const char* text, size_t length)
+{
+    if (writer -> size + length > EXPORT_BUFFER_SIZE)
+        writer_flush(writer);
+
+    if (length > EXPORT_BUFFER_SIZE) // в буфер не влезет - пишем мимо него
+    {
+        if (fwrite(text, sizeof(char), length, writer -> stream) != length)
+            writer -> failed = true;
+        writer -> bytes_written += length;
+        return;
+    }
+
+    memcpy(writer -> buffer + writer -> size, text, length);
+    writer -> size += length;
+}
+
+
+static void writer_put_literal(export_writer_t* writer, const char* text)
+{
+    writer_put(writer, text, strlen(text));
+}
+
+
+static void writer_put_number(export_writer_t* writer, size_t number)
+{
+    char digits[MAX_LENGTH_OF_NUMBER] = {};
+    size_t position = sizeof(digits);
+
+    do
+    {
+        digits[--position] = (char)('0' + number % 10);
+        number /= 10;
+    }
+    while (number != 0);
+
+    writer_put(writer, digits + position, sizeof(digits) - position);
+}
+
+
+// Длина правильной последовательности UTF-8 в начале text или 0, если она испорчена
+static size_t utf8_sequence_length(const unsigned char* text)
+{
+    unsigned char lead = text[0];
+    size_t length = 0;
+    unsigned char second_min = 0x80;
+    unsigned char second_max = 0xBF;
+
+    if      (lead <  0x80)                 return 1;
+    else if (lead >= 0xC2 && lead <= 0xDF) length = 2;
+    else if (lead == 0xE0)               { length = 3; second_min = 0xA0; } // без лишне длинных форм
+    else if (lead >= 0xE1 && lead <= 0xEC) length = 3;
+    else if (lead == 0xED)               { length = 3; second_max = 0x9F; } // без суррогатов
+    else if (lead >= 0xEE && lead <= 0xEF) length = 3;
+    else if (lead == 0xF0)               { length = 4; second_min = 0x90; }
+    else if (lead >= 0xF1 && lead <= 0xF3) length = 4;
+    else if (lead == 0xF4)               { length = 4; second_max = 0x8F; } // не дальше U+10FFFF
+    else                                   return 0;
+
+    if (text[1] < second_min || text[1] > second_max)
+        return 0;
+
+    for (size_t i = 2; i < length; i++) // завершающий ноль не продолжение, за строку не выйдем
+        if ((text[i] & 0xC0) != 0x80)
+            return 0;
+
+    return length;
+}
+
+
+// \u00XX для байта, который нельзя записать как есть
+static void writer_put_byte_escape(export_writer_t* writer, unsigned char symbol)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    writer_put(writer, "\\u00", 4);
+    writer_put(writer, &hex_digits[symbol >> 4],  1);
+    writer_put(writer, &hex_digits[symbol & 0xF], 1);
+}
+
+
+// Строка JSON. Фразы вводятся с консоли и могут быть не в UTF-8 (например, в cp1251):
+// такие байты пишем как \u00XX, чтобы запись осталась правильным JSON
+static void writer_put_string(export_writer_t* writer, const char* text)
+{
+    writer_put(writer, "\"", 1);
+
+    const unsigned char* run = (const unsigned char*)text; // кусок, который пишется как есть
+    const unsigned char* symbol = run;
+
+    while (*symbol != '\0')
+    {
+        size_t length = (*symbol >= 0x20 && *symbol != '"' && *symbol != '\\') ? utf8_sequence_length(symbol) : 0;
+        if (length != 0)
+        {
+            symbol += length;
+            continue;
+        }
+
+        writer_put(writer, (const char*)run, (size_t)(symbol - run));
+
+        switch (*symbol)
+        {
+            case '"':  writer_put(writer, "\\\"", 2); break;
+            case '\\': writer_put(writer, "\\\\", 2); break;
+            case '\n': writer_put(writer, "\\n",  2); break;
+            case '\r': writer_put(writer, "\\r",  2); break;
+            case '\t': writer_put(writer, "\\t",  2); break;
+            default:   writer_put_byte_escape(writer, *symbol); break;
+        }
+
+        run = ++symbol;
+    }
+
+    writer_put(writer, (const char*)run, (size_t)(symbol - run));
+    writer_put(writer, "\"", 1);
+}
+
+// ============================RECORDS==========================================
+
+static void write_node_record(export_writer_t* writer, const node_t* node, size_t id, const export_path_t* path)
+{
+    writer_put_literal(writer, "{\"type\":\"node\",\"id\":");
+    writer_put_number(writer, id);
+
+    if (path -> count == 0)
+    {
+        writer_put_literal(writer, ",\"parent\":null,\"branch\":null");
+    }
+    else
+    {
+        const export_step_t* parent = &path -> steps[path -> count - 1];
+
+        writer_put_literal(writer, ",\"parent\":");
+        writer_put_number(writer, parent -> id);
+        writer_put_literal(writer, parent -> answer ? ",\"branch\":\"yes\"" : ",\"branch\":\"no\"");
+    }
+
+    writer_put_literal(writer, ",\"text\":");
+    writer_put_string(writer, node -> question);
+    writer_put_literal(writer, (node -> yes == NULL && node -> no == NULL) ? ",\"leaf\":true}\n" : ",\"leaf\":false}\n");
+}
+
+
+static void write_path_record(export_writer_t* writer, const node_t* leaf, size_t id, const export_path_t* path)
+{
+    writer_put_literal(writer, "{\"type\":\"path\",\"leaf\":");
+    writer_put_number(writer, id);
+    writer_put_literal(writer, ",\"object\":");
+    writer_put_string(writer, leaf -> question);
+    writer_put_literal(writer, ",\"path\":[");
+
+    for (size_t i = 0; i < path -> count; i++)
+    {
+        writer_put_literal(writer, (i == 0) ? "[" : ",[");
+        writer_put_string(writer, path -> steps[i].node -> question);
+        writer_put_literal(writer, path -> steps[i].answer ? ",\"yes\"]" : ",\"no\"]");
+    }
+
+    writer_put_literal(writer, "]}\n");
+}
+
+
+static tree_error_type push_export_step(export_path_t* path, const node_t* node, size_t id, bool answer)
+{
+    if (path -> count == path -> capacity)
+    {
+        size_t new_capacity = (path -> capacity == 0) ? 64 : 2 * path -> capacity;
+
+        export_step_t* new_steps = (export_step_t*)realloc(path -> steps, new_capacity * sizeof(export_step_t));
+        if (new_steps == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        path -> steps    = new_steps;
+        path -> capacity = new_capacity;
+    }
+
+    path -> steps[path -> count++] = {node, id, answer};
+
+    return TREE_NO_ERROR;
+}
+
+// ============================EXPORT===========================================
+
+// Прямой обход без рекурсии: path хранит вопросы от корня до текущего узла,
+// после поддерева поднимаемся по нему до первого вопроса, у которого ещё не пройдена ветка "нет"
+tree_error_type tree_export_ndjson(const tree_t* tree, FILE* stream, bool with_paths, tree_export_report_t* report)
+{
+    assert(tree   != NULL);
+    assert(stream != NULL);
+    assert(report != NULL);
+
+    *report = {};
+
+    export_writer_t writer = {};
+    writer.stream = stream;
+    writer.buffer = (char*)calloc(EXPORT_BUFFER_SIZE, sizeof(char));
+    if (writer.buffer == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    export_path_t path = {};
+    tree_error_type result = TREE_NO_ERROR;
+
+    const node_t* node = tree -> root;
+    size_t next_id = 0;
+
+    while (node != NULL && result == TREE_NO_ERROR && !writer.failed)
+    {
+        size_t id = next_id++;
+        write_node_record(&writer, node, id, &path);
+
+        if (node -> yes != NULL || node -> no != NULL)
+        {
+            result = push_export_step(&path, node, id, node -> yes != NULL);
+            node = (node -> yes != NULL) ? node -> yes : node -> no;
+            continue;
+        }
+
+        if (with_paths)
+        {
+            write_path_record(&writer, node, id, &path);
+            report -> number_of_paths++;
+        }
+
+        node = NULL;
+        while (path.count > 0 && node == NULL)
+        {
+            export_step_t* step = &path.steps[path.count - 1];
+
+            if (step -> answer && step -> node -> no != NULL)
+            {
+                step -> answer = false;
+                node = step -> node -> no;
+            }
+            else
+            {
+                path.count--;
+            }
+        }
+    }
+
+    writer_flush(&writer);
+    if (fflush(stream) != 0)
+        writer.failed = true;
+
+    report -> number_of_nodes = next_id;
+    report -> bytes_written   = writer.bytes_written;
+
+    free(writer.buffer);
+    free(path.steps);
+
+    if (result == TREE_NO_ERROR && writer.failed)
+        result = TREE_ERROR_OPENING_FILE;
+
+    return result;
+}
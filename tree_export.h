@@ -0,0 +1,27 @@
+#ifndef TREE_EXPORT_H_
+#define TREE_EXPORT_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define EXPORT_BUFFER_SIZE (64 * 1024)
+
+// Записи NDJSON, по одной на строку, в прямом порядке обхода:
+//   {"type":"node","id":1,"parent":0,"branch":"yes","text":"dog","leaf":true}
+// с путями после каждого листа ещё
+//   {"type":"path","leaf":1,"object":"dog","path":[["has tail","yes"],["barks","yes"]]}
+// Номера - позиции в прямом обходе, у корня parent и branch - null.
+// Память не зависит от размера дерева: буфер вывода и путь от корня до текущего узла
+struct tree_export_report_t
+{
+    size_t number_of_nodes;
+    size_t number_of_paths;
+    size_t bytes_written;
+};
+
+tree_error_type tree_export_ndjson(const tree_t* tree, FILE* stream, bool with_paths, tree_export_report_t* report);
+
+#endif // TREE_EXPORT_H_
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_history.h"
+#include "tree_compact.h"
+#include "tree_snapshot.h"
+#include "tree_error_type.h"
+
+
+static tree_split_record_t* history_record(tree_history_t* history, size_t index)
+{
+    return &history -> records[(history -> first + index) % TREE_HISTORY_CAPACITY];
+}
+
+
+tree_error_type tree_history_create(tree_t* tree)
+{
+    assert(tree != NULL);
+
+    if (tree -> history != NULL)
+        return TREE_NO_ERROR;
+
+    tree -> history = (tree_history_t*)calloc(1, sizeof(tree_history_t));
+    if (tree -> history == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    return TREE_NO_ERROR;
+}
+
+
+void tree_history_destroy(tree_t* tree)
+{
+    assert(tree != NULL);
+
+    tree_history_clear(tree);
+
+    free(tree -> history);
+    tree -> history = NULL;
+}
+
+
+// Лист, отцепленный отменой: если разделение пережило уплотнение, лист лежит в арене вместе с фразой
+static void release_detached_leaf(tree_t* tree, node_t* leaf)
+{
+    if (is_node_in_arena(tree -> arena, leaf))
+        return;
+
+    if (!tree_snapshot_retire_subtree(tree, leaf))
+        tree_destroy_recursive(leaf);
+}
+
+
+// У действующей записи в журнале только старая фраза листа, у отменённой - признак и отцепленные
+// дети. Фразы и листы могут лежать в арене, тогда их освободит она.
+// Пока идёт фоновое сохранение, всё это может быть в его снимке - тогда освобождает он
+static void release_record(tree_t* tree, tree_split_record_t* record, bool is_applied)
+{
+    if (!is_phrase_in_arena(tree -> arena, record -> other_question) &&
+        !tree_snapshot_retire_phrase(tree, record -> other_question))
+        free(record -> other_question);
+
+    if (!is_applied)
+    {
+        release_detached_leaf(tree, record -> yes);
+        release_detached_leaf(tree, record -> no);
+    }
+
+    *record = {};
+}
+
+
+// Вызывать, пока арена, в которой могут лежать фразы журнала, ещё жива
+void tree_history_clear(tree_t* tree)
+{
+    assert(tree != NULL);
+
+    tree_history_t* history = tree -> history;
+    if (history == NULL)
+        return;
+
+    for (size_t i = 0; i < history -> number_of_records; i++)
+        release_record(tree, history_record(history, i), i < history -> number_of_applied);
+
+    history -> first = 0;
+    history -> number_of_records = 0;
+    history -> number_of_applied = 0;
+}
+
+
+// Журнал забирает старую фразу листа: при отмене она вернётся на место без копирования
+void tree_history_record_split(tree_t* tree, node_t* node, char* old_question)
+{
+    assert(tree         != NULL);
+    assert(node         != NULL);
+    assert(old_question != NULL);
+
+    tree_history_t* history = tree -> history;
+    assert(history != NULL);
+
+    while (history -> number_of_records > history -> number_of_applied)
+    {
+        history -> number_of_records--;
+        release_record(tree, history_record(history, history -> number_of_records), false);
+    }
+
+    if (history -> number_of_records == TREE_HISTORY_CAPACITY)
+    {
+        release_record(tree, history_record(history, 0), true);
+
+        history -> first = (history -> first + 1) % TREE_HISTORY_CAPACITY;
+        history -> number_of_records--;
+        history -> number_of_applied--;
+    }
+
+    *history_record(history, history -> number_of_records) = {node, old_question, NULL, NULL};
+
+    history -> number_of_records++;
+    history -> number_of_applied++;
+}
+
+
+// Разделение, пережившее уплотнение: его листья лежат в арене, и пока оно отменено, в дереве их нет
+static size_t children_in_arena(const tree_t* tree, const tree_split_record_t* record)
+{
+    return (size_t)is_node_in_arena(tree -> arena, record -> yes) + (size_t)is_node_in_arena(tree -> arena, record -> no);
+}
+
+
+static void swap_split(tree_split_record_t* record)
+{
+    node_t* node = record -> node;
+
+    char* question = node -> question;
+    node -> question = record -> other_question;
+    record -> other_question = question;
+
+    node_t* yes = node -> yes;
+    node_t* no  = node -> no;
+    node -> yes = record -> yes;
+    node -> no  = record -> no;
+    record -> yes = yes;
+    record -> no  = no;
+}
+
+
+tree_error_type tree_undo_split(tree_t* tree, const tree_split_record_t** record)
+{
+    assert(tree != NULL);
+
+    tree_history_t* history = tree -> history;
+    if (history == NULL || history -> number_of_applied == 0)
+        return TREE_ERROR_STRUCTURE;
+
+    tree_split_record_t* last = history_record(history, history -> number_of_applied - 1);
+
+    // отменять можно только по порядку, поэтому дети последнего разделения - ещё листья
+    if (!is_leaf(last -> node -> yes) || !is_leaf(last -> node -> no))
+        return TREE_ERROR_STRUCTURE;
+
+    tree_snapshot_preserve(tree, last -> node);
+    swap_split(last);
+
+    if (tree -> arena != NULL)
+        tree -> arena -> number_of_detached += children_in_arena(tree, last);
+
+    history -> number_of_applied--;
+    tree -> size -= 2;
+
+    if (record != NULL)
+        *record = last;
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type tree_redo_split(tree_t* tree, const tree_split_record_t** record)
+{
+    assert(tree != NULL);
+
+    tree_history_t* history = tree -> history;
+    if (history == NULL || history -> number_of_applied == history -> number_of_records)
+        return TREE_ERROR_STRUCTURE;
+
+    tree_split_record_t* next = history_record(history, history -> number_of_applied);
+
+    if (!is_leaf(next -> node))
+        return TREE_ERROR_STRUCTURE;
+
+    if (tree -> arena != NULL)
+        tree -> arena -> number_of_detached -= children_in_arena(tree, next);
+
+    tree_snapshot_preserve(tree, next -> node);
+    swap_split(next);
+
+    history -> number_of_applied++;
+    tree -> size += 2;
+
+    if (record != NULL)
+        *record = next;
+
+    return TREE_NO_ERROR;
+}
+
+
+size_t tree_history_undo_count(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    return (tree -> history != NULL) ? tree -> history -> number_of_applied : 0;
+}
+
+
+size_t tree_history_redo_count(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    if (tree -> history == NULL)
+        return 0;
+
+    return tree -> history -> number_of_records - tree -> history -> number_of_applied;
+}
@@ -0,0 +1,40 @@
+#ifndef TREE_HISTORY_H_
+#define TREE_HISTORY_H_
+
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define TREE_HISTORY_CAPACITY 64 // старые разделения вытесняются и отменить их уже нельзя
+
+// Одно разделение листа. Отмена и возврат только меняют местами указатели, ничего не выделяя
+struct tree_split_record_t
+{
+    node_t* node;         // разделённый лист, пока разделение действует - вопрос
+    char* other_question; // фраза, которой сейчас у узла нет: старый объект или, после отмены, признак
+    node_t* yes;          // дети, пока разделение отменено, иначе NULL - они в дереве
+    node_t* no;
+};
+
+// Кольцевой журнал: records[(first + i) % TREE_HISTORY_CAPACITY], первые number_of_applied
+// записей действуют, остальные отменены и их можно вернуть. Новое разделение стирает отменённые.
+// Уплотнение переносит узлы, и tree_compact переводит записи на новые адреса
+struct tree_history_t
+{
+    tree_split_record_t records[TREE_HISTORY_CAPACITY];
+    size_t first;
+    size_t number_of_records;
+    size_t number_of_applied;
+};
+
+tree_error_type tree_history_create(tree_t* tree);
+void tree_history_destroy(tree_t* tree);
+void tree_history_clear(tree_t* tree);
+void tree_history_record_split(tree_t* tree, node_t* node, char* old_question);
+tree_error_type tree_undo_split(tree_t* tree, const tree_split_record_t** record);
+tree_error_type tree_redo_split(tree_t* tree, const tree_split_record_t** record);
+size_t tree_history_undo_count(const tree_t* tree);
+size_t tree_history_redo_count(const tree_t* tree);
+
+#endif // TREE_HISTORY_H_
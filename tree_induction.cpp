@@ -0,0 +1,1009 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <strings.h>
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+#include "tree.h"
+#include "tree_induction.h"
+#include "tree_error_type.h"
+
+#define INDUCTION_NO_FEATURE ((size_t)-1)
+#define INDUCTION_BLOCK_OF_ROWS ((1u << INDUCTION_COUNTER_PLANES) - 1)
+#define INDUCTION_BITS_PER_WORD 64
+
+struct csv_reader_t
+{
+    FILE* file;
+    const char* filename;
+    char* buffer;
+    size_t size;
+    size_t position;
+    size_t line;
+    size_t record_line; // строка, с которой началась текущая запись, - её и пишем в ошибках
+
+    char* field; // текущее поле без кавычек, длина не ограничена
+    size_t field_length;
+    size_t field_capacity;
+};
+
+// Кусок таблицы, из которого строится одно поддерево: объекты order[begin, end)
+struct induction_task_t
+{
+    size_t begin;
+    size_t end;
+    node_t** slot; // куда положить корень поддерева
+    node_t* parent;
+    size_t depth;
+};
+
+struct induction_tasks_t
+{
+    induction_task_t* tasks;
+    size_t count;
+    size_t capacity;
+};
+
+// Своё у каждого потока: вертикальные счётчики, стек задач и статистика
+struct induction_worker_t
+{
+    uint64_t* planes;   // INDUCTION_COUNTER_PLANES битовых плоскостей по words_per_row слов
+    uint64_t* any_bits; // признак есть хотя бы у одного объекта куска
+    uint64_t* all_bits; // признак есть у всех
+    size_t* counts;     // words_per_row * 64, у скольких объектов есть признак
+
+    induction_tasks_t stack;
+
+    size_t number_of_nodes;
+    size_t depth;
+    size_t number_of_indistinguishable;
+};
+
+struct induction_context_t
+{
+    const induction_table_t* table;
+    uint32_t* order; // перестановка объектов, каждый узел делит свой кусок на "да" и "нет"
+
+    induction_tasks_t frontier; // поддеревья, которые потоки строят целиком
+    std::atomic<size_t> next_task;
+    std::atomic<bool> failed;
+};
+
+// ============================CSV==============================================
+
+static tree_error_type open_csv_reader(csv_reader_t* reader, const char* filename)
+{
+    *reader = {};
+    reader -> filename = filename;
+    reader -> line     = 1;
+
+    reader -> file = fopen(filename, "rb");
+    if (reader -> file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    reader -> buffer = (char*)calloc(INDUCTION_READ_BUFFER_SIZE, sizeof(char));
+    if (reader -> buffer == NULL)
+    {
+        fclose(reader -> file);
+        reader -> file = NULL;
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+static void close_csv_reader(csv_reader_t* reader)
+{
+    if (reader -> file != NULL)
+        fclose(reader -> file);
+
+    free(reader -> buffer);
+    free(reader -> field);
+    *reader = {};
+}
+
+
+static int csv_peek(csv_reader_t* reader)
+{
+    if (reader -> position == reader -> size)
+    {
+        reader -> size     = fread(reader -> buffer, sizeof(char), INDUCTION_READ_BUFFER_SIZE, reader -> file);
+        reader -> position = 0;
+
+        if (reader -> size == 0)
+            return EOF;
+    }
+
+    return (unsigned char)reader -> buffer[reader -> position];
+}
+
+
+static int csv_get(csv_reader_t* reader)
+{
+    int symbol = csv_peek(reader);
+    if (symbol == EOF)
+        return EOF;
+
+    reader -> position++;
+    if (symbol == '\n')
+        reader -> line++;
+
+    return symbol;
+}
+
+
+static tree_error_type report_csv_error(const csv_reader_t* reader, const char* message)
+{
+    fprintf(stderr, "Import: %s:%zu: %s\n", reader -> filename, reader -> record_line, message);
+    return TREE_ERROR_SYNTAX;
+}
+
+
+static tree_error_type append_to_field(csv_reader_t* reader, const char* text, size_t length)
+{
+    if (reader -> field_length + length >= reader -> field_capacity)
+    {
+        size_t new_capacity = (reader -> field_capacity == 0) ? 64 : 2 * reader -> field_capacity;
+        while (new_capacity <= reader -> field_length + length)
+            new_capacity *= 2;
+
+        char* new_field = (char*)realloc(reader -> field, new_capacity);
+        if (new_field == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        reader -> field = new_field;
+        reader -> field_capacity = new_capacity;
+    }
+
+    memcpy(reader -> field + reader -> field_length, text, length);
+    reader -> field_length += length;
+    reader -> field[reader -> field_length] = '\0';
+
+    return TREE_NO_ERROR;
+}
+
+
+// Поле без кавычек копируем кусками до разделителя, не по символу
+static tree_error_type read_plain_field(csv_reader_t* reader)
+{
+    while (csv_peek(reader) != EOF)
+    {
+        const char* begin = reader -> buffer + reader -> position;
+        const char* end   = reader -> buffer + reader -> size;
+        const char* stop  = begin;
+
+        while (stop != end && *stop != ',' && *stop != '\n')
+            stop++;
+
+        tree_error_type result = append_to_field(reader, begin, (size_t)(stop - begin));
+        if (result != TREE_NO_ERROR)
+            return result;
+
+        reader -> position += (size_t)(stop - begin);
+        if (stop != end)
+            break;
+    }
+
+    while (reader -> field_length > 0 && isspace((unsigned char)reader -> field[reader -> field_length - 1]))
+        reader -> field[--reader -> field_length] = '\0';
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type read_quoted_field(csv_reader_t* reader)
+{
+    csv_get(reader); // открывающая кавычка
+
+    while (true)
+    {
+        int symbol = csv_get(reader);
+        if (symbol == EOF)
+            return report_csv_error(reader, "unterminated quoted field");
+
+        if (symbol == '"')
+        {
+            if (csv_peek(reader) != '"')
+                break;
+            csv_get(reader); // "" внутри кавычек - сама кавычка
+        }
+
+        char text = (char)symbol;
+        tree_error_type result = append_to_field(reader, &text, 1);
+        if (result != TREE_NO_ERROR)
+            return result;
+    }
+
+    int symbol = csv_peek(reader);
+    while (symbol == ' ' || symbol == '\t' || symbol == '\r')
+    {
+        csv_get(reader);
+        symbol = csv_peek(reader);
+    }
+
+    if (symbol != ',' && symbol != '\n' && symbol != EOF)
+        return report_csv_error(reader, "unexpected text after closing quote");
+
+    return TREE_NO_ERROR;
+}
+
+
+// Читает одно поле и разделитель после него. end_of_row - поле было последним в строке
+static tree_error_type read_csv_field(csv_reader_t* reader, bool* end_of_row)
+{
+    reader -> field_length = 0;
+    tree_error_type result = append_to_field(reader, "", 0); // поле всегда есть, хотя бы пустое
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    int symbol = csv_peek(reader);
+    while (symbol == ' ' || symbol == '\t')
+    {
+        csv_get(reader);
+        symbol = csv_peek(reader);
+    }
+
+    result = (symbol == '"') ? read_quoted_field(reader) : read_plain_field(reader);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    symbol = csv_get(reader);
+    *end_of_row = (symbol != ',');
+
+    return TREE_NO_ERROR;
+}
+
+
+// Пустые строки между записями пропускаем
+static bool skip_empty_lines(csv_reader_t* reader)
+{
+    int symbol = csv_peek(reader);
+    while (symbol == '\n' || symbol == '\r')
+    {
+        csv_get(reader);
+        symbol = csv_peek(reader);
+    }
+
+    reader -> record_line = reader -> line;
+    return symbol != EOF;
+}
+
+
+// Фраза потом сохраняется в кавычках и читается в буфер MAX_LENGTH_OF_ANSWER, запас - под "is it "
+static tree_error_type check_phrase(const csv_reader_t* reader, const char* phrase)
+{
+    if (*phrase == '\0')
+        return report_csv_error(reader, "empty name");
+
+    if (strchr(phrase, '"') != NULL)
+        return report_csv_error(reader, "names must not contain '\"'");
+
+    if (strlen(phrase) + sizeof("is it ") > MAX_LENGTH_OF_ANSWER)
+        return report_csv_error(reader, "name is too long");
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type read_csv_header(csv_reader_t* reader, induction_table_t* table)
+{
+    if (!skip_empty_lines(reader))
+        return report_csv_error(reader, "file is empty");
+
+    size_t capacity = 0;
+    bool end_of_row = false;
+
+    tree_error_type result = read_csv_field(reader, &end_of_row); // заголовок столбца с объектами не нужен
+
+    while (result == TREE_NO_ERROR && !end_of_row)
+    {
+        result = read_csv_field(reader, &end_of_row);
+        if (result != TREE_NO_ERROR)
+            break;
+
+        result = check_phrase(reader, reader -> field);
+        if (result != TREE_NO_ERROR)
+            break;
+
+        if (table -> number_of_features == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : 2 * capacity;
+
+            char** new_names = (char**)realloc(table -> feature_names, capacity * sizeof(char*));
+            if (new_names == NULL)
+                return TREE_ERROR_ALLOCATION;
+            table -> feature_names = new_names;
+        }
+
+        table -> feature_names[table -> number_of_features] = strdup(reader -> field);
+        if (table -> feature_names[table -> number_of_features] == NULL)
+            return TREE_ERROR_ALLOCATION;
+        table -> number_of_features++;
+    }
+
+    table -> words_per_row = (table -> number_of_features + INDUCTION_BITS_PER_WORD - 1) / INDUCTION_BITS_PER_WORD;
+
+    return result;
+}
+
+
+static tree_error_type reserve_table_row(induction_table_t* table)
+{
+    if (table -> number_of_objects < table -> objects_capacity)
+        return TREE_NO_ERROR;
+
+    size_t new_capacity = (table -> objects_capacity == 0) ? 1024 : 2 * table -> objects_capacity;
+    if (new_capacity > UINT32_MAX)
+        return TREE_ERROR_ALLOCATION; // номера объектов хранятся в uint32_t
+
+    char** new_names = (char**)realloc(table -> object_names, new_capacity * sizeof(char*));
+    if (new_names == NULL)
+        return TREE_ERROR_ALLOCATION;
+    table -> object_names = new_names;
+
+    if (table -> words_per_row != 0)
+    {
+        uint64_t* new_rows = (uint64_t*)realloc(table -> rows, new_capacity * table -> words_per_row * sizeof(uint64_t));
+        if (new_rows == NULL)
+            return TREE_ERROR_ALLOCATION;
+        table -> rows = new_rows;
+    }
+
+    table -> objects_capacity = new_capacity;
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type parse_feature_value(const csv_reader_t* reader, bool* value)
+{
+    const char* field = reader -> field;
+
+    if (strcmp(field, "1") == 0 || strcasecmp(field, "yes") == 0 || strcasecmp(field, "true") == 0)
+        *value = true;
+    else if (strcmp(field, "0") == 0 || strcasecmp(field, "no") == 0 || strcasecmp(field, "false") == 0)
+        *value = false;
+    else
+        return report_csv_error(reader, "feature value must be 1/0, yes/no or true/false");
+
+    return TREE_NO_ERROR;
+}
+
+
+// Почти все значения - одиночные 0 или 1: их разбираем прямо в буфере, остальное - обычным путём
+static bool read_bare_bit(csv_reader_t* reader, bool* value, bool* end_of_row)
+{
+    if (reader -> size - reader -> position < 3)
+        return false;
+
+    const char* text = reader -> buffer + reader -> position;
+    if ((unsigned char)(text[0] - '0') > 1)
+        return false;
+
+    size_t length = 1;
+    if (text[1] == '\r')
+        length++;
+
+    if (text[length] != ',' && text[length] != '\n')
+        return false;
+
+    *value = (text[0] == '1');
+    *end_of_row = (text[length] == '\n');
+
+    reader -> position += length + 1;
+    if (*end_of_row)
+        reader -> line++;
+
+    return true;
+}
+
+
+static tree_error_type read_csv_row(csv_reader_t* reader, induction_table_t* table)
+{
+    tree_error_type result = reserve_table_row(table);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    bool end_of_row = false;
+
+    result = read_csv_field(reader, &end_of_row);
+    if (result == TREE_NO_ERROR)
+        result = check_phrase(reader, reader -> field);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    // буфер поля переиспользуется, поэтому имя копируем сразу
+    size_t object = table -> number_of_objects;
+    table -> object_names[object] = strdup(reader -> field);
+    if (table -> object_names[object] == NULL)
+        return TREE_ERROR_ALLOCATION;
+    table -> number_of_objects++; // с этого момента имя освобождает induction_table_destroy
+
+    uint64_t* row = table -> rows + object * table -> words_per_row;
+    memset(row, 0, table -> words_per_row * sizeof(uint64_t));
+
+    for (size_t feature = 0; feature < table -> number_of_features; feature++)
+    {
+        if (end_of_row)
+            return report_csv_error(reader, "too few values in row");
+
+        bool value = false;
+
+        if (!read_bare_bit(reader, &value, &end_of_row))
+        {
+            result = read_csv_field(reader, &end_of_row);
+            if (result == TREE_NO_ERROR)
+                result = parse_feature_value(reader, &value);
+            if (result != TREE_NO_ERROR)
+                return result;
+        }
+
+        row[feature / INDUCTION_BITS_PER_WORD] |= (uint64_t)value << (feature % INDUCTION_BITS_PER_WORD); // без ветвления: значения случайны
+    }
+
+    if (!end_of_row)
+        return report_csv_error(reader, "too many values in row");
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type induction_table_load_csv(const char* filename, induction_table_t* table)
+{
+    assert(filename != NULL);
+    assert(table    != NULL);
+
+    *table = {};
+
+    csv_reader_t reader = {};
+    tree_error_type result = open_csv_reader(&reader, filename);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    result = read_csv_header(&reader, table);
+
+    while (result == TREE_NO_ERROR && skip_empty_lines(&reader))
+        result = read_csv_row(&reader, table);
+
+    if (result == TREE_NO_ERROR && table -> number_of_objects == 0)
+        result = report_csv_error(&reader, "no objects");
+
+    close_csv_reader(&reader);
+
+    if (result != TREE_NO_ERROR)
+        induction_table_destroy(table);
+
+    return result;
+}
+
+
+void induction_table_destroy(induction_table_t* table)
+{
+    assert(table != NULL);
+
+    for (size_t i = 0; i < table -> number_of_objects; i++)
+        free(table -> object_names[i]);
+    for (size_t i = 0; i < table -> number_of_features; i++)
+        free(table -> feature_names[i]);
+
+    free(table -> object_names);
+    free(table -> feature_names);
+    free(table -> rows);
+
+    *table = {};
+}
+
+// ============================COUNTING=========================================
+
+static tree_error_type create_induction_worker(induction_worker_t* worker, size_t words_per_row)
+{
+    *worker = {};
+
+    size_t words = (words_per_row == 0) ? 1 : words_per_row; // без признаков счётчики не нужны, но NULL неудобен
+
+    worker -> planes   = (uint64_t*)calloc(INDUCTION_COUNTER_PLANES * words, sizeof(uint64_t));
+    worker -> any_bits = (uint64_t*)calloc(words, sizeof(uint64_t));
+    worker -> all_bits = (uint64_t*)calloc(words, sizeof(uint64_t));
+    worker -> counts   = (size_t*)  calloc(words * INDUCTION_BITS_PER_WORD, sizeof(size_t));
+
+    if (worker -> planes == NULL || worker -> any_bits == NULL || worker -> all_bits == NULL || worker -> counts == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    return TREE_NO_ERROR;
+}
+
+
+static void destroy_induction_worker(induction_worker_t* worker)
+{
+    free(worker -> planes);
+    free(worker -> any_bits);
+    free(worker -> all_bits);
+    free(worker -> counts);
+    free(worker -> stack.tasks);
+
+    *worker = {};
+}
+
+
+// Номер младшего единичного бита: bits != 0, поэтому __builtin_ctzll вернёт от 0 до 63
+static size_t lowest_set_bit(uint64_t bits)
+{
+    assert(bits != 0);
+
+    return (size_t)__builtin_ctzll(bits);
+}
+
+
+// Переносит битовые плоскости в обычные счётчики и обнуляет их
+static void flush_counter_planes(induction_worker_t* worker, size_t words_per_row)
+{
+    for (size_t plane = 0; plane < INDUCTION_COUNTER_PLANES; plane++)
+    {
+        uint64_t* bits_of_plane = worker -> planes + plane * words_per_row;
+
+        for (size_t word = 0; word < words_per_row; word++)
+        {
+            uint64_t bits = bits_of_plane[word];
+            bits_of_plane[word] = 0;
+
+            while (bits != 0)
+            {
+                worker -> counts[word * INDUCTION_BITS_PER_WORD + lowest_set_bit(bits)] += (size_t)1 << plane;
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+
+// Сколько объектов куска имеют каждый признак. Считаем вертикально: плоскость p хранит
+// p-й разряд счётчиков всех 64 признаков слова, строка прибавляется как двоичная единица
+// с переносом, поэтому на строку уходит несколько операций на слово, а не на бит
+static void count_features(const induction_context_t* context, size_t begin, size_t end, induction_worker_t* worker)
+{
+    const induction_table_t* table = context -> table;
+    size_t words_per_row = table -> words_per_row;
+
+    memset(worker -> counts, 0, words_per_row * INDUCTION_BITS_PER_WORD * sizeof(size_t));
+    for (size_t word = 0; word < words_per_row; word++)
+    {
+        worker -> any_bits[word] = 0;
+        worker -> all_bits[word] = ~0ULL;
+    }
+
+    size_t rows_in_block = 0;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        const uint64_t* row = table -> rows + (size_t)context -> order[i] * words_per_row;
+
+        for (size_t word = 0; word < words_per_row; word++)
+        {
+            uint64_t carry = row[word];
+            worker -> any_bits[word] |= carry;
+            worker -> all_bits[word] &= carry;
+
+            for (uint64_t* plane = worker -> planes + word; carry != 0; plane += words_per_row)
+            {
+                uint64_t next_carry = *plane & carry;
+                *plane ^= carry;
+                carry = next_carry;
+            }
+        }
+
+        if (++rows_in_block == INDUCTION_BLOCK_OF_ROWS)
+        {
+            flush_counter_planes(worker, words_per_row);
+            rows_in_block = 0;
+        }
+    }
+
+    if (rows_in_block != 0)
+        flush_counter_planes(worker, words_per_row);
+}
+
+
+// Классы ID3 здесь - сами объекты, все различны. Прирост информации от вопроса, который
+// делит n объектов на k и n - k, равен H(k/n), и он тем больше, чем ближе k к n/2.
+// Поэтому логарифмы не нужны: берём признак с наименьшим |2k - n|, при равенстве - первый
+static size_t choose_feature(const induction_worker_t* worker, size_t words_per_row, size_t number_of_objects)
+{
+    size_t best_feature = INDUCTION_NO_FEATURE;
+    size_t best_imbalance = SIZE_MAX;
+
+    for (size_t word = 0; word < words_per_row; word++)
+    {
+        uint64_t candidates = worker -> any_bits[word] & ~worker -> all_bits[word]; // признак делит кусок
+
+        while (candidates != 0)
+        {
+            size_t feature = word * INDUCTION_BITS_PER_WORD + lowest_set_bit(candidates);
+            candidates &= candidates - 1;
+
+            size_t twice_count = 2 * worker -> counts[feature];
+            size_t imbalance = (twice_count > number_of_objects) ? twice_count - number_of_objects
+                                                                 : number_of_objects - twice_count;
+            if (imbalance < best_imbalance)
+            {
+                best_imbalance = imbalance;
+                best_feature   = feature;
+            }
+        }
+    }
+
+    return best_feature;
+}
+
+// ============================BUILDING=========================================
+
+static tree_error_type push_induction_task(induction_tasks_t* tasks, const induction_task_t* task)
+{
+    if (tasks -> count == tasks -> capacity)
+    {
+        size_t new_capacity = (tasks -> capacity == 0) ? 64 : 2 * tasks -> capacity;
+
+        induction_task_t* new_tasks = (induction_task_t*)realloc(tasks -> tasks, new_capacity * sizeof(induction_task_t));
+        if (new_tasks == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        tasks -> tasks    = new_tasks;
+        tasks -> capacity = new_capacity;
+    }
+
+    tasks -> tasks[tasks -> count++] = *task;
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type create_induced_node(induction_worker_t* worker, const char* phrase,
+                                           node_t** slot, node_t* parent, size_t depth)
+{
+    tree_error_type result = tree_create_node(slot, phrase);
+    if (result != TREE_NO_ERROR)
+    {
+        *slot = NULL;
+        return result;
+    }
+
+    tree_set_parent(*slot, parent);
+
+    worker -> number_of_nodes++;
+    if (depth > worker -> depth)
+        worker -> depth = depth;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Один объект - лист. Несколько неразличимых - цепочка "is it X": да - X, нет - остальные
+static tree_error_type build_leaf_chain(const induction_context_t* context, const induction_task_t* task,
+                                        induction_worker_t* worker)
+{
+    node_t** slot = task -> slot;
+    node_t* parent = task -> parent;
+    size_t depth = task -> depth;
+
+    if (task -> end - task -> begin > 1)
+        worker -> number_of_indistinguishable += task -> end - task -> begin;
+
+    char question[MAX_LENGTH_OF_ANSWER] = {};
+
+    for (size_t i = task -> begin; i + 1 < task -> end; i++)
+    {
+        const char* name = context -> table -> object_names[context -> order[i]];
+        snprintf(question, sizeof(question), "is it %s", name);
+
+        tree_error_type result = create_induced_node(worker, question, slot, parent, depth);
+        if (result == TREE_NO_ERROR)
+            result = create_induced_node(worker, name, &(*slot) -> yes, *slot, depth + 1);
+        if (result != TREE_NO_ERROR)
+            return result;
+
+        parent = *slot;
+        slot   = &(*slot) -> no;
+        depth++;
+    }
+
+    return create_induced_node(worker, context -> table -> object_names[context -> order[task -> end - 1]],
+                               slot, parent, depth);
+}
+
+
+// Объекты с признаком - в начало куска, без признака - в конец
+static size_t partition_by_feature(const induction_context_t* context, size_t begin, size_t end, size_t feature)
+{
+    const induction_table_t* table = context -> table;
+    uint32_t* order = context -> order;
+
+    size_t word = feature / INDUCTION_BITS_PER_WORD;
+    uint64_t mask = 1ULL << (feature % INDUCTION_BITS_PER_WORD);
+
+    size_t yes_end = begin;
+    size_t no_begin = end;
+
+    while (yes_end < no_begin)
+    {
+        if (table -> rows[(size_t)order[yes_end] * table -> words_per_row + word] & mask)
+        {
+            yes_end++;
+        }
+        else
+        {
+            no_begin--;
+            uint32_t object = order[yes_end];
+            order[yes_end]  = order[no_begin];
+            order[no_begin] = object;
+        }
+    }
+
+    return yes_end;
+}
+
+
+static tree_error_type build_question(const induction_context_t* context, const induction_task_t* task,
+                                      size_t feature, induction_worker_t* worker,
+                                      induction_task_t* yes_task, induction_task_t* no_task)
+{
+    tree_error_type result = create_induced_node(worker, context -> table -> feature_names[feature],
+                                                 task -> slot, task -> parent, task -> depth);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    size_t middle = partition_by_feature(context, task -> begin, task -> end, feature);
+    node_t* node = *task -> slot;
+
+    *yes_task = {task -> begin, middle,      &node -> yes, node, task -> depth + 1};
+    *no_task  = {middle,        task -> end, &node -> no,  node, task -> depth + 1};
+
+    return TREE_NO_ERROR;
+}
+
+
+// Поддерево задачи целиком в одном потоке, обход через свой стек вместо рекурсии
+static tree_error_type build_subtree(const induction_context_t* context, const induction_task_t* root_task,
+                                     induction_worker_t* worker)
+{
+    worker -> stack.count = 0;
+
+    tree_error_type result = push_induction_task(&worker -> stack, root_task);
+
+    while (result == TREE_NO_ERROR && worker -> stack.count > 0)
+    {
+        induction_task_t task = worker -> stack.tasks[--worker -> stack.count];
+
+        size_t feature = INDUCTION_NO_FEATURE;
+        if (task.end - task.begin > 1)
+        {
+            count_features(context, task.begin, task.end, worker);
+            feature = choose_feature(worker, context -> table -> words_per_row, task.end - task.begin);
+        }
+
+        if (feature == INDUCTION_NO_FEATURE)
+        {
+            result = build_leaf_chain(context, &task, worker);
+            continue;
+        }
+
+        induction_task_t yes_task = {};
+        induction_task_t no_task  = {};
+
+        result = build_question(context, &task, feature, worker, &yes_task, &no_task);
+        if (result == TREE_NO_ERROR)
+            result = push_induction_task(&worker -> stack, &no_task);
+        if (result == TREE_NO_ERROR)
+            result = push_induction_task(&worker -> stack, &yes_task);
+    }
+
+    return result;
+}
+
+
+static void induction_worker_loop(induction_context_t* context, induction_worker_t* worker)
+{
+    while (!context -> failed)
+    {
+        size_t task = context -> next_task++;
+        if (task >= context -> frontier.count)
+            return;
+
+        if (build_subtree(context, &context -> frontier.tasks[task], worker) != TREE_NO_ERROR)
+            context -> failed = true;
+    }
+}
+
+
+// Верхние узлы с большими кусками: счёт делим между потоками, складываем результаты в первом
+static void count_features_parallel(const induction_context_t* context, const induction_task_t* task,
+                                    induction_worker_t* workers, size_t number_of_threads, std::thread* helpers)
+{
+    size_t number_of_objects = task -> end - task -> begin;
+    size_t slice = (number_of_objects + number_of_threads - 1) / number_of_threads;
+
+    for (size_t i = 1; i < number_of_threads; i++)
+    {
+        size_t begin = task -> begin + i * slice;
+        size_t end   = begin + slice;
+        if (begin > task -> end) begin = task -> end;
+        if (end   > task -> end) end   = task -> end;
+
+        helpers[i - 1] = std::thread(count_features, context, begin, end, &workers[i]);
+    }
+
+    size_t first_end = task -> begin + slice;
+    count_features(context, task -> begin, (first_end < task -> end) ? first_end : task -> end, &workers[0]);
+
+    size_t words_per_row = context -> table -> words_per_row;
+
+    for (size_t i = 1; i < number_of_threads; i++)
+    {
+        helpers[i - 1].join();
+
+        for (size_t word = 0; word < words_per_row; word++)
+        {
+            workers[0].any_bits[word] |= workers[i].any_bits[word];
+            workers[0].all_bits[word] &= workers[i].all_bits[word];
+        }
+        for (size_t feature = 0; feature < words_per_row * INDUCTION_BITS_PER_WORD; feature++)
+            workers[0].counts[feature] += workers[i].counts[feature];
+    }
+}
+
+
+// Первая фаза: узлы над большими кусками строит главный поток, считая признаки всеми потоками.
+// Куски не больше порога уходят во frontier - их поддеревья потом строятся параллельно
+static tree_error_type build_top_of_tree(induction_context_t* context, node_t** root, size_t threshold,
+                                         induction_worker_t* workers, size_t number_of_threads, std::thread* helpers)
+{
+    induction_tasks_t stack = {};
+    induction_task_t root_task = {0, context -> table -> number_of_objects, root, NULL, 0};
+
+    tree_error_type result = push_induction_task(&stack, &root_task);
+
+    while (result == TREE_NO_ERROR && stack.count > 0)
+    {
+        induction_task_t task = stack.tasks[--stack.count];
+
+        if (task.end - task.begin <= threshold)
+        {
+            result = push_induction_task(&context -> frontier, &task);
+            continue;
+        }
+
+        count_features_parallel(context, &task, workers, number_of_threads, helpers);
+        size_t feature = choose_feature(&workers[0], context -> table -> words_per_row, task.end - task.begin);
+
+        if (feature == INDUCTION_NO_FEATURE)
+        {
+            result = build_leaf_chain(context, &task, &workers[0]);
+            continue;
+        }
+
+        induction_task_t yes_task = {};
+        induction_task_t no_task  = {};
+
+        result = build_question(context, &task, feature, &workers[0], &yes_task, &no_task);
+        if (result == TREE_NO_ERROR)
+            result = push_induction_task(&stack, &no_task);
+        if (result == TREE_NO_ERROR)
+            result = push_induction_task(&stack, &yes_task);
+    }
+
+    free(stack.tasks);
+
+    return result;
+}
+
+
+tree_error_type induce_tree(const induction_table_t* table, size_t number_of_threads,
+                            tree_t* tree, induction_report_t* report)
+{
+    assert(table  != NULL);
+    assert(tree   != NULL);
+    assert(report != NULL);
+
+    *report = {};
+
+    if (table -> number_of_objects == 0)
+        return TREE_ERROR_STRUCTURE;
+
+    if (number_of_threads == 0)
+        number_of_threads = std::thread::hardware_concurrency();
+    if (number_of_threads == 0)
+        number_of_threads = 1;
+
+    // на маленькой таблице запуск потоков дороже самого построения
+    if (table -> number_of_objects / INDUCTION_MIN_OBJECTS_PER_THREAD < number_of_threads)
+        number_of_threads = table -> number_of_objects / INDUCTION_MIN_OBJECTS_PER_THREAD + 1;
+
+    induction_context_t context;
+    context.table     = table;
+    context.order     = (uint32_t*)calloc(table -> number_of_objects, sizeof(uint32_t));
+    context.frontier  = {};
+    context.next_task = 0;
+    context.failed    = false;
+
+    induction_worker_t* workers = (induction_worker_t*)calloc(number_of_threads, sizeof(induction_worker_t));
+    std::thread* helpers = new (std::nothrow) std::thread[number_of_threads];
+
+    tree_error_type result = (context.order == NULL || workers == NULL || helpers == NULL) ? TREE_ERROR_ALLOCATION
+                                                                                            : TREE_NO_ERROR;
+
+    for (size_t i = 0; i < number_of_threads && result == TREE_NO_ERROR; i++)
+        result = create_induction_worker(&workers[i], table -> words_per_row);
+
+    node_t* root = NULL;
+
+    if (result == TREE_NO_ERROR)
+    {
+        for (size_t i = 0; i < table -> number_of_objects; i++)
+            context.order[i] = (uint32_t)i;
+
+        size_t threshold = table -> number_of_objects / (number_of_threads * INDUCTION_TASKS_PER_THREAD);
+        if (number_of_threads == 1)
+            threshold = table -> number_of_objects; // делить нечего, всё дерево - одна задача
+
+        result = build_top_of_tree(&context, &root, threshold, workers, number_of_threads, helpers);
+    }
+
+    if (result == TREE_NO_ERROR)
+    {
+        for (size_t i = 1; i < number_of_threads; i++)
+            helpers[i - 1] = std::thread(induction_worker_loop, &context, &workers[i]);
+
+        induction_worker_loop(&context, &workers[0]); // главный поток тоже работает
+
+        for (size_t i = 1; i < number_of_threads; i++)
+            helpers[i - 1].join();
+
+        if (context.failed)
+            result = TREE_ERROR_ALLOCATION;
+    }
+
+    if (workers != NULL)
+    {
+        for (size_t i = 0; i < number_of_threads; i++)
+        {
+            report -> number_of_nodes             += workers[i].number_of_nodes;
+            report -> number_of_indistinguishable += workers[i].number_of_indistinguishable;
+            if (workers[i].depth > report -> depth)
+                report -> depth = workers[i].depth;
+
+            destroy_induction_worker(&workers[i]);
+        }
+    }
+    report -> number_of_threads = number_of_threads;
+
+    free(workers);
+    delete[] helpers;
+    free(context.frontier.tasks);
+    free(context.order);
+
+    if (result != TREE_NO_ERROR)
+    {
+        tree_destroy_recursive(root); // недостроенные ветки - NULL, их уничтожать не нужно
+        *report = {};
+        return result;
+    }
+
+    replace_tree(tree, root);
+
+    return TREE_NO_ERROR;
+}
+
+
+void induction_report_print(const induction_report_t* report, FILE* stream)
+{
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "Induced tree: %zu nodes, depth %zu, %zu threads, %zu indistinguishable objects\n",
+            report -> number_of_nodes, report -> depth, report -> number_of_threads,
+            report -> number_of_indistinguishable);
+}
@@ -0,0 +1,46 @@
+#ifndef TREE_INDUCTION_H_
+#define TREE_INDUCTION_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define INDUCTION_READ_BUFFER_SIZE (64 * 1024)
+#define INDUCTION_COUNTER_PLANES 16 // разрядов в битовых счётчиках, сброс каждые 2^16 - 1 строк
+#define INDUCTION_TASKS_PER_THREAD 8 // поддеревья разного размера, поэтому задач больше, чем потоков
+#define INDUCTION_MIN_OBJECTS_PER_THREAD 4096
+
+// Таблица "объекты x признаки" из CSV: первая строка - "объект,признак1,признак2,...",
+// дальше по строке на объект со значениями 1/0, yes/no или true/false.
+// Признаки объекта хранятся битами подряд: строка таблицы - words_per_row слов
+struct induction_table_t
+{
+    char** object_names;
+    size_t number_of_objects;
+    size_t objects_capacity;
+
+    char** feature_names;
+    size_t number_of_features;
+
+    uint64_t* rows;
+    size_t words_per_row;
+};
+
+struct induction_report_t
+{
+    size_t number_of_nodes;
+    size_t depth; // вопросов на самом длинном пути
+    size_t number_of_threads;
+    size_t number_of_indistinguishable; // объекты с одинаковыми признаками, их различает "is it ..."
+};
+
+tree_error_type induction_table_load_csv(const char* filename, induction_table_t* table);
+void induction_table_destroy(induction_table_t* table);
+tree_error_type induce_tree(const induction_table_t* table, size_t number_of_threads,
+                            tree_t* tree, induction_report_t* report);
+void induction_report_print(const induction_report_t* report, FILE* stream);
+
+#endif // TREE_INDUCTION_H_
@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_memory.h"
+#include "tree_compact.h"
+#include "packed_tree.h"
+#include "tree_error_type.h"
+
+#define MEMORY_HASH_OFFSET 14695981039346656037ULL
+#define MEMORY_HASH_PRIME  1099511628211ULL
+
+struct memory_step_t
+{
+    const node_t* node;
+    size_t depth;
+};
+
+// Уже встреченные фразы: открытая адресация по тексту, NULL - пусто.
+// Для каждого текста хранится первая встреченная копия
+struct memory_phrase_set_t
+{
+    const char** buckets;
+    size_t number_of_buckets;
+};
+
+// ============================PHRASES==========================================
+
+// FNV-1a, длина считается тем же проходом
+static uint64_t hash_phrase(const char* text, size_t* length)
+{
+    uint64_t hash = MEMORY_HASH_OFFSET;
+    const char* symbol = text;
+
+    for (; *symbol != '\0'; symbol++)
+    {
+        hash ^= (unsigned char)*symbol;
+        hash *= MEMORY_HASH_PRIME;
+    }
+
+    *length = (size_t)(symbol - text);
+    return hash;
+}
+
+
+static void account_phrase(const tree_t* tree, memory_phrase_set_t* set, const char* phrase, tree_memory_report_t* report)
+{
+    size_t length = 0;
+    uint64_t hash = hash_phrase(phrase, &length);
+    size_t mask = set -> number_of_buckets - 1;
+
+    for (size_t index = hash & mask; ; index = (index + 1) & mask)
+    {
+        const char* stored = set -> buckets[index];
+
+        if (stored == NULL)
+        {
+            set -> buckets[index] = phrase;
+            break;
+        }
+
+        if (stored == phrase) // та же строка из пула или арены
+        {
+            report -> shared_phrases++;
+            return;
+        }
+
+        if (strcmp(stored, phrase) == 0)
+        {
+            report -> duplicate_phrase_bytes += length + 1;
+            break;
+        }
+    }
+
+    report -> phrase_bytes += length + 1;
+
+    if (!is_phrase_in_arena(tree -> arena, phrase))
+        report -> allocator_overhead += heap_chunk_size(length + 1) - (length + 1);
+}
+
+// ============================REPORT===========================================
+
+static tree_error_type count_depth(tree_memory_report_t* report, size_t* depth_capacity, size_t depth)
+{
+    if (depth >= *depth_capacity)
+    {
+        size_t new_capacity = (*depth_capacity == 0) ? 64 : 2 * *depth_capacity;
+        while (new_capacity <= depth)
+            new_capacity *= 2;
+
+        size_t* new_counts = (size_t*)realloc(report -> depth_counts, new_capacity * sizeof(size_t));
+        if (new_counts == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        memset(new_counts + *depth_capacity, 0, (new_capacity - *depth_capacity) * sizeof(size_t));
+
+        report -> depth_counts = new_counts;
+        *depth_capacity = new_capacity;
+    }
+
+    report -> depth_counts[depth]++;
+    if (depth > report -> max_depth)
+        report -> max_depth = depth;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Один обход без рекурсии: узлы, фразы, повторы фраз и гистограмма глубин сразу.
+// Как и tree_heap_memory_estimate, заходим не дальше tree -> size узлов, чтобы не зациклиться на битом дереве
+tree_error_type tree_memory_report_build(const tree_t* tree, tree_memory_report_t* report)
+{
+    assert(tree   != NULL);
+    assert(report != NULL);
+
+    *report = {};
+
+    if (tree -> root == NULL)
+        return TREE_NO_ERROR;
+
+    memory_phrase_set_t set = {};
+    set.number_of_buckets = 16;
+    while (set.number_of_buckets < 2 * tree -> size)
+        set.number_of_buckets *= 2;
+
+    set.buckets = (const char**)calloc(set.number_of_buckets, sizeof(const char*));
+    memory_step_t* stack = (memory_step_t*)calloc(tree -> size + 1, sizeof(memory_step_t));
+    if (set.buckets == NULL || stack == NULL)
+    {
+        free(set.buckets);
+        free(stack);
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    tree_error_type result = TREE_NO_ERROR;
+    size_t depth_capacity = 0;
+    size_t leaf_depth_sum = 0;
+    size_t stack_size = 0;
+    stack[stack_size++] = {tree -> root, 0};
+
+    while (stack_size > 0 && report -> number_of_nodes < tree -> size && result == TREE_NO_ERROR)
+    {
+        memory_step_t step = stack[--stack_size];
+        const node_t* node = step.node;
+
+        report -> number_of_nodes++;
+        report -> node_bytes += sizeof(node_t);
+
+        if (!is_node_in_arena(tree -> arena, node))
+        {
+            report -> heap_nodes++;
+            report -> allocator_overhead += heap_chunk_size(sizeof(node_t)) - sizeof(node_t);
+        }
+
+        if (node -> question != NULL)
+            account_phrase(tree, &set, node -> question, report);
+
+        result = count_depth(report, &depth_capacity, step.depth);
+
+        if (node -> yes == NULL && node -> no == NULL)
+        {
+            report -> number_of_leaves++;
+            leaf_depth_sum += step.depth;
+        }
+
+        if (node -> no  != NULL && stack_size <= tree -> size) stack[stack_size++] = {node -> no,  step.depth + 1};
+        if (node -> yes != NULL && stack_size <= tree -> size) stack[stack_size++] = {node -> yes, step.depth + 1};
+    }
+
+    free(set.buckets);
+    free(stack);
+
+    if (result != TREE_NO_ERROR)
+    {
+        tree_memory_report_destroy(report);
+        return result;
+    }
+
+    if (report -> number_of_leaves != 0)
+        report -> average_leaf_depth = (double)leaf_depth_sum / (double)report -> number_of_leaves;
+
+    return TREE_NO_ERROR;
+}
+
+
+void tree_memory_report_destroy(tree_memory_report_t* report)
+{
+    assert(report != NULL);
+
+    free(report -> depth_counts);
+    *report = {};
+}
+
+
+size_t tree_memory_report_total(const tree_memory_report_t* report)
+{
+    assert(report != NULL);
+
+    return report -> node_bytes + report -> phrase_bytes + report -> allocator_overhead;
+}
+
+// ============================OUTPUT===========================================
+
+// Глубже MEMORY_HISTOGRAM_ROWS уровней строки гистограммы объединяют соседние глубины
+static size_t histogram_row_width(const tree_memory_report_t* report)
+{
+    return (report -> max_depth + MEMORY_HISTOGRAM_ROWS) / MEMORY_HISTOGRAM_ROWS;
+}
+
+
+static size_t histogram_row_count(const tree_memory_report_t* report, size_t first_depth, size_t width)
+{
+    size_t count = 0;
+
+    for (size_t depth = first_depth; depth < first_depth + width && depth <= report -> max_depth; depth++)
+        count += report -> depth_counts[depth];
+
+    return count;
+}
+
+
+static size_t histogram_largest_row(const tree_memory_report_t* report, size_t width)
+{
+    size_t largest = 0;
+
+    for (size_t first_depth = 0; first_depth <= report -> max_depth; first_depth += width)
+    {
+        size_t count = histogram_row_count(report, first_depth, width);
+        if (count > largest)
+            largest = count;
+    }
+
+    return largest;
+}
+
+
+static size_t histogram_bar_length(size_t count, size_t largest)
+{
+    if (count == 0 || largest == 0)
+        return 0;
+
+    size_t length = count * MEMORY_HISTOGRAM_BAR_WIDTH / largest;
+    return (length == 0) ? 1 : length;
+}
+
+
+void tree_memory_report_print(const tree_memory_report_t* report, FILE* stream)
+{
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    size_t total = tree_memory_report_total(report);
+
+    fprintf(stream, "Memory: %zu nodes (%zu in heap blocks, %zu in arena), %zu leaves\n",
+                    report -> number_of_nodes, report -> heap_nodes,
+                    report -> number_of_nodes - report -> heap_nodes, report -> number_of_leaves);
+    fprintf(stream, "  nodes               %zu bytes\n", report -> node_bytes);
+    fprintf(stream, "  phrases             %zu bytes (%zu shared references)\n", report -> phrase_bytes, report -> shared_phrases);
+    fprintf(stream, "  duplicate phrases   %zu bytes could be saved by interning\n", report -> duplicate_phrase_bytes);
+    fprintf(stream, "  allocator overhead  %zu bytes\n", report -> allocator_overhead);
+    fprintf(stream, "  total               %zu bytes, %.1f per node\n", total,
+                    (report -> number_of_nodes != 0) ? (double)total / (double)report -> number_of_nodes : 0.0);
+
+    if (report -> number_of_nodes == 0)
+        return;
+
+    size_t width = histogram_row_width(report);
+    size_t largest = histogram_largest_row(report, width);
+
+    fprintf(stream, "Depth histogram (max depth %zu, average leaf depth %.1f):\n",
+                    report -> max_depth, report -> average_leaf_depth);
+
+    for (size_t first_depth = 0; first_depth <= report -> max_depth; first_depth += width)
+    {
+        size_t count = histogram_row_count(report, first_depth, width);
+        size_t last_depth = first_depth + width - 1;
+        if (last_depth > report -> max_depth)
+            last_depth = report -> max_depth;
+
+        char label[MAX_LENGTH_OF_ADDRESS] = {};
+        if (first_depth == last_depth)
+            snprintf(label, sizeof(label), "%zu", first_depth);
+        else
+            snprintf(label, sizeof(label), "%zu-%zu", first_depth, last_depth);
+
+        fprintf(stream, "  %11s |", label);
+        for (size_t i = histogram_bar_length(count, largest); i > 0; i--)
+            fputc('#', stream);
+        fprintf(stream, " %zu\n", count);
+    }
+}
+
+
+void tree_memory_report_write_html(const tree_memory_report_t* report, FILE* htm_file)
+{
+    assert(report   != NULL);
+    assert(htm_file != NULL);
+
+    size_t total = tree_memory_report_total(report);
+
+    fprintf(htm_file, "<div style='margin-bottom:15px;'>\n");
+    fprintf(htm_file, "<p><b>Memory:</b> %zu bytes, %zu nodes in heap blocks, %zu in arena, %zu leaves</p>\n",
+                      total, report -> heap_nodes, report -> number_of_nodes - report -> heap_nodes, report -> number_of_leaves);
+
+    fprintf(htm_file, "<table border='1' style='border-collapse:collapse; margin-top:5px;'>\n");
+    fprintf(htm_file, "<tr><th>Part</th><th>Bytes</th></tr>\n");
+    fprintf(htm_file, "<tr><td>Nodes</td><td>%zu</td></tr>\n", report -> node_bytes);
+    fprintf(htm_file, "<tr><td>Phrases</td><td>%zu</td></tr>\n", report -> phrase_bytes);
+    fprintf(htm_file, "<tr><td>Duplicate phrases (saved by interning)</td><td>%zu</td></tr>\n", report -> duplicate_phrase_bytes);
+    fprintf(htm_file, "<tr><td>Allocator overhead</td><td>%zu</td></tr>\n", report -> allocator_overhead);
+    fprintf(htm_file, "</table>\n");
+
+    if (report -> number_of_nodes != 0)
+    {
+        size_t width = histogram_row_width(report);
+        size_t largest = histogram_largest_row(report, width);
+
+        fprintf(htm_file, "<p><b>Depth histogram:</b> max depth %zu, average leaf depth %.1f</p>\n",
+                          report -> max_depth, report -> average_leaf_depth);
+        fprintf(htm_file, "<table style='border-collapse:collapse;'>\n");
+
+        for (size_t first_depth = 0; first_depth <= report -> max_depth; first_depth += width)
+        {
+            size_t count = histogram_row_count(report, first_depth, width);
+            size_t last_depth = first_depth + width - 1;
+            if (last_depth > report -> max_depth)
+                last_depth = report -> max_depth;
+
+            if (first_depth == last_depth)
+                fprintf(htm_file, "<tr><td>%zu</td>", first_depth);
+            else
+                fprintf(htm_file, "<tr><td>%zu-%zu</td>", first_depth, last_depth);
+
+            fprintf(htm_file, "<td><div style='background:#69c; height:10px; width:%zupx;'></div></td><td>%zu</td></tr>\n",
+                              histogram_bar_length(count, largest) * 5, count);
+        }
+
+        fprintf(htm_file, "</table>\n");
+    }
+
+    fprintf(htm_file, "</div>\n");
+}
@@ -0,0 +1,38 @@
+#ifndef TREE_MEMORY_H_
+#define TREE_MEMORY_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define MEMORY_HISTOGRAM_ROWS 16      // глубокие деревья печатаются диапазонами глубин
+#define MEMORY_HISTOGRAM_BAR_WIDTH 40
+
+// Куда уходит память загруженной базы. Всё считается за один обход дерева.
+// Узлы и фразы из арены tree_compact и из общего пула лежат без заголовков malloc
+struct tree_memory_report_t
+{
+    size_t number_of_nodes;
+    size_t number_of_leaves;
+    size_t heap_nodes;              // узлы в отдельных блоках malloc, остальные в арене
+
+    size_t node_bytes;              // sizeof(node_t) на каждый узел
+    size_t phrase_bytes;            // текст фраз с '\0', фраза, на которую ссылаются несколько узлов, - один раз
+    size_t duplicate_phrase_bytes;  // из них копии уже встреченного текста: столько сэкономит интернирование
+    size_t shared_phrases;          // ссылок на уже посчитанную фразу
+    size_t allocator_overhead;      // заголовки и выравнивание блоков malloc
+
+    size_t* depth_counts;           // узлов на каждой глубине, у корня глубина 0
+    size_t max_depth;
+    double average_leaf_depth;
+};
+
+tree_error_type tree_memory_report_build(const tree_t* tree, tree_memory_report_t* report);
+void tree_memory_report_destroy(tree_memory_report_t* report);
+size_t tree_memory_report_total(const tree_memory_report_t* report);
+void tree_memory_report_print(const tree_memory_report_t* report, FILE* stream);
+void tree_memory_report_write_html(const tree_memory_report_t* report, FILE* htm_file);
+
+#endif // TREE_MEMORY_H_
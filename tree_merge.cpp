@@ -0,0 +1,880 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_merge.h"
+#include "tree_parser.h"
+#include "tree_error_type.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME        1099511628211ULL
+
+// Заголовок узла: фраза и то, лист ли это. У вопроса дети ещё лежат в потоке
+struct merge_node_t
+{
+    bool is_nil;
+    bool is_leaf;
+    char* phrase;
+};
+
+enum merge_frame_type
+{
+    MERGE_FRAME_COPY      = 0, // вопрос одной базы переписывается как есть
+    MERGE_FRAME_EQUAL     = 1, // одинаковые вопросы: ответы сливаются попарно
+    MERGE_FRAME_DIFFERENT = 2, // вопрос второй базы над поддеревом первой
+    MERGE_FRAME_GRAFT     = 3, // различающий вопрос: по "да" объект, по "нет" поддерево
+};
+
+// Вопрос, у которого ещё не выведены ответы. Рекурсии нет: глубина базы ограничена только памятью
+struct merge_frame_t
+{
+    merge_frame_type type;
+    merge_side side;       // у COPY и GRAFT - база, из которой читаются ответы
+    int child;             // сколько ответов уже выведено
+    merge_node_t pending;  // у DIFFERENT и GRAFT - уже прочитанное поддерево для ответа "нет"
+};
+
+struct merge_context_t
+{
+    merge_stream_t first;
+    merge_stream_t second;
+    FILE* output;
+    merge_report_t* report;
+
+    merge_frame_t* frames;
+    size_t number_of_frames;
+    size_t frames_capacity;
+
+    merge_object_t* objects; // объекты, которые вывели только из одной базы
+    size_t number_of_objects;
+    size_t objects_capacity;
+};
+
+struct merge_path_step_t
+{
+    char* question;
+    bool answer;
+};
+
+// ============================STREAM===========================================
+
+static tree_error_type open_merge_stream(merge_stream_t* stream, const char* filename)
+{
+    *stream = {};
+    stream -> filename = filename;
+
+    stream -> file = fopen(filename, "rb"); // двоичный режим - чтобы позиции для fseek были честными
+    if (stream -> file == NULL)
+        return TREE_ERROR_OPENING_FILE;
+
+    stream -> buffer = (char*)calloc(MERGE_STREAM_BUFFER_SIZE, sizeof(char));
+    if (stream -> buffer == NULL)
+    {
+        fclose(stream -> file);
+        stream -> file = NULL;
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+static void close_merge_stream(merge_stream_t* stream)
+{
+    if (stream -> file != NULL)
+        fclose(stream -> file);
+
+    free(stream -> buffer);
+    *stream = {};
+}
+
+
+static int stream_get(merge_stream_t* stream)
+{
+    if (stream -> position == stream -> size)
+    {
+        stream -> offset  += stream -> size;
+        stream -> size     = fread(stream -> buffer, sizeof(char), MERGE_STREAM_BUFFER_SIZE, stream -> file);
+        stream -> position = 0;
+
+        if (stream -> size == 0)
+            return EOF;
+    }
+
+    return (unsigned char)stream -> buffer[stream -> position++];
+}
+
+
+static int stream_peek_not_space(merge_stream_t* stream)
+{
+    int symbol = stream_get(stream);
+    while (symbol != EOF && isspace(symbol))
+        symbol = stream_get(stream);
+
+    if (symbol != EOF)
+        stream -> position--; // символ всегда из текущего буфера, вернуть его можно
+
+    return symbol;
+}
+
+
+static size_t stream_tell(const merge_stream_t* stream)
+{
+    return stream -> offset + stream -> position;
+}
+
+
+static tree_error_type stream_seek(merge_stream_t* stream, size_t position)
+{
+    if (position >= stream -> offset && position <= stream -> offset + stream -> size)
+    {
+        stream -> position = position - stream -> offset;
+        return TREE_NO_ERROR;
+    }
+
+    if (fseek(stream -> file, (long)position, SEEK_SET) != 0)
+        return TREE_ERROR_OPENING_FILE;
+
+    stream -> offset   = position;
+    stream -> size     = 0;
+    stream -> position = 0;
+
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type report_stream_syntax_error(const merge_stream_t* stream)
+{
+    fprintf(stderr, "Merge: syntax error in %s near byte %zu\n", stream -> filename, stream -> offset + stream -> position);
+    return TREE_ERROR_SYNTAX;
+}
+
+
+static tree_error_type expect_stream_word(merge_stream_t* stream, const char* word)
+{
+    stream_peek_not_space(stream);
+
+    for (const char* symbol = word; *symbol != '\0'; symbol++)
+    {
+        if (stream_get(stream) != (unsigned char)*symbol)
+            return report_stream_syntax_error(stream);
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+// Экранирование то же, что у tree_parse
+static tree_error_type read_stream_phrase(merge_stream_t* stream, char** phrase)
+{
+    size_t capacity = MERGE_INITIAL_PHRASE_SIZE;
+    size_t length = 0;
+    char* buffer = (char*)calloc(capacity, sizeof(char));
+    if (buffer == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    int symbol = stream_get(stream);
+    while (symbol != '"')
+    {
+        if (symbol == EOF)
+        {
+            free(buffer);
+            return report_stream_syntax_error(stream);
+        }
+
+        if (length + 1 == capacity)
+        {
+            char* new_buffer = (char*)realloc(buffer, capacity * 2);
+            if (new_buffer == NULL)
+            {
+                free(buffer);
+                return TREE_ERROR_ALLOCATION;
+            }
+
+            buffer = new_buffer;
+            capacity *= 2;
+        }
+
+        if (symbol == '\\')
+        {
+            int next = stream_get(stream);
+            int value = tree_phrase_escape_value(next);
+
+            if (value >= 0)
+            {
+                symbol = value;
+            }
+            else if (next != EOF)
+            {
+                stream -> position--; // не экранирование: обратная косая черта остаётся как есть
+            }
+        }
+
+        buffer[length++] = (char)symbol;
+        symbol = stream_get(stream);
+    }
+
+    buffer[length] = '\0';
+    *phrase = buffer;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Читаем "(фраза" и сразу смотрим, лист ли это: у листа дальше идут "nil nil)"
+static tree_error_type read_merge_node(merge_stream_t* stream, merge_node_t* node)
+{
+    *node = {};
+
+    int symbol = stream_peek_not_space(stream);
+    if (symbol == 'n')
+    {
+        node -> is_nil = true;
+        return expect_stream_word(stream, "nil");
+    }
+
+    tree_error_type result = expect_stream_word(stream, "(");
+    if (result == TREE_NO_ERROR)
+        result = expect_stream_word(stream, "\"");
+    if (result == TREE_NO_ERROR)
+        result = read_stream_phrase(stream, &node -> phrase);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    if (stream_peek_not_space(stream) == 'n')
+    {
+        node -> is_leaf = true;
+
+        result = expect_stream_word(stream, "nil");
+        if (result == TREE_NO_ERROR)
+            result = expect_stream_word(stream, "nil"); // у вопроса ровно два ответа
+        if (result == TREE_NO_ERROR)
+            result = expect_stream_word(stream, ")");
+    }
+
+    if (result != TREE_NO_ERROR)
+    {
+        free(node -> phrase);
+        node -> phrase = NULL;
+    }
+
+    return result;
+}
+
+// ============================OUTPUT===========================================
+
+static uint64_t hash_object_name(const char* name)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (const char* symbol = name; *symbol != '\0'; symbol++)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)*symbol);
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+static bool equal_phrases(const char* first, const char* second)
+{
+    for (; *first != '\0' && *second != '\0'; first++, second++)
+    {
+        if (tolower((unsigned char)*first) != tolower((unsigned char)*second))
+            return false;
+    }
+
+    return *first == *second;
+}
+
+
+// Формат тот же, что у save_tree_to_file, но без разбора форматной строки на каждый узел
+static void write_quoted_phrase(FILE* output, const char* prefix, const char* phrase)
+{
+    fputs("(\"", output);
+    tree_write_phrase(output, prefix);
+    tree_write_phrase(output, phrase);
+    fputc('"', output);
+}
+
+
+static uint64_t make_object_key(const char* name, merge_side side)
+{
+    return (hash_object_name(name) << 1) | (side == MERGE_SIDE_SECOND ? 1 : 0);
+}
+
+
+static tree_error_type remember_one_sided_object(merge_context_t* context, const char* name, merge_side side)
+{
+    if (context -> number_of_objects == context -> objects_capacity)
+    {
+        size_t new_capacity = (context -> objects_capacity == 0) ? 64 : context -> objects_capacity * 2;
+        merge_object_t* new_objects = (merge_object_t*)realloc(context -> objects, new_capacity * sizeof(merge_object_t));
+        if (new_objects == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        context -> objects = new_objects;
+        context -> objects_capacity = new_capacity;
+    }
+
+    context -> objects[context -> number_of_objects++] = {make_object_key(name, side)};
+    return TREE_NO_ERROR;
+}
+
+
+static tree_error_type write_leaf(merge_context_t* context, const char* name, merge_side side, bool one_sided)
+{
+    write_quoted_phrase(context -> output, "", name);
+    fputs(" nil nil)", context -> output);
+    context -> report -> number_of_output_nodes++;
+
+    return one_sided ? remember_one_sided_object(context, name, side) : TREE_NO_ERROR;
+}
+
+
+static void write_question_begin(merge_context_t* context, const char* question)
+{
+    write_quoted_phrase(context -> output, "", question);
+    fputc(' ', context -> output);
+    context -> report -> number_of_output_nodes++;
+}
+
+
+static void write_distinguishing_question(merge_context_t* context, const char* object)
+{
+    write_quoted_phrase(context -> output, "is it ", object);
+    fputc(' ', context -> output);
+    context -> report -> number_of_output_nodes++;
+    context -> report -> number_of_grafted_nodes++;
+}
+
+// ============================MERGE===========================================
+
+static merge_stream_t* side_stream(merge_context_t* context, merge_side side)
+{
+    return (side == MERGE_SIDE_FIRST) ? &context -> first : &context -> second;
+}
+
+
+static tree_error_type push_merge_frame(merge_context_t* context, merge_frame_type type, merge_side side,
+                                        int child, merge_node_t* pending)
+{
+    if (context -> number_of_frames == context -> frames_capacity)
+    {
+        size_t new_capacity = (context -> frames_capacity == 0) ? MERGE_INITIAL_DEPTH : 2 * context -> frames_capacity;
+
+        merge_frame_t* new_frames = (merge_frame_t*)realloc(context -> frames, new_capacity * sizeof(merge_frame_t));
+        if (new_frames == NULL)
+        {
+            if (pending != NULL)
+                free(pending -> phrase);
+            return TREE_ERROR_ALLOCATION;
+        }
+
+        context -> frames = new_frames;
+        context -> frames_capacity = new_capacity;
+    }
+
+    merge_frame_t* frame = &context -> frames[context -> number_of_frames++];
+    *frame = {type, side, child, {}};
+
+    if (pending != NULL)
+        frame -> pending = *pending;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Поддерево, которое есть только в одной базе, переписываем как есть.
+// Лист выводится сразу, у вопроса ответы дочитывает merge_trees
+static tree_error_type start_copy(merge_context_t* context, merge_side side, merge_node_t* node)
+{
+    if (node -> is_nil)
+    {
+        fputs("nil", context -> output);
+        return TREE_NO_ERROR;
+    }
+
+    if (node -> is_leaf)
+    {
+        tree_error_type result = write_leaf(context, node -> phrase, side, true);
+        free(node -> phrase);
+        return result;
+    }
+
+    write_question_begin(context, node -> phrase);
+    free(node -> phrase);
+
+    return push_merge_frame(context, MERGE_FRAME_COPY, side, 0, NULL);
+}
+
+
+// Ищем объект в детях уже прочитанного вопроса, ничего не выводя. Хватает счётчика открытых
+// вопросов: разметку скобок проверит копирование, которое после просмотра идёт всегда
+static tree_error_type find_object_in_children(merge_stream_t* stream, const char* object, bool* found)
+{
+    tree_error_type result = TREE_NO_ERROR;
+    size_t depth = 1;
+
+    while (result == TREE_NO_ERROR && depth > 0 && !*found)
+    {
+        if (stream_peek_not_space(stream) == ')')
+        {
+            result = expect_stream_word(stream, ")");
+            depth--;
+            continue;
+        }
+
+        merge_node_t node = {};
+
+        result = read_merge_node(stream, &node);
+        if (result != TREE_NO_ERROR || node.is_nil)
+            continue;
+
+        if (node.is_leaf)
+            *found = equal_phrases(node.phrase, object);
+        else
+            depth++;
+
+        free(node.phrase);
+    }
+
+    return result;
+}
+
+
+// Заглядываем вперёд и возвращаемся: каждое поддерево так просматривается не больше одного раза,
+// поэтому лишнего чтения - не больше размера файла, а памяти - ничего
+static tree_error_type subtree_contains_object(merge_stream_t* stream, const char* object, bool* found)
+{
+    *found = false;
+
+    size_t start = stream_tell(stream);
+
+    tree_error_type result = find_object_in_children(stream, object, found);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    return stream_seek(stream, start);
+}
+
+
+// Объект одной базы оказался там, где у другой целое поддерево: вешаем его над поддеревом
+static tree_error_type start_graft(merge_context_t* context, merge_node_t* object, merge_side object_side,
+                                   merge_node_t* subtree, merge_side subtree_side)
+{
+    bool is_known = false;
+
+    tree_error_type result = TREE_NO_ERROR;
+    if (!subtree -> is_leaf)
+        result = subtree_contains_object(side_stream(context, subtree_side), object -> phrase, &is_known);
+
+    // другая база уже уточнила этот объект дальше по тому же пути - её поддерево и берём
+    if (result == TREE_NO_ERROR && is_known)
+    {
+        context -> report -> number_of_aligned_nodes++;
+        free(object -> phrase);
+        return start_copy(context, subtree_side, subtree);
+    }
+
+    if (result != TREE_NO_ERROR)
+    {
+        free(object -> phrase);
+        free(subtree -> phrase);
+        return result;
+    }
+
+    write_distinguishing_question(context, object -> phrase);
+
+    result = write_leaf(context, object -> phrase, object_side, true);
+    free(object -> phrase);
+
+    if (result != TREE_NO_ERROR)
+    {
+        free(subtree -> phrase);
+        return result;
+    }
+
+    // ответ "да" уже выведен, по "нет" пойдёт поддерево
+    return push_merge_frame(context, MERGE_FRAME_GRAFT, subtree_side, 1, subtree);
+}
+
+
+static tree_error_type start_equal_questions(merge_context_t* context, merge_node_t* first, merge_node_t* second)
+{
+    write_question_begin(context, first -> phrase);
+    context -> report -> number_of_aligned_nodes++;
+
+    free(first -> phrase);
+    free(second -> phrase);
+
+    return push_merge_frame(context, MERGE_FRAME_EQUAL, MERGE_SIDE_FIRST, 0, NULL);
+}
+
+
+// Вопросы разные: вопрос второй базы ставим выше, как при обучении - новый признак над старым
+// поддеревом. Его объекты не знают ответа на новый вопрос и уходят по "нет" вместе с no-веткой второй базы
+static tree_error_type start_different_questions(merge_context_t* context, merge_node_t* first, merge_node_t* second)
+{
+    write_question_begin(context, second -> phrase);
+    free(second -> phrase);
+
+    return push_merge_frame(context, MERGE_FRAME_DIFFERENT, MERGE_SIDE_SECOND, 0, first);
+}
+
+
+static tree_error_type start_merge(merge_context_t* context, merge_node_t* first, merge_node_t* second)
+{
+    if (first -> is_nil)
+        return start_copy(context, MERGE_SIDE_SECOND, second);
+
+    if (second -> is_nil)
+        return start_copy(context, MERGE_SIDE_FIRST, first);
+
+    if (first -> is_leaf && second -> is_leaf)
+    {
+        tree_error_type result = TREE_NO_ERROR;
+
+        if (equal_phrases(first -> phrase, second -> phrase))
+        {
+            context -> report -> number_of_aligned_nodes++;
+            result = write_leaf(context, first -> phrase, MERGE_SIDE_FIRST, false);
+            free(first -> phrase);
+            free(second -> phrase);
+            return result;
+        }
+
+        return start_graft(context, second, MERGE_SIDE_SECOND, first, MERGE_SIDE_FIRST);
+    }
+
+    if (second -> is_leaf)
+        return start_graft(context, second, MERGE_SIDE_SECOND, first, MERGE_SIDE_FIRST);
+
+    if (first -> is_leaf)
+        return start_graft(context, first, MERGE_SIDE_FIRST, second, MERGE_SIDE_SECOND);
+
+    if (equal_phrases(first -> phrase, second -> phrase))
+        return start_equal_questions(context, first, second);
+
+    return start_different_questions(context, first, second);
+}
+
+
+static tree_error_type read_both_nodes(merge_context_t* context, merge_node_t* first, merge_node_t* second)
+{
+    tree_error_type result = read_merge_node(&context -> first, first);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    result = read_merge_node(&context -> second, second);
+    if (result != TREE_NO_ERROR)
+        free(first -> phrase);
+
+    return result;
+}
+
+
+// Следующий ответ вопроса на вершине стека. Кадр копируем: новый кадр может переложить массив
+static tree_error_type continue_merge_frame(merge_context_t* context)
+{
+    merge_frame_t* top = &context -> frames[context -> number_of_frames - 1];
+    merge_frame_t frame = *top;
+
+    top -> child++;
+
+    if (frame.child == 1)
+    {
+        top -> pending = {}; // поддерево для "нет" теперь у frame
+        fputc(' ', context -> output);
+    }
+
+    merge_node_t first = {}, second = {};
+    tree_error_type result = TREE_NO_ERROR;
+
+    switch (frame.type)
+    {
+        case MERGE_FRAME_COPY:
+            result = read_merge_node(side_stream(context, frame.side), &first);
+            if (result == TREE_NO_ERROR)
+                result = start_copy(context, frame.side, &first);
+            break;
+
+        case MERGE_FRAME_EQUAL:
+            result = read_both_nodes(context, &first, &second);
+            if (result == TREE_NO_ERROR)
+                result = start_merge(context, &first, &second);
+            break;
+
+        case MERGE_FRAME_DIFFERENT:
+            result = read_merge_node(&context -> second, &second);
+            if (result != TREE_NO_ERROR)
+                free(frame.pending.phrase);
+            else if (frame.child == 0)
+                result = start_copy(context, MERGE_SIDE_SECOND, &second);
+            else
+                result = start_merge(context, &frame.pending, &second);
+            break;
+
+        case MERGE_FRAME_GRAFT:
+            result = start_copy(context, frame.side, &frame.pending);
+            break;
+
+        default:
+            assert(0 && "unknown merge frame");
+            break;
+    }
+
+    return result;
+}
+
+
+// Оба ответа выведены: закрываем вопрос в тех базах, из которых он прочитан
+static tree_error_type finish_merge_frame(merge_context_t* context)
+{
+    merge_frame_t frame = context -> frames[--context -> number_of_frames];
+
+    tree_error_type result = TREE_NO_ERROR;
+
+    if (frame.type == MERGE_FRAME_COPY)
+        result = expect_stream_word(side_stream(context, frame.side), ")");
+
+    if (frame.type == MERGE_FRAME_EQUAL)
+        result = expect_stream_word(&context -> first, ")");
+
+    if (result == TREE_NO_ERROR && (frame.type == MERGE_FRAME_EQUAL || frame.type == MERGE_FRAME_DIFFERENT))
+        result = expect_stream_word(&context -> second, ")");
+
+    fputc(')', context -> output);
+    return result;
+}
+
+
+static tree_error_type merge_trees(merge_context_t* context, merge_node_t* first, merge_node_t* second)
+{
+    tree_error_type result = start_merge(context, first, second);
+
+    while (result == TREE_NO_ERROR && context -> number_of_frames > 0)
+    {
+        if (context -> frames[context -> number_of_frames - 1].child == 2)
+            result = finish_merge_frame(context);
+        else
+            result = continue_merge_frame(context);
+    }
+
+    // после ошибки в стеке могут остаться прочитанные, но не выведенные поддеревья
+    for (size_t i = 0; i < context -> number_of_frames; i++)
+        free(context -> frames[i].pending.phrase);
+
+    context -> number_of_frames = 0;
+    return result;
+}
+
+// ============================CONFLICTS===========================================
+
+static int compare_merge_objects(const void* first, const void* second)
+{
+    const merge_object_t* first_object  = (const merge_object_t*)first;
+    const merge_object_t* second_object = (const merge_object_t*)second;
+
+    if (first_object -> key != second_object -> key)
+        return (first_object -> key < second_object -> key) ? -1 : 1;
+
+    return 0;
+}
+
+
+// Конфликт - объект, который из одной базы пришёл одним путём, а из другой - другим.
+// После сортировки в objects остаются только ключи таких объектов со сброшенным битом базы
+static size_t keep_conflicting_objects(merge_context_t* context)
+{
+    qsort(context -> objects, context -> number_of_objects, sizeof(merge_object_t), compare_merge_objects);
+
+    size_t number_of_conflicts = 0;
+
+    for (size_t i = 0; i < context -> number_of_objects; )
+    {
+        uint64_t hash = context -> objects[i].key >> 1;
+
+        size_t j = i;
+        while (j < context -> number_of_objects && context -> objects[j].key >> 1 == hash)
+            j++;
+
+        // ключи отсортированы, поэтому объект из первой базы - первым, из второй - последним
+        bool has_first  = (context -> objects[i].key & 1) == 0;
+        bool has_second = (context -> objects[j - 1].key & 1) == 1;
+
+        if (has_first && has_second)
+            context -> objects[number_of_conflicts++] = {hash << 1};
+
+        i = j;
+    }
+
+    context -> number_of_objects = number_of_conflicts;
+    return number_of_conflicts;
+}
+
+
+static bool is_conflicting_object(const merge_context_t* context, const char* name)
+{
+    merge_object_t key = {make_object_key(name, MERGE_SIDE_FIRST)};
+
+    return bsearch(&key, context -> objects, context -> number_of_objects, sizeof(merge_object_t),
+                   compare_merge_objects) != NULL;
+}
+
+
+static void print_conflict(FILE* stream, const char* object, const merge_path_step_t* path, size_t depth)
+{
+    fprintf(stream, "Conflict: \"%s\" reached by:", object);
+
+    for (size_t i = 0; i < depth; i++)
+        fprintf(stream, " %s%s", path[i].answer ? "" : "not ", path[i].question);
+
+    fprintf(stream, "\n");
+}
+
+
+// Второй проход по результату: печатаем пути к конфликтующим объектам.
+// path - вопросы от корня, answer - в какой ответ сейчас спустились
+static tree_error_type report_conflicts(merge_context_t* context, const char* output_filename, FILE* conflicts_stream)
+{
+    merge_stream_t stream = {};
+
+    tree_error_type result = open_merge_stream(&stream, output_filename);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    merge_path_step_t* path = NULL;
+    size_t path_capacity = 0;
+    size_t depth = 0;
+
+    do
+    {
+        merge_node_t node = {};
+
+        result = read_merge_node(&stream, &node);
+        if (result != TREE_NO_ERROR)
+            break;
+
+        if (!node.is_nil && !node.is_leaf)
+        {
+            if (depth == path_capacity)
+            {
+                size_t new_capacity = (path_capacity == 0) ? MERGE_INITIAL_DEPTH : path_capacity * 2;
+                merge_path_step_t* new_path = (merge_path_step_t*)realloc(path, new_capacity * sizeof(merge_path_step_t));
+                if (new_path == NULL)
+                {
+                    free(node.phrase);
+                    result = TREE_ERROR_ALLOCATION;
+                    break;
+                }
+
+                path = new_path;
+                path_capacity = new_capacity;
+            }
+
+            path[depth++] = {node.phrase, true};
+            continue;
+        }
+
+        if (node.is_leaf && is_conflicting_object(context, node.phrase))
+            print_conflict(conflicts_stream, node.phrase, path, depth);
+
+        free(node.phrase);
+
+        // поднимаемся до вопроса, у которого ещё не прочитан ответ "нет"
+        while (result == TREE_NO_ERROR && depth > 0 && !path[depth - 1].answer)
+        {
+            free(path[--depth].question);
+            result = expect_stream_word(&stream, ")");
+        }
+
+        if (depth > 0)
+            path[depth - 1].answer = false;
+    }
+    while (result == TREE_NO_ERROR && depth > 0);
+
+    for (size_t i = 0; i < depth; i++)
+        free(path[i].question);
+
+    free(path);
+    close_merge_stream(&stream);
+
+    return result;
+}
+
+// ============================API===========================================
+
+tree_error_type merge_databases(const char* first_filename, const char* second_filename,
+                                const char* output_filename, FILE* conflicts_stream, merge_report_t* report)
+{
+    assert(first_filename  != NULL);
+    assert(second_filename != NULL);
+    assert(output_filename != NULL);
+    assert(report          != NULL);
+
+    *report = {};
+
+    merge_context_t context = {};
+    context.report = report;
+
+    tree_error_type result = open_merge_stream(&context.first, first_filename);
+    if (result == TREE_NO_ERROR)
+        result = open_merge_stream(&context.second, second_filename);
+
+    if (result == TREE_NO_ERROR)
+    {
+        context.output = fopen(output_filename, "w");
+        if (context.output == NULL)
+            result = TREE_ERROR_OPENING_FILE;
+        else
+            setvbuf(context.output, NULL, _IOFBF, MERGE_STREAM_BUFFER_SIZE);
+    }
+
+    merge_node_t first_root = {}, second_root = {};
+
+    if (result == TREE_NO_ERROR)
+        result = read_merge_node(&context.first, &first_root);
+    if (result == TREE_NO_ERROR)
+    {
+        result = read_merge_node(&context.second, &second_root);
+        if (result != TREE_NO_ERROR)
+            free(first_root.phrase);
+    }
+
+    if (result == TREE_NO_ERROR)
+        result = merge_trees(&context, &first_root, &second_root);
+
+    if (context.output != NULL)
+        fclose(context.output);
+
+    close_merge_stream(&context.first);
+    close_merge_stream(&context.second);
+
+    if (result == TREE_NO_ERROR)
+    {
+        report -> number_of_conflicts = keep_conflicting_objects(&context);
+
+        if (report -> number_of_conflicts > 0 && conflicts_stream != NULL)
+            result = report_conflicts(&context, output_filename, conflicts_stream);
+    }
+
+    free(context.frames);
+    free(context.objects);
+    return result;
+}
+
+
+void merge_report_print(const merge_report_t* report, FILE* stream)
+{
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "Merged tree: %zu nodes, %zu aligned, %zu new distinguishing questions, %zu conflicts\n",
+                    report -> number_of_output_nodes, report -> number_of_aligned_nodes,
+                    report -> number_of_grafted_nodes, report -> number_of_conflicts);
+}
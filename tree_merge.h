@@ -0,0 +1,51 @@
+#ifndef TREE_MERGE_H_
+#define TREE_MERGE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define MERGE_STREAM_BUFFER_SIZE (64 * 1024)
+#define MERGE_INITIAL_PHRASE_SIZE 64
+#define MERGE_INITIAL_DEPTH 64
+
+enum merge_side
+{
+    MERGE_SIDE_FIRST  = 1,
+    MERGE_SIDE_SECOND = 2,
+};
+
+// Базы читаются потоково прямо из файлов, деревья в память не загружаются:
+// память - это глубина дерева плюс объекты, которые встретились только в одной из баз
+struct merge_stream_t
+{
+    FILE* file;
+    const char* filename;
+    char* buffer;
+    size_t size;
+    size_t position;
+    size_t offset; // сколько байт файла уже прочитано до buffer
+};
+
+// Хэш имени объекта, в младшем бите - база, из которой он пришёл: 8 байт на объект
+struct merge_object_t
+{
+    uint64_t key;
+};
+
+struct merge_report_t
+{
+    size_t number_of_output_nodes;
+    size_t number_of_aligned_nodes;  // одинаковые вопросы и объекты на одинаковых путях
+    size_t number_of_grafted_nodes;  // новые различающие вопросы
+    size_t number_of_conflicts;      // объект есть в обеих базах, но на разных путях
+};
+
+tree_error_type merge_databases(const char* first_filename, const char* second_filename,
+                                const char* output_filename, FILE* conflicts_stream, merge_report_t* report);
+void merge_report_print(const merge_report_t* report, FILE* stream);
+
+#endif // TREE_MERGE_H_
@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_parser.h"
+#include "tree_scan.h"
+#include "tree_error_type.h"
+
+// Вопрос, у которого ещё не дочитаны ответы
+struct parser_frame_t
+{
+    node_t* node;
+    int children; // сколько ответов уже прочитано
+};
+
+struct tree_parser_t
+{
+    const char* text;
+    const char* position;
+    const char* end;
+
+    char* phrase; // фраза без экранирования, буфер растёт под самую длинную
+    size_t phrase_capacity;
+
+    parser_frame_t* frames;
+    size_t depth;
+    size_t frames_capacity;
+
+    node_t* root;
+    size_t number_of_nodes;
+    tree_parse_error_t* error;
+};
+
+// ============================ERRORS===========================================
+
+// Строку и столбец считаем только при ошибке, чтобы не платить за них на каждом символе
+static tree_error_type parser_fail(tree_parser_t* parser, const char* position, const char* message)
+{
+    tree_parse_error_t* error = parser -> error;
+
+    error -> offset  = (size_t)(position - parser -> text);
+    error -> message = message;
+    error -> line    = 1;
+
+    const char* line_start = parser -> text;
+    for (const char* symbol = parser -> text; symbol < position; symbol++)
+    {
+        if (*symbol == '\n')
+        {
+            error -> line++;
+            line_start = symbol + 1;
+        }
+    }
+
+    error -> column = (size_t)(position - line_start) + 1;
+
+    return TREE_ERROR_SYNTAX;
+}
+
+
+void tree_parse_error_print(const tree_parse_error_t* error, const char* filename, FILE* stream)
+{
+    assert(error    != NULL);
+    assert(filename != NULL);
+    assert(stream   != NULL);
+
+    fprintf(stream, "Syntax error in %s at line %zu, column %zu: %s\n", filename, error -> line, error -> column,
+                    (error -> message != NULL) ? error -> message : "unknown error");
+}
+
+// ============================LEXER============================================
+
+static bool is_space(char symbol)
+{
+    return symbol == ' ' || symbol == '\n' || symbol == '\r' || symbol == '\t' || symbol == '\v' || symbol == '\f';
+}
+
+
+static void skip_spaces(tree_parser_t* parser)
+{
+    while (parser -> position < parser -> end && is_space(*parser -> position))
+        parser -> position++;
+}
+
+
+int tree_phrase_escape_value(int symbol)
+{
+    switch (symbol)
+    {
+        case '"':  return '"';
+        case '\\': return '\\';
+        case 'n':  return '\n';
+        case 't':  return '\t';
+        default:   return -1;
+    }
+}
+
+
+static tree_error_type reserve_phrase(tree_parser_t* parser, size_t length)
+{
+    if (length < parser -> phrase_capacity)
+        return TREE_NO_ERROR;
+
+    size_t new_capacity = (parser -> phrase_capacity == 0) ? PARSER_INITIAL_PHRASE_SIZE : parser -> phrase_capacity;
+    while (new_capacity <= length)
+        new_capacity *= 2;
+
+    char* new_phrase = (char*)realloc(parser -> phrase, new_capacity);
+    if (new_phrase == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    parser -> phrase = new_phrase;
+    parser -> phrase_capacity = new_capacity;
+
+    return TREE_NO_ERROR;
+}
+
+
+// Стоим на открывающей кавычке. Куски без экранирования копируются целиком
+static tree_error_type read_phrase(tree_parser_t* parser, size_t* length)
+{
+    const char* opening_quote = parser -> position++;
+    size_t phrase_length = 0;
+
+    while (true)
+    {
+        const char* run = parser -> position;
+        while (parser -> position < parser -> end && *parser -> position != '"' &&
+               *parser -> position != '\\' && *parser -> position != '\0')
+            parser -> position++;
+
+        size_t run_length = (size_t)(parser -> position - run);
+        if (reserve_phrase(parser, phrase_length + run_length + 1) != TREE_NO_ERROR)
+            return TREE_ERROR_ALLOCATION;
+
+        memcpy(parser -> phrase + phrase_length, run, run_length);
+        phrase_length += run_length;
+
+        if (parser -> position == parser -> end)
+            return parser_fail(parser, opening_quote, "phrase has no closing quote");
+
+        char symbol = *parser -> position;
+        if (symbol == '"')
+            break;
+
+        if (symbol == '\0')
+            return parser_fail(parser, parser -> position, "zero byte inside a phrase");
+
+        // обратная косая черта
+        int value = (parser -> position + 1 < parser -> end) ? tree_phrase_escape_value((unsigned char)parser -> position[1]) : -1;
+        if (value >= 0)
+        {
+            parser -> phrase[phrase_length++] = (char)value;
+            parser -> position += 2;
+        }
+        else
+        {
+            parser -> phrase[phrase_length++] = '\\';
+            parser -> position++;
+        }
+    }
+
+    parser -> position++; // закрывающая кавычка
+
+    if (phrase_length == 0)
+        return parser_fail(parser, opening_quote, "empty phrase");
+
+    parser -> phrase[phrase_length] = '\0';
+    *length = phrase_length;
+
+    return TREE_NO_ERROR;
+}
+
+// ============================TREE=============================================
+
+static tree_error_type push_frame(tree_parser_t* parser, node_t* node)
+{
+    if (parser -> depth == parser -> frames_capacity)
+    {
+        size_t new_capacity = (parser -> frames_capacity == 0) ? PARSER_INITIAL_DEPTH : 2 * parser -> frames_capacity;
+
+        parser_frame_t* new_frames = (parser_frame_t*)realloc(parser -> frames, new_capacity * sizeof(parser_frame_t));
+        if (new_frames == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        parser -> frames = new_frames;
+        parser -> frames_capacity = new_capacity;
+    }
+
+    parser -> frames[parser -> depth++] = {node, 0};
+
+    return TREE_NO_ERROR;
+}
+
+
+// Узел сразу подвешивается к дереву: при ошибке всё прочитанное освобождается одним вызовом.
+// phrase - уже без экранирования, завершающий ноль не нужен
+static tree_error_type create_parsed_node(tree_parser_t* parser, const char* phrase, size_t length)
+{
+    node_t* node = (node_t*)calloc(1, sizeof(node_t));
+    if (node == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    node -> question = (char*)malloc(length + 1);
+    if (node -> question == NULL)
+    {
+        free(node);
+        return TREE_ERROR_ALLOCATION;
+    }
+    memcpy(node -> question, phrase, length);
+    node -> question[length] = '\0';
+
+    if (parser -> depth == 0)
+    {
+        parser -> root = node;
+    }
+    else
+    {
+        parser_frame_t* parent = &parser -> frames[parser -> depth - 1];
+
+        node -> parent = parent -> node;
+        if (parent -> children == 0)
+            parent -> node -> yes = node;
+        else
+            parent -> node -> no = node;
+    }
+
+    parser -> number_of_nodes++;
+
+    return push_frame(parser, node);
+}
+
+
+// Одна ветка: ("фраза" ... или nil. У вопроса дальше читаются его ответы
+static tree_error_type read_branch(tree_parser_t* parser)
+{
+    skip_spaces(parser);
+
+    if (parser -> position == parser -> end)
+        return parser_fail(parser, parser -> position, "unexpected end of file, expected '(' or nil");
+
+    if (*parser -> position == '(')
+    {
+        parser -> position++;
+        skip_spaces(parser);
+
+        if (parser -> position == parser -> end || *parser -> position != '"')
+            return parser_fail(parser, parser -> position, "expected '\"' after '('");
+
+        size_t length = 0;
+        tree_error_type result = read_phrase(parser, &length);
+        if (result != TREE_NO_ERROR)
+            return result;
+
+        return create_parsed_node(parser, parser -> phrase, length);
+    }
+
+    if (parser -> end - parser -> position >= 3 && memcmp(parser -> position, "nil", 3) == 0)
+    {
+        if (parser -> depth == 0)
+            return parser_fail(parser, parser -> position, "the database is empty: root is nil");
+
+        parser -> position += 3;
+        parser -> frames[parser -> depth - 1].children++;
+        return TREE_NO_ERROR;
+    }
+
+    return parser_fail(parser, parser -> position, "expected '(' or nil");
+}
+
+
+// После обоих ответов ждём ')' и поднимаемся, пока не найдём вопрос с недочитанным ответом
+static tree_error_type close_finished_questions(tree_parser_t* parser)
+{
+    while (parser -> depth > 0 && parser -> frames[parser -> depth - 1].children == 2)
+    {
+        skip_spaces(parser);
+
+        if (parser -> position == parser -> end || *parser -> position != ')')
+            return parser_fail(parser, parser -> position, "expected ')' after two answers");
+
+        parser -> position++;
+        parser -> depth--;
+
+        if (parser -> depth > 0)
+            parser -> frames[parser -> depth - 1].children++;
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+// Посимвольный разбор. Он же ищет место и причину ошибки, если её нашёл разбор по индексу
+static tree_error_type parse_by_symbols(tree_parser_t* parser)
+{
+    tree_error_type result = TREE_NO_ERROR;
+
+    do
+    {
+        result = read_branch(parser);
+        if (result == TREE_NO_ERROR)
+            result = close_finished_questions(parser);
+    }
+    while (result == TREE_NO_ERROR && parser -> depth > 0);
+
+    if (result == TREE_NO_ERROR)
+    {
+        skip_spaces(parser);
+        if (parser -> position != parser -> end)
+            result = parser_fail(parser, parser -> position, "extra characters after the tree");
+    }
+
+    return result;
+}
+
+// ============================STRUCTURAL INDEX=================================
+
+// Разбор по позициям из tree_scan: пробелы между ними уже проверены сканером,
+// фраза без экранирования копируется в узел прямо из текста.
+// Здесь на любую ошибку просто TREE_ERROR_SYNTAX, без места и текста
+
+static bool is_word_symbol(char symbol)
+{
+    return !is_space(symbol) && symbol != '(' && symbol != ')' && symbol != '"';
+}
+
+
+// opening - открывающая кавычка. В индексе дальше только \ и нули внутри фразы и закрывающая кавычка
+static tree_error_type read_indexed_phrase(tree_parser_t* parser, tree_scanner_t* scanner, size_t opening)
+{
+    const char* text = parser -> text;
+    size_t length = (size_t)(parser -> end - text);
+
+    size_t run = opening + 1;
+    size_t phrase_length = 0;
+    bool is_decoded = false;
+
+    while (true)
+    {
+        size_t position = tree_scanner_next(scanner);
+        if (position == SCAN_END || text[position] == '\0')
+            return TREE_ERROR_SYNTAX;
+
+        if (text[position] == '"' && !is_decoded)
+        {
+            if (position == run)
+                return TREE_ERROR_SYNTAX;
+
+            return create_parsed_node(parser, text + run, position - run);
+        }
+
+        if (reserve_phrase(parser, phrase_length + (position - run) + 1) != TREE_NO_ERROR)
+            return TREE_ERROR_ALLOCATION;
+
+        memcpy(parser -> phrase + phrase_length, text + run, position - run);
+        phrase_length += position - run;
+
+        if (text[position] == '"')
+            break;
+
+        // обратная косая черта; экранированные \ и " сканер в индекс не кладёт
+        int value = (position + 1 < length) ? tree_phrase_escape_value((unsigned char)text[position + 1]) : -1;
+        parser -> phrase[phrase_length++] = (value >= 0) ? (char)value : '\\';
+        run = (value >= 0) ? position + 2 : position + 1;
+        is_decoded = true;
+    }
+
+    return create_parsed_node(parser, parser -> phrase, phrase_length);
+}
+
+
+// В индексе только начало слова, а посимвольный разбор читает "nilnil" как две ветки.
+// Поэтому после nil посреди слова следующая позиция - сразу за ним
+static size_t next_position(tree_scanner_t* scanner, size_t* word_rest)
+{
+    size_t position = *word_rest;
+    *word_rest = SCAN_END;
+
+    return (position != SCAN_END) ? position : tree_scanner_next(scanner);
+}
+
+
+static tree_error_type parse_by_index(tree_parser_t* parser, tree_scanner_t* scanner)
+{
+    const char* text = parser -> text;
+    size_t length = (size_t)(parser -> end - text);
+    size_t word_rest = SCAN_END;
+
+    do
+    {
+        size_t position = next_position(scanner, &word_rest);
+        if (position == SCAN_END)
+            return TREE_ERROR_SYNTAX;
+
+        if (text[position] == '(')
+        {
+            size_t quote = tree_scanner_next(scanner);
+            if (quote == SCAN_END || text[quote] != '"')
+                return TREE_ERROR_SYNTAX;
+
+            tree_error_type result = read_indexed_phrase(parser, scanner, quote);
+            if (result != TREE_NO_ERROR)
+                return result;
+        }
+        else if (length - position >= 3 && memcmp(text + position, "nil", 3) == 0 && parser -> depth > 0)
+        {
+            parser -> frames[parser -> depth - 1].children++;
+
+            if (length - position > 3 && is_word_symbol(text[position + 3]))
+                word_rest = position + 3;
+        }
+        else
+            return TREE_ERROR_SYNTAX;
+
+        while (parser -> depth > 0 && parser -> frames[parser -> depth - 1].children == 2)
+        {
+            size_t closing = next_position(scanner, &word_rest);
+            if (closing == SCAN_END || text[closing] != ')')
+                return TREE_ERROR_SYNTAX;
+
+            parser -> depth--;
+            if (parser -> depth > 0)
+                parser -> frames[parser -> depth - 1].children++;
+        }
+    }
+    while (parser -> depth > 0);
+
+    return (next_position(scanner, &word_rest) == SCAN_END) ? TREE_NO_ERROR : TREE_ERROR_SYNTAX;
+}
+
+// ============================PARSE============================================
+
+static void parser_reset_tree(tree_parser_t* parser)
+{
+    tree_parse_destroy(parser -> root);
+
+    parser -> root = NULL;
+    parser -> number_of_nodes = 0;
+    parser -> depth = 0;
+    parser -> position = parser -> text;
+}
+
+
+// Сначала разбор по структурному индексу. Ошибки в базах редки, поэтому их место и текст
+// ищет посимвольный разбор заново с начала: сообщения не зависят от набора инструкций.
+// Без SIMD индекс строится дольше, чем идёт весь посимвольный разбор, и его не строим
+tree_error_type tree_parse(const char* text, size_t length, node_t** root, size_t* number_of_nodes, tree_parse_error_t* error)
+{
+    assert(text  != NULL);
+    assert(root  != NULL);
+    assert(error != NULL);
+
+    *error = {};
+
+    tree_parser_t parser = {};
+    parser.text     = text;
+    parser.position = text;
+    parser.end      = text + length;
+    parser.error    = error;
+
+    tree_error_type result = TREE_NO_ERROR;
+
+    if (tree_scan_current() == TREE_SCAN_NONE)
+        result = parse_by_symbols(&parser);
+    else
+    {
+        tree_scanner_t scanner = {};
+        result = tree_scanner_init(&scanner, text, length);
+
+        if (result == TREE_NO_ERROR)
+            result = parse_by_index(&parser, &scanner);
+
+        tree_scanner_destroy(&scanner);
+
+        if (result == TREE_ERROR_SYNTAX)
+        {
+            parser_reset_tree(&parser);
+            result = parse_by_symbols(&parser);
+            assert(result != TREE_NO_ERROR && "structural index rejected a valid database");
+        }
+    }
+
+    free(parser.phrase);
+    free(parser.frames);
+
+    if (result != TREE_NO_ERROR)
+    {
+        if (result == TREE_ERROR_ALLOCATION)
+            error -> message = "out of memory";
+
+        tree_parse_destroy(parser.root);
+        return result;
+    }
+
+    *root = parser.root;
+    if (number_of_nodes != NULL)
+        *number_of_nodes = parser.number_of_nodes;
+
+    return TREE_NO_ERROR;
+}
+
+
+void tree_parse_destroy(node_t* root)
+{
+    node_t* node = root;
+
+    while (node != NULL)
+    {
+        if (node -> yes != NULL)
+        {
+            node_t* child = node -> yes;
+            node -> yes = NULL;
+            node = child;
+        }
+        else if (node -> no != NULL)
+        {
+            node_t* child = node -> no;
+            node -> no = NULL;
+            node = child;
+        }
+        else
+        {
+            node_t* parent = (node == root) ? NULL : node -> parent;
+
+            free(node -> question);
+            free(node);
+
+            node = parent;
+        }
+    }
+}
+
+// ============================WRITER===========================================
+
+void tree_write_phrase(FILE* file, const char* phrase)
+{
+    assert(file   != NULL);
+    assert(phrase != NULL);
+
+    const char* run = phrase;
+
+    for (const char* symbol = phrase; *symbol != '\0'; symbol++)
+    {
+        const char* escape = NULL;
+        switch (*symbol)
+        {
+            case '"':  escape = "\\\""; break;
+            case '\\': escape = "\\\\"; break;
+            case '\n': escape = "\\n";  break;
+            case '\t': escape = "\\t";  break;
+            default:   continue;
+        }
+
+        fwrite(run, sizeof(char), (size_t)(symbol - run), file);
+        fputs(escape, file);
+        run = symbol + 1;
+    }
+
+    fputs(run, file);
+}
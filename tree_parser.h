@@ -0,0 +1,39 @@
+#ifndef TREE_PARSER_H_
+#define TREE_PARSER_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define PARSER_INITIAL_PHRASE_SIZE 256
+#define PARSER_INITIAL_DEPTH 64
+
+// Где и почему разбор остановился. Строки и столбцы с 1, столбец - в байтах
+struct tree_parse_error_t
+{
+    size_t offset;
+    size_t line;
+    size_t column;
+    const char* message;
+};
+
+// Формат базы: узел - ("фраза" да нет), пустая ветка - nil.
+// Во фразе \" - кавычка, \\ - обратная косая черта, \n и \t - перевод строки и табуляция.
+// Остальные \x читаются как есть: так их понимали базы, записанные до экранирования.
+// Длина фраз и глубина дерева ограничены только памятью, разбор без рекурсии,
+// на вход - ровно length байт, завершающий ноль не нужен.
+// Текст сначала размечается структурным индексом (tree_scan.h), и разбор идёт по нему;
+// место ошибки ищет посимвольный разбор, так что сообщения одинаковы на любом процессоре
+tree_error_type tree_parse(const char* text, size_t length, node_t** root, size_t* number_of_nodes, tree_parse_error_t* error);
+void tree_parse_error_print(const tree_parse_error_t* error, const char* filename, FILE* stream);
+
+// Освобождает дерево без рекурсии, по ссылкам на родителя: годится и для недоразобранного
+void tree_parse_destroy(node_t* root);
+
+// Запись фразы в том же экранировании, без кавычек вокруг
+void tree_write_phrase(FILE* file, const char* phrase);
+int tree_phrase_escape_value(int symbol);
+
+#endif // TREE_PARSER_H_
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "tree.h"
+#include "tree_parser.h"
+#include "tree_scan.h"
+#include "tree_error_type.h"
+
+// Скорость tree_parse на корпусе баз:
+//     ./tree_parser_bench [--repeat N] [--synthetic NODES] [--scanner auto|none|scalar|sse2|avx2] [файл...]
+// Каждый файл читается в память один раз и разбирается N раз подряд, берётся лучшее время.
+// Отдельно меряется первая стадия - построение структурного индекса. Без --scanner -
+// посимвольный разбор (none) и все классификаторы, которые поддерживает процессор.
+// Без файлов разбирается сгенерированная база со скобками, экранированием и длинными фразами
+
+#define BENCH_DEFAULT_REPEAT 5
+#define BENCH_DEFAULT_SYNTHETIC_NODES 1000000
+
+struct bench_buffer_t
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+};
+
+struct bench_result_t
+{
+    size_t bytes;
+    size_t nodes;
+    double index_seconds;
+    double parse_seconds;
+};
+
+// ============================CORPUS===========================================
+
+static bool append_text(bench_buffer_t* buffer, const char* text, size_t length)
+{
+    if (buffer -> size + length > buffer -> capacity)
+    {
+        size_t new_capacity = (buffer -> capacity == 0) ? 4096 : buffer -> capacity;
+        while (new_capacity < buffer -> size + length)
+            new_capacity *= 2;
+
+        char* new_data = (char*)realloc(buffer -> data, new_capacity);
+        if (new_data == NULL)
+            return false;
+
+        buffer -> data = new_data;
+        buffer -> capacity = new_capacity;
+    }
+
+    memcpy(buffer -> data + buffer -> size, text, length);
+    buffer -> size += length;
+
+    return true;
+}
+
+
+static bool append_phrase(bench_buffer_t* buffer, size_t index)
+{
+    static const char* const words[] = {"Он ", "умеет ", "летать ", "\\\"быстро\\\" ", "в\\\\или ", "\\nночью ",
+                                        "живёт ", "под водой ", "и ", "носит ", "плащ ", "(иногда) "};
+    const size_t number_of_words = sizeof(words) / sizeof(words[0]);
+
+    size_t state = index * 2654435761u + 1;
+    size_t length = 2 + state % 7;
+
+    char number[MAX_LENGTH_OF_ADDRESS] = {};
+    int number_length = snprintf(number, sizeof(number), "%zu", index);
+
+    bool ok = append_text(buffer, "(\"", 2);
+    for (size_t i = 0; i < length && ok; i++)
+    {
+        const char* word = words[(state >> (3 * i)) % number_of_words];
+        ok = append_text(buffer, word, strlen(word));
+    }
+
+    return ok && append_text(buffer, number, (size_t)number_length) && append_text(buffer, "\" ", 2);
+}
+
+
+// Полное бинарное дерево из number_of_nodes узлов в том же виде, что пишет save_tree_to_file
+static bool generate_synthetic(bench_buffer_t* buffer, size_t number_of_nodes)
+{
+    size_t* stack = (size_t*)calloc(64 * 2, sizeof(size_t));
+    if (stack == NULL)
+        return false;
+
+    // В стеке номера узлов в нумерации кучи: ответы узла i - это 2i и 2i + 1. Ноль - закрыть скобку
+    size_t count = 0;
+    stack[count++] = 1;
+
+    bool ok = true;
+    while (count > 0 && ok)
+    {
+        size_t index = stack[--count];
+
+        if (index == 0)
+        {
+            ok = append_text(buffer, ") ", 2);
+            continue;
+        }
+
+        if (index > number_of_nodes)
+        {
+            ok = append_text(buffer, "nil ", 4);
+            continue;
+        }
+
+        ok = append_phrase(buffer, index) && append_text(buffer, "\n", 1);
+
+        stack[count++] = 0;
+        stack[count++] = 2 * index + 1;
+        stack[count++] = 2 * index;
+    }
+
+    free(stack);
+    return ok;
+}
+
+
+static bool read_corpus_file(const char* filename, bench_buffer_t* buffer)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return false;
+
+    char chunk[BUFSIZ];
+    size_t bytes_read = 0;
+    bool ok = true;
+
+    while (ok && (bytes_read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        ok = append_text(buffer, chunk, bytes_read);
+
+    fclose(file);
+    return ok;
+}
+
+// ============================RUN==============================================
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static void print_result(const char* name, tree_scan_kind kind, const bench_result_t* result)
+{
+    printf("%-28s %-6s %10zu bytes %9zu nodes | index %8.1f MB/s | parse %9.3f ms %8.1f MB/s %7.2f Mnodes/s\n",
+           name, tree_scan_kind_name(kind), result -> bytes, result -> nodes,
+           (kind != TREE_SCAN_NONE) ? (double)result -> bytes / result -> index_seconds / 1e6 : 0.0, result -> parse_seconds * 1000,
+           (double)result -> bytes / result -> parse_seconds / 1e6, (double)result -> nodes / result -> parse_seconds / 1e6);
+}
+
+
+// Только первая стадия: индекс строится и вычитывается до конца
+static bool measure_index(const bench_buffer_t* buffer, double* seconds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    tree_scanner_t scanner = {};
+    if (tree_scanner_init(&scanner, buffer -> data, buffer -> size) != TREE_NO_ERROR)
+        return false;
+
+    while (tree_scanner_next(&scanner) != SCAN_END)
+        ;
+    tree_scanner_destroy(&scanner);
+
+    *seconds = seconds_since(start);
+    return true;
+}
+
+
+static bool bench_text(const char* name, const bench_buffer_t* buffer, size_t repeat, tree_scan_kind kind, bench_result_t* total)
+{
+    bench_result_t result = {};
+    result.bytes = buffer -> size;
+
+    tree_scan_select(kind);
+
+    for (size_t i = 0; i < repeat; i++)
+    {
+        double index_seconds = 0;
+        if (kind != TREE_SCAN_NONE && !measure_index(buffer, &index_seconds))
+            return false;
+
+        node_t* root = NULL;
+        tree_parse_error_t error = {};
+
+        auto start = std::chrono::steady_clock::now();
+        tree_error_type parse_result = tree_parse(buffer -> data, buffer -> size, &root, &result.nodes, &error);
+        double parse_seconds = seconds_since(start);
+
+        if (parse_result != TREE_NO_ERROR)
+        {
+            tree_parse_error_print(&error, name, stdout);
+            return false;
+        }
+
+        tree_parse_destroy(root);
+
+        if (i == 0 || index_seconds < result.index_seconds)
+            result.index_seconds = index_seconds;
+        if (i == 0 || parse_seconds < result.parse_seconds)
+            result.parse_seconds = parse_seconds;
+    }
+
+    print_result(name, kind, &result);
+
+    total -> bytes         += result.bytes;
+    total -> nodes         += result.nodes;
+    total -> index_seconds += result.index_seconds;
+    total -> parse_seconds += result.parse_seconds;
+
+    return true;
+}
+
+
+static bool parse_scanner_name(const char* name, tree_scan_kind* kind)
+{
+    const tree_scan_kind kinds[] = {TREE_SCAN_AUTO, TREE_SCAN_NONE, TREE_SCAN_SCALAR, TREE_SCAN_SSE2, TREE_SCAN_AVX2};
+
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        if (strcmp(name, tree_scan_kind_name(kinds[i])) == 0)
+        {
+            *kind = (kinds[i] == TREE_SCAN_AUTO) ? tree_scan_current() : kinds[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+int main(int argc, char* argv[])
+{
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+    size_t synthetic_nodes = 0;
+    int first_file = argc;
+
+    tree_scan_kind kinds[] = {TREE_SCAN_NONE, TREE_SCAN_SCALAR, TREE_SCAN_SSE2, TREE_SCAN_AVX2};
+    size_t number_of_kinds = sizeof(kinds) / sizeof(kinds[0]);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+            synthetic_nodes = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--scanner") == 0 && i + 1 < argc)
+        {
+            if (!parse_scanner_name(argv[++i], &kinds[0]) || !tree_scan_is_supported(kinds[0]))
+            {
+                fprintf(stderr, "Scanner %s is not supported\n", argv[i]);
+                return 1;
+            }
+            number_of_kinds = 1;
+        }
+        else
+        {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (repeat == 0)
+        repeat = 1;
+
+    if (first_file == argc && synthetic_nodes == 0)
+        synthetic_nodes = BENCH_DEFAULT_SYNTHETIC_NODES;
+
+    size_t number_of_texts = (size_t)(argc - first_file) + (synthetic_nodes != 0);
+    bench_buffer_t* texts = (bench_buffer_t*)calloc(number_of_texts, sizeof(bench_buffer_t));
+    const char** names = (const char**)calloc(number_of_texts, sizeof(const char*));
+    char synthetic_name[MAX_LENGTH_OF_ADDRESS] = {};
+    bool ok = (texts != NULL && names != NULL);
+
+    for (size_t text = 0; text < number_of_texts && ok; text++)
+    {
+        if (synthetic_nodes != 0 && text == 0)
+        {
+            snprintf(synthetic_name, sizeof(synthetic_name), "<synthetic %zu nodes>", synthetic_nodes);
+            names[text] = synthetic_name;
+
+            if (!(ok = generate_synthetic(&texts[text], synthetic_nodes)))
+                fprintf(stderr, "Cannot generate the synthetic database\n");
+        }
+        else
+        {
+            names[text] = argv[first_file + (int)text - (synthetic_nodes != 0)];
+
+            if (!(ok = read_corpus_file(names[text], &texts[text])))
+                fprintf(stderr, "Cannot read %s\n", names[text]);
+        }
+    }
+
+    for (size_t kind = 0; kind < number_of_kinds && ok; kind++)
+    {
+        if (!tree_scan_is_supported(kinds[kind]))
+            continue;
+
+        bench_result_t total = {};
+        for (size_t text = 0; text < number_of_texts && ok; text++)
+            ok = bench_text(names[text], &texts[text], repeat, kinds[kind], &total);
+
+        if (ok && number_of_texts > 1)
+            print_result("total (best of each)", kinds[kind], &total);
+    }
+
+    for (size_t text = 0; texts != NULL && text < number_of_texts; text++)
+        free(texts[text].data);
+    free(texts);
+    free(names);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "tree.h"
+#include "tree_parser.h"
+#include "tree_scan.h"
+#include "tree_error_type.h"
+
+// Фаззинг tree_parse. libFuzzer вызывает LLVMFuzzerTestOneInput сам (make fuzz).
+// Для AFL и для воспроизведения найденного собирается с -D TREE_PARSER_FUZZ_MAIN:
+// тогда входы читаются из файлов в аргументах или из stdin.
+// Кроме падений проверяется, что разобранное дерево после записи читается в точно такое же
+// и что посимвольный разбор и разбор по индексу со всеми классификаторами tree_scan,
+// которые есть на машине, дают одно и то же: то же дерево или ошибку в том же месте
+
+struct fuzz_step_t
+{
+    const node_t* node;
+    bool is_close;
+};
+
+
+// Тот же формат, что у save_tree_to_file, но без рекурсии: вход может быть очень глубоким
+static bool write_tree(const node_t* root, size_t number_of_nodes, FILE* file)
+{
+    fuzz_step_t* stack = (fuzz_step_t*)calloc(2 * number_of_nodes + 1, sizeof(fuzz_step_t));
+    if (stack == NULL)
+        return false;
+
+    size_t count = 0;
+    stack[count++] = {root, false};
+
+    while (count > 0)
+    {
+        fuzz_step_t step = stack[--count];
+
+        if (step.is_close || step.node == NULL)
+        {
+            fputs(step.is_close ? ")" : "nil", file);
+            if (count > 0 && !stack[count - 1].is_close)
+                fputc(' ', file);
+            continue;
+        }
+
+        fputs("(\"", file);
+        tree_write_phrase(file, step.node -> question);
+        fputs("\" ", file);
+
+        stack[count++] = {NULL, true};
+        stack[count++] = {step.node -> no, false};
+        stack[count++] = {step.node -> yes, false};
+    }
+
+    free(stack);
+    return true;
+}
+
+
+static bool equal_trees(const node_t* first, const node_t* second, size_t number_of_nodes)
+{
+    const node_t** stack = (const node_t**)calloc(2 * number_of_nodes + 2, sizeof(const node_t*));
+    if (stack == NULL)
+        return true; // проверить нечем, это не ошибка разбора
+
+    size_t count = 0;
+    stack[count++] = first;
+    stack[count++] = second;
+
+    bool equal = true;
+    while (count > 0 && equal)
+    {
+        const node_t* right = stack[--count];
+        const node_t* left  = stack[--count];
+
+        if (left == NULL || right == NULL)
+        {
+            equal = (left == right);
+            continue;
+        }
+
+        equal = strcmp(left -> question, right -> question) == 0;
+
+        stack[count++] = left -> no;
+        stack[count++] = right -> no;
+        stack[count++] = left -> yes;
+        stack[count++] = right -> yes;
+    }
+
+    free(stack);
+    return equal;
+}
+
+
+static void check_round_trip(const node_t* root, size_t number_of_nodes)
+{
+    FILE* file = tmpfile();
+    if (file == NULL)
+        return;
+
+    if (!write_tree(root, number_of_nodes, file))
+    {
+        fclose(file);
+        return;
+    }
+
+    long size = ftell(file);
+    char* text = (char*)malloc((size_t)size + 1);
+    rewind(file);
+
+    if (text == NULL || fread(text, sizeof(char), (size_t)size, file) != (size_t)size)
+    {
+        free(text);
+        fclose(file);
+        return;
+    }
+    fclose(file);
+
+    node_t* copy = NULL;
+    size_t copy_nodes = 0;
+    tree_parse_error_t error = {};
+
+    if (tree_parse(text, (size_t)size, &copy, &copy_nodes, &error) != TREE_NO_ERROR)
+    {
+        fprintf(stderr, "Written tree does not parse at line %zu, column %zu: %s\n", error.line, error.column, error.message);
+        abort();
+    }
+
+    if (copy_nodes != number_of_nodes || !equal_trees(root, copy, number_of_nodes))
+    {
+        fprintf(stderr, "Written tree parses into a different tree\n");
+        abort();
+    }
+
+    tree_parse_destroy(copy);
+    free(text);
+}
+
+
+static void check_other_scanners(const uint8_t* data, size_t size, tree_error_type expected_result,
+                                 const node_t* expected_root, size_t expected_nodes, const tree_parse_error_t* expected_error)
+{
+    const tree_scan_kind kinds[] = {TREE_SCAN_NONE, TREE_SCAN_SCALAR, TREE_SCAN_SSE2, TREE_SCAN_AVX2};
+
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        if (!tree_scan_select(kinds[i]))
+            continue;
+
+        node_t* root = NULL;
+        size_t number_of_nodes = 0;
+        tree_parse_error_t error = {};
+        tree_error_type result = tree_parse((const char*)data, size, &root, &number_of_nodes, &error);
+
+        if (result != expected_result ||
+            (result == TREE_NO_ERROR && (number_of_nodes != expected_nodes || !equal_trees(root, expected_root, number_of_nodes))) ||
+            (result != TREE_NO_ERROR && error.offset != expected_error -> offset))
+        {
+            fprintf(stderr, "Scanner %s disagrees with %s\n", tree_scan_kind_name(kinds[i]), tree_scan_kind_name(TREE_SCAN_AUTO));
+            abort();
+        }
+
+        if (result == TREE_NO_ERROR)
+            tree_parse_destroy(root);
+    }
+
+    tree_scan_select(TREE_SCAN_AUTO);
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    node_t* root = NULL;
+    size_t number_of_nodes = 0;
+    tree_parse_error_t error = {};
+
+    tree_error_type result = tree_parse((const char*)data, size, &root, &number_of_nodes, &error);
+    check_other_scanners(data, size, result, root, number_of_nodes, &error);
+
+    if (result != TREE_NO_ERROR)
+    {
+        if (error.offset > size || error.line == 0 || error.column == 0 || error.message == NULL)
+            abort(); // место ошибки всегда внутри входа
+
+        return 0;
+    }
+
+    check_round_trip(root, number_of_nodes);
+    tree_parse_destroy(root);
+
+    return 0;
+}
+
+
+#ifdef TREE_PARSER_FUZZ_MAIN
+
+static bool run_file(FILE* file)
+{
+    size_t capacity = 4096;
+    size_t size = 0;
+    uint8_t* data = (uint8_t*)malloc(capacity);
+    if (data == NULL)
+        return false;
+
+    size_t bytes_read = 0;
+    while ((bytes_read = fread(data + size, 1, capacity - size, file)) > 0)
+    {
+        size += bytes_read;
+        if (size == capacity)
+        {
+            uint8_t* new_data = (uint8_t*)realloc(data, 2 * capacity);
+            if (new_data == NULL)
+            {
+                free(data);
+                return false;
+            }
+
+            data = new_data;
+            capacity *= 2;
+        }
+    }
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+        return run_file(stdin) ? 0 : 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE* file = fopen(argv[i], "rb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+
+        run_file(file);
+        fclose(file);
+    }
+
+    return 0;
+}
+
+#endif // TREE_PARSER_FUZZ_MAIN
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "tree_registry.h"
+#include "tree_compact.h"
+#include "tree_embedded.h"
+#include "string_pool.h"
+#include "tree_error_type.h"
+
+
+tree_error_type tree_registry_init(tree_registry_t* registry)
+{
+    assert(registry != NULL);
+
+    registry -> number_of_entries = 0;
+
+    return string_pool_init(&registry -> pool);
+}
+
+
+// Пул освобождается последним: фразы всех деревьев лежат в нём
+void tree_registry_destroy(tree_registry_t* registry)
+{
+    if (registry == NULL)
+        return;
+
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+        tree_registry_unload(&registry -> entries[i]);
+
+    registry -> number_of_entries = 0;
+    string_pool_destroy(&registry -> pool);
+}
+
+
+tree_error_type tree_registry_add(tree_registry_t* registry, const char* name, const char* filename)
+{
+    assert(registry != NULL);
+    assert(name     != NULL);
+    assert(filename != NULL);
+
+    if (tree_registry_find(registry, name) != NULL)
+        return TREE_NO_ERROR;
+
+    if (registry -> number_of_entries == MAX_NUMBER_OF_TREES ||
+        strlen(name) >= MAX_LENGTH_OF_TREE_NAME || strlen(filename) >= MAX_LENGTH_OF_FILENAME)
+        return TREE_ERROR_SIZE_MISMATCH;
+
+    tree_registry_entry_t* entry = &registry -> entries[registry -> number_of_entries++];
+    *entry = {};
+
+    strcpy(entry -> name, name);
+    strcpy(entry -> filename, filename);
+
+    return TREE_NO_ERROR;
+}
+
+
+tree_registry_entry_t* tree_registry_find(tree_registry_t* registry, const char* name)
+{
+    assert(registry != NULL);
+    assert(name     != NULL);
+
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+    {
+        if (strcmp(registry -> entries[i].name, name) == 0)
+            return &registry -> entries[i];
+    }
+
+    return NULL;
+}
+
+
+// Нет файла - берём встроенную базу (tree_embedded.h) без копирования; на диск она попадёт
+// при обычном сохранении на выходе. После разбора дерево уплотняется, и его фразы переезжают в общий пул
+tree_error_type tree_registry_load(tree_registry_t* registry, tree_registry_entry_t* entry, bool* created)
+{
+    assert(registry != NULL);
+    assert(entry    != NULL);
+    assert(created  != NULL);
+
+    *created = false;
+
+    if (entry -> is_loaded)
+        return TREE_NO_ERROR;
+
+    tree_error_type result = tree_constructor(&entry -> tree);
+    if (result != TREE_NO_ERROR)
+        return result;
+
+    entry -> tree.pool = &registry -> pool;
+
+    if (load_tree_from_file(&entry -> tree, entry -> filename) != TREE_NO_ERROR)
+    {
+        *created = true;
+        result = tree_embedded_attach(&entry -> tree);
+    }
+    else
+    {
+        result = tree_compact(&entry -> tree);
+    }
+
+    if (result != TREE_NO_ERROR)
+    {
+        tree_destructor(&entry -> tree);
+        return result;
+    }
+
+    entry -> is_loaded = true;
+    return TREE_NO_ERROR;
+}
+
+
+tree_error_type tree_registry_save(const tree_registry_entry_t* entry)
+{
+    assert(entry != NULL);
+
+    if (!entry -> is_loaded)
+        return TREE_NO_ERROR;
+
+    return save_tree_to_file(&entry -> tree, entry -> filename);
+}
+
+
+// Узлы уходят вместе с ареной дерева, фразы остаются в пуле: их могут делить другие базы,
+// а при повторной загрузке этой же базы они просто найдутся там снова
+tree_error_type tree_registry_unload(tree_registry_entry_t* entry)
+{
+    assert(entry != NULL);
+
+    if (!entry -> is_loaded)
+        return TREE_NO_ERROR;
+
+    tree_destructor(&entry -> tree);
+    entry -> tree.pool = NULL;
+    entry -> is_loaded = false;
+
+    return TREE_NO_ERROR;
+}
+
+
+void tree_registry_print(const tree_registry_t* registry, FILE* stream)
+{
+    assert(registry != NULL);
+    assert(stream   != NULL);
+
+    for (size_t i = 0; i < registry -> number_of_entries; i++)
+    {
+        const tree_registry_entry_t* entry = &registry -> entries[i];
+
+        if (entry -> is_loaded)
+            fprintf(stream, "  %-16s %s (%zu nodes)\n", entry -> name, entry -> filename, entry -> tree.size);
+        else
+            fprintf(stream, "  %-16s %s (not loaded)\n", entry -> name, entry -> filename);
+    }
+
+    fprintf(stream, "Shared phrase pool: %zu phrases, %zu of %zu bytes stored, %zu bytes with index\n",
+                    registry -> pool.number_of_strings, registry -> pool.stored_bytes,
+                    registry -> pool.interned_bytes, string_pool_memory_usage(&registry -> pool));
+}
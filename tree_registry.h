@@ -0,0 +1,40 @@
+#ifndef TREE_REGISTRY_H_
+#define TREE_REGISTRY_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "string_pool.h"
+#include "tree_error_type.h"
+
+#define MAX_NUMBER_OF_TREES 16
+#define MAX_LENGTH_OF_TREE_NAME 64
+
+struct tree_registry_entry_t
+{
+    char name[MAX_LENGTH_OF_TREE_NAME];
+    char filename[MAX_LENGTH_OF_FILENAME];
+    tree_t tree;
+    bool is_loaded;
+};
+
+// Несколько именованных баз в одном процессе. Фразы всех деревьев лежат в общем пуле,
+// узлы - в арене своего дерева, поэтому загрузка и выгрузка одной базы других не задевают
+struct tree_registry_t
+{
+    tree_registry_entry_t entries[MAX_NUMBER_OF_TREES] = {};
+    size_t number_of_entries = 0;
+    string_pool_t pool = {};
+};
+
+tree_error_type tree_registry_init(tree_registry_t* registry);
+void tree_registry_destroy(tree_registry_t* registry);
+tree_error_type tree_registry_add(tree_registry_t* registry, const char* name, const char* filename);
+tree_registry_entry_t* tree_registry_find(tree_registry_t* registry, const char* name);
+tree_error_type tree_registry_load(tree_registry_t* registry, tree_registry_entry_t* entry, bool* created);
+tree_error_type tree_registry_save(const tree_registry_entry_t* entry);
+tree_error_type tree_registry_unload(tree_registry_entry_t* entry);
+void tree_registry_print(const tree_registry_t* registry, FILE* stream);
+
+#endif // TREE_REGISTRY_H_
@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+
+#include "tree_scan.h"
+#include "tree_error_type.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_X86 0
+#endif
+
+#define SCAN_EVEN_BITS 0x5555555555555555ULL
+#define SCAN_INDEX_SLACK 8
+
+#define SCAN_BYTE_ONES        0x0101010101010101ULL
+#define SCAN_BYTE_LOW_BITS    0x7F7F7F7F7F7F7F7FULL
+#define SCAN_GATHER_HIGH_BITS 0x0102040810204080ULL
+
+// Побитовые маски одного блока: бит i - байт i блока
+struct scan_masks_t
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t open;
+    uint64_t close;
+    uint64_t space;
+    uint64_t zero;
+};
+
+typedef void (*scan_classify_t)(const char* block, scan_masks_t* masks);
+
+static std::atomic<int> selected_kind(TREE_SCAN_AUTO);
+
+// ============================CLASSIFIERS======================================
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+// Без SIMD - по 8 байт в одном uint64_t. Байт, равный symbol, становится нулём,
+// точная проверка на нулевой байт даёт 0x80 только в нём, умножение собирает старшие биты в 8 бит
+static uint64_t swar_equal(uint64_t word, unsigned char symbol)
+{
+    uint64_t difference = word ^ (SCAN_BYTE_ONES * symbol);
+    uint64_t zero_bytes = ~(((difference & SCAN_BYTE_LOW_BITS) + SCAN_BYTE_LOW_BITS) | difference | SCAN_BYTE_LOW_BITS);
+
+    return ((zero_bytes >> 7) * SCAN_GATHER_HIGH_BITS) >> 56;
+}
+
+
+// Пробельные те же, что у посимвольного разбора: ' ' и '\t', '\n', '\v', '\f', '\r'
+static void classify_scalar(const char* block, scan_masks_t* masks)
+{
+    *masks = {};
+
+    for (size_t part = 0; part < SCAN_BLOCK_SIZE; part += 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, block + part, sizeof(word));
+
+        masks -> quote     |= swar_equal(word, '"')  << part;
+        masks -> backslash |= swar_equal(word, '\\') << part;
+        masks -> open      |= swar_equal(word, '(')  << part;
+        masks -> close     |= swar_equal(word, ')')  << part;
+        masks -> zero      |= swar_equal(word, '\0') << part;
+        masks -> space     |= (swar_equal(word, ' ')  | swar_equal(word, '\t') | swar_equal(word, '\n') |
+                               swar_equal(word, '\v') | swar_equal(word, '\f') | swar_equal(word, '\r')) << part;
+    }
+}
+
+#else
+
+static void classify_scalar(const char* block, scan_masks_t* masks)
+{
+    *masks = {};
+
+    for (size_t i = 0; i < SCAN_BLOCK_SIZE; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+
+        switch (block[i])
+        {
+            case '"':  masks -> quote     |= bit; break;
+            case '\\': masks -> backslash |= bit; break;
+            case '(':  masks -> open      |= bit; break;
+            case ')':  masks -> close     |= bit; break;
+            case '\0': masks -> zero      |= bit; break;
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\v':
+            case '\f':
+            case '\r': masks -> space     |= bit; break;
+            default:                              break;
+        }
+    }
+}
+
+#endif // __BYTE_ORDER__
+
+#if SCAN_X86
+
+#define SCAN_TARGET_SSE2 __attribute__((target("sse2")))
+#define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+
+SCAN_TARGET_SSE2
+static uint64_t sse2_equal(__m128i bytes, char symbol)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(symbol)));
+}
+
+
+SCAN_TARGET_SSE2
+static void classify_sse2(const char* block, scan_masks_t* masks)
+{
+    *masks = {};
+
+    for (size_t part = 0; part < SCAN_BLOCK_SIZE; part += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + part));
+
+        // коды 9-13 после вычитания 9 - это ровно байты не больше 4
+        __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+
+        masks -> quote     |= sse2_equal(bytes, '"')  << part;
+        masks -> backslash |= sse2_equal(bytes, '\\') << part;
+        masks -> open      |= sse2_equal(bytes, '(')  << part;
+        masks -> close     |= sse2_equal(bytes, ')')  << part;
+        masks -> zero      |= sse2_equal(bytes, '\0') << part;
+        masks -> space     |= (sse2_equal(bytes, ' ') | (uint32_t)_mm_movemask_epi8(control)) << part;
+    }
+}
+
+
+SCAN_TARGET_AVX2
+static uint64_t avx2_equal(__m256i bytes, char symbol)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(symbol)));
+}
+
+
+SCAN_TARGET_AVX2
+static void classify_avx2(const char* block, scan_masks_t* masks)
+{
+    __m256i low  = _mm256_loadu_si256((const __m256i*)block);
+    __m256i high = _mm256_loadu_si256((const __m256i*)(block + 32));
+
+    __m256i low_shifted  = _mm256_sub_epi8(low,  _mm256_set1_epi8('\t'));
+    __m256i high_shifted = _mm256_sub_epi8(high, _mm256_set1_epi8('\t'));
+    __m256i low_control  = _mm256_cmpeq_epi8(_mm256_min_epu8(low_shifted,  _mm256_set1_epi8(4)), low_shifted);
+    __m256i high_control = _mm256_cmpeq_epi8(_mm256_min_epu8(high_shifted, _mm256_set1_epi8(4)), high_shifted);
+
+    masks -> quote     = avx2_equal(low, '"')  | avx2_equal(high, '"')  << 32;
+    masks -> backslash = avx2_equal(low, '\\') | avx2_equal(high, '\\') << 32;
+    masks -> open      = avx2_equal(low, '(')  | avx2_equal(high, '(')  << 32;
+    masks -> close     = avx2_equal(low, ')')  | avx2_equal(high, ')')  << 32;
+    masks -> zero      = avx2_equal(low, '\0') | avx2_equal(high, '\0') << 32;
+    masks -> space     = avx2_equal(low, ' ')  | (uint32_t)_mm256_movemask_epi8(low_control) |
+                         (avx2_equal(high, ' ') | (uint32_t)_mm256_movemask_epi8(high_control)) << 32;
+}
+
+#endif // SCAN_X86
+
+// ============================SELECTION========================================
+
+bool tree_scan_is_supported(tree_scan_kind kind)
+{
+    switch (kind)
+    {
+        case TREE_SCAN_AUTO:
+        case TREE_SCAN_NONE:
+        case TREE_SCAN_SCALAR: return true;
+#if SCAN_X86
+        case TREE_SCAN_SSE2:   return __builtin_cpu_supports("sse2");
+        case TREE_SCAN_AVX2:   return __builtin_cpu_supports("avx2");
+#else
+        case TREE_SCAN_SSE2:
+        case TREE_SCAN_AVX2:   return false;
+#endif
+        default:               return false;
+    }
+}
+
+
+bool tree_scan_select(tree_scan_kind kind)
+{
+    if (!tree_scan_is_supported(kind))
+        return false;
+
+    selected_kind.store(kind, std::memory_order_relaxed);
+    return true;
+}
+
+
+tree_scan_kind tree_scan_current()
+{
+    tree_scan_kind kind = (tree_scan_kind)selected_kind.load(std::memory_order_relaxed);
+    if (kind != TREE_SCAN_AUTO)
+        return kind;
+
+    if (tree_scan_is_supported(TREE_SCAN_AVX2))
+        return TREE_SCAN_AVX2;
+
+    if (tree_scan_is_supported(TREE_SCAN_SSE2))
+        return TREE_SCAN_SSE2;
+
+    return TREE_SCAN_NONE;
+}
+
+
+const char* tree_scan_kind_name(tree_scan_kind kind)
+{
+    switch (kind)
+    {
+        case TREE_SCAN_AUTO:   return "auto";
+        case TREE_SCAN_NONE:   return "none";
+        case TREE_SCAN_SCALAR: return "scalar";
+        case TREE_SCAN_SSE2:   return "sse2";
+        case TREE_SCAN_AVX2:   return "avx2";
+        default:               return "unknown";
+    }
+}
+
+
+static scan_classify_t classifier(tree_scan_kind kind)
+{
+    switch (kind)
+    {
+#if SCAN_X86
+        case TREE_SCAN_SSE2:   return classify_sse2;
+        case TREE_SCAN_AVX2:   return classify_avx2;
+#else
+        case TREE_SCAN_SSE2:
+        case TREE_SCAN_AVX2:
+#endif
+        case TREE_SCAN_AUTO:
+        case TREE_SCAN_NONE:
+        case TREE_SCAN_SCALAR:
+        default:               return classify_scalar;
+    }
+}
+
+// ============================INDEX============================================
+
+// Байты, перед которыми нечётное число обратных косых черт подряд, в том числе из прошлого блока.
+// Серии, начатые с чётного и с нечётного бита, разделяются одним сложением
+static uint64_t find_escaped(uint64_t backslash, uint64_t* prev_escaped)
+{
+    backslash &= ~*prev_escaped;
+    uint64_t follows_escape = (backslash << 1) | *prev_escaped;
+
+    uint64_t odd_sequence_starts = backslash & ~SCAN_EVEN_BITS & ~follows_escape;
+    uint64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+    *prev_escaped = (sequences_starting_on_even_bits < backslash) ? 1 : 0;
+
+    uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+    return (SCAN_EVEN_BITS ^ invert_mask) & follows_escape;
+}
+
+
+// Бит i - нечётное число единиц в битах 0..i: от открывающей кавычки до закрывающей, не включая её
+static uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+
+static void index_block(tree_scanner_t* scanner, const scan_masks_t* masks, uint32_t offset)
+{
+    uint64_t escaped = find_escaped(masks -> backslash, &scanner -> prev_escaped);
+    uint64_t quotes  = masks -> quote & ~escaped;
+
+    uint64_t in_string = prefix_xor(quotes) ^ scanner -> prev_in_string;
+    scanner -> prev_in_string = (uint64_t)0 - (in_string >> 63);
+
+    // Слово - всё, что вне фраз и не пробел, не скобка и не кавычка. В индекс идёт только его начало
+    uint64_t scalar = ~(masks -> space | masks -> open | masks -> close | masks -> quote) & ~in_string;
+    uint64_t scalar_starts = scalar & ~((scalar << 1) | scanner -> prev_scalar);
+    scanner -> prev_scalar = scalar >> 63;
+
+    uint64_t structural = quotes | ((masks -> open | masks -> close) & ~in_string) | scalar_starts |
+                          (((masks -> backslash & ~escaped) | masks -> zero) & in_string);
+
+    // Пишем по 8 позиций без проверок: хвост за count потом перезапишется, под него в индексе запас
+    uint32_t* index = scanner -> index + scanner -> count;
+    scanner -> count += (size_t)__builtin_popcountll(structural);
+
+    while (structural != 0)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            index[i] = offset + (uint32_t)__builtin_ctzll(structural | ((uint64_t)1 << 63));
+            structural &= structural - 1;
+        }
+        index += 8;
+    }
+}
+
+
+// Цикл по блокам свой для каждого набора инструкций, чтобы классификатор встраивался
+static void scan_blocks_scalar(tree_scanner_t* scanner, size_t end)
+{
+    scan_masks_t masks = {};
+
+    for (; scanner -> scanned < end; scanner -> scanned += SCAN_BLOCK_SIZE)
+    {
+        classify_scalar(scanner -> text + scanner -> scanned, &masks);
+        index_block(scanner, &masks, (uint32_t)(scanner -> scanned - scanner -> window_start));
+    }
+}
+
+#if SCAN_X86
+
+SCAN_TARGET_SSE2
+static void scan_blocks_sse2(tree_scanner_t* scanner, size_t end)
+{
+    scan_masks_t masks = {};
+
+    for (; scanner -> scanned < end; scanner -> scanned += SCAN_BLOCK_SIZE)
+    {
+        classify_sse2(scanner -> text + scanner -> scanned, &masks);
+        index_block(scanner, &masks, (uint32_t)(scanner -> scanned - scanner -> window_start));
+    }
+}
+
+
+SCAN_TARGET_AVX2
+static void scan_blocks_avx2(tree_scanner_t* scanner, size_t end)
+{
+    scan_masks_t masks = {};
+
+    for (; scanner -> scanned < end; scanner -> scanned += SCAN_BLOCK_SIZE)
+    {
+        classify_avx2(scanner -> text + scanner -> scanned, &masks);
+        index_block(scanner, &masks, (uint32_t)(scanner -> scanned - scanner -> window_start));
+    }
+}
+
+#endif // SCAN_X86
+
+
+tree_error_type tree_scanner_init(tree_scanner_t* scanner, const char* text, size_t length)
+{
+    assert(scanner != NULL);
+    assert(text    != NULL);
+
+    *scanner = {};
+    scanner -> text   = text;
+    scanner -> length = length;
+    scanner -> kind   = tree_scan_current();
+
+    // Позиций в окне не больше, чем байт в нём
+    size_t capacity = ((length < SCAN_WINDOW_SIZE) ? length : SCAN_WINDOW_SIZE) + SCAN_INDEX_SLACK;
+    scanner -> index = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    if (scanner -> index == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    return TREE_NO_ERROR;
+}
+
+
+void tree_scanner_destroy(tree_scanner_t* scanner)
+{
+    assert(scanner != NULL);
+
+    free(scanner -> index);
+    *scanner = {};
+}
+
+
+// Следующее окно текста. Последний неполный блок дополняется пробелами: они не дают позиций
+bool tree_scanner_refill(tree_scanner_t* scanner)
+{
+    assert(scanner != NULL);
+
+    if (scanner -> scanned >= scanner -> length)
+        return false;
+
+    scanner -> window_start = scanner -> scanned;
+    scanner -> count  = 0;
+    scanner -> cursor = 0;
+
+    size_t window_end = scanner -> length - scanner -> window_start > SCAN_WINDOW_SIZE ?
+                        scanner -> window_start + SCAN_WINDOW_SIZE : scanner -> length;
+
+    size_t blocks_end = window_end - (window_end - scanner -> window_start) % SCAN_BLOCK_SIZE;
+
+    switch (scanner -> kind)
+    {
+#if SCAN_X86
+        case TREE_SCAN_SSE2: scan_blocks_sse2(scanner, blocks_end);   break;
+        case TREE_SCAN_AVX2: scan_blocks_avx2(scanner, blocks_end);   break;
+#else
+        case TREE_SCAN_SSE2:
+        case TREE_SCAN_AVX2:
+#endif
+        case TREE_SCAN_AUTO:
+        case TREE_SCAN_NONE:
+        case TREE_SCAN_SCALAR:
+        default:             scan_blocks_scalar(scanner, blocks_end); break;
+    }
+
+    if (scanner -> scanned < window_end)
+    {
+        char tail[SCAN_BLOCK_SIZE];
+        memset(tail, ' ', sizeof(tail));
+        memcpy(tail, scanner -> text + scanner -> scanned, window_end - scanner -> scanned);
+
+        scan_masks_t masks = {};
+        classifier(scanner -> kind)(tail, &masks);
+        index_block(scanner, &masks, (uint32_t)(scanner -> scanned - scanner -> window_start));
+        scanner -> scanned = window_end;
+    }
+
+    return true;
+}
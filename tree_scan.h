@@ -0,0 +1,72 @@
+#ifndef TREE_SCAN_H_
+#define TREE_SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree_error_type.h"
+
+#define SCAN_BLOCK_SIZE 64            // байт за один шаг классификации, по биту маски на байт
+#define SCAN_WINDOW_SIZE (64 * 1024)  // байт текста на одно заполнение индекса
+#define SCAN_END SIZE_MAX
+
+enum tree_scan_kind
+{
+    TREE_SCAN_AUTO   = 0,
+    TREE_SCAN_NONE   = 1, // без индекса: tree_parse идёт посимвольно
+    TREE_SCAN_SCALAR = 2, // по 8 байт в uint64_t, медленнее посимвольного разбора, для проверки и сравнения
+    TREE_SCAN_SSE2   = 3,
+    TREE_SCAN_AVX2   = 4,
+};
+
+// Первая стадия разбора базы. Текст классифицируется блоками по 64 байта (AVX2, SSE2 или побайтно),
+// и в индекс попадают позиции всего, на что должен посмотреть разборщик:
+//     кавычки, кроме экранированных;
+//     скобки вне фраз;
+//     начала слов вне фраз (nil и любой мусор);
+//     обратные косые черты и нулевые байты внутри фраз.
+// Между соседними позициями индекса вне фраз только пробельные символы.
+// Индекс строится окнами по SCAN_WINDOW_SIZE байт, чтобы оставаться в кэше
+struct tree_scanner_t
+{
+    const char* text;
+    size_t length;
+
+    size_t window_start;  // от него отсчитываются смещения в index
+    size_t scanned;       // столько байт текста уже классифицировано
+
+    uint64_t prev_escaped;    // первый байт следующего блока экранирован
+    uint64_t prev_in_string;  // все единицы, если блок закончился внутри фразы
+    uint64_t prev_scalar;     // последний байт блока - часть слова
+
+    uint32_t* index;
+    size_t count;
+    size_t cursor;
+
+    tree_scan_kind kind;
+};
+
+tree_error_type tree_scanner_init(tree_scanner_t* scanner, const char* text, size_t length);
+void tree_scanner_destroy(tree_scanner_t* scanner);
+bool tree_scanner_refill(tree_scanner_t* scanner);
+
+// Следующая позиция индекса или SCAN_END
+inline size_t tree_scanner_next(tree_scanner_t* scanner)
+{
+    while (scanner -> cursor == scanner -> count)
+    {
+        if (!tree_scanner_refill(scanner))
+            return SCAN_END;
+    }
+
+    return scanner -> window_start + scanner -> index[scanner -> cursor++];
+}
+
+// Какой классификатор брать для новых сканеров. AUTO - AVX2 или SSE2, если их поддерживает процессор,
+// иначе NONE. Возвращает false, если выбранный набор инструкций недоступен
+bool tree_scan_select(tree_scan_kind kind);
+bool tree_scan_is_supported(tree_scan_kind kind);
+tree_scan_kind tree_scan_current();
+const char* tree_scan_kind_name(tree_scan_kind kind);
+
+#endif // TREE_SCAN_H_
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "tree.h"
+#include "tree_snapshot.h"
+#include "tree_parser.h"
+#include "metrics.h"
+#include "trace.h"
+#include "tree_error_type.h"
+
+// Состояние узла на момент снимка, если игра успела его изменить
+struct snapshot_shadow_t
+{
+    const node_t* node;
+    const char* question;
+    const node_t* yes;
+    const node_t* no;
+};
+
+// Память, которую игра уже освободила бы, но снимок ещё может читать
+struct snapshot_retired_t
+{
+    char* phrase;
+    node_t* subtree;
+};
+
+struct tree_snapshot_t
+{
+    const node_t* root = NULL;
+    char filename[MAX_LENGTH_OF_FILENAME] = {};
+    std::chrono::steady_clock::time_point start = {};
+
+    std::mutex mutex = {}; // узлы рабочий поток читает под ним, игра под ним же запоминает их перед изменением
+    snapshot_shadow_t* shadows = NULL; // открытая адресация, node == NULL - пусто
+    size_t number_of_shadows = 0;
+    size_t shadows_capacity = 0;
+
+    snapshot_retired_t* retired = NULL; // только игровой поток
+    size_t number_of_retired = 0;
+    size_t retired_capacity = 0;
+
+    std::thread worker = {};
+    std::atomic<bool> finished = {false};
+    tree_error_type result = TREE_NO_ERROR;
+    size_t number_of_nodes = 0;
+    double duration_ms = 0;
+};
+
+// Элемент стека обхода: узел (или nil) либо закрывающая скобка вопроса
+struct snapshot_step_t
+{
+    const node_t* node;
+    bool is_close;
+};
+
+// Что записать в файл: начало узла с фразой, nil или закрывающую скобку.
+// Фраза остаётся живой до конца снимка, поэтому пишем её уже без мьютекса
+struct snapshot_token_t
+{
+    const char* question; // NULL - nil или скобка
+    bool is_close;
+    bool space_after;
+};
+
+#define SNAPSHOT_HASH_MULTIPLIER 11400714819323198485ULL // 2^64 / золотое сечение
+
+// ============================SHADOWS==========================================
+
+static size_t shadow_slot(const tree_snapshot_t* snapshot, const node_t* node)
+{
+    uintptr_t address = (uintptr_t)node;
+    uint64_t hash = address * SNAPSHOT_HASH_MULTIPLIER;
+
+    size_t mask = snapshot -> shadows_capacity - 1;
+    size_t slot = (hash >> 32) & mask; // младшие биты адреса почти всегда нули
+
+    while (snapshot -> shadows[slot].node != NULL && snapshot -> shadows[slot].node != node)
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+
+static bool grow_shadows(tree_snapshot_t* snapshot)
+{
+    size_t new_capacity = (snapshot -> shadows_capacity == 0) ? SNAPSHOT_INITIAL_SHADOWS : 2 * snapshot -> shadows_capacity;
+
+    snapshot_shadow_t* new_shadows = (snapshot_shadow_t*)calloc(new_capacity, sizeof(snapshot_shadow_t));
+    if (new_shadows == NULL)
+        return false;
+
+    snapshot_shadow_t* old_shadows = snapshot -> shadows;
+    size_t old_capacity = snapshot -> shadows_capacity;
+
+    snapshot -> shadows = new_shadows;
+    snapshot -> shadows_capacity = new_capacity;
+
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old_shadows[i].node != NULL)
+            snapshot -> shadows[shadow_slot(snapshot, old_shadows[i].node)] = old_shadows[i];
+    }
+
+    free(old_shadows);
+    return true;
+}
+
+// ============================WORKER===========================================
+
+// Вызывать под мьютексом снимка
+static void read_node_state(const tree_snapshot_t* snapshot, const node_t* node, snapshot_shadow_t* state)
+{
+    if (snapshot -> number_of_shadows != 0)
+    {
+        const snapshot_shadow_t* shadow = &snapshot -> shadows[shadow_slot(snapshot, node)];
+        if (shadow -> node != NULL)
+        {
+            *state = *shadow;
+            return;
+        }
+    }
+
+    *state = {node, node -> question, node -> yes, node -> no};
+}
+
+
+static tree_error_type push_snapshot_step(snapshot_step_t** stack, size_t* count, size_t* capacity,
+                                          const node_t* node, bool is_close)
+{
+    if (*count == *capacity)
+    {
+        size_t new_capacity = (*capacity == 0) ? 256 : 2 * *capacity;
+
+        snapshot_step_t* new_stack = (snapshot_step_t*)realloc(*stack, new_capacity * sizeof(snapshot_step_t));
+        if (new_stack == NULL)
+            return TREE_ERROR_ALLOCATION;
+
+        *stack    = new_stack;
+        *capacity = new_capacity;
+    }
+
+    (*stack)[(*count)++] = {node, is_close};
+
+    return TREE_NO_ERROR;
+}
+
+
+static void write_snapshot_tokens(FILE* file, const snapshot_token_t* tokens, size_t number_of_tokens)
+{
+    for (size_t i = 0; i < number_of_tokens; i++)
+    {
+        if (tokens[i].question != NULL)
+        {
+            fputs("(\"", file);
+            tree_write_phrase(file, tokens[i].question);
+            fputs("\" ", file);
+            continue;
+        }
+
+        fputs(tokens[i].is_close ? ")" : "nil", file);
+        if (tokens[i].space_after)
+            fputc(' ', file); // дальше ветка "нет" того же вопроса
+    }
+}
+
+
+// Тот же формат, что у save_tree_to_file, но обход без рекурсии и узлы читаются через тени.
+// Мьютекс берётся раз на SNAPSHOT_NODES_PER_LOCK шагов обхода, файл пишется уже без него
+static tree_error_type write_snapshot(tree_snapshot_t* snapshot, FILE* file)
+{
+    snapshot_step_t* stack = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    snapshot_token_t* tokens = (snapshot_token_t*)calloc(SNAPSHOT_NODES_PER_LOCK, sizeof(snapshot_token_t));
+    if (tokens == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    tree_error_type result = push_snapshot_step(&stack, &count, &capacity, snapshot -> root, false);
+
+    while (result == TREE_NO_ERROR && count > 0)
+    {
+        size_t number_of_tokens = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(snapshot -> mutex);
+
+            while (result == TREE_NO_ERROR && count > 0 && number_of_tokens < SNAPSHOT_NODES_PER_LOCK)
+            {
+                snapshot_step_t step = stack[--count];
+
+                if (step.is_close || step.node == NULL)
+                {
+                    tokens[number_of_tokens++] = {NULL, step.is_close, count > 0 && !stack[count - 1].is_close};
+                    continue;
+                }
+
+                snapshot_shadow_t state = {};
+                read_node_state(snapshot, step.node, &state);
+                snapshot -> number_of_nodes++;
+
+                tokens[number_of_tokens++] = {state.question, false, false};
+
+                result = push_snapshot_step(&stack, &count, &capacity, NULL, true);
+                if (result == TREE_NO_ERROR)
+                    result = push_snapshot_step(&stack, &count, &capacity, state.no, false);
+                if (result == TREE_NO_ERROR)
+                    result = push_snapshot_step(&stack, &count, &capacity, state.yes, false);
+            }
+        }
+
+        write_snapshot_tokens(file, tokens, number_of_tokens);
+    }
+
+    free(tokens);
+    free(stack);
+
+    return result;
+}
+
+
+static void snapshot_worker(tree_snapshot_t* snapshot)
+{
+    TRACE_THREAD_NAME("background save");
+    TRACE_SPAN("background save");
+
+    char temporary_name[MAX_LENGTH_OF_FILENAME + sizeof(SNAPSHOT_TEMPORARY_SUFFIX)] = {};
+    snprintf(temporary_name, sizeof(temporary_name), "%s%s", snapshot -> filename, SNAPSHOT_TEMPORARY_SUFFIX);
+
+    tree_error_type result = TREE_NO_ERROR;
+
+    FILE* file = fopen(temporary_name, "w");
+    if (file == NULL)
+    {
+        result = TREE_ERROR_OPENING_FILE;
+    }
+    else
+    {
+        setvbuf(file, NULL, _IOFBF, SNAPSHOT_FILE_BUFFER_SIZE);
+
+        result = write_snapshot(snapshot, file);
+
+        if (ferror(file) && result == TREE_NO_ERROR)
+            result = TREE_ERROR_OPENING_FILE;
+        if (fclose(file) != 0 && result == TREE_NO_ERROR)
+            result = TREE_ERROR_OPENING_FILE;
+    }
+
+    if (result == TREE_NO_ERROR && rename(temporary_name, snapshot -> filename) != 0)
+    {
+        // rename в Windows не заменяет существующий файл
+        remove(snapshot -> filename);
+        if (rename(temporary_name, snapshot -> filename) != 0)
+            result = TREE_ERROR_OPENING_FILE;
+    }
+    if (result != TREE_NO_ERROR)
+        remove(temporary_name);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - snapshot -> start;
+
+    if (result == TREE_NO_ERROR)
+        metrics_observe(METRIC_TREE_SAVE_SECONDS, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    else
+        metrics_counter_add(METRIC_TREE_SAVE_ERRORS, 1);
+
+    snapshot -> result      = result;
+    snapshot -> duration_ms = elapsed.count();
+    snapshot -> finished    = true;
+}
+
+// ============================CONTROL==========================================
+
+tree_error_type tree_snapshot_save(tree_t* tree, const char* filename)
+{
+    assert(tree     != NULL);
+    assert(filename != NULL);
+
+    if (strlen(filename) >= MAX_LENGTH_OF_FILENAME)
+        return TREE_ERROR_OPENING_FILE;
+
+    tree_snapshot_report_t previous = {};
+    if (tree_snapshot_wait(tree, &previous)) // два снимка одного дерева сразу не ведём
+        tree_snapshot_report_print(&previous, stdout);
+
+    tree_snapshot_t* snapshot = new (std::nothrow) tree_snapshot_t();
+    if (snapshot == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    snapshot -> root  = tree -> root;
+    snapshot -> start = std::chrono::steady_clock::now();
+    snapshot -> finished = false;
+    strcpy(snapshot -> filename, filename);
+
+    try
+    {
+        snapshot -> worker = std::thread(snapshot_worker, snapshot);
+    }
+    catch (...)
+    {
+        delete snapshot;
+        return TREE_ERROR_ALLOCATION;
+    }
+
+    tree -> snapshot = snapshot;
+
+    return TREE_NO_ERROR;
+}
+
+
+static void finish_snapshot(tree_t* tree, tree_snapshot_report_t* report)
+{
+    tree_snapshot_t* snapshot = tree -> snapshot;
+
+    snapshot -> worker.join();
+
+    if (report != NULL)
+    {
+        strcpy(report -> filename, snapshot -> filename);
+        report -> result          = snapshot -> result;
+        report -> number_of_nodes = snapshot -> number_of_nodes;
+        report -> duration_ms     = snapshot -> duration_ms;
+    }
+
+    for (size_t i = 0; i < snapshot -> number_of_retired; i++)
+    {
+        free(snapshot -> retired[i].phrase);
+        tree_destroy_recursive(snapshot -> retired[i].subtree);
+    }
+
+    free(snapshot -> shadows);
+    free(snapshot -> retired);
+    delete snapshot;
+
+    tree -> snapshot = NULL;
+}
+
+
+// Если сохранение закончилось, забирает его итог. Не ждёт
+bool tree_snapshot_poll(tree_t* tree, tree_snapshot_report_t* report)
+{
+    assert(tree != NULL);
+
+    if (tree -> snapshot == NULL || !tree -> snapshot -> finished)
+        return false;
+
+    finish_snapshot(tree, report);
+    return true;
+}
+
+
+// Дожидается сохранения, если оно идёт. false - ждать было нечего
+bool tree_snapshot_wait(tree_t* tree, tree_snapshot_report_t* report)
+{
+    assert(tree != NULL);
+
+    if (tree -> snapshot == NULL)
+        return false;
+
+    finish_snapshot(tree, report);
+    return true;
+}
+
+
+bool tree_snapshot_is_running(const tree_t* tree)
+{
+    assert(tree != NULL);
+
+    return tree -> snapshot != NULL;
+}
+
+
+void tree_snapshot_report_print(const tree_snapshot_report_t* report, FILE* stream)
+{
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    if (report -> result == TREE_NO_ERROR)
+        fprintf(stream, "Background save to %s finished: %zu nodes in %.1f ms\n",
+                report -> filename, report -> number_of_nodes, report -> duration_ms);
+    else
+        fprintf(stream, "Background save to %s failed: %s\n", report -> filename, tree_error_translator(report -> result));
+}
+
+// ============================MUTATIONS========================================
+
+static bool add_shadow(tree_snapshot_t* snapshot, const node_t* node)
+{
+    std::lock_guard<std::mutex> lock(snapshot -> mutex);
+
+    // таблица заполнена не больше чем наполовину, поэтому цепочки поиска короткие
+    if (2 * (snapshot -> number_of_shadows + 1) > snapshot -> shadows_capacity && !grow_shadows(snapshot))
+        return false;
+
+    snapshot_shadow_t* shadow = &snapshot -> shadows[shadow_slot(snapshot, node)];
+    if (shadow -> node == node)
+        return true;
+
+    *shadow = {node, node -> question, node -> yes, node -> no};
+    snapshot -> number_of_shadows++;
+
+    return true;
+}
+
+
+// Вызывать перед изменением полей узла. Запоминается только первое, снимочное состояние
+void tree_snapshot_preserve(tree_t* tree, const node_t* node)
+{
+    assert(tree != NULL);
+    assert(node != NULL);
+
+    if (tree -> snapshot == NULL || add_shadow(tree -> snapshot, node))
+        return;
+
+    // запомнить негде - изменение подождёт, пока сохранение не закончится
+    tree_snapshot_report_t report = {};
+    finish_snapshot(tree, &report);
+    tree_snapshot_report_print(&report, stdout);
+}
+
+
+static bool retire(tree_t* tree, char* phrase, node_t* subtree)
+{
+    tree_snapshot_t* snapshot = tree -> snapshot;
+    if (snapshot == NULL)
+        return false;
+
+    if (snapshot -> number_of_retired == snapshot -> retired_capacity)
+    {
+        size_t new_capacity = (snapshot -> retired_capacity == 0) ? 16 : 2 * snapshot -> retired_capacity;
+
+        snapshot_retired_t* new_retired = (snapshot_retired_t*)realloc(snapshot -> retired, new_capacity * sizeof(snapshot_retired_t));
+        if (new_retired == NULL)
+        {
+            tree_snapshot_report_t report = {};
+            finish_snapshot(tree, &report);
+            tree_snapshot_report_print(&report, stdout);
+            return false; // снимок дописан, освобождать можно сразу
+        }
+
+        snapshot -> retired = new_retired;
+        snapshot -> retired_capacity = new_capacity;
+    }
+
+    snapshot -> retired[snapshot -> number_of_retired++] = {phrase, subtree};
+
+    return true;
+}
+
+
+// true - фразу забрал снимок и освободит сам, иначе освобождать вызывающему
+bool tree_snapshot_retire_phrase(tree_t* tree, char* phrase)
+{
+    assert(tree != NULL);
+
+    return retire(tree, phrase, NULL);
+}
+
+
+bool tree_snapshot_retire_subtree(tree_t* tree, node_t* subtree)
+{
+    assert(tree != NULL);
+
+    return retire(tree, NULL, subtree);
+}
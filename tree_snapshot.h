@@ -0,0 +1,41 @@
+#ifndef TREE_SNAPSHOT_H_
+#define TREE_SNAPSHOT_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define SNAPSHOT_FILE_BUFFER_SIZE (64 * 1024)
+#define SNAPSHOT_TEMPORARY_SUFFIX ".tmp"
+#define SNAPSHOT_NODES_PER_LOCK 256 // рабочий поток берёт мьютекс раз на столько узлов
+#define SNAPSHOT_INITIAL_SHADOWS 64  // тени - хэш-таблица по адресу узла, размер - степень двойки
+
+struct tree_snapshot_t;
+
+struct tree_snapshot_report_t
+{
+    char filename[MAX_LENGTH_OF_FILENAME];
+    tree_error_type result;
+    size_t number_of_nodes;
+    double duration_ms;
+};
+
+// Фоновое сохранение. Снимок ничего не копирует: рабочий поток обходит живое дерево,
+// а узлы, которые игра меняет во время сохранения, перед изменением запоминают своё
+// прежнее состояние (tree_snapshot_preserve). Освобождение памяти, которую снимок ещё
+// может читать, откладывается до конца сохранения (tree_snapshot_retire_*).
+// Файл пишется во временный и подменяет старый только целиком
+tree_error_type tree_snapshot_save(tree_t* tree, const char* filename);
+bool tree_snapshot_poll(tree_t* tree, tree_snapshot_report_t* report);
+bool tree_snapshot_wait(tree_t* tree, tree_snapshot_report_t* report);
+bool tree_snapshot_is_running(const tree_t* tree);
+void tree_snapshot_report_print(const tree_snapshot_report_t* report, FILE* stream);
+
+// Для кода, который меняет или освобождает узлы дерева
+void tree_snapshot_preserve(tree_t* tree, const node_t* node);
+bool tree_snapshot_retire_phrase(tree_t* tree, char* phrase);
+bool tree_snapshot_retire_subtree(tree_t* tree, node_t* subtree);
+
+#endif // TREE_SNAPSHOT_H_
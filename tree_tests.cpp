@@ -1,20 +1,265 @@
-#include <TXLib.h>
 #include <time.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
+#include <atomic>
+#include <thread>
+
 #include "tree.h"
 #include "speech.h"
+#include "tree_tests.h"
+#include "tree_dump.h"
+#include "tree_verifier.h"
+#include "tree_compact.h"
+#include "tree_memory.h"
+#include "packed_tree.h"
+#include "tree_diff.h"
+#include "tree_registry.h"
+#include "tree_history.h"
+#include "tree_induction.h"
+#include "tree_parser.h"
+#include "tree_scan.h"
+#include "tree_embedded.h"
+#include "tree_merge.h"
+#include "tree_export.h"
+#include "tree_snapshot.h"
+#include "phrase_filter.h"
+#include "metrics.h"
+#include "trace.h"
 #include "tree_error_type.h"
 
-void test_akinator()
+// Самотест пишет только во временные файлы: база удаляется в конце,
+// лог с дампами остаётся для просмотра и не отслеживается git
+#define SELF_TEST_LOG       "log_SelfTest"
+#define SELF_TEST_TREE_FILE "akinator_selftest_tree.txt"
+
+#define SELF_TEST_MERGE_DEPTH 100000 // рекурсивное слияние падало на такой глубине по стеку
+#define SELF_TEST_SNAPSHOT_NODES 200001 // чтобы сохранение ещё шло, пока игра учится
+#define SELF_TEST_SNAPSHOT_CHANGES 20000
+#define SELF_TEST_TRACE_OVERWRITTEN 100 // столько первых спанов каждого потока затирается в кольце
+
+#define SELF_TEST_CHECK(condition) \
+    self_test_check((condition), #condition, __LINE__, &failures)
+#define SELF_TEST_CHECK_SIZE(actual, expected) \
+    self_test_check_size((actual), (expected), #actual, __LINE__, &failures)
+#define SELF_TEST_CHECK_STRING(actual, expected) \
+    self_test_check_string((actual), (expected), #actual, __LINE__, &failures)
+
+
+static void self_test_check(bool condition, const char* expression, int line, size_t* failures)
+{
+    if (condition)
+        return;
+
+    printf("FAILED (tree_tests.cpp:%d): %s\n", line, expression);
+    (*failures)++;
+}
+
+
+static void self_test_check_size(size_t actual, size_t expected, const char* expression, int line, size_t* failures)
+{
+    if (actual == expected)
+        return;
+
+    printf("FAILED (tree_tests.cpp:%d): %s is %zu, expected %zu\n", line, expression, actual, expected);
+    (*failures)++;
+}
+
+
+static void self_test_check_string(const char* actual, const char* expected, const char* expression, int line, size_t* failures)
+{
+    if (actual != NULL && strcmp(actual, expected) == 0)
+        return;
+
+    printf("FAILED (tree_tests.cpp:%d): %s is \"%s\", expected \"%s\"\n", line, expression,
+           (actual != NULL) ? actual : "(null)", expected);
+    (*failures)++;
+}
+
+
+static bool write_self_test_file(const char* filename, const char* text)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+        return false;
+
+    fputs(text, file);
+    fclose(file);
+
+    return true;
+}
+
+
+// Цепочка вопросов: по "да" объект, по "нет" следующий вопрос, в самом низу - bottom
+static bool write_question_chain(const char* filename, size_t depth, const char* bottom)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+        return false;
+
+    for (size_t i = 0; i < depth; i++)
+        fprintf(file, "(\"question %zu\" (\"object %zu\" nil nil) ", i, i);
+
+    fprintf(file, "(\"%s\" nil nil)", bottom);
+
+    for (size_t i = 0; i < depth; i++)
+        fputc(')', file);
+
+    fclose(file);
+
+    return true;
+}
+
+
+// Строка JSON так, как её пишет tree_export_ndjson: \" \\ \n \r \t и \u00XX.
+// Возвращает позицию за закрывающей кавычкой или NULL
+static const char* read_json_string(const char* position, char* text, size_t text_size)
+{
+    if (*position != '"')
+        return NULL;
+
+    position++;
+    size_t length = 0;
+
+    while (*position != '"')
+    {
+        if (*position == '\0' || length + 1 >= text_size)
+            return NULL;
+
+        char symbol = *position++;
+        if (symbol == '\\')
+        {
+            char escape = *position++;
+            unsigned int value = 0;
+
+            switch (escape)
+            {
+                case '"':
+                case '\\': symbol = escape; break;
+                case 'n':  symbol = '\n';   break;
+                case 'r':  symbol = '\r';   break;
+                case 't':  symbol = '\t';   break;
+                case 'u':
+                    if (sscanf(position, "%4x", &value) != 1 || value > 0xFF)
+                        return NULL;
+                    symbol = (char)value;
+                    position += 4;
+                    break;
+                default:   return NULL;
+            }
+        }
+
+        text[length++] = symbol;
+    }
+
+    text[length] = '\0';
+    return position + 1;
+}
+
+
+// Следующий узел в прямом порядке обхода, yes раньше no. Без стека: по ссылкам на родителя
+static const node_t* next_in_preorder(const node_t* node)
+{
+    if (node -> yes != NULL)
+        return node -> yes;
+    if (node -> no != NULL)
+        return node -> no;
+
+    while (node -> parent != NULL && (node == node -> parent -> no || node -> parent -> no == NULL))
+        node = node -> parent;
+
+    return (node -> parent != NULL) ? node -> parent -> no : NULL;
+}
+
+
+// Дерево растёт, как в игре: разделяется случайный лист, фразы у всех узлов разные
+static bool grow_self_test_tree(tree_t* tree, size_t number_of_nodes, size_t* random_state)
+{
+    char feature[MAX_LENGTH_OF_ADDRESS] = {};
+    char object[MAX_LENGTH_OF_ADDRESS]  = {};
+
+    while (tree -> size + 2 <= number_of_nodes)
+    {
+        node_t* leaf = tree -> root;
+        while (leaf -> yes != NULL)
+        {
+            *random_state = *random_state * 6364136223846793005u + 1442695040888963407u;
+            leaf = ((*random_state >> 33) & 1) ? leaf -> yes : leaf -> no;
+        }
+
+        snprintf(feature, sizeof(feature), "feature %zu", tree -> size);
+        snprintf(object,  sizeof(object),  "object %zu",  tree -> size);
+
+        if (tree_split_node(tree, leaf, feature, object) != TREE_NO_ERROR)
+            return false;
+    }
+
+    return true;
+}
+
+#if TRACE_ENABLED
+struct trace_test_sync_t
+{
+    std::atomic<int> recorded = {0};
+    std::atomic<bool> written = {false};
+};
+
+
+// Поток держит своё кольцо, пока трасса не записана: иначе кольцо досталось бы другому потоку
+static void record_trace_test_spans(const char* thread_name, trace_test_sync_t* sync)
+{
+    TRACE_THREAD_NAME(thread_name);
+
+    for (size_t i = 0; i < TRACE_RING_SIZE + SELF_TEST_TRACE_OVERWRITTEN; i++)
+    {
+        TRACE_SPAN((i < SELF_TEST_TRACE_OVERWRITTEN) ? "overwritten span" : "kept span");
+    }
+
+    sync -> recorded.fetch_add(1);
+    while (!sync -> written.load())
+        std::this_thread::yield();
+}
+
+
+// Номер потока берётся из записи thread_name, потом считаются его спаны с этим именем
+static size_t count_trace_events(const char* json, const char* thread_name, const char* span_name)
 {
+    char pattern[MAX_LENGTH_OF_ADDRESS] = {};
+    snprintf(pattern, sizeof(pattern), "\"args\":{\"name\":\"%s\"}", thread_name);
+
+    const char* record = strstr(json, pattern);
+    if (record == NULL)
+        return 0;
+
+    while (record > json && record[-1] != '\n')
+        record--;
+
+    const char* tid = strstr(record, "\"tid\":");
+    if (tid == NULL)
+        return 0;
+
+    snprintf(pattern, sizeof(pattern), "{\"name\":\"%s\",\"cat\":\"akinator\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,",
+             span_name, strtoul(tid + strlen("\"tid\":"), NULL, 10));
+
+    size_t number_of_events = 0;
+    for (const char* event = strstr(json, pattern); event != NULL; event = strstr(event + 1, pattern))
+        number_of_events++;
+
+    return number_of_events;
+}
+#endif
+
+
+size_t test_akinator()
+{
+    size_t failures = 0;
+
     tree_t tree = {};
     tree_constructor(&tree);
 
-    const char* folder_name = "log_TestAkinator";
+    const char* folder_name = SELF_TEST_LOG;
     initialization_of_tree_log(folder_name);
 
     tree_dump(&tree, folder_name);
@@ -64,16 +309,985 @@ void test_akinator()
     printf("Final tree with %zu elements\n", tree.size);
     tree_dump(&tree, folder_name);
 
+    SELF_TEST_CHECK_SIZE(tree.size, 11);
+    SELF_TEST_CHECK_STRING(tree.root -> question, "has tail");
+    SELF_TEST_CHECK_STRING(tree.root -> yes -> no -> question, "live in Thailand");
+    SELF_TEST_CHECK_STRING(tree.root -> no -> no -> no -> question, "nothing");
+
+    printf("Partial dumps: neighbourhood of 'dog' and top of the tree\n");
+    {
+        dump_options_t options = {};
+        dump_options_init(&options);
+
+        options.focus_object = "dog";
+        options.radius = 2;
+        tree_dump_with_options(&tree, folder_name, &options);
+
+        dump_options_init(&options);
+        options.max_depth = 1;
+        options.table_page_size = 2;
+        tree_dump_with_options(&tree, folder_name, &options);
+
+        // сводные узлы вместе с показанными покрывают всё дерево
+        dump_snapshot_t* snapshot = NULL;
+        SELF_TEST_CHECK(dump_snapshot_create(&tree, &options, &snapshot) == TREE_NO_ERROR);
+        if (snapshot != NULL)
+        {
+            size_t covered = 0;
+            for (size_t i = 0; i < snapshot -> count; i++)
+                covered += (snapshot -> nodes[i].collapsed != 0) ? snapshot -> nodes[i].collapsed : 1;
+
+            SELF_TEST_CHECK_SIZE(snapshot -> number_of_collapsed, 4);
+            SELF_TEST_CHECK_SIZE(covered, tree.size);
+            dump_snapshot_destroy(snapshot);
+        }
+
+        // ветка "да" длиной 1000: под ней 1000 отложенных листов "нет", больше MAX_PATH_DEPTH
+        tree_t comb = {};
+        tree_constructor(&comb);
+
+        node_t* leaf = comb.root;
+        for (size_t i = 0; i < 1000 && leaf != NULL; i++)
+        {
+            tree_split_node(&comb, leaf, "deeper", "bottom");
+            leaf = leaf -> yes;
+        }
+
+        dump_options_init(&options);
+        options.max_depth = 0;
+        snapshot = NULL;
+        SELF_TEST_CHECK(dump_snapshot_create(&comb, &options, &snapshot) == TREE_NO_ERROR);
+        if (snapshot != NULL && snapshot -> count == 3)
+        {
+            SELF_TEST_CHECK_SIZE(snapshot -> nodes[1].collapsed + snapshot -> nodes[2].collapsed, comb.size - 1);
+            SELF_TEST_CHECK(strchr(snapshot -> nodes[1].question, '+') == NULL);
+        }
+        else
+        {
+            SELF_TEST_CHECK(snapshot != NULL && snapshot -> count == 3);
+        }
+        dump_snapshot_destroy(snapshot);
+        tree_destructor(&comb);
+    }
+
     tree_error_type verify_result = tree_verify(&tree);
     printf("Tree verification: %s\n", tree_error_translator(verify_result));
 
-    save_tree_to_file(&tree, "akinator_database.txt");
-    speak_print_with_variable_number_of_parameters("Tree saved to akinator_database.txt\n");
+    printf("Memory before compaction\n");
+    {
+        tree_memory_report_t memory = {};
+        SELF_TEST_CHECK(tree_memory_report_build(&tree, &memory) == TREE_NO_ERROR);
+        tree_memory_report_print(&memory, stdout);
+
+        size_t depth_total = 0;
+        for (size_t depth = 0; depth <= memory.max_depth && memory.depth_counts != NULL; depth++)
+            depth_total += memory.depth_counts[depth];
+
+        SELF_TEST_CHECK_SIZE(memory.number_of_nodes, tree.size);
+        SELF_TEST_CHECK_SIZE(memory.heap_nodes, tree.size);
+        SELF_TEST_CHECK_SIZE(memory.number_of_leaves, (tree.size + 1) / 2);
+        SELF_TEST_CHECK_SIZE(memory.node_bytes, tree.size * sizeof(node_t));
+        SELF_TEST_CHECK_SIZE(depth_total, tree.size);
+        tree_memory_report_destroy(&memory);
+
+        // "nothing" остаётся в листе и ещё раз копируется в новый лист: одна копия лишняя
+        tree_t small = {};
+        SELF_TEST_CHECK(tree_constructor(&small) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&small, small.root, "has tail", "nothing") == TREE_NO_ERROR);
+
+        SELF_TEST_CHECK(tree_memory_report_build(&small, &memory) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(memory.number_of_nodes, 3);
+        SELF_TEST_CHECK_SIZE(memory.number_of_leaves, 2);
+        SELF_TEST_CHECK_SIZE(memory.heap_nodes, 3);
+        SELF_TEST_CHECK_SIZE(memory.phrase_bytes, sizeof("has tail") + 2 * sizeof("nothing"));
+        SELF_TEST_CHECK_SIZE(memory.duplicate_phrase_bytes, sizeof("nothing"));
+        SELF_TEST_CHECK_SIZE(memory.shared_phrases, 0);
+        SELF_TEST_CHECK_SIZE(memory.max_depth, 1);
+        SELF_TEST_CHECK(memory.depth_counts != NULL && memory.depth_counts[0] == 1 && memory.depth_counts[1] == 2);
+        SELF_TEST_CHECK(memory.average_leaf_depth > 0.999 && memory.average_leaf_depth < 1.001); // оба листа на глубине 1
+        SELF_TEST_CHECK(memory.allocator_overhead > 0);
+        tree_memory_report_destroy(&memory);
+
+        // в арене ни узлы, ни фразы не платят за заголовки malloc
+        SELF_TEST_CHECK(tree_compact(&small) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_memory_report_build(&small, &memory) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(memory.number_of_nodes, 3);
+        SELF_TEST_CHECK_SIZE(memory.heap_nodes, 0);
+        SELF_TEST_CHECK_SIZE(memory.allocator_overhead, 0);
+        tree_memory_report_destroy(&memory);
+        tree_destructor(&small);
+    }
+
+    SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&tree), tree.size);
+
+    // маленькое дерево автоматически не уплотняется: по compact-bench выигрыша нет
+    SELF_TEST_CHECK(tree_compact_if_needed(&tree) == TREE_NO_ERROR && tree.arena == NULL);
+
+    SELF_TEST_CHECK(tree_compact(&tree) == TREE_NO_ERROR);
+    verify_result = tree_verify(&tree);
+    printf("Tree verification after compaction: %s\n", tree_error_translator(verify_result));
+
+    SELF_TEST_CHECK(verify_result == TREE_NO_ERROR);
+    SELF_TEST_CHECK_SIZE(tree.size, 11);
+    SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&tree), 0);
+    SELF_TEST_CHECK(tree.root == &tree.arena -> nodes[0]);
+    SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "snake") != NULL);
+
+    printf("Packed storage\n");
+    {
+        packed_tree_t packed = {};
+        if (packed_tree_build(&tree, &packed) == TREE_NO_ERROR)
+        {
+            uint32_t dog = packed_tree_find_leaf_by_phrase(&packed, "Dog");
+            printf("Found '%s' at index %u, %zu bytes packed vs %zu bytes in heap nodes\n",
+                   (dog != PACKED_NIL) ? packed_node_question(&packed, dog) : "nothing", dog,
+                   packed_tree_memory_usage(&packed), tree_heap_memory_estimate(&tree));
+
+            SELF_TEST_CHECK_SIZE(packed.count, tree.size);
+            SELF_TEST_CHECK(packed_tree_memory_usage(&packed) < tree_heap_memory_estimate(&tree));
+            SELF_TEST_CHECK(dog != PACKED_NIL);
+            if (dog != PACKED_NIL)
+            {
+                SELF_TEST_CHECK_STRING(packed_node_question(&packed, dog), "dog");
+                SELF_TEST_CHECK_STRING(packed_node_question(&packed, packed_node_parent(&packed, dog)), "barks");
+
+                // длинная фраза уходит в пул, короткая остаётся в узле: обе переживают распаковку
+                SELF_TEST_CHECK(packed_tree_split_node(&packed, dog, "guards the house at night", "pug") == TREE_NO_ERROR);
+            }
+
+            tree_t unpacked = {};
+            SELF_TEST_CHECK(packed_tree_unpack(&packed, &unpacked) == TREE_NO_ERROR);
+            SELF_TEST_CHECK(tree_verify(&unpacked) == TREE_NO_ERROR);
+            SELF_TEST_CHECK_SIZE(unpacked.size, tree.size + 2);
+
+            node_t* pug = find_leaf_by_phrase(unpacked.root, "pug");
+            SELF_TEST_CHECK(pug != NULL);
+            if (pug != NULL)
+            {
+                SELF_TEST_CHECK_STRING(pug -> parent -> question, "guards the house at night");
+                SELF_TEST_CHECK_STRING(pug -> parent -> no -> question, "dog");
+            }
+            tree_destructor(&unpacked);
+        }
+        else
+        {
+            SELF_TEST_CHECK(!"packed_tree_build failed");
+        }
+        packed_tree_destroy(&packed);
+    }
+
+    printf("Deep verification of a tree with a broken back-pointer\n");
+    {
+        node_t* snake_node = tree.root -> yes -> no -> yes;
+        node_t* real_parent = snake_node -> parent;
+
+        snake_node -> parent = tree.root;
+
+        tree_verify_report_t report = {};
+        SELF_TEST_CHECK(tree_verify_deep(&tree, 0, &report) != TREE_NO_ERROR);
+        tree_verify_report_print(&report, stdout);
+
+        // нарушение видно у родителя, на которого ребёнок не ссылается
+        SELF_TEST_CHECK(report.violation == TREE_VIOLATION_PARENT_POINTER);
+        SELF_TEST_CHECK(report.node == real_parent);
+        SELF_TEST_CHECK_SIZE(report.path_length, 3);
+        if (report.path_length == 3)
+        {
+            SELF_TEST_CHECK(report.path[0].question_node == tree.root && report.path[0].answer);
+            SELF_TEST_CHECK(report.path[1].question_node == tree.root -> yes && !report.path[1].answer);
+        }
+        tree_verify_report_destroy(&report);
+
+        snake_node -> parent = real_parent;
+
+        SELF_TEST_CHECK(tree_verify_deep(&tree, 0, &report) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(report.violation == TREE_VIOLATION_NONE);
+        SELF_TEST_CHECK_SIZE(report.number_of_nodes, tree.size);
+        tree_verify_report_destroy(&report);
+    }
+
+    printf("Undo and redo of learned objects\n");
+    {
+        SELF_TEST_CHECK(tree_history_create(&tree) == TREE_NO_ERROR);
+
+        node_t* dog_node = find_leaf_by_phrase(tree.root, "dog");
+        SELF_TEST_CHECK(dog_node != NULL);
+        SELF_TEST_CHECK(tree_split_node(&tree, dog_node, "is small", "chihuahua") == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree.size, 13);
+
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) == TREE_NO_ERROR);
+        printf("After undo: %zu nodes, %s, leaf '%s'\n", tree.size, tree_error_translator(tree_verify(&tree)), dog_node -> question);
+        SELF_TEST_CHECK_SIZE(tree.size, 11);
+        SELF_TEST_CHECK(tree_verify(&tree) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(is_leaf(dog_node));
+        SELF_TEST_CHECK_STRING(dog_node -> question, "dog");
+
+        SELF_TEST_CHECK(tree_redo_split(&tree, NULL) == TREE_NO_ERROR);
+        printf("After redo: %zu nodes, %s, question '%s'\n", tree.size, tree_error_translator(tree_verify(&tree)), dog_node -> question);
+        SELF_TEST_CHECK_SIZE(tree.size, 13);
+        SELF_TEST_CHECK(tree_verify(&tree) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(dog_node -> question, "is small");
+        SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "chihuahua") != NULL);
+
+        // новое разделение после отмены стирает то, что можно было вернуть
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&tree, find_leaf_by_phrase(tree.root, "bird"), "is black", "crow") == TREE_NO_ERROR);
+        tree_error_type redo_result = tree_redo_split(&tree, NULL);
+        printf("Redo after a new split: %s\n", (redo_result == TREE_NO_ERROR) ? "applied" : "nothing to redo");
+        SELF_TEST_CHECK(redo_result != TREE_NO_ERROR);
+        SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "chihuahua") == NULL);
+
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) == TREE_NO_ERROR);
+
+        // уплотнение переносит узлы, но журнал идёт за ними: отмена после него работает
+        SELF_TEST_CHECK(tree_split_node(&tree, find_leaf_by_phrase(tree.root, "dog"), "is small", "chihuahua") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_compact(&tree) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&tree), 0);
+
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) == TREE_NO_ERROR);
+        printf("Undo after compaction: %zu nodes, %s\n", tree.size, tree_error_translator(tree_verify(&tree)));
+        SELF_TEST_CHECK_SIZE(tree.size, 11);
+        SELF_TEST_CHECK(tree_verify(&tree) == TREE_NO_ERROR);
+        dog_node = find_leaf_by_phrase(tree.root, "dog");
+        SELF_TEST_CHECK(dog_node != NULL && is_leaf(dog_node));
+        SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "chihuahua") == NULL);
+
+        // отменённые листья теперь в арене, а следующее уплотнение её освобождает
+        SELF_TEST_CHECK(tree_compact(&tree) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_redo_split(&tree, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree.size, 13);
+        SELF_TEST_CHECK(tree_verify(&tree) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "chihuahua") != NULL);
+        SELF_TEST_CHECK(find_leaf_by_phrase(tree.root, "dog") != NULL);
+
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_undo_split(&tree, NULL) != TREE_NO_ERROR); // отменённый "crow" стёрло новое разделение
+        tree_history_destroy(&tree);
+        printf("Back to %zu nodes: %s\n", tree.size, tree_error_translator(tree_verify(&tree)));
+        SELF_TEST_CHECK_SIZE(tree.size, 11);
+        SELF_TEST_CHECK(tree_verify(&tree) == TREE_NO_ERROR);
+    }
+
+    // ни рабочую базу игрока, ни файлы из репозитория самотест не трогает
+    SELF_TEST_CHECK(save_tree_to_file(&tree, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+    speak_print_with_variable_number_of_parameters("Tree saved to " SELF_TEST_TREE_FILE "\n");
+
+    printf("Scattered nodes after an undo across compaction\n");
+    {
+        tree_t session = {};
+        SELF_TEST_CHECK(load_tree_from_file(&session, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_history_create(&session) == TREE_NO_ERROR);
+
+        // листья отменённого разделения остаются в арене, но в дереве их уже нет
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "dog"), "is small", "chihuahua") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_compact(&session) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_undo_split(&session, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&session), 0);
+
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "bird"), "is black", "crow") == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&session), 2);
+
+        SELF_TEST_CHECK(tree_undo_split(&session, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_redo_split(&session, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&session), 2);
+
+        SELF_TEST_CHECK(tree_compact(&session) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(tree_count_scattered_nodes(&session), 0);
+
+        tree_history_destroy(&session);
+        tree_destructor(&session);
+    }
+
+    printf("Structural diff between the saved snapshot and a session after it\n");
+    {
+        tree_t session = {};
+        tree_diff_t diff = {};
+        char* printed = NULL;
+
+        SELF_TEST_CHECK(load_tree_from_file(&session, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "fish"), "has fins", "shark") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_diff(&tree, &session, &diff) == TREE_NO_ERROR);
+
+        tree_diff_print(&diff, stdout);
+        SELF_TEST_CHECK_SIZE(diff.number_of_changes, 2);
+        SELF_TEST_CHECK_SIZE(diff.number_of_skipped_nodes, 8);
+
+        FILE* diff_file = fopen("akinator_test_diff.txt", "w");
+        SELF_TEST_CHECK(diff_file != NULL);
+        if (diff_file != NULL)
+        {
+            tree_diff_print(&diff, diff_file);
+            fclose(diff_file);
+        }
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_diff.txt", &printed, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(printed,
+            "split            \"has fins\" asked before \"fish\": \"has tail\" -no-> \"can fly\" -no-> \"can swim\" -yes-> \"has fins\"\n"
+            "add              \"has tail\" -no-> \"can fly\" -no-> \"can swim\" -yes-> \"has fins\" -yes-> \"shark\"\n"
+            "Tree diff: 2 changes, 7 node pairs compared, 8 nodes skipped in identical subtrees\n");
+
+        free(printed);
+        remove("akinator_test_diff.txt");
+        tree_diff_destroy(&diff);
+        tree_destructor(&session);
+    }
+
+    printf("Phrases with quotes and backslashes survive saving\n");
+    {
+        tree_t quoted = {};
+        tree_t reloaded = {};
+
+        SELF_TEST_CHECK(load_tree_from_file(&quoted, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&quoted, find_leaf_by_phrase(quoted.root, "fish"),
+                                        "says \"blub\" <loudly> & often", "C:\\fish\\tank") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(save_tree_to_file(&quoted, "akinator_test_escapes.txt") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(load_tree_from_file(&reloaded, "akinator_test_escapes.txt") == TREE_NO_ERROR);
+
+        node_t* tank = find_leaf_by_phrase(reloaded.root, "C:\\fish\\tank");
+        printf("Leaf 'C:\\fish\\tank' is %s, %zu nodes after reload\n", (tank != NULL) ? "found" : "lost", reloaded.size);
+
+        SELF_TEST_CHECK_SIZE(reloaded.size, quoted.size);
+        SELF_TEST_CHECK(tank != NULL && tank -> parent != NULL);
+        if (tank != NULL && tank -> parent != NULL)
+            SELF_TEST_CHECK_STRING(tank -> parent -> question, "says \"blub\" <loudly> & often");
+
+        // в HTML-логе та же фраза не должна стать разметкой
+        dump_options_t options = {};
+        dump_options_init(&options);
+        dump_snapshot_t* snapshot = NULL;
+        SELF_TEST_CHECK(dump_snapshot_create(&quoted, &options, &snapshot) == TREE_NO_ERROR);
+
+        FILE* htm_file = fopen("akinator_test_escapes.htm", "w");
+        SELF_TEST_CHECK(htm_file != NULL);
+        if (htm_file != NULL && snapshot != NULL)
+            write_tree_nodes_table(htm_file, snapshot);
+        if (htm_file != NULL)
+            fclose(htm_file);
+
+        char* table = NULL;
+        size_t table_size = 0;
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_escapes.htm", &table, &table_size) == TREE_NO_ERROR);
+        if (table != NULL)
+        {
+            SELF_TEST_CHECK(strstr(table, "<td>says &quot;blub&quot; &lt;loudly&gt; &amp; often</td>") != NULL);
+            SELF_TEST_CHECK(strstr(table, "<loudly>") == NULL);
+        }
+
+        free(table);
+        dump_snapshot_destroy(snapshot);
+        tree_destructor(&quoted);
+        tree_destructor(&reloaded);
+        remove("akinator_test_escapes.txt");
+        remove("akinator_test_escapes.htm");
+
+        printf("Databases are scanned with %s\n", tree_scan_kind_name(tree_scan_current()));
+
+        const char broken[] = "(\"has tail\"\n    (\"cat\" nil nil)\n    (\"dog nil nil)\n)\n";
+        const char valid[]  = "(\"has \\\"tail\\\"\" (\"cat\" nil nil)\n (\"dog\" nil nil))";
+        node_t* root = NULL;
+        tree_parse_error_t error = {};
+
+        if (tree_parse(broken, sizeof(broken) - 1, &root, NULL, &error) != TREE_NO_ERROR)
+            tree_parse_error_print(&error, "<broken database>", stdout);
+        tree_parse_destroy(root);
+
+        // незакрытая кавычка у "dog: место ошибки не зависит от классификатора
+        tree_scan_kind current = tree_scan_current();
+        const tree_scan_kind kinds[] = {TREE_SCAN_NONE, TREE_SCAN_SCALAR, TREE_SCAN_SSE2, TREE_SCAN_AVX2};
+
+        for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+        {
+            if (!tree_scan_select(kinds[i]))
+                continue;
+
+            root = NULL;
+            error = {};
+            SELF_TEST_CHECK(tree_parse(broken, sizeof(broken) - 1, &root, NULL, &error) != TREE_NO_ERROR);
+            SELF_TEST_CHECK_SIZE(error.line, 3);
+            SELF_TEST_CHECK_SIZE(error.column, 6);
+            SELF_TEST_CHECK_SIZE(error.offset, sizeof("(\"has tail\"\n    (\"cat\" nil nil)\n    (") - 1);
+            SELF_TEST_CHECK(error.message != NULL);
+            if (error.message != NULL)
+                SELF_TEST_CHECK_STRING(error.message, "phrase has no closing quote");
+            tree_parse_destroy(root);
+
+            root = NULL;
+            size_t number_of_nodes = 0;
+            SELF_TEST_CHECK(tree_parse(valid, sizeof(valid) - 1, &root, &number_of_nodes, &error) == TREE_NO_ERROR);
+            SELF_TEST_CHECK_SIZE(number_of_nodes, 3);
+            if (root != NULL && root -> no != NULL)
+            {
+                SELF_TEST_CHECK_STRING(root -> question, "has \"tail\"");
+                SELF_TEST_CHECK_STRING(root -> no -> question, "dog");
+            }
+            tree_parse_destroy(root);
+        }
+
+        SELF_TEST_CHECK(tree_scan_select(current));
+    }
+
+    printf("Built-in default database\n");
+    {
+        tree_t builtin = {};
+        tree_t fresh   = {};
+
+        SELF_TEST_CHECK(tree_embedded_attach(&builtin) == TREE_NO_ERROR);
+        printf("Built-in database: %zu nodes, %s\n", builtin.size, tree_error_translator(tree_verify(&builtin)));
+
+        SELF_TEST_CHECK(tree_is_embedded(&builtin));
+        SELF_TEST_CHECK_SIZE(builtin.size, 11);
+        SELF_TEST_CHECK(tree_verify(&builtin) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(builtin.root != NULL && builtin.root -> question != NULL);
+        if (builtin.root != NULL && builtin.root -> question != NULL)
+            SELF_TEST_CHECK_STRING(builtin.root -> question, "has tail");
+
+        // встроенная таблица только для чтения: новый объект учится в копии
+        node_t* fish = find_leaf_by_phrase(builtin.root, "fish");
+        SELF_TEST_CHECK(fish != NULL);
+        SELF_TEST_CHECK(tree_split_node(&builtin, fish, "has fins", "shark") == TREE_NO_ERROR);
+        printf("After learning 'shark': %s, %zu nodes, %s\n", tree_is_embedded(&builtin) ? "still built-in" : "own copy",
+               builtin.size, tree_error_translator(tree_verify(&builtin)));
+
+        SELF_TEST_CHECK(!tree_is_embedded(&builtin));
+        SELF_TEST_CHECK_SIZE(builtin.size, 13);
+        SELF_TEST_CHECK(tree_verify(&builtin) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(find_leaf_by_phrase(builtin.root, "shark") != NULL);
+
+        SELF_TEST_CHECK(tree_embedded_attach(&fresh) == TREE_NO_ERROR);
+        printf("Next start sees %zu nodes, 'shark' is %s\n", fresh.size,
+               (find_leaf_by_phrase(fresh.root, "shark") != NULL) ? "found" : "not learned");
+
+        SELF_TEST_CHECK(tree_is_embedded(&fresh));
+        SELF_TEST_CHECK_SIZE(fresh.size, 11);
+        SELF_TEST_CHECK(find_leaf_by_phrase(fresh.root, "shark") == NULL);
+        SELF_TEST_CHECK(find_leaf_by_phrase(fresh.root, "fish") != NULL);
+
+        tree_destructor(&builtin);
+        tree_destructor(&fresh);
+    }
+
+    printf("Two databases sharing one phrase pool\n");
+    {
+        static tree_registry_t registry;
+        SELF_TEST_CHECK(tree_registry_init(&registry) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_registry_add(&registry, "first",  SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_registry_add(&registry, "second", SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+
+        bool created = false;
+        SELF_TEST_CHECK(tree_registry_load(&registry, &registry.entries[0], &created) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_registry_load(&registry, &registry.entries[1], &created) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(!created);
+
+        // одна и та же фраза двух баз - одна строка пула
+        node_t* first_dog  = find_leaf_by_phrase(registry.entries[0].tree.root, "dog");
+        node_t* second_dog = find_leaf_by_phrase(registry.entries[1].tree.root, "dog");
+        SELF_TEST_CHECK(first_dog != NULL && second_dog != NULL && first_dog -> question == second_dog -> question);
+        SELF_TEST_CHECK_SIZE(registry.pool.number_of_strings, 11);
+        SELF_TEST_CHECK_SIZE(registry.pool.interned_bytes, 2 * registry.pool.stored_bytes);
+
+        // выгрузка первой базы не должна задеть фразы второй
+        SELF_TEST_CHECK(tree_registry_unload(&registry.entries[0]) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(!registry.entries[0].is_loaded);
+
+        tree_error_type second_result = tree_verify(&registry.entries[1].tree);
+        second_dog = find_leaf_by_phrase(registry.entries[1].tree.root, "dog");
+        printf("Second database after unloading the first: %s, 'dog' is %s\n", tree_error_translator(second_result),
+               (second_dog != NULL) ? "found" : "lost");
+        SELF_TEST_CHECK(second_result == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(registry.entries[1].tree.size, 11);
+        SELF_TEST_CHECK(second_dog != NULL);
+
+        tree_registry_print(&registry, stdout);
+        tree_registry_destroy(&registry);
+    }
+
+    printf("Tree induced from a table of features\n");
+    {
+        FILE* table_file = fopen("akinator_test_table.csv", "w");
+        if (table_file != NULL)
+        {
+            fputs("object,has tail,can fly,barks\n"
+                  "dog,1,0,1\n"
+                  "cat,yes,no,no\n"
+                  "bird,true,true,false\n"
+                  "fish,1,0,0\n", table_file); // fish и cat по этим признакам не различить
+            fclose(table_file);
+        }
+
+        induction_table_t table = {};
+        tree_t induced = {};
+        induction_report_t report = {};
+        char* saved = NULL;
+
+        SELF_TEST_CHECK(induction_table_load_csv("akinator_test_table.csv", &table) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(table.number_of_objects,  4);
+        SELF_TEST_CHECK_SIZE(table.number_of_features, 3);
+        SELF_TEST_CHECK(induce_tree(&table, 0, &induced, &report) == TREE_NO_ERROR);
+
+        induction_report_print(&report, stdout);
+        printf("Verification: %s, 'bird' is %s\n", tree_error_translator(tree_verify(&induced)),
+               (find_leaf_by_phrase(induced.root, "bird") != NULL) ? "found" : "lost");
+        SELF_TEST_CHECK_SIZE(report.number_of_nodes, 7);
+        SELF_TEST_CHECK_SIZE(report.depth, 3);
+        SELF_TEST_CHECK_SIZE(report.number_of_indistinguishable, 2);
+        SELF_TEST_CHECK_SIZE(induced.size, 7);
+        SELF_TEST_CHECK(tree_verify(&induced) == TREE_NO_ERROR);
+
+        SELF_TEST_CHECK(save_tree_to_file(&induced, "akinator_test_induced.txt") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_induced.txt", &saved, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(saved, "(\"can fly\" (\"bird\" nil nil) "
+                                      "(\"barks\" (\"dog\" nil nil) (\"is it fish\" (\"fish\" nil nil) (\"cat\" nil nil))))");
+
+        free(saved);
+        induction_table_destroy(&table);
+        tree_destructor(&induced);
+        remove("akinator_test_table.csv");
+        remove("akinator_test_induced.txt");
+    }
+
+    printf("NDJSON export reads back\n");
+    {
+        tree_t exported = {};
+        tree_export_report_t report = {};
+        char* records = NULL;
+        size_t records_length = 0;
+
+        // кавычка, обратная черта, перевод строки и байт не из UTF-8 пишутся экранированными
+        SELF_TEST_CHECK(load_tree_from_file(&exported, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&exported, find_leaf_by_phrase(exported.root, "fish"),
+                                        "says \"blub\"\n", "C:\\fish\xff") == TREE_NO_ERROR);
+
+        FILE* export_file = fopen("akinator_test_export.ndjson", "wb");
+        SELF_TEST_CHECK(export_file != NULL);
+        if (export_file != NULL)
+        {
+            SELF_TEST_CHECK(tree_export_ndjson(&exported, export_file, true, &report) == TREE_NO_ERROR);
+            fclose(export_file);
+        }
+
+        printf("Exported %zu nodes and %zu paths, %zu bytes\n", report.number_of_nodes, report.number_of_paths, report.bytes_written);
+        SELF_TEST_CHECK_SIZE(report.number_of_nodes, 13);
+        SELF_TEST_CHECK_SIZE(report.number_of_paths, 7);
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_export.ndjson", &records, &records_length) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(records_length, report.bytes_written);
+        SELF_TEST_CHECK(records != NULL && strstr(records, "\"text\":\"says \\\"blub\\\"\\n\"") != NULL);
+        SELF_TEST_CHECK(records != NULL && strstr(records, "\"text\":\"C:\\\\fish\\u00ff\"") != NULL);
+
+        // тексты узлов, разобранные обратно, совпадают с деревом в прямом порядке обхода
+        size_t number_of_node_records = 0;
+        size_t number_of_path_records = 0;
+        const node_t* node = exported.root;
+
+        for (const char* line = records; line != NULL && *line != '\0'; )
+        {
+            const char* line_end = strchr(line, '\n');
+
+            if (strncmp(line, "{\"type\":\"node\"", strlen("{\"type\":\"node\"")) == 0)
+            {
+                char phrase[MAX_LENGTH_OF_ADDRESS] = {};
+                const char* text = strstr(line, "\"text\":");
+                const char* text_end = (text != NULL) ? read_json_string(text + strlen("\"text\":"), phrase, sizeof(phrase)) : NULL;
+
+                SELF_TEST_CHECK(text_end != NULL && text_end < line_end && node != NULL);
+                if (text_end != NULL && node != NULL)
+                    SELF_TEST_CHECK_STRING(phrase, node -> question);
+
+                node = (node != NULL) ? next_in_preorder(node) : NULL;
+                number_of_node_records++;
+            }
+            else if (strncmp(line, "{\"type\":\"path\"", strlen("{\"type\":\"path\"")) == 0)
+            {
+                number_of_path_records++;
+            }
+            else
+            {
+                SELF_TEST_CHECK(!"unknown NDJSON record");
+            }
+
+            line = (line_end != NULL) ? line_end + 1 : NULL;
+        }
+
+        SELF_TEST_CHECK_SIZE(number_of_node_records, exported.size);
+        SELF_TEST_CHECK_SIZE(number_of_path_records, 7);
+        SELF_TEST_CHECK(node == NULL);
+
+        free(records);
+        tree_destructor(&exported);
+        remove("akinator_test_export.ndjson");
+    }
+
+    printf("Background save while the game keeps learning\n");
+    {
+        tree_t growing = {};
+        tree_t saved   = {};
+        size_t random_state = 1;
+        tree_snapshot_report_t report = {};
+
+        SELF_TEST_CHECK(tree_constructor(&growing) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(grow_self_test_tree(&growing, SELF_TEST_SNAPSHOT_NODES, &random_state));
+        size_t saved_size = growing.size;
+
+        char first_new_object[MAX_LENGTH_OF_ADDRESS] = {};
+        snprintf(first_new_object, sizeof(first_new_object), "object %zu", saved_size);
+
+        // файл должен получиться таким, каким дерево было в момент запуска сохранения
+        SELF_TEST_CHECK(tree_snapshot_save(&growing, "akinator_test_snapshot.txt") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(grow_self_test_tree(&growing, saved_size + SELF_TEST_SNAPSHOT_CHANGES, &random_state));
+        SELF_TEST_CHECK(tree_snapshot_wait(&growing, &report));
+
+        printf("Saved %zu nodes while the tree grew to %zu\n", report.number_of_nodes, growing.size);
+        SELF_TEST_CHECK(report.result == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(report.number_of_nodes, saved_size);
+
+        SELF_TEST_CHECK(load_tree_from_file(&saved, "akinator_test_snapshot.txt") == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(saved.size, saved_size);
+        SELF_TEST_CHECK(tree_verify(&saved) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(find_leaf_by_phrase(saved.root, first_new_object) == NULL);
+        SELF_TEST_CHECK(find_leaf_by_phrase(growing.root, first_new_object) != NULL);
+
+        tree_destructor(&saved);
+        tree_destructor(&growing);
+        remove("akinator_test_snapshot.txt");
+    }
+
+    printf("Merging two databases\n");
+    {
+        merge_report_t report = {};
+        char* merged = NULL;
+
+        // dog в одной базе по "да", в другой - по "нет": конфликт с путями из обеих
+        write_self_test_file("akinator_test_merge_1.txt", "(\"has tail\" (\"dog\" nil nil) (\"fish\" nil nil))");
+        write_self_test_file("akinator_test_merge_2.txt", "(\"has tail\" (\"cat\" nil nil) (\"dog\" nil nil))");
+
+        FILE* conflicts = fopen("akinator_test_conflicts.txt", "w");
+        SELF_TEST_CHECK(conflicts != NULL);
+        if (conflicts != NULL)
+        {
+            SELF_TEST_CHECK(merge_databases("akinator_test_merge_1.txt", "akinator_test_merge_2.txt",
+                                            "akinator_test_merged.txt", conflicts, &report) == TREE_NO_ERROR);
+            fclose(conflicts);
+        }
+
+        merge_report_print(&report, stdout);
+        SELF_TEST_CHECK_SIZE(report.number_of_output_nodes,  7);
+        SELF_TEST_CHECK_SIZE(report.number_of_aligned_nodes, 1);
+        SELF_TEST_CHECK_SIZE(report.number_of_grafted_nodes, 2);
+        SELF_TEST_CHECK_SIZE(report.number_of_conflicts,     1);
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_merged.txt", &merged, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(merged, "(\"has tail\" (\"is it cat\" (\"cat\" nil nil) (\"dog\" nil nil)) "
+                                       "(\"is it dog\" (\"dog\" nil nil) (\"fish\" nil nil)))");
+        free(merged);
+        merged = NULL;
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_conflicts.txt", &merged, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(merged, "Conflict: \"dog\" reached by: has tail not is it cat\n"
+                                       "Conflict: \"dog\" reached by: not has tail is it dog\n");
+        free(merged);
+        merged = NULL;
+
+        // разные вопросы: вопрос второй базы встаёт выше, первая база целиком уходит по "нет"
+        write_self_test_file("akinator_test_merge_2.txt", "(\"can fly\" (\"bird\" nil nil) (\"fish\" nil nil))");
+
+        SELF_TEST_CHECK(merge_databases("akinator_test_merge_1.txt", "akinator_test_merge_2.txt",
+                                        "akinator_test_merged.txt", NULL, &report) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(report.number_of_output_nodes,  5);
+        SELF_TEST_CHECK_SIZE(report.number_of_aligned_nodes, 1);
+        SELF_TEST_CHECK_SIZE(report.number_of_conflicts,     0);
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_merged.txt", &merged, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_STRING(merged, "(\"can fly\" (\"bird\" nil nil) (\"has tail\" (\"dog\" nil nil) (\"fish\" nil nil)))");
+        free(merged);
+
+        // глубина базы ограничена только памятью: внизу цепочек разные объекты
+        write_question_chain("akinator_test_merge_1.txt", SELF_TEST_MERGE_DEPTH, "bottom");
+        write_question_chain("akinator_test_merge_2.txt", SELF_TEST_MERGE_DEPTH, "other bottom");
+
+        SELF_TEST_CHECK(merge_databases("akinator_test_merge_1.txt", "akinator_test_merge_2.txt",
+                                        "akinator_test_merged.txt", NULL, &report) == TREE_NO_ERROR);
+        merge_report_print(&report, stdout);
+        SELF_TEST_CHECK_SIZE(report.number_of_output_nodes,  2 * SELF_TEST_MERGE_DEPTH + 3);
+        SELF_TEST_CHECK_SIZE(report.number_of_aligned_nodes, 2 * SELF_TEST_MERGE_DEPTH);
+        SELF_TEST_CHECK_SIZE(report.number_of_grafted_nodes, 1);
+
+        // разбор и освобождение без рекурсии: tree_t с такой глубиной не справится
+        char* deep_text = NULL;
+        size_t deep_length = 0;
+        node_t* deep_root = NULL;
+        size_t deep_size = 0;
+        tree_parse_error_t error = {};
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_merged.txt", &deep_text, &deep_length) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_parse(deep_text, deep_length, &deep_root, &deep_size, &error) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(deep_size, 2 * SELF_TEST_MERGE_DEPTH + 3);
+
+        const node_t* lowest = deep_root;
+        while (lowest != NULL && lowest -> no != NULL)
+            lowest = lowest -> no;
+
+        SELF_TEST_CHECK(lowest != NULL && lowest -> parent != NULL);
+        if (lowest != NULL && lowest -> parent != NULL)
+            SELF_TEST_CHECK_STRING(lowest -> parent -> yes -> question, "other bottom");
+
+        tree_parse_destroy(deep_root);
+        free(deep_text);
+
+        remove("akinator_test_merge_1.txt");
+        remove("akinator_test_merge_2.txt");
+        remove("akinator_test_merged.txt");
+        remove("akinator_test_conflicts.txt");
+    }
+
+    printf("Incremental dumps after a split, an undo and a compaction\n");
+    {
+        tree_t session = {};
+        dump_options_t options = {};
+        dump_options_init(&options);
+        dump_snapshot_t* snapshots[5] = {};
+
+        SELF_TEST_CHECK(load_tree_from_file(&session, SELF_TEST_TREE_FILE) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_history_create(&session) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(dump_snapshot_create(&session, &options, &snapshots[0]) == TREE_NO_ERROR);
+
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "dog"), "is small", "chihuahua") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(dump_snapshot_create(&session, &options, &snapshots[1]) == TREE_NO_ERROR);
+
+        SELF_TEST_CHECK(tree_undo_split(&session, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(dump_snapshot_create(&session, &options, &snapshots[2]) == TREE_NO_ERROR);
+
+        // после уплотнения у всех узлов новые адреса, но дерево то же
+        SELF_TEST_CHECK(tree_compact(&session) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(dump_snapshot_create(&session, &options, &snapshots[3]) == TREE_NO_ERROR);
+
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "bird"), "is black", "crow") == TREE_NO_ERROR);
+        SELF_TEST_CHECK(dump_snapshot_create(&session, &options, &snapshots[4]) == TREE_NO_ERROR);
+
+        // добавлено, изменено, удалено
+        const size_t expected[4][3] = {{2, 1, 0}, {0, 1, 2}, {0, 0, 0}, {2, 1, 0}};
+
+        for (size_t i = 1; i < 5; i++)
+        {
+            if (snapshots[i] == NULL || snapshots[i - 1] == NULL)
+                continue;
+
+            SELF_TEST_CHECK(compute_dump_diff(snapshots[i], snapshots[i - 1]) == TREE_NO_ERROR);
+            printf("Dump %zu: %zu added, %zu changed, %zu removed\n", i, snapshots[i] -> number_of_added,
+                   snapshots[i] -> number_of_changed, snapshots[i] -> number_of_removed);
+
+            SELF_TEST_CHECK_SIZE(snapshots[i] -> number_of_added,   expected[i - 1][0]);
+            SELF_TEST_CHECK_SIZE(snapshots[i] -> number_of_changed, expected[i - 1][1]);
+            SELF_TEST_CHECK_SIZE(snapshots[i] -> number_of_removed, expected[i - 1][2]);
+        }
+
+        if (snapshots[2] != NULL && snapshots[3] != NULL)
+            SELF_TEST_CHECK(snapshots[2] -> nodes[0].address != snapshots[3] -> nodes[0].address);
+
+        for (size_t i = 0; i < 5; i++)
+            dump_snapshot_destroy(snapshots[i]);
+
+        // то же через лог: полный дамп, разделение и разностный дамп следом
+        options.mode = DUMP_MODE_FULL;
+        SELF_TEST_CHECK(tree_dump_with_options(&session, folder_name, &options) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(tree_split_node(&session, find_leaf_by_phrase(session.root, "fish"), "has fins", "shark") == TREE_NO_ERROR);
+        options.mode = DUMP_MODE_INCREMENTAL;
+        SELF_TEST_CHECK(tree_dump_with_options(&session, folder_name, &options) == TREE_NO_ERROR);
+        dump_worker_flush();
+
+        char* log_text = NULL;
+        SELF_TEST_CHECK(read_file_to_buffer(SELF_TEST_LOG ".htm", &log_text, NULL) == TREE_NO_ERROR);
+
+        const char* last_changes = NULL;
+        for (const char* found = log_text; found != NULL && (found = strstr(found, "Changes since previous dump")) != NULL; found++)
+            last_changes = found;
+
+        SELF_TEST_CHECK(last_changes != NULL &&
+                        strncmp(last_changes, "Changes since previous dump:</b> 2 added, 1 changed, 0 removed",
+                                strlen("Changes since previous dump:</b> 2 added, 1 changed, 0 removed")) == 0);
+
+        free(log_text);
+        tree_history_destroy(&session);
+        tree_destructor(&session);
+    }
+
+    printf("Forbidden phrases filter\n");
+    {
+        phrase_filter_t filter = {};
+
+        // фразы перекрываются: после "th" в "thhis" автомат должен по суффиксной ссылке перейти в "his"
+        const char* phrases[] = {"this", "his", "is not", "", "not a"};
+        SELF_TEST_CHECK(phrase_filter_build(&filter, phrases, sizeof(phrases) / sizeof(phrases[0])) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(filter.number_of_phrases, 4);
+
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "THIS"));
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "It Is Not"));
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "thhis"));
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "thiis not"));
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "thinot a"));
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "thi hi is no"));
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "it is no"));
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, ""));
+
+        // пустой список ничего не запрещает
+        SELF_TEST_CHECK(phrase_filter_build(&filter, phrases + 3, 1) == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(filter.number_of_phrases, 0);
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "this is not"));
+
+        SELF_TEST_CHECK(phrase_filter_build(&filter, phrases, 0) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "this is not"));
+
+        // из файла: комментарии и пустые строки пропускаются, концы строк CRLF тоже
+        write_self_test_file("akinator_test_phrases.txt", "# negative answers\r\ndon't\r\n\n#not\nnever\n");
+        SELF_TEST_CHECK(phrase_filter_load_from_file(&filter, "akinator_test_phrases.txt") == TREE_NO_ERROR);
+        SELF_TEST_CHECK_SIZE(filter.number_of_phrases, 2);
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "I DON'T know"));
+        SELF_TEST_CHECK(phrase_filter_matches(&filter, "now or never"));
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "not negative"));
+        SELF_TEST_CHECK(!phrase_filter_matches(&filter, "# negative answers"));
+
+        phrase_filter_destroy(&filter);
+        remove("akinator_test_phrases.txt");
+    }
+
+    printf("Histogram buckets, quantiles and the Prometheus text\n");
+    {
+        // до 64 корзины точные, дальше ширина корзины растёт вдвое на каждую степень двойки
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(31), 31);
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(32), 32);
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(63), 63);
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(64), 64);
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(65), 64);
+        SELF_TEST_CHECK(metrics_bucket_upper_bound(64) == 65);
+
+        const uint64_t one = 1;
+        const uint64_t edges[] = {31, 32, 63, 64, (one << 31) - 1, one << 31, (one << 32) - 1, one << 32,
+                                  (one << 63) - 1, one << 63, UINT64_MAX};
+
+        for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+        {
+            size_t index = metrics_bucket_index(edges[i]);
+
+            SELF_TEST_CHECK(index < METRICS_NUMBER_OF_BUCKETS);
+            SELF_TEST_CHECK(metrics_bucket_upper_bound(index) >= edges[i]);
+            SELF_TEST_CHECK(index == 0 || metrics_bucket_upper_bound(index - 1) < edges[i]);
+        }
+
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(one << 31), 27 * METRICS_SUB_BUCKETS);
+        SELF_TEST_CHECK(metrics_bucket_upper_bound(metrics_bucket_index((one << 31) - 1)) == (one << 31) - 1);
+        SELF_TEST_CHECK(metrics_bucket_upper_bound(metrics_bucket_index((one << 32) - 1)) == (one << 32) - 1);
+        SELF_TEST_CHECK(metrics_bucket_upper_bound(metrics_bucket_index((one << 63) - 1)) == (one << 63) - 1);
+        SELF_TEST_CHECK_SIZE(metrics_bucket_index(UINT64_MAX), METRICS_NUMBER_OF_BUCKETS - 1);
+        SELF_TEST_CHECK(metrics_bucket_upper_bound(METRICS_NUMBER_OF_BUCKETS - 1) == UINT64_MAX);
+
+        // 1..100: до 64 квантиль точный, дальше - верхняя граница корзины из двух значений
+        metrics_reset();
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0.5) == 0);
+
+        for (uint64_t value = 1; value <= 100; value++)
+            metrics_observe(METRIC_QUESTIONS_PER_GAME, value);
+
+        SELF_TEST_CHECK(metrics_histogram_count(METRIC_QUESTIONS_PER_GAME) == 100);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0)     == 1);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0.5)   == 50);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0.9)   == 91);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0.99)  == 99);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 0.999) == 100);
+        SELF_TEST_CHECK(metrics_histogram_quantile(METRIC_QUESTIONS_PER_GAME, 1)     == 100);
+
+        // время копится в наносекундах, а выводится в секундах; квантиль не больше максимума
+        metrics_counter_add(METRIC_GAMES_PLAYED, 3);
+        metrics_observe(METRIC_TREE_LOAD_SECONDS, 1500000000);
+
+        char* text = NULL;
+        FILE* metrics_file = fopen("akinator_test_metrics.prom", "w");
+        SELF_TEST_CHECK(metrics_file != NULL);
+        if (metrics_file != NULL)
+        {
+            metrics_write_prometheus(metrics_file);
+            fclose(metrics_file);
+        }
+
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_metrics.prom", &text, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "# TYPE akinator_games_played_total counter\n"
+                                                     "akinator_games_played_total 3\n") != NULL);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "# TYPE akinator_tree_load_seconds summary\n"
+                                                     "akinator_tree_load_seconds{quantile=\"0.5\"} 1.5\n"
+                                                     "akinator_tree_load_seconds{quantile=\"0.9\"} 1.5\n"
+                                                     "akinator_tree_load_seconds{quantile=\"0.99\"} 1.5\n"
+                                                     "akinator_tree_load_seconds{quantile=\"0.999\"} 1.5\n"
+                                                     "akinator_tree_load_seconds_sum 1.5\n"
+                                                     "akinator_tree_load_seconds_count 1\n") != NULL);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "akinator_questions_per_game{quantile=\"0.9\"} 91\n") != NULL);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "akinator_questions_per_game_sum 5050\n"
+                                                     "akinator_questions_per_game_count 100\n") != NULL);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "akinator_tree_save_seconds{quantile=\"0.5\"} 0\n") != NULL);
+        SELF_TEST_CHECK(text != NULL && strstr(text, "akinator_tree_save_seconds_count 0\n") != NULL);
+
+        free(text);
+        remove("akinator_test_metrics.prom");
+        metrics_reset();
+    }
+
+#if TRACE_ENABLED
+    printf("Trace keeps the newest events of every thread\n");
+    {
+        // трассу, включённую --trace, не останавливаем: тестовые спаны просто попадут в неё
+        bool was_enabled = trace_is_enabled();
+        SELF_TEST_CHECK(was_enabled || trace_start("akinator_test_trace.json"));
+
+        trace_test_sync_t sync = {};
+        std::thread first(record_trace_test_spans, "trace test 1", &sync);
+        std::thread second(record_trace_test_spans, "trace test 2", &sync);
+
+        while (sync.recorded.load() < 2)
+            std::this_thread::yield();
+
+        FILE* trace_file = fopen("akinator_test_trace_events.json", "w");
+        SELF_TEST_CHECK(trace_file != NULL);
+        if (trace_file != NULL)
+        {
+            trace_write_chrome_json(trace_file);
+            fclose(trace_file);
+        }
+
+        sync.written.store(true);
+        first.join();
+        second.join();
+
+        if (!was_enabled)
+        {
+            trace_stop();
+            remove("akinator_test_trace.json");
+        }
+
+        char* json = NULL;
+        SELF_TEST_CHECK(read_file_to_buffer("akinator_test_trace_events.json", &json, NULL) == TREE_NO_ERROR);
+        SELF_TEST_CHECK(json != NULL && strstr(json, "\"args\":{\"name\":\"trace test 1\"}}") != NULL);
+        SELF_TEST_CHECK(json != NULL && strstr(json, "\"args\":{\"name\":\"trace test 2\"}}") != NULL);
+
+        if (json != NULL)
+        {
+            SELF_TEST_CHECK_SIZE(count_trace_events(json, "trace test 1", "kept span"), TRACE_RING_SIZE);
+            SELF_TEST_CHECK_SIZE(count_trace_events(json, "trace test 2", "kept span"), TRACE_RING_SIZE);
+            SELF_TEST_CHECK_SIZE(count_trace_events(json, "trace test 1", "overwritten span"), 0);
+            SELF_TEST_CHECK_SIZE(count_trace_events(json, "trace test 2", "overwritten span"), 0);
+        }
+
+        free(json);
+        remove("akinator_test_trace_events.json");
+    }
+#endif
 
     close_tree_log(folder_name);
     tree_destructor(&tree);
+    remove(SELF_TEST_TREE_FILE);
+
+    if (failures == 0)
+        speak_print_with_variable_number_of_parameters("Akinator Test Completed\n");
+    else
+        printf("Akinator Test FAILED: %zu checks\n", failures);
 
-    speak_print_with_variable_number_of_parameters("Akinator Test Completed\n");
+    return failures;
 }
 
 
@@ -4,6 +4,7 @@
 #include "tree.h"
 #include "tree_tests.h"
 
-void test_akinator();
+// Возвращает число проваленных проверок, 0 - всё сошлось
+size_t test_akinator();
 
 #endif //TREE_TESTS_H_
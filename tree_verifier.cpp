@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include <new>
+#include <atomic>
+#include <thread>
+
+#include "tree.h"
+#include "tree_verifier.h"
+#include "tree_error_type.h"
+
+#define VERIFY_ABORT_CHECK_PERIOD 4096 // как часто поток смотрит, не нашли ли нарушение раньше него
+
+// Верх дерева проверяется по одному узлу, ниже split_depth каждое поддерево - отдельная задача.
+// Задачи идут в прямом порядке обхода, поэтому первое нарушение - в задаче с наименьшим номером
+struct verify_unit_t
+{
+    node_t* node;
+    size_t depth;
+    bool whole_subtree;
+
+    tree_violation_type violation;
+    node_t* bad_node;
+    path_step* trail; // путь от node до bad_node
+    size_t trail_length;
+    size_t number_of_nodes;
+};
+
+struct verify_units_t
+{
+    verify_unit_t* units;
+    size_t count;
+    size_t capacity;
+};
+
+struct verify_stack_entry
+{
+    node_t* node;
+    size_t depth; // от корня задачи
+    bool is_yes;
+};
+
+struct verify_context_t
+{
+    verify_units_t* units;
+    std::atomic<size_t> next_unit;
+    std::atomic<size_t> first_bad_unit;
+};
+
+
+const char* tree_violation_translator(tree_violation_type violation)
+{
+    switch (violation)
+    {
+        case TREE_VIOLATION_NONE:           return "no violations";
+        case TREE_VIOLATION_SIZE_MISMATCH:  return "tree size doesn't match actual node count";
+        case TREE_VIOLATION_ROOT_PARENT:    return "root has a parent";
+        case TREE_VIOLATION_PARENT_POINTER: return "child points to another parent";
+        case TREE_VIOLATION_CYCLE:          return "child is one of its own ancestors";
+        case TREE_VIOLATION_ONE_CHILD:      return "question has only one answer";
+        case TREE_VIOLATION_EMPTY_PHRASE:   return "empty phrase";
+        default:                            return "unknown violation";
+    }
+}
+
+
+static tree_violation_type check_node_locally(const node_t* node)
+{
+    if (node -> question == NULL || node -> question[0] == '\0')
+        return TREE_VIOLATION_EMPTY_PHRASE;
+
+    if ((node -> yes == NULL) != (node -> no == NULL))
+        return TREE_VIOLATION_ONE_CHILD;
+
+    // если все обратные ссылки сходятся, то обход не может зациклиться или зайти в узел дважды
+    if (node -> yes != NULL && (node -> yes -> parent != node || node -> yes == node -> no))
+        return TREE_VIOLATION_PARENT_POINTER;
+
+    if (node -> no != NULL && node -> no -> parent != node)
+        return TREE_VIOLATION_PARENT_POINTER;
+
+    return TREE_VIOLATION_NONE;
+}
+
+
+static bool add_verify_unit(verify_units_t* units, node_t* node, size_t depth, bool whole_subtree)
+{
+    if (units -> count == units -> capacity)
+    {
+        size_t new_capacity = (units -> capacity == 0) ? 64 : units -> capacity * 2;
+        verify_unit_t* new_units = (verify_unit_t*)realloc(units -> units, new_capacity * sizeof(verify_unit_t));
+        if (new_units == NULL)
+            return false;
+
+        units -> units = new_units;
+        units -> capacity = new_capacity;
+    }
+
+    verify_unit_t unit = {};
+    unit.node          = node;
+    unit.depth         = depth;
+    unit.whole_subtree = whole_subtree;
+    unit.bad_node      = NULL;
+
+    units -> units[units -> count++] = unit;
+    return true;
+}
+
+
+// Верх дерева небольшой (глубина split_depth), его разбираем рекурсивно прямо здесь
+static tree_error_type split_into_units(verify_units_t* units, node_t* node, size_t depth, size_t split_depth,
+                                        bool* stop)
+{
+    if (depth == split_depth || is_leaf(node))
+        return add_verify_unit(units, node, depth, true) ? TREE_NO_ERROR : TREE_ERROR_ALLOCATION;
+
+    if (!add_verify_unit(units, node, depth, false))
+        return TREE_ERROR_ALLOCATION;
+
+    verify_unit_t* unit = &units -> units[units -> count - 1];
+    unit -> number_of_nodes = 1;
+    unit -> violation = check_node_locally(node);
+
+    if (unit -> violation != TREE_VIOLATION_NONE)
+    {
+        unit -> bad_node = node; // всё, что дальше в прямом порядке, уже не важно
+        *stop = true;
+        return TREE_NO_ERROR;
+    }
+
+    tree_error_type result = split_into_units(units, node -> yes, depth + 1, split_depth, stop);
+    if (result != TREE_NO_ERROR || *stop)
+        return result;
+
+    return split_into_units(units, node -> no, depth + 1, split_depth, stop);
+}
+
+
+static bool set_trail_step(verify_unit_t* unit, size_t* trail_capacity, size_t depth, node_t* node)
+{
+    if (depth >= *trail_capacity)
+    {
+        size_t new_capacity = (*trail_capacity == 0) ? 64 : *trail_capacity * 2;
+        path_step* new_trail = (path_step*)realloc(unit -> trail, new_capacity * sizeof(path_step));
+        if (new_trail == NULL)
+            return false;
+
+        unit -> trail = new_trail;
+        *trail_capacity = new_capacity;
+    }
+
+    unit -> trail[depth].question_node = node;
+    unit -> trail[depth].answer = false;
+    unit -> trail_length = depth + 1;
+
+    return true;
+}
+
+
+static tree_error_type verify_subtree(verify_context_t* context, size_t unit_index)
+{
+    verify_unit_t* unit = &context -> units -> units[unit_index];
+
+    verify_stack_entry* stack = NULL;
+    size_t stack_size = 0, stack_capacity = 0;
+    size_t trail_capacity = 0;
+
+    tree_error_type result = TREE_NO_ERROR;
+    verify_stack_entry start = {unit -> node, 0, true};
+
+    for (bool has_entry = true; has_entry; has_entry = (stack_size > 0))
+    {
+        verify_stack_entry entry = (stack_size == 0) ? start : stack[--stack_size];
+
+        if (unit -> number_of_nodes % VERIFY_ABORT_CHECK_PERIOD == 0 && context -> first_bad_unit < unit_index)
+            break; // нарушение уже нашлось раньше в порядке обхода, дальше проверять незачем
+
+        if (!set_trail_step(unit, &trail_capacity, entry.depth, entry.node))
+        {
+            result = TREE_ERROR_ALLOCATION;
+            break;
+        }
+        if (entry.depth > 0)
+            unit -> trail[entry.depth - 1].answer = entry.is_yes;
+
+        unit -> number_of_nodes++;
+        unit -> violation = check_node_locally(entry.node);
+
+        if (unit -> violation != TREE_VIOLATION_NONE)
+        {
+            unit -> bad_node = entry.node;
+
+            size_t first_bad = context -> first_bad_unit;
+            while (unit_index < first_bad && !context -> first_bad_unit.compare_exchange_weak(first_bad, unit_index))
+                ;
+            break;
+        }
+
+        if (entry.node -> yes == NULL)
+            continue;
+
+        if (stack_size + 2 > stack_capacity)
+        {
+            size_t new_capacity = (stack_capacity == 0) ? 64 : stack_capacity * 2;
+            verify_stack_entry* new_stack = (verify_stack_entry*)realloc(stack, new_capacity * sizeof(verify_stack_entry));
+            if (new_stack == NULL)
+            {
+                result = TREE_ERROR_ALLOCATION;
+                break;
+            }
+
+            stack = new_stack;
+            stack_capacity = new_capacity;
+        }
+
+        // no кладём первым, чтобы yes-ветка проверялась раньше
+        stack[stack_size++] = {entry.node -> no,  entry.depth + 1, false};
+        stack[stack_size++] = {entry.node -> yes, entry.depth + 1, true};
+    }
+
+    free(stack);
+    return result;
+}
+
+
+static void verify_worker(verify_context_t* context, std::atomic<bool>* allocation_failed)
+{
+    while (true)
+    {
+        size_t unit_index = context -> next_unit++;
+        if (unit_index >= context -> units -> count || unit_index > context -> first_bad_unit)
+            break;
+
+        if (!context -> units -> units[unit_index].whole_subtree)
+            continue; // верхние узлы уже проверены при разбиении
+
+        if (verify_subtree(context, unit_index) != TREE_NO_ERROR)
+            *allocation_failed = true;
+    }
+}
+
+
+static size_t choose_split_depth(size_t number_of_threads)
+{
+    size_t split_depth = 0;
+    while (((size_t)1 << split_depth) < number_of_threads * VERIFY_TASKS_PER_THREAD && split_depth < 20)
+        split_depth++;
+
+    return split_depth;
+}
+
+
+static bool is_on_path(const path_step* path, size_t path_length, const node_t* node)
+{
+    for (size_t i = 0; i < path_length; i++)
+    {
+        if (path[i].question_node == node)
+            return true;
+    }
+
+    return false;
+}
+
+
+// Путь до корня задачи восстанавливаем по обратным ссылкам: при разбиении они уже проверены
+static tree_error_type fill_report(tree_verify_report_t* report, const verify_unit_t* unit)
+{
+    size_t trail_length = unit -> whole_subtree ? unit -> trail_length : 1;
+
+    report -> path = (path_step*)calloc(unit -> depth + trail_length, sizeof(path_step));
+    if (report -> path == NULL)
+        return TREE_ERROR_ALLOCATION;
+
+    report -> path_length = unit -> depth + trail_length;
+    report -> violation   = unit -> violation;
+    report -> node        = unit -> bad_node;
+    report -> error       = TREE_ERROR_STRUCTURE;
+
+    node_t* current = unit -> node;
+    for (size_t i = unit -> depth; i > 0; i--)
+    {
+        node_t* parent = current -> parent;
+
+        report -> path[i - 1].question_node = parent;
+        report -> path[i - 1].answer = (parent -> yes == current);
+        current = parent;
+    }
+
+    if (unit -> whole_subtree)
+    {
+        for (size_t i = 0; i < unit -> trail_length; i++)
+            report -> path[unit -> depth + i] = unit -> trail[i];
+    }
+    else
+        report -> path[unit -> depth].question_node = unit -> node;
+
+    if (report -> violation == TREE_VIOLATION_PARENT_POINTER)
+    {
+        const node_t* bad = report -> node;
+        if (is_on_path(report -> path, report -> path_length, bad -> yes) ||
+            is_on_path(report -> path, report -> path_length, bad -> no))
+            report -> violation = TREE_VIOLATION_CYCLE;
+    }
+
+    return TREE_NO_ERROR;
+}
+
+
+static void free_verify_units(verify_units_t* units)
+{
+    for (size_t i = 0; i < units -> count; i++)
+        free(units -> units[i].trail);
+
+    free(units -> units);
+}
+
+
+tree_error_type tree_verify_deep(tree_t* tree, size_t number_of_threads, tree_verify_report_t* report)
+{
+    assert(report != NULL);
+
+    *report = {};
+    report -> error = TREE_NO_ERROR;
+
+    if (tree == NULL)
+        return report -> error = TREE_ERROR_NULL_PTR;
+
+    if (tree -> root == NULL)
+    {
+        if (tree -> size != 0)
+        {
+            report -> violation = TREE_VIOLATION_SIZE_MISMATCH;
+            report -> error     = TREE_ERROR_SIZE_MISMATCH;
+        }
+        return report -> error;
+    }
+
+    if (tree -> root -> parent != NULL)
+    {
+        verify_unit_t root_unit = {};
+        root_unit.node      = tree -> root;
+        root_unit.bad_node  = tree -> root;
+        root_unit.violation = TREE_VIOLATION_ROOT_PARENT;
+
+        if (fill_report(report, &root_unit) != TREE_NO_ERROR)
+            return report -> error = TREE_ERROR_ALLOCATION;
+        return report -> error;
+    }
+
+    if (number_of_threads == 0)
+        number_of_threads = std::thread::hardware_concurrency();
+    if (number_of_threads == 0)
+        number_of_threads = 1;
+
+    // на маленьком дереве запуск потоков дороже самой проверки
+    if (tree -> size / VERIFY_MIN_NODES_PER_THREAD < number_of_threads)
+        number_of_threads = tree -> size / VERIFY_MIN_NODES_PER_THREAD + 1;
+
+    verify_units_t units = {};
+    bool stop = false;
+
+    tree_error_type result = split_into_units(&units, tree -> root, 0, choose_split_depth(number_of_threads), &stop);
+    if (result != TREE_NO_ERROR)
+    {
+        free_verify_units(&units);
+        return report -> error = result;
+    }
+
+    verify_context_t context;
+    context.units = &units;
+    context.next_unit = 0;
+    context.first_bad_unit = SIZE_MAX;
+
+    std::atomic<bool> allocation_failed(false);
+
+    size_t number_of_helpers = (number_of_threads < units.count ? number_of_threads : units.count) - 1;
+    std::thread* helpers = new (std::nothrow) std::thread[number_of_helpers + 1];
+    if (helpers == NULL)
+        number_of_helpers = 0;
+
+    for (size_t i = 0; i < number_of_helpers; i++)
+        helpers[i] = std::thread(verify_worker, &context, &allocation_failed);
+
+    verify_worker(&context, &allocation_failed); // главный поток тоже работает
+
+    for (size_t i = 0; i < number_of_helpers; i++)
+        helpers[i].join();
+    delete[] helpers;
+
+    report -> number_of_threads = number_of_helpers + 1;
+
+    for (size_t i = 0; i < units.count; i++)
+    {
+        if (units.units[i].violation != TREE_VIOLATION_NONE)
+        {
+            if (fill_report(report, &units.units[i]) != TREE_NO_ERROR)
+                report -> error = TREE_ERROR_ALLOCATION;
+
+            free_verify_units(&units);
+            return report -> error;
+        }
+
+        report -> number_of_nodes += units.units[i].number_of_nodes;
+    }
+
+    free_verify_units(&units);
+
+    if (allocation_failed)
+        return report -> error = TREE_ERROR_ALLOCATION;
+
+    if (report -> number_of_nodes != tree -> size)
+    {
+        report -> violation = TREE_VIOLATION_SIZE_MISMATCH;
+        report -> error     = TREE_ERROR_SIZE_MISMATCH;
+    }
+
+    return report -> error;
+}
+
+
+void tree_verify_report_print(const tree_verify_report_t* report, FILE* stream)
+{
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    if (report -> violation == TREE_VIOLATION_NONE)
+    {
+        fprintf(stream, "Tree verification: %s (%zu nodes, %zu threads)\n", tree_error_translator(report -> error),
+                        report -> number_of_nodes, report -> number_of_threads);
+        return;
+    }
+
+    if (report -> node == NULL)
+    {
+        fprintf(stream, "Tree verification: %s\n", tree_violation_translator(report -> violation));
+        return;
+    }
+
+    const char* question = report -> node -> question;
+    fprintf(stream, "Tree verification: %s at node %p \"%s\"\n", tree_violation_translator(report -> violation),
+                    (const void*)report -> node, (question != NULL) ? question : "(null)");
+
+    fprintf(stream, "Path from root:");
+    for (size_t i = 0; i < report -> path_length; i++)
+    {
+        const char* step_question = report -> path[i].question_node -> question;
+        fprintf(stream, " \"%s\"", (step_question != NULL) ? step_question : "(null)");
+
+        if (i + 1 < report -> path_length)
+            fprintf(stream, " -%s->", report -> path[i].answer ? "yes" : "no");
+    }
+    fprintf(stream, "\n");
+}
+
+
+void tree_verify_report_destroy(tree_verify_report_t* report)
+{
+    if (report == NULL)
+        return;
+
+    free(report -> path);
+    report -> path = NULL;
+    report -> path_length = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef TREE_VERIFIER_H_
+#define TREE_VERIFIER_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tree.h"
+#include "tree_error_type.h"
+
+#define VERIFY_TASKS_PER_THREAD 8 // поддеревья разного размера, поэтому задач больше, чем потоков
+#define VERIFY_MIN_NODES_PER_THREAD 65536
+
+enum tree_violation_type
+{
+    TREE_VIOLATION_NONE           = 0,
+    TREE_VIOLATION_SIZE_MISMATCH  = 1,
+    TREE_VIOLATION_ROOT_PARENT    = 2, // у корня есть родитель
+    TREE_VIOLATION_PARENT_POINTER = 3, // ребёнок ссылается не на того родителя (или узел общий у двух родителей)
+    TREE_VIOLATION_CYCLE          = 4, // ребёнок - один из предков
+    TREE_VIOLATION_ONE_CHILD      = 5, // у вопроса должно быть ровно два ответа
+    TREE_VIOLATION_EMPTY_PHRASE   = 6,
+};
+
+// Первое нарушение в прямом порядке обхода (yes раньше no) и путь к нему от корня
+struct tree_verify_report_t
+{
+    tree_error_type error;
+    tree_violation_type violation;
+    const node_t* node;
+    path_step* path;   // path[0] - корень, ответ - куда пошли из этого узла
+    size_t path_length;
+    size_t number_of_nodes;
+    size_t number_of_threads;
+};
+
+tree_error_type tree_verify_deep(tree_t* tree, size_t number_of_threads, tree_verify_report_t* report);
+void tree_verify_report_print(const tree_verify_report_t* report, FILE* stream);
+void tree_verify_report_destroy(tree_verify_report_t* report);
+const char* tree_violation_translator(tree_violation_type violation);
+
+#endif // TREE_VERIFIER_H_